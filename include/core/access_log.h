@@ -0,0 +1,124 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class AccessLogFormat {
+    COMMON,     // NCSA common log format
+    COMBINED,   // common plus referer and user agent
+    JSON        // one JSON object per line
+};
+
+// Request access log that never blocks a worker. Each recording thread owns a
+// single-producer ring of fixed-size records; a background thread drains every ring,
+// formats the records and writes them in batches. A full ring drops the record and
+// counts it. Process-wide like ServerMetrics, so HTTP/1.1 and HTTP/2 code log without
+// extra plumbing.
+class AccessLog {
+public:
+    static const size_t RING_CAPACITY = 512;             // records per thread, power of two
+    static const int FLUSH_INTERVAL_MS = 50;
+    static const size_t WRITE_BATCH_BYTES = 64 * 1024;
+
+    // What a caller knows about one finished request. Strings are only read during record().
+    struct Request {
+        const std::string& method;
+        const std::string& path;
+        const std::map<std::string, std::string>* headers;   // lowercase names, may be null
+        const char* protocol;                                 // "HTTP/1.1", "HTTP/2"
+        const char* peer;                                     // client address, "" if unknown
+        int status;
+        size_t bytes_sent;
+        double duration_ms;
+    };
+
+    struct Stats {
+        uint64_t written;
+        uint64_t dropped;       // ring was full
+        uint64_t sampled_out;   // skipped by sampling
+    };
+
+    static AccessLog& instance();
+
+    static bool parse_format(const std::string& name, AccessLogFormat& format);
+    static const char* format_name(AccessLogFormat format);
+
+    // Client address of a connected socket ("" if unknown); call once per connection
+    static std::string peer_address(int socket);
+
+    // Path "-" writes to stdout, "off" disables logging. Keeps 1 in 'sample_every'
+    // requests per thread; 5xx responses are always kept. Only while stopped.
+    bool configure(const std::string& path, AccessLogFormat format, uint32_t sample_every);
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Hot path: one ring slot copy, no locks or syscalls
+    void record(const Request& request);
+
+    void start();
+    // Writes every record still queued, then joins the writer thread
+    void stop();
+
+    Stats get_stats() const;
+
+    // One queued request; strings are truncated to fit
+    struct Record {
+        int64_t time_ms;         // system clock, ms since the epoch
+        uint32_t duration_us;
+        uint16_t status;
+        uint64_t bytes_sent;
+        char protocol[12];
+        char method[16];
+        char peer[46];
+        char path[256];
+        char referer[128];
+        char user_agent[128];
+    };
+
+    // Appends one formatted line for 'record'
+    static void format_record(const Record& record, AccessLogFormat format, std::string& out);
+
+private:
+    struct Ring {
+        Record records[RING_CAPACITY];
+        std::atomic<size_t> head{0};   // next slot the producer writes
+        std::atomic<size_t> tail{0};   // next slot the writer reads
+        std::atomic<bool> in_use{false};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> sampled_out{0};
+        uint64_t seen = 0;             // producer only
+    };
+
+    AccessLog();
+
+    Ring* thread_ring();
+    void writer_loop();
+    bool drain(std::string& buffer);
+    void write_out(std::string& buffer);
+    void wake();
+
+    mutable std::mutex rings_mutex;
+    std::vector<std::unique_ptr<Ring>> rings;   // never shrinks; rings of exited threads are reused
+
+    std::atomic<bool> enabled{true};
+    std::atomic<uint32_t> sample_every{1};
+    AccessLogFormat format = AccessLogFormat::COMMON;
+    int output_fd;
+    bool owns_fd = false;
+
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> written{0};
+    std::thread writer_thread;
+    int wake_fd;
+
+    friend struct AccessLogRingHolder;
+};
+
+#endif // ACCESS_LOG_H
@@ -0,0 +1,59 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// In-process sampling CPU profiler. For the duration of a profile every thread registered
+// with ProcessStats gets a POSIX timer on its own CPU-time clock that sends it SIGPROF, so
+// only threads that are actually running are sampled. The signal handler unwinds the stack
+// and counts it in that thread's own fixed-size table (no locks, no allocation); tables
+// are symbolised and merged once sampling has stopped.
+class CpuProfiler {
+public:
+    static const int MAX_DEPTH = 64;
+    static const size_t STACKS_PER_THREAD = 1024;   // distinct stacks, power of two
+    static const int MAX_SECONDS = 60;
+    static const int MAX_HZ = 1000;
+    static const int DEFAULT_HZ = 99;                // off the 100 Hz beat of periodic work
+
+    // Folded stacks: "role;outermost;...;innermost" and how often each was sampled
+    struct Profile {
+        std::vector<std::pair<std::string, uint64_t>> stacks;   // sorted by stack
+        uint64_t samples;
+        uint64_t dropped;   // a thread's table was full
+        size_t threads;
+        int seconds;
+        int hz;
+    };
+
+    enum Result { OK, BUSY, FAILED };
+
+    static CpuProfiler& instance();
+
+    // Samples for 'seconds' and blocks the caller meanwhile. One profile at a time.
+    Result profile(int seconds, int hz, Profile& out);
+
+    // "stack count" lines, the input format of flamegraph.pl and speedscope
+    static std::string folded(const Profile& profile);
+
+    // Self-contained SVG flame graph (hover a frame for its name and share)
+    static std::string flamegraph_svg(const Profile& profile, const std::string& title);
+
+    // Function name of a demangled symbol without its parameter list; ';' would split a
+    // folded frame, so it is replaced
+    static std::string frame_name(const std::string& demangled);
+
+    struct ThreadTable;
+
+private:
+    CpuProfiler() = default;
+
+    std::atomic<bool> busy{false};
+};
+
+#endif // CPU_PROFILER_H
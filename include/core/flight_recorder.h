@@ -0,0 +1,127 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Last CAPACITY finished requests with their phase timestamps, kept for after-the-fact
+// diagnosis of slow requests. Recording copies one fixed-size record into a shared ring
+// (one atomic increment, no locks, no allocation); the oldest record is overwritten.
+// A background thread writes the ring to a file on SIGUSR1, and shortly after a request
+// slower than the configured threshold.
+class FlightRecorder {
+public:
+    static const size_t CAPACITY = 4096;            // records, power of two
+    static const int SLOW_CAPTURE_DELAY_MS = 200;   // let requests in flight alongside it finish
+    static const int SLOW_DUMP_INTERVAL_MS = 10000; // at most one slow-request dump per interval
+
+    enum Protocol : uint8_t { HTTP1 = 1, HTTPS, HTTP2 };
+
+    // One finished request. Timestamps are steady-clock nanoseconds (see nanos()); 0 where
+    // the protocol or request does not have that phase, e.g. accept and queue on the second
+    // request of a kept-alive connection. record() fills in sequence, worker and time_ms.
+    struct Record {
+        uint64_t sequence;
+        uint64_t connection_id;
+        int64_t time_ms;            // system clock when recorded
+        int64_t accepted_ns;
+        int64_t dequeued_ns;        // picked up by a worker
+        int64_t first_byte_ns;      // HTTP/2: stream opened
+        int64_t parsed_ns;          // HTTP/2: request complete
+        int64_t handled_ns;         // response built
+        int64_t finished_ns;        // last byte written (HTTP/2: stream closed)
+        uint64_t bytes_received;
+        uint64_t bytes_sent;
+        int32_t worker;             // kernel thread ID that recorded it
+        int32_t stream_id;          // 0 for HTTP/1.1
+        uint16_t status;
+        uint8_t protocol;
+        char method[8];
+        char path[64];              // truncated
+
+        void set_request(const std::string& method_name, const std::string& request_path);
+        // Earliest phase timestamp present; total latency is finished_ns - start_ns()
+        int64_t start_ns() const;
+    };
+
+    struct Stats {
+        uint64_t recorded;
+        uint64_t slow;      // requests over the threshold
+        uint64_t dumps;     // files written
+    };
+
+    static FlightRecorder& instance();
+
+    static int64_t nanos(std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+    static uint64_t next_connection_id();
+
+    // Dumps go to 'directory'; "off" stops recording. slow_ms 0 disables slow-request dumps.
+    bool configure(const std::string& directory, uint32_t slow_ms);
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Extra lines for the dump header (queue depth, connections); called on the dump thread
+    void set_context(std::function<std::string()> provider);
+
+    // Hot path: one ring slot copy, no locks or allocation
+    void record(Record& record);
+
+    // Records still in the ring, oldest first
+    void snapshot(std::vector<Record>& out) const;
+
+    // Writes the ring to a new file in the dump directory; returns its path, "" on failure.
+    // 'trigger' is the sequence of the slow request, or 0.
+    std::string dump(const char* reason, uint64_t trigger);
+
+    // Appends one formatted line for 'record'
+    static void format_record(const Record& record, std::string& out);
+
+    // SIGUSR1 handler: async-signal-safe, asks the dump thread to write a dump
+    static void on_dump_signal(int signal);
+
+    void start();
+    void stop();
+
+    Stats get_stats() const;
+
+private:
+    // Seqlock: odd while the slot is being written, 2 * sequence + 2 once complete
+    struct Slot {
+        std::atomic<uint64_t> version{0};
+        Record record;
+    };
+
+    FlightRecorder();
+
+    void dump_loop();
+    void wake();
+
+    Slot slots[CAPACITY];
+    std::atomic<uint64_t> next_sequence{1};
+
+    std::atomic<bool> enabled{true};
+    std::atomic<int64_t> slow_threshold_ns{0};
+    std::atomic<int64_t> last_slow_dump_ms{0};
+    std::atomic<uint64_t> slow_trigger{0};      // sequence awaiting a slow-request dump
+    std::atomic<bool> signal_requested{false};
+    std::atomic<uint64_t> slow_count{0};
+    std::atomic<uint64_t> dump_count{0};
+
+    std::mutex config_mutex;                    // directory and context
+    std::string directory;
+    std::function<std::string()> context;
+
+    std::atomic<bool> running{false};
+    std::thread dump_thread;
+    int wake_fd;
+};
+
+#endif // FLIGHT_RECORDER_H
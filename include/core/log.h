@@ -0,0 +1,81 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Diagnostics facade (the access log is separate, see access_log.h).
+//
+// Two gates:
+//  - LOG_MIN_LEVEL is a compile-time floor. Statements below it sit behind a constant
+//    false condition, so the optimiser removes them and their arguments entirely.
+//    Release builds (NDEBUG) default to DEBUG, which compiles per-frame TRACE out; other
+//    builds keep everything. Override with -DLOG_MIN_LEVEL=<0..5>.
+//  - Each module has a runtime level (default INFO). Checking it is one relaxed atomic
+//    load; the message is only formatted when the statement is enabled.
+//
+//   LOG_DEBUG(LogModule::HTTP2, "stream " << id << " closed");
+enum class LogLevel : uint8_t { TRACE = 0, DEBUG = 1, INFO = 2, WARN = 3, ERROR = 4, OFF = 5 };
+
+enum class LogModule : uint8_t { SERVER, HTTP2, WEBSOCKET, TLS, POOL, EVENTS, MODULE_COUNT };
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL 1
+#else
+#define LOG_MIN_LEVEL 0
+#endif
+#endif
+
+// Constant for a constant level, so statements below the floor fold away
+constexpr bool log_compiled_in(int level) { return level >= LOG_MIN_LEVEL; }
+
+class Log {
+public:
+    static const size_t MODULE_COUNT = static_cast<size_t>(LogModule::MODULE_COUNT);
+
+    static bool enabled(LogModule module, LogLevel level) {
+        return static_cast<uint8_t>(level) >=
+               levels[static_cast<size_t>(module)].load(std::memory_order_relaxed);
+    }
+
+    static LogLevel level(LogModule module) {
+        return static_cast<LogLevel>(levels[static_cast<size_t>(module)].load(std::memory_order_relaxed));
+    }
+    static void set_level(LogModule module, LogLevel level);
+    static void set_all(LogLevel level);
+
+    // "debug" sets every module; "http2=trace,server=debug" sets the modules named.
+    // Returns false (changing nothing) if any part is not understood.
+    static bool configure(const std::string& spec);
+
+    static bool parse_level(const std::string& name, LogLevel& level);
+    static bool parse_module(const std::string& name, LogModule& module);
+    static const char* level_name(LogLevel level);
+    static const char* module_name(LogModule module);
+
+    // One line, one write(2): WARN and above to stderr, the rest to stdout
+    static void write(LogLevel level, LogModule module, const std::string& message);
+
+private:
+    static std::atomic<uint8_t> levels[MODULE_COUNT];
+};
+
+#define LOG_AT(level, module, expr)                                                          \
+    do {                                                                                     \
+        if (log_compiled_in(static_cast<int>(level)) && Log::enabled((module), (level))) {   \
+            std::ostringstream log_stream_;                                                  \
+            log_stream_ << expr;                                                             \
+            Log::write((level), (module), log_stream_.str());                                \
+        }                                                                                    \
+    } while (0)
+
+#define LOG_TRACE(module, expr) LOG_AT(LogLevel::TRACE, module, expr)
+#define LOG_DEBUG(module, expr) LOG_AT(LogLevel::DEBUG, module, expr)
+#define LOG_INFO(module, expr) LOG_AT(LogLevel::INFO, module, expr)
+#define LOG_WARN(module, expr) LOG_AT(LogLevel::WARN, module, expr)
+#define LOG_ERROR(module, expr) LOG_AT(LogLevel::ERROR, module, expr)
+
+#endif // LOG_H
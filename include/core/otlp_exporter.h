@@ -0,0 +1,126 @@
+#ifndef OTLP_EXPORTER_H
+#define OTLP_EXPORTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "flight_recorder.h"
+#include "../handlers/otlp_writer.h"
+
+// OpenTelemetry export over OTLP/HTTP with JSON bodies, to a collector such as
+// otelcol listening on :4318. Off unless an endpoint is configured.
+//
+// Traces: each request becomes a server span with one child span per phase, built from
+// the phase timestamps the flight recorder already takes. A W3C traceparent request
+// header makes the span a child of the caller's. Sampling is decided when the request
+// finishes (tail-based): slow requests, 5xx and requests whose caller sampled them are
+// always kept, other requests 1 in sample_every. Kept spans go into a bounded queue that
+// a background thread exports in batches; a full queue drops the span and counts it.
+// Unkept requests cost a few comparisons and never take the queue lock.
+//
+// Metrics: the same thread asks a provider for a snapshot every METRICS_INTERVAL_MS and
+// exports it as cumulative sums, gauges and histograms.
+class OtlpExporter {
+public:
+    static const size_t QUEUE_CAPACITY = 2048;       // spans waiting for export
+    static const size_t BATCH_SIZE = 256;            // spans per export request
+    static const int EXPORT_INTERVAL_MS = 1000;
+    static const int METRICS_INTERVAL_MS = 10000;
+    static const int TIMEOUT_MS = 2000;              // connect, send and response, per request
+    static const uint16_t DEFAULT_PORT = 4318;
+
+    // Parsed traceparent: 00-<32 hex trace id>-<16 hex parent span id>-<2 hex flags>
+    struct TraceContext {
+        uint8_t trace_id[16];
+        uint8_t parent_id[8];
+        bool sampled;
+    };
+
+    // One kept request. Timestamps in 'request' are steady-clock nanoseconds;
+    // adding clock_offset_ns gives Unix time.
+    struct Span {
+        uint8_t trace_id[16];
+        uint8_t span_id[8];
+        uint8_t parent_id[8];
+        bool has_parent;
+        int64_t clock_offset_ns;
+        FlightRecorder::Record request;
+    };
+
+    struct Stats {
+        uint64_t spans_exported;
+        uint64_t spans_dropped;       // queue was full, or the export failed
+        uint64_t sampled_out;
+        uint64_t export_failures;     // trace and metric requests that failed
+        uint64_t metric_exports;
+    };
+
+    static OtlpExporter& instance();
+
+    static bool parse_traceparent(const std::string& header, TraceContext& context);
+
+    // 'endpoint' is http://host[:port][/prefix], or "off". Keeps 1 in 'sample_every'
+    // ordinary requests (0: none) plus every request of at least 'slow_ms'. Only while stopped.
+    bool configure(const std::string& endpoint, uint32_t sample_every, uint32_t slow_ms);
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+    const std::string& get_endpoint() const { return endpoint_url; }
+
+    // Called on the export thread to fill in the metrics of each export
+    void set_metrics_provider(std::function<void(OtlpMetricsWriter&)> provider);
+
+    // Hot path: 'traceparent' is the request header, "" if absent
+    void record(const FlightRecorder::Record& request, const std::string& traceparent);
+
+    void start();
+    // Exports the queued spans and a last metrics snapshot, then joins the export thread
+    void stop();
+
+    Stats get_stats() const;
+
+    // ExportTraceServiceRequest JSON for 'spans': per span, the server span and its phases
+    static void format_spans(const std::vector<Span>& spans, std::string& out);
+
+private:
+    OtlpExporter();
+
+    bool keep(const FlightRecorder::Record& request, bool parent_sampled);
+    void export_loop();
+    void export_spans();
+    void export_metrics();
+    bool post(const char* path, const std::string& body);
+    void wake();
+
+    std::atomic<bool> enabled{false};
+    std::atomic<uint32_t> sample_every{0};
+    std::atomic<int64_t> slow_threshold_ns{0};
+    std::string endpoint_url;
+    std::string host;
+    uint16_t port = DEFAULT_PORT;
+    std::string path_prefix;
+    int64_t start_unix_nano;
+
+    std::mutex queue_mutex;
+    std::deque<Span> queue;
+
+    std::mutex provider_mutex;
+    std::function<void(OtlpMetricsWriter&)> metrics_provider;
+
+    std::atomic<uint64_t> exported{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> sampled_out{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> metric_exports{0};
+    bool last_export_ok = true;   // export thread only; failures are logged once per outage
+
+    std::atomic<bool> running{false};
+    std::thread export_thread;
+    int wake_fd;
+};
+
+#endif // OTLP_EXPORTER_H
@@ -0,0 +1,53 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT tracepoints under the "webserver" provider, for bpftrace/perf on a live process:
+//
+//   bpftrace -e 'usdt:./bin/webserver:webserver:handler__end { @[arg2] = count(); }'
+//   perf probe -x ./bin/webserver sdt_webserver:response__sent
+//
+// Each probe is a single nop plus an ELF note; nothing happens until a tracer attaches.
+// Arguments are plain integers and char pointers (read with str() in bpftrace). HTTP/1.1
+// requests use stream ID 0.
+//
+//   accept(fd)                                   connection accepted
+//   request__parsed(fd, stream, method, path)    request headers parsed
+//   handler__start(fd, stream, method, path)     before the handler runs
+//   handler__end(fd, stream, status)             response built
+//   response__sent(fd, stream, status, bytes)    response written (HTTP/2: stream closed)
+//   tls__handshake(fd, ok)                       TLS handshake finished, ok is 0 or 1
+//   http2__stream__open(fd, stream)
+//   http2__stream__close(fd, stream, error_code)
+//   websocket__message__in(fd, opcode, bytes)    message reassembled and inflated
+//   websocket__message__out(fd, opcode, bytes)   frame fully written
+//   pool__enqueue(depth)                         injection queue depth after the push
+//   pool__dequeue(wait_ns, depth)                queue wait of the task taken
+//
+// Arguments are evaluated even with no tracer attached, so they must stay cheap: a field
+// or a relaxed atomic load, never a scan or an allocation.
+//
+// Built with <sys/sdt.h> (systemtap-sdt-dev / systemtap-sdt-devel) when it is installed;
+// otherwise, or with -DWEBSERVER_NO_PROBES, the macros expand to nothing.
+
+#if !defined(WEBSERVER_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define WEBSERVER_PROBES 1
+#endif
+#endif
+
+#ifdef WEBSERVER_PROBES
+#define SERVER_PROBE1(name, a) DTRACE_PROBE1(webserver, name, a)
+#define SERVER_PROBE2(name, a, b) DTRACE_PROBE2(webserver, name, a, b)
+#define SERVER_PROBE3(name, a, b, c) DTRACE_PROBE3(webserver, name, a, b, c)
+#define SERVER_PROBE4(name, a, b, c, d) DTRACE_PROBE4(webserver, name, a, b, c, d)
+#else
+// sizeof keeps the arguments type-checked and "used" without evaluating them
+#define SERVER_PROBE1(name, a) do { (void)sizeof(a); } while (0)
+#define SERVER_PROBE2(name, a, b) do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#define SERVER_PROBE3(name, a, b, c) do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while (0)
+#define SERVER_PROBE4(name, a, b, c, d) \
+    do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); (void)sizeof(d); } while (0)
+#endif
+
+#endif // PROBES_H
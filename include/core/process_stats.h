@@ -0,0 +1,60 @@
+#ifndef PROCESS_STATS_H
+#define PROCESS_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ctime>
+#include <sys/types.h>
+
+// Resource usage read from the kernel: process CPU time and context switches from
+// getrusage(), resident memory from /proc/self/statm, and per-thread CPU time from each
+// registered thread's CPU clock.
+class ProcessStats {
+public:
+    struct Usage {
+        double user_seconds;
+        double system_seconds;
+        uint64_t voluntary_switches;     // thread blocked (I/O, locks, sleep)
+        uint64_t involuntary_switches;   // thread preempted
+        uint64_t rss_bytes;
+    };
+
+    static Usage read_usage();
+
+    // Resident set size from /proc/self/statm, read with a single read(2); 0 if unavailable
+    static uint64_t read_rss_bytes();
+
+    // Attribute the calling thread's CPU time to 'role' until the thread exits
+    static void register_thread(const char* role);
+
+    // CPU seconds per role, including threads of that role that have already exited
+    static std::vector<std::pair<std::string, double>> thread_cpu_by_role();
+
+    struct ThreadInfo {
+        pid_t tid;          // kernel thread id
+        clockid_t clock;    // the thread's CPU-time clock
+        std::string role;
+    };
+
+    // Threads registered right now (the CPU profiler samples these)
+    static std::vector<ThreadInfo> registered_threads();
+};
+
+// Process CPU utilisation between successive calls. Not thread-safe: each sampler belongs
+// to one caller (PerformanceMetrics samples under its own lock).
+class CpuSampler {
+public:
+    CpuSampler();
+
+    // Percent of one core used since the previous call (may exceed 100 on several cores)
+    double sample();
+
+private:
+    double last_cpu_seconds;
+    std::chrono::steady_clock::time_point last_wall;
+};
+
+#endif // PROCESS_STATS_H
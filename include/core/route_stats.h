@@ -0,0 +1,96 @@
+#ifndef ROUTE_STATS_H
+#define ROUTE_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../handlers/request_recorder.h"
+
+// Request counts and latencies per route template ("/api/users/{id}", not one entry per
+// user id). The router's fixed routes are registered up front and static files on their
+// first successful response, up to MAX_ROUTES templates; anything else, including every
+// 404, is counted under OVERFLOW_ROUTE, so memory is bounded whatever paths clients send.
+//
+// Nothing here takes a lock. Templates live in an open-addressed table whose entries are
+// claimed with a compare-and-swap; counters are sharded per thread like RequestRecorder's.
+// Each route keeps its totals since start and its latencies in two 30-second slots.
+class RouteStats {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    static const size_t MAX_ROUTES = 32;       // not counting the overflow entry
+    static const size_t NAME_LENGTH = 64;      // longer templates overflow
+    static const int SLOT_SECONDS = 30;
+    static const int SLOT_COUNT = 2;
+    static const char* const OVERFLOW_ROUTE;
+
+    struct Summary {
+        std::string route;
+        uint64_t requests;
+        uint64_t server_errors;        // 5xx responses
+        uint64_t latency_sum_micros;
+        LatencyHistogram recent;       // the current and the previous slot (30 to 60 seconds)
+    };
+
+    RouteStats();
+    RouteStats(const RouteStats&) = delete;
+    RouteStats& operator=(const RouteStats&) = delete;
+
+    static RouteStats& instance();
+
+    // Template of a request path as the server routes it, written to 'out' (NAME_LENGTH
+    // bytes, NUL-terminated) without allocating. Returns its length: 0 for paths that are
+    // not a route (unknown API endpoints, missing files, unparsable requests) or whose
+    // template is too long to be tracked.
+    static size_t route_template(const char* path, size_t length, int status_code, char* out);
+    static std::string route_template(const std::string& path, int status_code);
+
+    void record(const std::string& path, int status_code, double response_time_ms) {
+        record_at(std::chrono::steady_clock::now(), path, status_code, response_time_ms);
+    }
+    void record_at(TimePoint now, const std::string& path, int status_code, double response_time_ms);
+
+    // Routes with at least one request, overflow included
+    std::vector<Summary> snapshot(TimePoint now) const;
+    size_t route_count() const { return std::min(routes.load(std::memory_order_relaxed), MAX_ROUTES); }
+
+private:
+    static const size_t TABLE_SIZE = 64;   // power of two, at least twice MAX_ROUTES
+    enum EntryState { EMPTY, CLAIMED, READY };
+
+    struct Slot {
+        std::atomic<int64_t> epoch;
+        std::atomic<uint32_t> counts[LatencyHistogram::BUCKET_COUNT];
+    };
+
+    struct Shard {
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> server_errors;
+        std::atomic<uint64_t> latency_sum;
+        Slot slots[SLOT_COUNT];
+    };
+
+    // Name and counters are written once by the thread that claims the entry, before
+    // it publishes READY
+    struct Entry {
+        std::atomic<int> state{EMPTY};
+        uint64_t hash = 0;
+        char name[NAME_LENGTH] = {};
+        std::unique_ptr<Shard[]> shards;
+    };
+
+    Entry* find(const char* route, size_t length, bool add);
+    Summary summarize(const Entry& entry, int64_t current_slot) const;
+
+    TimePoint start_time;
+    Entry table[TABLE_SIZE];
+    Entry overflow;
+    std::atomic<size_t> routes{0};
+};
+
+#endif // ROUTE_STATS_H
@@ -18,10 +18,13 @@
 #include "../network/http_request.h"
 #include "../handlers/file_handler.h"
 #include "thread_pool.h"
+#include "server_metrics.h"
 #include "../handlers/json_handler.h"
 #include "../handlers/websocket_handler.h"
 #include "../handlers/http2_handler.h"
 
+class OtlpMetricsWriter;
+
 class WebServer {
 private:
     int server_fd;
@@ -32,6 +35,14 @@ private:
     std::unique_ptr<ThreadPool> thread_pool;
     std::unique_ptr<WebSocketHandler> websocket_handler;
     std::shared_ptr<PerformanceMetrics> performance_metrics;
+    std::shared_ptr<EventStreamHub> event_stream;
+    
+    // Server-sent events endpoint for live metrics (HTTP/1.1 and HTTP/2)
+    static constexpr const char* EVENT_STREAM_PATH = "/api/metrics/stream";
+    // Prometheus text exposition of ServerMetrics and the request histograms
+    static constexpr const char* METRICS_PATH = "/metrics";
+    // Liveness probe; queued ahead of other work
+    static constexpr const char* HEALTH_PATH = "/health";
     
     // Keep-Alive support with proper thread safety
     std::atomic<bool> keep_alive_enabled;
@@ -55,6 +66,9 @@ private:
     // HTTP/2 support
     std::atomic<bool> http2_enabled;
     
+    // /api/profile is opt-in: a profile ties up a worker for its whole duration
+    std::atomic<bool> profiler_enabled{false};
+    
     // TLS/ALPN support
     std::atomic<bool> tls_enabled;
     SSL_CTX* ssl_ctx;
@@ -63,6 +77,8 @@ private:
     
 public:
     WebServer(int port = 8080, const std::string& doc_root = "./www", size_t thread_count = 4);
+    // Elastic worker pool between pool_scaling.min_threads and max_threads
+    WebServer(int port, const std::string& doc_root, const ThreadPool::Scaling& pool_scaling);
     ~WebServer();
     
     // Non-copyable
@@ -73,9 +89,18 @@ public:
     void start();
     void cleanup();
     
-    void handle_client_task_safe(int client_socket);
+    // 'lane' is the thread pool lane the acceptor chose from the first request line
+    void handle_client_task_safe(int client_socket, std::chrono::steady_clock::time_point accepted,
+                                 std::chrono::steady_clock::time_point dequeued,
+                                 ThreadPool::Priority lane = ThreadPool::NORMAL);
     int extract_status_code(const std::string& response) const;
-    bool read_request_with_timeout(int socket, std::string& headers_data, std::chrono::seconds timeout);
+    // Admission control in the acceptor: the thread pool lane for a new connection, from its
+    // first request line if that has arrived, and the 503 sent when the lane is full
+    static ThreadPool::Priority connection_priority(int client_socket);
+    static void send_overloaded(int client_socket);
+    // 'first_byte', when given, is set to the time the first bytes arrived
+    bool read_request_with_timeout(int socket, std::string& headers_data, std::chrono::seconds timeout,
+                                   std::chrono::steady_clock::time_point* first_byte = nullptr);
     bool send_response_safe(int socket, const std::string& response);
     void add_connection_safe(int socket);
     void update_connection_timestamp_safe(int socket);
@@ -87,6 +112,28 @@ public:
     void enable_http2(bool enable);
     bool is_http2_enabled() const { return http2_enabled.load(); }
     
+    // WebSocket limits
+    void set_websocket_max_message_size(size_t max_bytes);
+    // Per-client outbound queue limit and slow-consumer policy; 0 / "" keep the defaults
+    void set_websocket_backpressure(size_t max_outbound_bytes, const std::string& policy_name);
+    
+    // Access log destination ("-" for stdout, "off"), format name and 1-in-N sampling
+    bool set_access_log(const std::string& path, const std::string& format_name, uint32_t sample_every);
+    
+    // Serve CPU profiles at /api/profile
+    void enable_profiler(bool enable);
+    
+    // Flight recorder dump directory ("off" stops recording) and slow-request threshold (0 = none)
+    bool set_flight_recorder(const std::string& directory, uint32_t slow_request_ms);
+    
+    // OTLP/HTTP collector ("off" disables), 1-in-N sampling of ordinary requests and the
+    // duration from which every request is traced
+    bool set_otlp_export(const std::string& endpoint, uint32_t sample_every, uint32_t slow_ms);
+    
+    // Connections each thread pool lane may queue, as "high=256,normal=1024,low=256" (0 for
+    // no limit); past it the acceptor answers 503 itself
+    bool set_queue_limits(const std::string& spec);
+    
     // TLS/ALPN support
     void enable_tls(bool enable, const std::string& cert_file = "", const std::string& key_file = "");
     bool is_tls_enabled() const { return tls_enabled.load(); }
@@ -106,8 +153,10 @@ private:
     bool send_http2_upgrade_response(int client_socket);
     
     // HTTP connection handling
-    // Returns true if the connection was upgraded to WebSocket and ownership of the socket is transferred
-    bool handle_http_connection(int client_socket);
+    // Returns true if the connection was upgraded to WebSocket and ownership of the socket is transferred.
+    // A connection admitted outside the normal lane serves its first request only.
+    bool handle_http_connection(int client_socket, std::chrono::steady_clock::time_point accepted,
+                                std::chrono::steady_clock::time_point dequeued, bool single_request);
     
     // TLS/ALPN handling
     bool initialize_ssl_context();
@@ -144,6 +193,12 @@ private:
     std::string handle_users_api(const HttpRequest& request);
     std::string handle_user_api(const HttpRequest& request, const std::string& user_id);
     std::string handle_server_stats_api(const HttpRequest& request);
+    std::string handle_log_levels_api(const HttpRequest& request);
+    std::string handle_profile_api(const HttpRequest& request);
+    std::string handle_request_rate_api(const HttpRequest& request);
+    std::string handle_metrics_history_api(const HttpRequest& request);
+    std::string handle_metrics_request(const HttpRequest& request);
+    void write_otlp_metrics(OtlpMetricsWriter& out);
     std::string handle_api_docs(const HttpRequest& request);
     std::string handle_dashboard_request(const HttpRequest& request);
     std::string handle_admin_dashboard_request(const HttpRequest& request);
@@ -165,8 +220,8 @@ private:
     bool should_keep_alive(const HttpRequest& request) const;
     
     // Logging
-    void log_request(const std::string& method, const std::string& path, int status_code, 
-                    const std::chrono::milliseconds& duration) const;
+    void log_request(const HttpRequest& request, int status_code, size_t response_bytes,
+                     double duration_ms, const char* peer) const;
     void safe_cout(const std::string& message) const;
     
     // Data management helpers
@@ -176,6 +231,9 @@ private:
     bool is_api_path(const std::string& path) const;
     bool is_websocket_path(const std::string& path) const;
     
+    // Admission control in the acceptor
+    void reject_overloaded(int client_socket);
+    
     // Performance monitoring
     void start_metrics_collection();
     void stop_metrics_collection();
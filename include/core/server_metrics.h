@@ -0,0 +1,143 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "../handlers/request_recorder.h"
+
+// Process-wide counters behind GET /metrics, updated on the hot path and never walked.
+// Per-request counters are relaxed atomic adds on the calling thread's shard (same
+// assignment as RequestRecorder); rarer events use single atomics.
+class ServerMetrics {
+public:
+    enum Protocol { HTTP1, HTTP2, PROTOCOL_COUNT };
+
+    // Route groups, matching the server's router; a fixed set keeps label cardinality bounded
+    enum Route {
+        ROUTE_STATIC,
+        ROUTE_API,
+        ROUTE_DASHBOARD,
+        ROUTE_WEBSOCKET,
+        ROUTE_EVENT_STREAM,
+        ROUTE_METRICS,
+        ROUTE_COUNT
+    };
+
+    // Stages of an HTTP/1.1 request, each timed between two timestamps:
+    //   accept     accept() returned -> handed to the thread pool
+    //   queue      handed to the pool -> picked up by a worker
+    //   first_byte picked up -> first request byte read (first request on a connection only)
+    //   read       first byte -> headers read and parsed
+    //   handler    parsed -> response built
+    //   write      response built -> last byte sent
+    enum Phase {
+        PHASE_ACCEPT,
+        PHASE_QUEUE,
+        PHASE_FIRST_BYTE,
+        PHASE_READ,
+        PHASE_HANDLER,
+        PHASE_WRITE,
+        PHASE_COUNT
+    };
+
+    // Connections held by a pool worker; WebSocket and event stream clients are counted
+    // by their own handlers
+    enum ConnectionState { CONN_HTTP1, CONN_HTTP2, CONNECTION_STATE_COUNT };
+
+    static const size_t STATUS_CLASS_COUNT = 5;          // 1xx .. 5xx
+    static const size_t QUEUE_WAIT_BUCKET_COUNT = 12;
+    static const double QUEUE_WAIT_BOUNDS[QUEUE_WAIT_BUCKET_COUNT];   // seconds
+
+    static ServerMetrics& instance();
+
+    static Route route_for(const std::string& path);
+    static const char* route_name(Route route);
+    static const char* protocol_name(Protocol protocol);
+    static const char* connection_state_name(ConnectionState state);
+    static const char* phase_name(Phase phase);
+
+    // Hot path
+    void record_request(Route route, Protocol protocol, int status_code);
+    void add_bytes_received(size_t bytes);
+    void add_bytes_sent(size_t bytes);
+    void record_queue_wait(std::chrono::steady_clock::duration wait);   // also records PHASE_QUEUE
+    void record_phase(Phase phase, std::chrono::steady_clock::duration elapsed);
+    void record_phase(Phase phase, std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        record_phase(phase, to - from);
+    }
+
+    void connection_accepted() { accepted.fetch_add(1, std::memory_order_relaxed); }
+    void connection_opened(ConnectionState state) { connections[state].fetch_add(1, std::memory_order_relaxed); }
+    void connection_closed(ConnectionState state) { connections[state].fetch_sub(1, std::memory_order_relaxed); }
+    void record_tls_handshake(bool ok);
+    void http2_stream_opened();
+    void http2_stream_closed() { http2_streams_active.fetch_sub(1, std::memory_order_relaxed); }
+
+    // Counts a connection in 'state' for the lifetime of the scope
+    class ConnectionScope {
+    public:
+        explicit ConnectionScope(ConnectionState state) : state(state) { ServerMetrics::instance().connection_opened(state); }
+        ~ConnectionScope() { ServerMetrics::instance().connection_closed(state); }
+        ConnectionScope(const ConnectionScope&) = delete;
+        ConnectionScope& operator=(const ConnectionScope&) = delete;
+    private:
+        ConnectionState state;
+    };
+
+    // Moves a connection to another state for the lifetime of the scope
+    class StateScope {
+    public:
+        StateScope(ConnectionState from, ConnectionState to);
+        ~StateScope();
+        StateScope(const StateScope&) = delete;
+        StateScope& operator=(const StateScope&) = delete;
+    private:
+        ConnectionState from;
+        ConnectionState to;
+    };
+
+    // Readers sum the shards
+    uint64_t requests(Route route, Protocol protocol, size_t status_class) const;
+    uint64_t bytes_received() const;
+    uint64_t bytes_sent() const;
+    // cumulative[i] counts waits <= QUEUE_WAIT_BOUNDS[i]; the last entry counts every wait
+    void queue_wait(uint64_t cumulative[QUEUE_WAIT_BUCKET_COUNT + 1], double& sum_seconds) const;
+    // Phase durations in nanoseconds, merged from every shard; values above ~4.3 s share
+    // the last bucket
+    LatencyHistogram phase_histogram(Phase phase) const;
+    uint64_t phase_sum_nanos(Phase phase) const;
+
+    uint64_t connections_accepted() const { return accepted.load(std::memory_order_relaxed); }
+    int64_t open_connections(ConnectionState state) const { return connections[state].load(std::memory_order_relaxed); }
+    uint64_t tls_handshakes(bool ok) const;
+    uint64_t http2_streams_started() const { return http2_streams_total.load(std::memory_order_relaxed); }
+    int64_t http2_streams_open() const { return http2_streams_active.load(std::memory_order_relaxed); }
+
+private:
+    ServerMetrics() = default;
+
+    struct Shard {
+        std::atomic<uint64_t> requests[ROUTE_COUNT][PROTOCOL_COUNT][STATUS_CLASS_COUNT];
+        std::atomic<uint64_t> bytes_received;
+        std::atomic<uint64_t> bytes_sent;
+        std::atomic<uint64_t> queue_wait[QUEUE_WAIT_BUCKET_COUNT + 1];
+        std::atomic<uint64_t> queue_wait_nanos;
+        std::atomic<uint64_t> phases[PHASE_COUNT][LatencyHistogram::BUCKET_COUNT];
+        std::atomic<uint64_t> phase_nanos[PHASE_COUNT];
+        char padding[64];   // keeps the next shard's counters off this shard's last cache line
+    };
+
+    // Static storage: every counter starts at zero
+    Shard shards[RequestRecorder::SHARD_COUNT];
+    std::atomic<uint64_t> accepted;
+    std::atomic<int64_t> connections[CONNECTION_STATE_COUNT];
+    std::atomic<uint64_t> tls_ok;
+    std::atomic<uint64_t> tls_failed;
+    std::atomic<uint64_t> http2_streams_total;
+    std::atomic<int64_t> http2_streams_active;
+};
+
+#endif // SERVER_METRICS_H
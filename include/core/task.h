@@ -0,0 +1,127 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only type-erased void() callable for the thread pool. Unlike std::function it
+// accepts move-only captures (sockets wrapped in unique_ptr, promises), and it keeps
+// callables of up to INLINE_SIZE bytes inside the object: a connection task capturing
+// a pointer, a socket and a timestamp is stored without touching the heap. Larger or
+// throwing-move callables fall back to one allocation. sizeof(Task) is 64 bytes.
+class Task {
+public:
+    static const size_t INLINE_SIZE = 56;
+
+    Task() noexcept : vtable(nullptr) {}
+
+    template <typename F, typename = typename std::enable_if<
+                              !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& function) : vtable(nullptr) {
+        typedef typename std::decay<F>::type Callable;
+        construct<Callable>(std::forward<F>(function), std::integral_constant<bool, fits_inline<Callable>()>());
+    }
+
+    Task(Task&& other) noexcept : vtable(other.vtable) {
+        if (vtable) {
+            vtable->move(storage, other.storage);
+            other.vtable = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.vtable) {
+                vtable = other.vtable;
+                vtable->move(storage, other.storage);
+                other.vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { vtable->invoke(storage); }
+    explicit operator bool() const { return vtable != nullptr; }
+
+    // True when the callable lives in the inline buffer (no allocation was made)
+    bool is_inline() const { return vtable && vtable->is_inline; }
+
+    void reset() {
+        if (vtable) {
+            vtable->destroy(storage);
+            vtable = nullptr;
+        }
+    }
+
+private:
+    struct VTable {
+        void (*invoke)(void* storage);
+        void (*move)(void* destination, void* source);   // move-constructs, destroys the source
+        void (*destroy)(void* storage);
+        bool is_inline;
+    };
+
+    template <typename Callable>
+    static constexpr bool fits_inline() {
+        return sizeof(Callable) <= INLINE_SIZE && alignof(Callable) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Callable>::value;
+    }
+
+    template <typename Callable>
+    struct Inline {
+        static void invoke(void* storage) { (*static_cast<Callable*>(storage))(); }
+        static void move(void* destination, void* source) {
+            Callable* from = static_cast<Callable*>(source);
+            new (destination) Callable(std::move(*from));
+            from->~Callable();
+        }
+        static void destroy(void* storage) { static_cast<Callable*>(storage)->~Callable(); }
+        static const VTable table;
+    };
+
+    // The buffer holds only the pointer; moving a Task moves the pointer
+    template <typename Callable>
+    struct Heap {
+        static Callable*& target(void* storage) { return *static_cast<Callable**>(storage); }
+        static void invoke(void* storage) { (*target(storage))(); }
+        static void move(void* destination, void* source) { new (destination) Callable*(target(source)); }
+        static void destroy(void* storage) { delete target(storage); }
+        static const VTable table;
+    };
+
+    template <typename Callable, typename F>
+    void construct(F&& function, std::true_type) {
+        new (storage) Callable(std::forward<F>(function));
+        vtable = &Inline<Callable>::table;
+    }
+
+    template <typename Callable, typename F>
+    void construct(F&& function, std::false_type) {
+        new (storage) Callable*(new Callable(std::forward<F>(function)));
+        vtable = &Heap<Callable>::table;
+    }
+
+    // Buffer first, so the vtable pointer fills the tail of the last 16-byte block
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    const VTable* vtable;
+};
+
+static_assert(sizeof(Task) == 64, "a Task fills exactly one cache line");
+
+template <typename Callable>
+const Task::VTable Task::Inline<Callable>::table = {&Inline<Callable>::invoke, &Inline<Callable>::move,
+                                                    &Inline<Callable>::destroy, true};
+
+template <typename Callable>
+const Task::VTable Task::Heap<Callable>::table = {&Heap<Callable>::invoke, &Heap<Callable>::move,
+                                                  &Heap<Callable>::destroy, false};
+
+#endif // TASK_H
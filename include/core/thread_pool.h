@@ -2,23 +2,191 @@
 #define THREAD_POOL_H
 
 #include <vector>
-#include <queue>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <functional>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "task.h"
 
+// Chase-Lev work-stealing deque of pointers with a fixed capacity (Lê et al., "Correct and
+// Efficient Work-Stealing for Weak Memory Models"). The owning thread pushes and pops at
+// the bottom, newest first; other threads steal from the top, oldest first. Only a pop
+// of the last item or a steal takes a CAS; a push is two plain stores.
+template <typename T, size_t Capacity>
+class WorkStealingDeque {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+    
+    WorkStealingDeque() {
+        for (auto& slot : slots) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    
+    // Owner only; false when full
+    bool push(T* item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= static_cast<int64_t>(Capacity)) {
+            return false;
+        }
+        slots[b & MASK].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+    
+    // Owner only; null when empty or a thief took the last item
+    T* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = slots[b & MASK].load(std::memory_order_relaxed);
+        if (t == b) {
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+    
+    // Any thread; null when empty or another thread won the race for the top item
+    T* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T* item = slots[t & MASK].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+    
+    // Approximate while the owner and thieves are active
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    static const int64_t MASK = static_cast<int64_t>(Capacity) - 1;
+    
+    // Thieves write top, the owner writes bottom: keep them on separate cache lines
+    std::atomic<int64_t> top{0};
+    char top_padding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom{0};
+    char bottom_padding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<T*> slots[Capacity];
+};
+
+// Work-stealing pool. Each worker runs tasks from its own deque, newest first, so a task
+// enqueued by a worker usually runs on the same core while its data is still in cache.
+// Tasks from other threads (the acceptor) go to a shared injection queue, which workers
+// take from oldest first, one task at a time. The injection queue has a lane per priority,
+// each with an optional length limit; workers pick among the lanes by weight. A worker
+// with nothing to do steals the oldest task of a randomly chosen worker, spins for a few
+// microseconds, then parks on its own futex until a wakeup is aimed at it: idle workers
+// use no CPU, and a new task is picked up by a spinning worker or the most recently
+// parked one.
+//
+// Scheduling allocates nothing in steady state: the callable lives inline in a Task,
+// queue nodes are recycled through per-thread caches, and the injection queue is a ring
+// that only grows.
+//
+// An elastic pool (max_threads > min_threads) runs a controller thread. While every
+// worker is busy it looks every SCALE_INTERVAL at how long tasks wait, from their enqueue
+// timestamps, and starts a worker when the wait exceeds the target. A worker parked for
+// the idle cooldown is retired, coldest first, down to min_threads. Worker slots (deque
+// and futex word) for max_threads exist from the start, so stealing never races a resize.
 class ThreadPool {
 public:
+    // Injection lanes, most urgent first
+    enum Priority { HIGH, NORMAL, LOW, PRIORITY_COUNT };
+    
+    struct Scaling {
+        size_t min_threads = 4;
+        size_t max_threads = 4;                                // equal to min_threads: fixed size, no controller
+        std::chrono::milliseconds target_wait{10};             // start a worker when tasks wait longer
+        std::chrono::milliseconds idle_cooldown{30000};        // retire a worker parked this long
+        
+        static Scaling fixed(size_t num_threads) {
+            Scaling scaling;
+            scaling.min_threads = num_threads;
+            scaling.max_threads = num_threads;
+            return scaling;
+        }
+    };
+    
+    // What the controller did; counters only grow
+    struct ScalingStats {
+        size_t min_threads;
+        size_t max_threads;
+        uint64_t started;                  // workers added because tasks waited too long
+        uint64_t retired;                  // workers stopped after the idle cooldown
+        uint64_t saturated;                // checks that wanted a worker at max_threads
+        double last_wait_ms;               // longest wait seen by the last check
+    };
+    
+
+    static const size_t LOCAL_CAPACITY = 256;     // per-worker deque; overflow goes to the injection queue
+    static const int SPIN_ROUNDS = 128;           // find_task attempts before parking, a pause apart
+    static const size_t NODE_CACHE_SIZE = 64;     // recycled queue nodes kept per thread
+    static const size_t NODE_DEPOT_SIZE = 4096;   // recycled queue nodes shared between threads
+    static const int SCALE_INTERVAL_MS = 10;      // controller period while every worker is busy
+    static const int RETIRE_INTERVAL_MS = 100;    // controller period while some workers are idle
+    
+    static const unsigned PRIORITY_WEIGHTS[PRIORITY_COUNT];   // share of picks while several lanes wait
+    
+    struct LaneStats {
+        size_t queued;
+        size_t limit;                      // 0: unlimited
+        uint64_t rejected;                 // enqueues refused at the limit
+    };
+    
+    static const char* priority_name(Priority priority);
+    static bool parse_priority(const std::string& name, Priority& priority);
+    
     // Constructor: create pool with specified number of threads
     ThreadPool(size_t num_threads);
     
+    // Elastic pool: starts min_threads workers and lets the controller add and retire them
+    explicit ThreadPool(const Scaling& scaling);
+    
     // Destructor: stop all threads and clean up
     ~ThreadPool();
     
-    // Add a task to the queue
-    void enqueue(std::function<void()> task);
+    // Add a task to the queue: the calling worker's deque, or the injection lane for its
+    // priority. Lambdas and std::function convert to Task implicitly. False, with the task
+    // destroyed unrun, when the lane is at its limit or the pool is stopping. Tasks from a
+    // worker stay on its deque; priorities and limits only apply to the lanes.
+    bool enqueue(Task task, Priority priority = NORMAL);
+    
+    // Add several tasks with one lock of the injection queue (none from a worker whose
+    // deque has room) and wake up to one parked worker per task. Returns how many were
+    // queued; tasks past the lane's limit are destroyed unrun.
+    size_t enqueue_batch(std::vector<Task> tasks, Priority priority = NORMAL);
+    
+    // Most tasks a lane holds before enqueue refuses more; 0 (the default) is unlimited
+    void set_queue_limit(Priority priority, size_t limit);
+    
+    // Limits as "high=64,normal=1024,low=256"; lanes not named keep theirs. Nothing is
+    // applied unless the whole spec is valid.
+    bool configure_limits(const std::string& spec);
     
     // Stop the thread pool
     void stop();
@@ -26,25 +194,104 @@ public:
     // Get number of active threads
     size_t get_thread_count() const;
     
-    // Get number of pending tasks
+    ScalingStats get_scaling_stats() const;
+    LaneStats get_lane_stats(Priority priority) const;
+    
+    // Get number of pending tasks (sums the queues without locking, so approximate)
     size_t get_queue_size() const;
 
 private:
-    // Worker threads
+    // Enqueue times feed the queue wait histogram in ServerMetrics
+    struct QueuedTask {
+        Task function;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+    struct NodeCache;
+    static NodeCache& node_cache();
+    static QueuedTask* acquire_node(Task&& task, std::chrono::steady_clock::time_point enqueued);
+    static void release_node(QueuedTask* node);
+    typedef WorkStealingDeque<QueuedTask, LOCAL_CAPACITY> LocalQueue;
+    
+    // Worker slots, max_threads of them; deques[i] belongs to workers[i]. Slots past
+    // slot_limit hold no worker. Only the constructor, the controller and stop() touch
+    // workers, under control_mutex.
+    Scaling scaling;
     std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<LocalQueue>> deques;
+    std::atomic<size_t> live_workers{0};
+    std::atomic<size_t> slot_limit{0};
+    
+    // Injection queue for tasks enqueued outside the pool's workers, one lane per
+    // priority. Each lane is a ring of count tasks from head, doubled when full.
+    struct Lane {
+        std::vector<QueuedTask*> ring;
+        size_t head = 0;
+        size_t count = 0;
+        size_t limit = 0;
+        int credit = 0;                        // smooth weighted round robin state
+        std::atomic<uint64_t> rejected{0};
+        
+        void push_back(QueuedTask* task);
+        QueuedTask* pop_front();
+    };
+    mutable std::mutex injection_mutex;
+    Lane lanes[PRIORITY_COUNT];
+    size_t injection_count = 0;              // all lanes
+    std::atomic<size_t> injection_size{0};   // injection_count, readable without the lock
+    std::atomic<size_t> urgent_size{0};      // lanes[HIGH].count, readable without the lock
+    
+    // Parking: one futex word per worker, so a wakeup goes to one chosen worker
+    enum ParkState : uint32_t { RUNNING, PARKED, NOTIFIED };
+    struct Parker {
+        std::atomic<int64_t> parked_since{0};   // steady_clock ticks, for the idle cooldown
+        std::atomic<uint32_t> state{RUNNING};
+        std::atomic<bool> retire{false};        // set by the controller before it wakes us
+        char padding[64 - sizeof(std::atomic<int64_t>) - sizeof(std::atomic<uint32_t>) - sizeof(std::atomic<bool>)];
+    };
+    std::unique_ptr<Parker[]> parkers;
     
-    // Task queue
-    std::queue<std::function<void()>> tasks;
+    // Parked workers, most recent last; enqueue only takes idle_mutex when idle_workers > 0
+    mutable std::mutex idle_mutex;
+    std::vector<size_t> idle_stack;
+    std::atomic<size_t> idle_workers{0};
+    std::atomic<size_t> spinning{0};    // workers looking for work before they park, at most half
     
-    // Synchronization
-    mutable std::mutex queue_mutex;           // Protects the task queue
-    std::condition_variable condition; // Wakes up sleeping threads
+    // Controller (elastic pools only). It sleeps on control_cv while some worker is idle;
+    // wake_one() notifies it when a task finds every worker busy.
+    std::thread controller;
+    mutable std::mutex control_mutex;
+    std::condition_variable control_cv;
+    std::atomic<bool> controller_sleeping{false};
+    std::atomic<int64_t> max_wait{0};    // longest dequeue wait since the last check, in ns
+    std::atomic<uint64_t> started{0};
+    std::atomic<uint64_t> retired{0};
+    std::atomic<uint64_t> saturated{0};
+    std::atomic<int64_t> last_wait{0};   // ns
     
     // Control flags
     std::atomic<bool> stop_flag;      // Signal to stop threads
     
     // Worker function that each thread runs
-    void worker();
+    void worker(size_t index);
+    void start_worker(size_t index);
+    void control();
+    std::chrono::steady_clock::duration oldest_wait(std::chrono::steady_clock::time_point now) const;
+    bool grow();
+    bool retire_one(std::chrono::steady_clock::time_point now);
+    void notify_controller();
+    bool push_local(QueuedTask* task);
+    bool inject(QueuedTask* task, Priority priority);
+    QueuedTask* take_front(Priority first);
+    void publish_sizes();
+    QueuedTask* find_task(size_t index);
+    QueuedTask* take_injected();
+    QueuedTask* steal(size_t index);
+    QueuedTask* spin(size_t index);
+    void park(size_t index);
+    bool has_work() const;
+    void wake_one();
+    void wake_all();
+    void run(QueuedTask* task);
 };
 
-#endif // THREAD_POOL_H
\ No newline at end of file
+#endif // THREAD_POOL_H
@@ -0,0 +1,100 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+// One client of a server-sent event stream. Publishers append formatted events; the
+// transport that owns the client (HTTP/1.1 writer thread or HTTP/2 stream) drains them.
+class EventStreamSubscriber {
+public:
+    // notify_fd is an eventfd written whenever new data is queued (-1 for none)
+    EventStreamSubscriber(int notify_fd, size_t max_pending);
+
+    EventStreamSubscriber(const EventStreamSubscriber&) = delete;
+    EventStreamSubscriber& operator=(const EventStreamSubscriber&) = delete;
+
+    // Queue an event; a client that falls max_pending bytes behind is closed instead.
+    // It reconnects with Last-Event-ID and resumes from there.
+    bool push(const std::string& event);
+
+    // Move queued bytes into 'out'. Returns false once the subscriber is closed and drained.
+    bool take(std::string& out);
+
+    void close();
+    bool is_closed() const;
+
+private:
+    void notify();
+
+    mutable std::mutex mutex;
+    std::string pending;
+    bool closed;
+    int notify_fd;
+    size_t max_pending;
+};
+
+// Fan-out point for the live metrics event stream (/api/metrics/stream). Events are
+// published once and shared by HTTP/1.1 clients, which are all served by a single writer
+// thread, and by HTTP/2 streams, which are drained by their connection's thread.
+class EventStreamHub {
+public:
+    static const size_t DEFAULT_MAX_PENDING = 256 * 1024;
+    static const int HEARTBEAT_SECONDS = 15;
+    static const int RETRY_MS = 3000;
+
+    EventStreamHub();
+    ~EventStreamHub();
+
+    EventStreamHub(const EventStreamHub&) = delete;
+    EventStreamHub& operator=(const EventStreamHub&) = delete;
+
+    // Builds the events a new client receives first from its Last-Event-ID ("" if none)
+    void set_replay(std::function<std::string(const std::string&)> replay);
+
+    // Register a client; its first events (retry hint and replay) are already queued
+    std::shared_ptr<EventStreamSubscriber> subscribe(const std::string& last_event_id, int notify_fd);
+    void publish(uint64_t id, const std::string& data);
+    size_t subscriber_count() const;
+
+    // HTTP/1.1: send the response head and hand the socket to the writer thread
+    bool attach_socket(int socket, const std::string& last_event_id);
+
+    void start();
+    void stop();
+
+    // "id: <id>" followed by one "data:" line per line of 'data'
+    static std::string format_event(uint64_t id, const std::string& data);
+
+private:
+    struct SocketClient {
+        int socket;
+        std::shared_ptr<EventStreamSubscriber> subscriber;
+        std::string output;
+        size_t offset;
+    };
+
+    void writer_loop();
+    bool write_client(SocketClient& client);
+    void close_client(SocketClient& client);
+
+    mutable std::mutex subscribers_mutex;
+    std::vector<std::weak_ptr<EventStreamSubscriber>> subscribers;
+    std::function<std::string(const std::string&)> replay;
+
+    // Sockets waiting to be picked up by the writer thread
+    std::mutex attach_mutex;
+    std::vector<SocketClient> attached;
+
+    std::atomic<bool> running{false};
+    std::thread writer_thread;
+    int wake_fd;
+};
+
+#endif // EVENT_STREAM_H
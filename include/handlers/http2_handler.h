@@ -6,8 +6,10 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <chrono>
 #include <functional>
 #include <vector>
+#include "event_stream.h"
 
 class FileHandler;
 class PerformanceMetrics;
@@ -29,9 +31,19 @@ struct HTTP2Stream {
     std::vector<std::string> push_resources;
     bool push_enabled;
     
+    // Server-sent event stream: the response never ends while the subscriber is open
+    std::shared_ptr<EventStreamSubscriber> events;
+    bool data_deferred;
+    
+    std::chrono::steady_clock::time_point start_time;
+    // Request complete and response built, for the flight recorder; unset until then
+    std::chrono::steady_clock::time_point parsed_time;
+    std::chrono::steady_clock::time_point handled_time;
+    
     HTTP2Stream(int32_t id) : stream_id(id), headers_complete(false), 
                              request_complete(false), status_code(200), response_data_sent(0),
-                             push_enabled(true) {}
+                             push_enabled(true), data_deferred(false),
+                             start_time(std::chrono::steady_clock::now()) {}
 };
 
 class HTTP2Handler {
@@ -45,6 +57,10 @@ private:
     std::shared_ptr<PerformanceMetrics> performance_metrics;
     std::string document_root;
     
+    // Event streams on this connection; their subscribers signal wake_fd
+    std::shared_ptr<EventStreamHub> event_stream;
+    int wake_fd;
+    
     // SSL support
     SSL* ssl_connection;
     bool is_tls_connection;
@@ -52,6 +68,10 @@ private:
     // HTTP/2 connection state
     bool preface_processed;
     
+    // Client address for the access log
+    std::string peer;
+    uint64_t connection_id;
+    
     // Stream priority support
     struct StreamPriority {
         int32_t stream_id;
@@ -76,6 +96,8 @@ private:
                                      const nghttp2_frame *frame, void *user_data);
     static int on_stream_close_callback(nghttp2_session *session, int32_t stream_id,
                                        uint32_t error_code, void *user_data);
+    static int on_begin_headers_callback(nghttp2_session *session, const nghttp2_frame *frame,
+                                         void *user_data);
     static int on_header_callback(nghttp2_session *session, const nghttp2_frame *frame,
                                  const uint8_t *name, size_t namelen,
                                  const uint8_t *value, size_t valuelen,
@@ -100,6 +122,8 @@ private:
     bool create_response_headers(HTTP2Stream* stream, std::vector<nghttp2_nv>& headers,
                                 std::vector<std::string>& header_storage);
     void send_window_update(int32_t stream_id, uint32_t window_size_increment);
+    void start_event_stream(HTTP2Stream* stream);
+    void record_request(const HTTP2Stream* stream);
     
     // Server push support
     bool server_push_enabled() const;
@@ -132,6 +156,13 @@ public:
     bool session_want_read() const;
     bool session_want_write() const;
     
+    // Server-sent events (/api/metrics/stream) as a long-lived stream on this connection.
+    // The connection loop polls get_wake_fd() and calls resume_event_streams() when it fires.
+    void set_event_stream(std::shared_ptr<EventStreamHub> hub) { event_stream = hub; }
+    int get_wake_fd() const { return wake_fd; }
+    bool resume_event_streams();
+    bool has_event_streams() const;
+    
     // Get buffered output data
     const std::vector<uint8_t>& get_output_buffer() const { return output_buffer; }
     void clear_output_buffer() { output_buffer.clear(); }
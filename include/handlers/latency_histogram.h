@@ -0,0 +1,45 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// HDR-style log-linear histogram of latencies (microseconds for requests, nanoseconds for
+// request phases). Values below 32 get one bucket each; every power of two above that is
+// split into 32 equal sub-buckets, so a bucket is never wider than 1/32 (~3%) of the
+// values it holds. 896 buckets cover 1 to 2^32 units (~71 minutes in us, ~4.3 s in ns);
+// larger values are clamped into the last bucket.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = SUB_BUCKET_COUNT * (32 - SUB_BUCKET_BITS + 1);
+    static const uint64_t MAX_VALUE = 0xffffffffULL;
+
+    LatencyHistogram();
+
+    static size_t bucket_index(uint64_t value);
+    static uint64_t bucket_lower(size_t index);
+    static uint64_t bucket_upper(size_t index);
+
+    void record(uint64_t value) { add(bucket_index(value), 1); }
+    void add(size_t index, uint64_t count);
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return total; }
+    uint64_t bucket_count(size_t index) const { return counts[index]; }
+
+    // Value at quantile q (0..1), reported as the midpoint of its bucket; 0 when empty
+    uint64_t percentile(double q) const;
+    uint64_t max() const;
+    // Samples in buckets that lie entirely at or below 'value' (cumulative "le" count)
+    uint64_t count_at_most(uint64_t value) const;
+    double mean() const;
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+};
+
+#endif // LATENCY_HISTOGRAM_H
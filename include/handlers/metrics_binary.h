@@ -0,0 +1,46 @@
+#ifndef METRICS_BINARY_H
+#define METRICS_BINARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Compact encoding of the dashboard metrics messages, sent as binary frames to clients
+// that negotiate the "metrics.bin.v1" WebSocket subprotocol. Every message starts with
+// a 4-byte header (u8 type, u8 version, u16 count) followed by fixed-layout little-endian
+// fields; the layouts are documented in docs/pages/api-websocket.md.
+class MetricsBinaryWriter {
+public:
+    enum MessageType : uint8_t {
+        METRICS = 1,
+        REQUEST_RATE = 2,
+        SYSTEM_METRICS = 3,
+        SYSTEM_METRICS_DELTA = 4
+    };
+
+    static const char* const SUBPROTOCOL;
+    static const uint8_t VERSION = 1;
+    static const size_t HEADER_SIZE = 4;
+    static const size_t SYSTEM_SAMPLE_SIZE = 40;
+
+    // Writes the header; body_size only reserves space
+    MetricsBinaryWriter(MessageType type, uint16_t count, size_t body_size);
+
+    void put_u8(uint8_t value) { out.push_back(static_cast<char>(value)); }
+    void put_u16(uint16_t value);
+    void put_u32(uint32_t value);
+    void put_u64(uint64_t value);
+    void put_i64(int64_t value) { put_u64(static_cast<uint64_t>(value)); }
+    void put_f32(float value);
+
+    std::string take() { return std::move(out); }
+
+    // JSON "type" the binary message stands for, used as its coalescing key
+    static const char* type_name(const std::string& payload);
+
+private:
+    std::string out;
+};
+
+#endif // METRICS_BINARY_H
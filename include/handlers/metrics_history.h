@@ -0,0 +1,99 @@
+#ifndef METRICS_HISTORY_H
+#define METRICS_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Append-only bit string, most significant bit first
+class BitStream {
+public:
+    void write(uint64_t value, int bits);   // low 'bits' of value, 0..64
+    void write_bit(bool bit) { write(bit ? 1 : 0, 1); }
+    size_t bit_count() const { return bits; }
+    size_t byte_size() const { return words.size() * sizeof(uint64_t); }
+    void shrink() { words.shrink_to_fit(); }
+
+    class Reader {
+    public:
+        explicit Reader(const BitStream& stream) : stream(stream), position(0) {}
+        uint64_t read(int bits);
+        bool read_bit() { return read(1) != 0; }
+    private:
+        const BitStream& stream;
+        size_t position;
+    };
+
+private:
+    std::vector<uint64_t> words;
+    size_t bits = 0;
+};
+
+// Compressed history of a fixed set of gauges sampled together, in the Gorilla format
+// (Pelkonen et al., VLDB 2015): timestamps as delta-of-deltas, values XORed with the
+// previous value so unchanged or slowly changing gauges take a bit or a few bits each.
+// Samples are grouped into hour-long chunks that share one timestamp stream; chunks
+// older than the retention are dropped whole. One writer, any number of readers.
+class MetricsHistory {
+public:
+    static const int64_t CHUNK_MS = 3600 * 1000;
+    static const int64_t RETENTION_MS = 24 * 3600 * 1000;
+    static const size_t MAX_POINTS = 10000;   // per series per query
+
+    enum Aggregation { AVG, MIN, MAX, LAST };
+
+    struct Point {
+        int64_t time_ms;   // start of the step
+        double value;
+    };
+
+    explicit MetricsHistory(const std::vector<std::string>& series_names);
+
+    static bool parse_aggregation(const std::string& name, Aggregation& aggregation);
+
+    // One sample of every series, in the order of names(). Samples older than the
+    // previous one are ignored.
+    void append(int64_t time_ms, const std::vector<double>& values);
+
+    // Samples in [from_ms, to_ms) downsampled to one point per 'step_ms' that has data,
+    // one vector per series in the order of names(); empty if the range needs more than
+    // MAX_POINTS steps
+    std::vector<std::vector<Point>> query(int64_t from_ms, int64_t to_ms, int64_t step_ms,
+                                          Aggregation aggregation) const;
+
+    const std::vector<std::string>& names() const { return series_names; }
+    size_t sample_count() const;
+    size_t compressed_bytes() const;
+
+private:
+    // XOR encoder state of one series
+    struct ValueState {
+        uint64_t previous = 0;
+        int leading = -1;    // window of the last stored XOR; -1 before the first one
+        int trailing = 0;
+    };
+
+    struct Chunk {
+        int64_t first_ms = 0;
+        int64_t last_ms = 0;
+        int64_t last_delta = 0;
+        size_t count = 0;
+        BitStream times;
+        std::vector<BitStream> values;
+        std::vector<ValueState> states;
+    };
+
+    static void encode_value(BitStream& out, ValueState& state, double value);
+    static double decode_value(BitStream::Reader& in, ValueState& state, bool first);
+    static void encode_delta_of_delta(BitStream& out, int64_t delta_of_delta);
+    static int64_t decode_delta_of_delta(BitStream::Reader& in);
+
+    std::vector<std::string> series_names;
+    mutable std::mutex mutex;
+    std::deque<Chunk> chunks;
+};
+
+#endif // METRICS_HISTORY_H
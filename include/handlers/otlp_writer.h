@@ -0,0 +1,52 @@
+#ifndef OTLP_WRITER_H
+#define OTLP_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Builds an OTLP/HTTP JSON metrics export request (ExportMetricsServiceRequest in the
+// protobuf JSON mapping). Like PrometheusWriter: start each metric with sum(), gauge() or
+// histogram(), then add its data points. Every point carries the same start and sample
+// time, so counters are cumulative since start_unix_nano.
+class OtlpMetricsWriter {
+public:
+    typedef std::vector<std::pair<std::string, std::string>> Attributes;
+
+    OtlpMetricsWriter(int64_t start_unix_nano, int64_t time_unix_nano);
+
+    void sum(const char* name, const char* unit, const char* description, bool monotonic);
+    void gauge(const char* name, const char* unit, const char* description);
+    void histogram(const char* name, const char* unit, const char* description);
+
+    void point(const Attributes& attributes, uint64_t value);
+    void point(const Attributes& attributes, double value);
+    // One histogram point: cumulative[i] samples were <= bounds[i]
+    void histogram_point(const Attributes& attributes, const double* bounds, const uint64_t* cumulative,
+                         size_t bound_count, uint64_t count, double sum);
+
+    // The whole request; 'resource' is the attribute list of the resource, e.g. service.name
+    std::string take(const Attributes& resource);
+
+    // JSON string value with quotes and escapes, and an OTLP attribute list
+    static void append_string(std::string& out, const std::string& value);
+    static void append_attributes(std::string& out, const Attributes& attributes);
+
+private:
+    enum Kind { NONE, SUM, GAUGE, HISTOGRAM };
+
+    void begin_metric(Kind kind, const char* name, const char* unit, const char* description);
+    void end_metric();
+    void begin_point(const Attributes& attributes);
+
+    std::string metrics;
+    std::string start_time;
+    std::string sample_time;
+    Kind kind = NONE;
+    bool monotonic = false;
+    bool first_point = true;
+};
+
+#endif // OTLP_WRITER_H
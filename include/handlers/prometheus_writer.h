@@ -0,0 +1,35 @@
+#ifndef PROMETHEUS_WRITER_H
+#define PROMETHEUS_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Builds a Prometheus text exposition (format 0.0.4) for GET /metrics. Write one family()
+// line pair per metric, then its samples; labels are passed preformatted, e.g.
+// route="api",status="2xx".
+class PrometheusWriter {
+public:
+    static const char* const CONTENT_TYPE;
+
+    PrometheusWriter();
+
+    void family(const char* name, const char* type, const char* help);
+    void sample(const char* name, const std::string& labels, uint64_t value);
+    void sample(const char* name, const std::string& labels, double value);
+
+    // One histogram series: cumulative[i] samples were <= bounds[i]
+    void histogram(const char* name, const std::string& labels, const double* bounds,
+                   const uint64_t* cumulative, size_t bound_count, uint64_t count, double sum);
+
+    std::string take() { return std::move(out); }
+
+private:
+    void begin_sample(const char* name, const char* suffix, const std::string& labels);
+    void append_double(double value);
+
+    std::string out;
+};
+
+#endif // PROMETHEUS_WRITER_H
@@ -0,0 +1,99 @@
+#ifndef REQUEST_RECORDER_H
+#define REQUEST_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "latency_histogram.h"
+
+// Request counters and latency histograms written without locks. Each recording thread
+// is assigned its own shard of relaxed atomic counters; readers merge every shard.
+//
+// Counts are kept in rings of time buckets: per second for the last rate_seconds (60 to
+// 3600, fixed at construction), per minute for the last hour and per hour for the last
+// day. Recording touches one bucket of each; reading a series walks its buckets once per
+// shard, however many requests there were. Latencies are kept in 5-second slots covering
+// the last minute, plus one histogram since start. A bucket or slot is cleared by the
+// first sample recorded after it expires. If two threads share a shard, a sample racing
+// that clear can be lost. This only happens when there are more threads than shards.
+class RequestRecorder {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    static const size_t SHARD_COUNT = 16;
+    static const int RATE_SECONDS = 60;           // default and minimum per-second history
+    static const int MAX_RATE_SECONDS = 3600;
+    static const int MINUTE_COUNT = 60;
+    static const int HOUR_COUNT = 24;
+    static const int SLOT_SECONDS = 5;
+    static const int SLOT_COUNT = 12;
+    static const int MAX_WINDOW_SECONDS = SLOT_SECONDS * SLOT_COUNT;
+
+    enum Resolution { SECOND, MINUTE, HOUR };
+
+    // 'rate_seconds' is clamped to [RATE_SECONDS, MAX_RATE_SECONDS]
+    explicit RequestRecorder(int rate_seconds = RATE_SECONDS);
+
+    RequestRecorder(const RequestRecorder&) = delete;
+    RequestRecorder& operator=(const RequestRecorder&) = delete;
+
+    // Shard of the calling thread, in [0, SHARD_COUNT); threads take shards round-robin
+    // on first use, so pool workers rarely share one
+    static size_t thread_shard();
+
+    void record(double response_time_ms, int status_code) {
+        record_at(std::chrono::steady_clock::now(), response_time_ms, status_code);
+    }
+    void record_at(TimePoint now, double response_time_ms, int status_code);
+
+    uint64_t total_requests() const;
+    uint64_t server_errors() const;     // 5xx responses since start
+    uint64_t latency_sum_micros() const; // exact sum of every recorded latency
+
+    // counts[i] is the number of requests recorded i seconds before 'now'
+    void count_per_second(TimePoint now, int counts[RATE_SECONDS]) const;
+    // counts[i] is the number of requests in the period i periods before the one holding
+    // 'now'; 'periods' is clamped to series_length(). Returns the number filled in.
+    int count_series(TimePoint now, Resolution resolution, uint64_t* counts, int periods) const;
+    int series_length(Resolution resolution) const;
+    static int period_seconds(Resolution resolution);
+    size_t requests_in_last(TimePoint now, int seconds) const;
+
+    // Latencies recorded in the last 'window_seconds', rounded up to whole slots
+    // (at most MAX_WINDOW_SECONDS); 0 means since start
+    LatencyHistogram latency(TimePoint now, int window_seconds) const;
+
+private:
+    struct Slot {
+        std::atomic<int64_t> epoch;
+        std::atomic<uint32_t> counts[LatencyHistogram::BUCKET_COUNT];
+    };
+
+    // Requests in one period; 'epoch' is the period's index since start
+    struct RateBucket {
+        std::atomic<int64_t> epoch;
+        std::atomic<uint64_t> count;
+    };
+
+    struct Shard {
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> server_errors;
+        std::atomic<uint64_t> latency_sum;
+        RateBucket minutes[MINUTE_COUNT];
+        RateBucket hours[HOUR_COUNT];
+        Slot slots[SLOT_COUNT];
+        std::atomic<uint64_t> lifetime[LatencyHistogram::BUCKET_COUNT];
+    };
+
+    int64_t seconds_at(TimePoint now) const;
+    const RateBucket* series(size_t shard, Resolution resolution) const;
+
+    TimePoint start_time;
+    int rate_seconds;
+    std::unique_ptr<Shard[]> shards;
+    std::unique_ptr<RateBucket[]> seconds;   // rate_seconds buckets per shard
+};
+
+#endif // REQUEST_RECORDER_H
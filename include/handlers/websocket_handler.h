@@ -11,29 +11,72 @@
 #include <memory>
 #include <functional>
 #include <queue>
+#include <deque>
+#include <set>
+#include <sstream>
+#include "../network/websocket_frame.h"
+#include "../network/websocket_deflate.h"
+#include "websocket_topics.h"
+#include "metrics_binary.h"
+#include "request_recorder.h"
+#include "metrics_history.h"
+#include "event_stream.h"
+#include "../core/process_stats.h"
+
+// What to do when a connection's outbound queue would exceed its byte limit
+enum class SlowConsumerPolicy {
+    DROP_OLDEST,   // discard the oldest queued messages
+    COALESCE,      // replace queued messages of the same type with the newest one
+    DISCONNECT     // close the connection
+};
+
+// Encoding of the dashboard metrics messages, chosen with Sec-WebSocket-Protocol
+enum class MetricsEncoding {
+    JSON,      // text frames (default)
+    BINARY     // binary frames in the metrics.bin.v1 layout
+};
 
 class WebSocketConnection {
 public:
+    // A complete encoded frame, shared between all queues it was published to
+    struct OutboundFrame {
+        std::shared_ptr<const std::vector<uint8_t>> data;
+        std::string coalesce_key;   // message type; empty for control frames
+    };
+    
     int socket;
     std::string client_id;
     std::chrono::steady_clock::time_point last_ping;
     bool is_authenticated;
+    WebSocketDeflateConfig deflate;
+    MetricsEncoding metrics_encoding;
+    
+    // Outbound queue, written only by the connection's own thread. Publishers on other
+    // threads append under send_mutex and signal wake_fd; they never block on the socket.
+    std::mutex send_mutex;
+    std::deque<OutboundFrame> outbound;
+    size_t outbound_bytes;
+    size_t front_offset;        // bytes of outbound.front() already written
+    int wake_fd;
+    std::atomic<bool> closing{false};
+    
+    // Topics this connection is subscribed to (for cleanup on disconnect)
+    std::mutex topics_mutex;
+    std::set<std::string> topics;
+    
+    WebSocketConnection(int sock, const std::string& id,
+                        const WebSocketDeflateConfig& deflate_config = WebSocketDeflateConfig(),
+                        MetricsEncoding encoding = MetricsEncoding::JSON);
+    ~WebSocketConnection();
     
-    WebSocketConnection(int sock, const std::string& id) 
-        : socket(sock), client_id(id), last_ping(std::chrono::steady_clock::now()), is_authenticated(false) {}
+    WebSocketConnection(const WebSocketConnection&) = delete;
+    WebSocketConnection& operator=(const WebSocketConnection&) = delete;
 };
 
 class PerformanceMetrics {
 public:
-    struct RequestMetric {
-        std::chrono::steady_clock::time_point timestamp;
-        double response_time_ms;
-        int status_code;
-        std::string method;
-        std::string path;
-    };
-    
     struct SystemMetric {
+        uint64_t seq;   // increases by one per recorded sample
         std::chrono::steady_clock::time_point timestamp;
         size_t memory_usage_mb;
         double cpu_usage_percent;
@@ -45,19 +88,28 @@ public:
     };
     
 private:
+    // Per-second request counts kept for /api/request-rate (10 minutes)
+    static const int RATE_HISTORY_SECONDS = 600;
+    
+    // Guards the system history only; requests are recorded without locks
     mutable std::mutex metrics_mutex;
-    std::queue<RequestMetric> request_history;
-    std::queue<SystemMetric> system_history;
-    std::atomic<size_t> total_requests{0};
-    std::atomic<size_t> requests_last_minute{0};
-    std::chrono::steady_clock::time_point last_minute_reset;
-    
-    // Keep last 1000 requests and 300 system metrics (5 minutes at 1 per second)
-    static const size_t MAX_REQUEST_HISTORY = 1000;
+    std::deque<SystemMetric> system_history;
+    uint64_t system_seq = 0;
+    RequestRecorder requests{RATE_HISTORY_SECONDS};
+    CpuSampler cpu_sampler;   // process CPU between system samples
+    
+    // Every system sample for the last day, compressed; backs /api/metrics/history
+    MetricsHistory history{{"memory_mb", "cpu_percent", "active_connections", "total_requests",
+                            "requests_per_second", "queue_size", "thread_count"}};
+    
+    // Keep 300 system metrics (5 minutes at 1 per second)
     static const size_t MAX_SYSTEM_HISTORY = 300;
     
 public:
-    PerformanceMetrics() : last_minute_reset(std::chrono::steady_clock::now()) {}
+    // Window of the latency percentiles in the metrics message
+    static const int LATENCY_WINDOW_SECONDS = 60;
+    
+    PerformanceMetrics() = default;
     
     void record_request(const std::string& method, const std::string& path, 
                        int status_code, double response_time_ms);
@@ -66,15 +118,51 @@ public:
     
     std::string get_metrics_json() const;
     std::string get_request_rate_json() const;
+    // Last 'periods' request counts at 'resolution', oldest first (at most the ring length)
+    std::string get_request_rate_series_json(RequestRecorder::Resolution resolution, int periods) const;
+    int get_request_rate_series_length(RequestRecorder::Resolution resolution) const {
+        return requests.series_length(resolution);
+    }
     std::string get_system_metrics_json() const;
+    // Samples recorded after 'after_seq'; falls back to a full snapshot when the
+    // requested position has already been evicted from the history
+    std::string get_system_metrics_delta_json(uint64_t after_seq) const;
+    uint64_t get_latest_system_seq() const;
+    
+    // Same messages in the compact binary encoding (see metrics_binary.h)
+    std::string get_metrics_binary() const;
+    std::string get_request_rate_binary() const;
+    std::string get_system_metrics_binary() const;
+    std::string get_system_metrics_delta_binary(uint64_t after_seq) const;
+    
+    size_t get_total_requests() const { return static_cast<size_t>(requests.total_requests()); }
+    size_t get_requests_per_minute() const {
+        return requests.requests_in_last(std::chrono::steady_clock::now(), 60);
+    }
     
-    size_t get_total_requests() const { return total_requests.load(); }
-    size_t get_requests_per_minute() const { return requests_last_minute.load(); }
+    // Response times recorded in the last 'window_seconds' (0 = since start), merged
+    // from every thread's shard
+    LatencyHistogram get_latency_histogram(int window_seconds) const {
+        return requests.latency(std::chrono::steady_clock::now(), window_seconds);
+    }
+    static std::string latency_json(const LatencyHistogram& histogram, int window_seconds);
+    uint64_t get_latency_sum_micros() const { return requests.latency_sum_micros(); }
+    
+    // System samples in [from_ms, to_ms) (Unix time), one point per step; 'series' limits
+    // the gauges returned (empty = all)
+    std::string get_metrics_history_json(int64_t from_ms, int64_t to_ms, int64_t step_ms,
+                                         MetricsHistory::Aggregation aggregation,
+                                         const std::vector<std::string>& series) const;
+    const MetricsHistory& get_history() const { return history; }
     
 private:
-    void update_request_rate();
+    bool find_delta_start_locked(uint64_t after_seq, std::deque<SystemMetric>::const_iterator& start) const;
+    std::string system_binary_locked(MetricsBinaryWriter::MessageType type, uint64_t prev_seq,
+                                     std::deque<SystemMetric>::const_iterator start) const;
+    void append_system_metric_json(std::ostringstream& json, const SystemMetric& metric) const;
+    std::string system_snapshot_json_locked() const;
     size_t get_memory_usage() const;
-    double get_cpu_usage() const;
+    double get_cpu_usage();
 };
 
 class WebSocketHandler {
@@ -85,6 +173,25 @@ private:
     std::thread broadcast_thread;
     std::thread ping_thread;
     std::shared_ptr<PerformanceMetrics> metrics;
+    std::atomic<size_t> max_message_size{WebSocketFrameDecoder::DEFAULT_MAX_MESSAGE_SIZE};
+    WebSocketTopicIndex topic_index;
+    std::atomic<size_t> binary_metrics_clients{0};
+    std::shared_ptr<EventStreamHub> event_stream;   // SSE clients of the metrics topic
+    
+    static const size_t MAX_TOPICS_PER_CONNECTION = 32;
+    
+    // Slow-consumer handling
+    std::atomic<size_t> max_outbound_bytes{DEFAULT_MAX_OUTBOUND_BYTES};
+    std::atomic<SlowConsumerPolicy> slow_consumer_policy{SlowConsumerPolicy::COALESCE};
+    std::atomic<size_t> queued_bytes_total{0};
+    std::atomic<size_t> queued_frames_total{0};
+    std::atomic<size_t> peak_queue_bytes{0};
+    std::atomic<size_t> frames_dropped{0};
+    std::atomic<size_t> frames_coalesced{0};
+    std::atomic<size_t> slow_disconnects{0};
+    
+    // Optional consumer for client messages that are not built-in commands
+    std::function<void(const std::string&, uint8_t, const std::vector<uint8_t>&)> message_handler;
     
     // WebSocket protocol constants
     static const uint8_t WS_OPCODE_CONTINUATION = 0x0;
@@ -94,47 +201,124 @@ private:
     static const uint8_t WS_OPCODE_PING = 0x9;
     static const uint8_t WS_OPCODE_PONG = 0xa;
     
+    // Messages shorter than this are sent uncompressed even when deflate is negotiated
+    static const size_t MIN_COMPRESS_SIZE = 64;
+    
+    // Frames for one outgoing text message, each encoding built at most once.
+    // Compression uses no context takeover, so a compressed frame is shared by every
+    // connection that negotiated the same server window size.
+    // Metrics messages may also carry a binary encoding for metrics.bin.v1 clients.
+    struct OutgoingFrames {
+        const std::string& message;
+        const std::string* binary_message;
+        std::string coalesce_key;
+        std::shared_ptr<const std::vector<uint8_t>> plain;
+        std::shared_ptr<const std::vector<uint8_t>> binary;
+        std::map<int, std::shared_ptr<const std::vector<uint8_t>>> compressed;
+        
+        explicit OutgoingFrames(const std::string& msg, const std::string* binary_msg = nullptr);
+    };
+    
 public:
+    static const size_t DEFAULT_MAX_OUTBOUND_BYTES = 1024 * 1024;
+    
+    // Backpressure counters (see get_backpressure_stats)
+    struct BackpressureStats {
+        size_t queued_bytes;
+        size_t queued_frames;
+        size_t peak_queue_bytes;
+        size_t frames_dropped;
+        size_t frames_coalesced;
+        size_t slow_disconnects;
+    };
+    
+    // Every connection starts subscribed to this topic, which carries the dashboard metrics
+    static const char* const METRICS_TOPIC;
+    
     WebSocketHandler();
     ~WebSocketHandler();
     
     // WebSocket protocol handling
     bool is_websocket_request(const std::map<std::string, std::string>& headers) const;
-    std::string generate_websocket_response(const std::map<std::string, std::string>& headers) const;
-    bool handle_websocket_connection(int client_socket, const std::string& client_id);
+    std::string generate_websocket_response(const std::map<std::string, std::string>& headers,
+                                            WebSocketDeflateConfig& deflate_config,
+                                            MetricsEncoding& metrics_encoding) const;
+    bool handle_websocket_connection(int client_socket, const std::string& client_id,
+                                     const WebSocketDeflateConfig& deflate_config = WebSocketDeflateConfig(),
+                                     MetricsEncoding metrics_encoding = MetricsEncoding::JSON);
     
     // Connection management
-    void add_connection(int socket, const std::string& client_id);
+    std::shared_ptr<WebSocketConnection> add_connection(int socket, const std::string& client_id,
+                        const WebSocketDeflateConfig& deflate_config = WebSocketDeflateConfig(),
+                        MetricsEncoding metrics_encoding = MetricsEncoding::JSON);
     void remove_connection(const std::string& client_id);
     void broadcast_message(const std::string& message);
     void send_message_to_client(const std::string& client_id, const std::string& message);
     
+    // Topic pub/sub. publish() sends to the topic's subscribers only and returns how many
+    // received the message; it may be called from any thread.
+    size_t publish(const std::string& topic, const std::string& message);
+    bool subscribe(const std::string& client_id, const std::string& topic);
+    bool unsubscribe(const std::string& client_id, const std::string& topic);
+    size_t get_subscriber_count(const std::string& topic) const { return topic_index.subscriber_count(topic); }
+    
+    // Incoming message limits and delivery
+    void set_max_message_size(size_t max_size) { max_message_size.store(max_size); }
+    size_t get_max_message_size() const { return max_message_size.load(); }
+    void set_message_handler(std::function<void(const std::string&, uint8_t, const std::vector<uint8_t>&)> handler);
+    
+    // Outbound limits for slow consumers
+    void set_max_outbound_bytes(size_t max_bytes) { max_outbound_bytes.store(max_bytes); }
+    size_t get_max_outbound_bytes() const { return max_outbound_bytes.load(); }
+    void set_slow_consumer_policy(SlowConsumerPolicy policy) { slow_consumer_policy.store(policy); }
+    SlowConsumerPolicy get_slow_consumer_policy() const { return slow_consumer_policy.load(); }
+    static bool parse_slow_consumer_policy(const std::string& name, SlowConsumerPolicy& policy);
+    static const char* slow_consumer_policy_name(SlowConsumerPolicy policy);
+    BackpressureStats get_backpressure_stats() const;
+    
     // Performance metrics
     void set_metrics(std::shared_ptr<PerformanceMetrics> perf_metrics);
     void record_request(const std::string& method, const std::string& path, 
                        int status_code, double response_time_ms);
     
+    // Metrics broadcasts are also published to this server-sent event stream; call after set_metrics
+    void set_event_stream(std::shared_ptr<EventStreamHub> hub);
+    
     // Control
     void start();
     void stop();
     size_t get_connection_count() const;
     
 private:
-    // WebSocket frame parsing and creation
-    struct WebSocketFrame {
-        bool fin;
-        uint8_t opcode;
-        bool masked;
-        uint64_t payload_length;
-        uint8_t mask[4];
-        std::vector<uint8_t> payload;
-    };
+    // WebSocket frame creation and incoming message dispatch
+    std::vector<uint8_t> create_frame(uint8_t opcode, const std::string& payload, bool compressed = false) const;
+    bool send_frame(WebSocketConnection& conn, uint8_t opcode, const std::string& payload);
+    bool send_text(WebSocketConnection& conn, const std::string& message);
+    bool send_binary_metrics(WebSocketConnection& conn, const std::string& payload);
+    size_t publish_frames(const std::string& topic, OutgoingFrames& frames);
+    size_t publish_metrics(const std::string& message, const std::string& binary_message, uint64_t event_id);
+    bool has_event_stream_clients() const { return event_stream && event_stream->subscriber_count() > 0; }
+    const std::shared_ptr<const std::vector<uint8_t>>& frame_for(const WebSocketConnection& conn, OutgoingFrames& frames) const;
+    
+    // Outbound queue: enqueue applies the slow-consumer policy; flush writes without blocking
+    bool enqueue_frame(WebSocketConnection& conn, const std::shared_ptr<const std::vector<uint8_t>>& frame,
+                       const std::string& coalesce_key);
+    bool flush_outbound(WebSocketConnection& conn);
+    void drop_queued_frame(WebSocketConnection& conn, size_t index);
+    void drain_before_close(WebSocketConnection& conn, int timeout_ms);
+    void release_outbound(WebSocketConnection& conn);
+    bool run_connection(const std::shared_ptr<WebSocketConnection>& conn, bool use_coordinator);
+    bool send_ping(WebSocketConnection& conn);
+    bool send_pong(WebSocketConnection& conn, const std::vector<uint8_t>& payload);
+    bool send_close(WebSocketConnection& conn, uint16_t code);
+    bool dispatch_messages(const std::shared_ptr<WebSocketConnection>& conn, WebSocketFrameDecoder& decoder,
+                           WebSocketInflater* inflater);
     
-    WebSocketFrame parse_frame(const std::vector<uint8_t>& data) const;
-    std::vector<uint8_t> create_frame(uint8_t opcode, const std::string& payload) const;
-    bool send_frame(int socket, uint8_t opcode, const std::string& payload) const;
-    bool send_ping(int socket) const;
-    bool send_pong(int socket) const;
+    // Topic subscriptions
+    bool subscribe_connection(const std::shared_ptr<WebSocketConnection>& conn, const std::string& topic);
+    bool unsubscribe_connection(const std::shared_ptr<WebSocketConnection>& conn, const std::string& topic);
+    void unsubscribe_all(const std::shared_ptr<WebSocketConnection>& conn);
+    bool handle_topic_command(const std::shared_ptr<WebSocketConnection>& conn, const std::string& text);
     
     // Background tasks
     void broadcast_loop();
@@ -150,7 +334,9 @@ private:
     void broadcast_message_safe(const std::string& message);
     void send_message_to_client_safe(const std::string& client_id, const std::string& message);
     size_t get_connection_count_safe() const;
-    bool handle_websocket_connection_safe(int client_socket, const std::string& client_id);
+    bool handle_websocket_connection_safe(int client_socket, const std::string& client_id,
+                                          const WebSocketDeflateConfig& deflate_config = WebSocketDeflateConfig(),
+                                          MetricsEncoding metrics_encoding = MetricsEncoding::JSON);
     void broadcast_loop_safe();
     void ping_loop_safe();
 };
@@ -0,0 +1,47 @@
+#ifndef WEBSOCKET_TOPICS_H
+#define WEBSOCKET_TOPICS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class WebSocketConnection;
+
+// Topic -> subscribers index, split into independently locked shards so that
+// subscribe/unsubscribe/publish on different topics do not contend. Each topic's
+// subscriber list is an immutable snapshot replaced on change (copy-on-write): a
+// publisher grabs the snapshot under the shard lock and fans out without holding it.
+class WebSocketTopicIndex {
+public:
+    typedef std::vector<std::shared_ptr<WebSocketConnection>> SubscriberList;
+
+    static const size_t SHARD_COUNT = 16;
+    static const size_t MAX_TOPIC_LENGTH = 64;
+
+    // Topic names: 1-64 characters from [A-Za-z0-9_.:-]
+    static bool is_valid_topic(const std::string& topic);
+
+    // Return false if already (un)subscribed
+    bool subscribe(const std::string& topic, const std::shared_ptr<WebSocketConnection>& conn);
+    bool unsubscribe(const std::string& topic, const std::shared_ptr<WebSocketConnection>& conn);
+
+    // Snapshot of the current subscribers (never null)
+    std::shared_ptr<const SubscriberList> subscribers(const std::string& topic) const;
+    size_t subscriber_count(const std::string& topic) const;
+    size_t topic_count() const;
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<const SubscriberList>> topics;
+    };
+
+    Shard shards[SHARD_COUNT];
+
+    Shard& shard_for(const std::string& topic);
+    const Shard& shard_for(const std::string& topic) const;
+};
+
+#endif // WEBSOCKET_TOPICS_H
@@ -0,0 +1,54 @@
+#ifndef WEBSOCKET_DEFLATE_H
+#define WEBSOCKET_DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// Negotiated permessage-deflate parameters (RFC 7692)
+struct WebSocketDeflateConfig {
+    bool enabled;
+    bool client_no_context_takeover;
+    int server_max_window_bits;   // window used when compressing server messages
+
+    WebSocketDeflateConfig()
+        : enabled(false), client_no_context_takeover(false), server_max_window_bits(15) {}
+};
+
+// Pick the first acceptable permessage-deflate offer from a Sec-WebSocket-Extensions
+// header value. On success fills 'config' and the value for the response header.
+// The server always answers with server_no_context_takeover: every outgoing message is
+// compressed independently, so one compressed broadcast frame is valid for all clients.
+bool negotiate_permessage_deflate(const std::string& extensions_header,
+                                  WebSocketDeflateConfig& config,
+                                  std::string& response_value);
+
+// Compress one message with no context takeover (fresh raw deflate stream, trailing
+// 0x00 0x00 0xff 0xff removed as required by RFC 7692 section 7.2.1)
+bool websocket_deflate_message(const std::string& input, int window_bits, std::string& output);
+
+// Per-connection decompressor for client messages. Keeps the sliding window between
+// messages unless the client agreed to client_no_context_takeover.
+class WebSocketInflater {
+public:
+    explicit WebSocketInflater(bool reset_per_message);
+    ~WebSocketInflater();
+
+    WebSocketInflater(const WebSocketInflater&) = delete;
+    WebSocketInflater& operator=(const WebSocketInflater&) = delete;
+
+    enum Result { OK, TOO_LARGE, CORRUPT };
+
+    // Inflate a complete compressed message payload; output is limited to max_size bytes
+    Result inflate_message(const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
+                           size_t max_size);
+
+private:
+    z_stream stream;
+    bool initialized;
+    bool reset_per_message;
+};
+
+#endif // WEBSOCKET_DEFLATE_H
@@ -0,0 +1,131 @@
+#ifndef WEBSOCKET_FRAME_H
+#define WEBSOCKET_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// XOR a (possibly partial) payload with the 4-byte client mask.
+// mask_offset is the number of payload bytes already unmasked, so a frame can be
+// unmasked in pieces as it arrives. Uses 32-byte (AVX2) or 16-byte (SSE2/NEON) lanes.
+void websocket_unmask(uint8_t* data, size_t len, const uint8_t mask[4], size_t mask_offset = 0);
+
+// Byte ring buffer with power-of-two capacity. Data is written directly into it by
+// recv() and consumed by the frame decoder without shifting the remaining bytes.
+class ByteRingBuffer {
+public:
+    explicit ByteRingBuffer(size_t capacity = 16384);
+
+    size_t size() const { return tail - head; }
+    size_t capacity() const { return storage.size(); }
+    size_t writable() const { return capacity() - size(); }
+    bool empty() const { return head == tail; }
+
+    // Contiguous writable region (may be shorter than writable() when wrapping)
+    uint8_t* write_ptr(size_t& contiguous);
+    void commit(size_t len);
+
+    // Append, growing the buffer if required
+    void write(const uint8_t* data, size_t len);
+
+    uint8_t peek(size_t offset) const { return storage[(head + offset) & mask]; }
+    void peek_bytes(uint8_t* dest, size_t len) const;
+    void read(uint8_t* dest, size_t len);   // copy and consume
+    void consume(size_t len);
+    void clear() { head = tail = 0; }
+
+private:
+    std::vector<uint8_t> storage;
+    size_t mask;
+    size_t head;   // monotonically increasing read position
+    size_t tail;   // monotonically increasing write position
+
+    void grow(size_t min_capacity);
+};
+
+// A complete data message (reassembled from fragments) or a control frame
+struct WebSocketMessage {
+    uint8_t opcode;
+    bool compressed;   // RSV1 was set on the first frame (permessage-deflate)
+    std::vector<uint8_t> payload;
+
+    WebSocketMessage() : opcode(0), compressed(false) {}
+};
+
+// Incremental RFC 6455 frame decoder. Bytes may arrive in arbitrary pieces; frames may
+// span reads, several frames may arrive in one read, and fragmented messages are
+// reassembled (control frames interleaved between fragments are delivered immediately).
+class WebSocketFrameDecoder {
+public:
+    enum Status {
+        NEED_MORE,      // no complete message buffered yet
+        MESSAGE,        // a message has been written to the output argument
+        PROTOCOL_ERROR  // connection must be closed with close_code()
+    };
+
+    static const size_t DEFAULT_MAX_MESSAGE_SIZE = 1024 * 1024;
+
+    // Close codes from RFC 6455 section 7.4.1
+    static const uint16_t CLOSE_NORMAL = 1000;
+    static const uint16_t CLOSE_PROTOCOL_ERROR = 1002;
+    static const uint16_t CLOSE_MESSAGE_TOO_BIG = 1009;
+
+    explicit WebSocketFrameDecoder(size_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE,
+                                   bool require_mask = true);
+
+    // Read from a socket directly into the ring buffer (same return semantics as recv)
+    ssize_t read_from(int socket);
+
+    // Feed bytes obtained elsewhere (tests, TLS, already-read handshake leftovers)
+    void feed(const uint8_t* data, size_t len);
+
+    // Decode the next message if one is complete
+    Status next(WebSocketMessage& out);
+
+    void set_max_message_size(size_t max_size) { max_message_size = max_size; }
+    size_t get_max_message_size() const { return max_message_size; }
+
+    // Accept RSV1 on the first frame of data messages once permessage-deflate is negotiated
+    void set_allow_rsv1(bool allow) { allow_rsv1 = allow; }
+
+    uint16_t close_code() const { return error_close_code; }
+    const std::string& error_message() const { return error_text; }
+    size_t buffered_bytes() const { return ring.size(); }
+
+private:
+    enum State { READ_HEADER, READ_PAYLOAD, FAILED };
+
+    ByteRingBuffer ring;
+    size_t max_message_size;
+    bool require_mask;
+    bool allow_rsv1;
+    State state;
+
+    // Current frame
+    bool frame_fin;
+    uint8_t frame_opcode;
+    uint8_t frame_rsv;
+    bool frame_masked;
+    uint8_t frame_mask[4];
+    uint64_t frame_length;
+    uint64_t frame_received;
+
+    // Message being reassembled from data frames
+    bool in_message;
+    uint8_t message_opcode;
+    bool message_compressed;
+    std::vector<uint8_t> message_payload;
+
+    // Control frame payload (never fragmented, at most 125 bytes)
+    std::vector<uint8_t> control_payload;
+
+    uint16_t error_close_code;
+    std::string error_text;
+
+    bool parse_header();
+    Status fail(uint16_t code, const std::string& reason);
+};
+
+#endif // WEBSOCKET_FRAME_H
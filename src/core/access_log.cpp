@@ -0,0 +1,363 @@
+#include "../../include/core/access_log.h"
+#include "../../include/core/process_stats.h"
+#include <iostream>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const size_t AccessLog::RING_CAPACITY;
+const int AccessLog::FLUSH_INTERVAL_MS;
+const size_t AccessLog::WRITE_BATCH_BYTES;
+
+// Gives the calling thread's ring back for reuse when the thread exits
+struct AccessLogRingHolder {
+    AccessLog::Ring* ring = nullptr;
+
+    ~AccessLogRingHolder() {
+        if (ring) {
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static void copy_field(char* dest, size_t size, const char* src, size_t length) {
+    if (length >= size) {
+        length = size - 1;
+    }
+    memcpy(dest, src, length);
+    dest[length] = '\0';
+}
+
+static void copy_field(char* dest, size_t size, const std::string& src) {
+    copy_field(dest, size, src.data(), src.size());
+}
+
+static void copy_header(char* dest, size_t size, const std::map<std::string, std::string>* headers, const char* name) {
+    dest[0] = '\0';
+    if (headers) {
+        auto it = headers->find(name);
+        if (it != headers->end()) {
+            copy_field(dest, size, it->second);
+        }
+    }
+}
+
+// Quote-safe copy for the text formats and JSON strings; empty fields become "-"
+static void append_escaped(std::string& out, const char* value) {
+    if (value[0] == '\0') {
+        out += '-';
+        return;
+    }
+    for (const char* c = value; *c; c++) {
+        unsigned char ch = static_cast<unsigned char>(*c);
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += *c;
+        } else if (ch < 0x20 || ch == 0x7f) {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "\\u%04x", ch);
+            out += hex;
+        } else {
+            out += *c;
+        }
+    }
+}
+
+AccessLog& AccessLog::instance() {
+    // Never destroyed: detached threads may still log while the process exits
+    static AccessLog* log = new AccessLog();
+    return *log;
+}
+
+AccessLog::AccessLog() : output_fd(STDOUT_FILENO), wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+bool AccessLog::parse_format(const std::string& name, AccessLogFormat& format) {
+    if (name == "common") {
+        format = AccessLogFormat::COMMON;
+    } else if (name == "combined") {
+        format = AccessLogFormat::COMBINED;
+    } else if (name == "json") {
+        format = AccessLogFormat::JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* AccessLog::format_name(AccessLogFormat format) {
+    switch (format) {
+        case AccessLogFormat::COMMON: return "common";
+        case AccessLogFormat::COMBINED: return "combined";
+        case AccessLogFormat::JSON: return "json";
+        default: return "unknown";
+    }
+}
+
+std::string AccessLog::peer_address(int socket) {
+    sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    if (getpeername(socket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        return "";
+    }
+    char text[INET6_ADDRSTRLEN] = "";
+    if (address.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(&address)->sin_addr, text, sizeof(text));
+    } else if (address.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &reinterpret_cast<sockaddr_in6*>(&address)->sin6_addr, text, sizeof(text));
+    }
+    return text;
+}
+
+bool AccessLog::configure(const std::string& path, AccessLogFormat new_format, uint32_t new_sample_every) {
+    if (running.load()) {
+        return false;
+    }
+    int fd = STDOUT_FILENO;
+    if (path != "-" && path != "off") {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "Cannot open access log " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    if (owns_fd) {
+        close(output_fd);
+    }
+    output_fd = fd;
+    owns_fd = fd != STDOUT_FILENO;
+    format = new_format;
+    sample_every.store(new_sample_every > 0 ? new_sample_every : 1);
+    enabled.store(path != "off");
+    return true;
+}
+
+AccessLog::Ring* AccessLog::thread_ring() {
+    static thread_local AccessLogRingHolder holder;
+    if (holder.ring) {
+        return holder.ring;
+    }
+
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (auto& ring : rings) {
+        bool free = false;
+        if (ring->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+            holder.ring = ring.get();
+            return holder.ring;
+        }
+    }
+    rings.emplace_back(new Ring());
+    rings.back()->in_use.store(true);
+    holder.ring = rings.back().get();
+    return holder.ring;
+}
+
+void AccessLog::record(const Request& request) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Ring* ring = thread_ring();
+
+    uint32_t every = sample_every.load(std::memory_order_relaxed);
+    if (every > 1 && request.status < 500 && ring->seen++ % every != 0) {
+        ring->sampled_out.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail >= RING_CAPACITY) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = ring->records[head & (RING_CAPACITY - 1)];
+    record.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    double micros = request.duration_ms * 1000.0;
+    record.duration_us = micros < 0 ? 0 : micros > 4e9 ? 4000000000u : static_cast<uint32_t>(micros);
+    record.status = static_cast<uint16_t>(request.status);
+    record.bytes_sent = request.bytes_sent;
+    copy_field(record.protocol, sizeof(record.protocol), request.protocol, strlen(request.protocol));
+    copy_field(record.method, sizeof(record.method), request.method);
+    copy_field(record.peer, sizeof(record.peer), request.peer, strlen(request.peer));
+    copy_field(record.path, sizeof(record.path), request.path);
+    if (format != AccessLogFormat::COMMON) {
+        copy_header(record.referer, sizeof(record.referer), request.headers, "referer");
+        copy_header(record.user_agent, sizeof(record.user_agent), request.headers, "user-agent");
+    }
+    ring->head.store(head + 1, std::memory_order_release);
+
+    // Flush early instead of waiting for the timer once a ring is half full
+    if (head - tail + 1 == RING_CAPACITY / 2) {
+        wake();
+    }
+}
+
+void AccessLog::format_record(const Record& record, AccessLogFormat format, std::string& out) {
+    time_t seconds = static_cast<time_t>(record.time_ms / 1000);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+    char number[64];
+
+    if (format == AccessLogFormat::JSON) {
+        strftime(number, sizeof(number), "%Y-%m-%dT%H:%M:%S", &utc);
+        out += "{\"time\":\"";
+        out += number;
+        snprintf(number, sizeof(number), ".%03dZ\",\"peer\":\"", static_cast<int>(record.time_ms % 1000));
+        out += number;
+        append_escaped(out, record.peer);
+        out += "\",\"method\":\"";
+        append_escaped(out, record.method);
+        out += "\",\"path\":\"";
+        append_escaped(out, record.path);
+        out += "\",\"protocol\":\"";
+        out += record.protocol;
+        snprintf(number, sizeof(number), "\",\"status\":%u,\"bytes\":%llu,\"duration_ms\":%.3f,\"referer\":\"",
+                 static_cast<unsigned>(record.status), static_cast<unsigned long long>(record.bytes_sent),
+                 record.duration_us / 1000.0);
+        out += number;
+        append_escaped(out, record.referer);
+        out += "\",\"user_agent\":\"";
+        append_escaped(out, record.user_agent);
+        out += "\"}\n";
+        return;
+    }
+
+    // host ident authuser [date] "request" status bytes
+    append_escaped(out, record.peer);
+    strftime(number, sizeof(number), " - - [%d/%b/%Y:%H:%M:%S +0000] \"", &utc);
+    out += number;
+    append_escaped(out, record.method);
+    out += ' ';
+    append_escaped(out, record.path);
+    out += ' ';
+    out += record.protocol;
+    if (record.bytes_sent > 0) {
+        snprintf(number, sizeof(number), "\" %u %llu", static_cast<unsigned>(record.status),
+                 static_cast<unsigned long long>(record.bytes_sent));
+    } else {
+        snprintf(number, sizeof(number), "\" %u -", static_cast<unsigned>(record.status));
+    }
+    out += number;
+    if (format == AccessLogFormat::COMBINED) {
+        out += " \"";
+        append_escaped(out, record.referer);
+        out += "\" \"";
+        append_escaped(out, record.user_agent);
+        out += '"';
+    }
+    out += '\n';
+}
+
+void AccessLog::start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    writer_thread = std::thread([this]() {
+        ProcessStats::register_thread("background");
+        this->writer_loop();
+    });
+}
+
+void AccessLog::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    wake();
+    if (writer_thread.joinable()) {
+        writer_thread.join();
+    }
+}
+
+void AccessLog::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+// Wakes every FLUSH_INTERVAL_MS, or early when a ring fills up; drains again after stop
+void AccessLog::writer_loop() {
+    std::string buffer;
+    buffer.reserve(WRITE_BATCH_BYTES + 4096);
+
+    while (running.load()) {
+        pollfd wake_poll = {wake_fd, POLLIN, 0};
+        if (poll(&wake_poll, 1, FLUSH_INTERVAL_MS) > 0) {
+            uint64_t count;
+            ssize_t ignored = read(wake_fd, &count, sizeof(count));
+            (void)ignored;
+        }
+        while (drain(buffer)) {
+        }
+        write_out(buffer);
+    }
+    while (drain(buffer)) {
+    }
+    write_out(buffer);
+}
+
+// Formats queued records until the batch is full; true if records may remain
+bool AccessLog::drain(std::string& buffer) {
+    std::vector<Ring*> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto& ring : rings) {
+            snapshot.push_back(ring.get());
+        }
+    }
+
+    bool more = false;
+    for (Ring* ring : snapshot) {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t count = 0;
+        while (tail != head && buffer.size() < WRITE_BATCH_BYTES) {
+            format_record(ring->records[tail & (RING_CAPACITY - 1)], format, buffer);
+            tail++;
+            count++;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+        written.fetch_add(count, std::memory_order_relaxed);
+        if (tail != head) {
+            more = true;
+        }
+        if (buffer.size() >= WRITE_BATCH_BYTES) {
+            write_out(buffer);
+        }
+    }
+    return more;
+}
+
+void AccessLog::write_out(std::string& buffer) {
+    size_t offset = 0;
+    while (offset < buffer.size()) {
+        ssize_t result = write(output_fd, buffer.data() + offset, buffer.size() - offset);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;   // unwritable output: drop this batch rather than stall the rings
+        }
+        offset += static_cast<size_t>(result);
+    }
+    buffer.clear();
+}
+
+AccessLog::Stats AccessLog::get_stats() const {
+    Stats stats = {written.load(std::memory_order_relaxed), 0, 0};
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (const auto& ring : rings) {
+        stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+        stats.sampled_out += ring->sampled_out.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
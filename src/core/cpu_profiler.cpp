@@ -0,0 +1,415 @@
+#include "../../include/core/cpu_profiler.h"
+#include "../../include/core/process_stats.h"
+#include "../../include/core/globals.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <time.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+const int CpuProfiler::MAX_DEPTH;
+const size_t CpuProfiler::STACKS_PER_THREAD;
+const int CpuProfiler::MAX_SECONDS;
+const int CpuProfiler::MAX_HZ;
+const int CpuProfiler::DEFAULT_HZ;
+
+// Written only by its own thread's SIGPROF handler (SIGPROF is blocked while the handler
+// runs); read once sampling has stopped and no handler is running
+struct CpuProfiler::ThreadTable {
+    struct Entry {
+        std::atomic<uint64_t> hash{0};   // 0 while the slot is free; stored last
+        std::atomic<uint64_t> count{0};
+        int depth = 0;
+        void* frames[MAX_DEPTH];
+    };
+
+    std::string role;
+    timer_t timer;
+    bool armed = false;
+    std::atomic<uint64_t> dropped{0};
+    Entry entries[STACKS_PER_THREAD];
+};
+
+// Frames of the handler itself and the kernel's signal trampoline
+static const int SKIPPED_FRAMES = 2;
+
+static std::atomic<bool> g_sampling{false};
+static std::atomic<int> g_handlers_running{0};
+
+static uint64_t hash_frames(void* const* frames, int depth) {
+    uint64_t hash = 14695981039346656037ULL;   // FNV-1a over the return addresses
+    for (int i = 0; i < depth; i++) {
+        hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i])) * 1099511628211ULL;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static void record_stack(CpuProfiler::ThreadTable* table, void* const* frames, int depth) {
+    uint64_t hash = hash_frames(frames, depth);
+    const size_t mask = CpuProfiler::STACKS_PER_THREAD - 1;
+    for (size_t probe = 0; probe < 64; probe++) {
+        CpuProfiler::ThreadTable::Entry& entry = table->entries[(hash + probe) & mask];
+        uint64_t existing = entry.hash.load(std::memory_order_relaxed);
+        if (existing == 0) {
+            entry.depth = depth;
+            memcpy(entry.frames, frames, sizeof(void*) * static_cast<size_t>(depth));
+            entry.count.store(1, std::memory_order_relaxed);
+            entry.hash.store(hash, std::memory_order_release);
+            return;
+        }
+        if (existing == hash && entry.depth == depth &&
+            memcmp(entry.frames, frames, sizeof(void*) * static_cast<size_t>(depth)) == 0) {
+            entry.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    table->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Async-signal context: no locks, no allocation. backtrace() is safe here once it has been
+// called outside a handler (the first call loads libgcc_s).
+static void on_sigprof(int, siginfo_t* info, void*) {
+    int saved_errno = errno;
+    g_handlers_running.fetch_add(1);
+    if (g_sampling.load() && info && info->si_code == SI_TIMER && info->si_value.sival_ptr) {
+        void* frames[CpuProfiler::MAX_DEPTH + SKIPPED_FRAMES];
+        int depth = backtrace(frames, CpuProfiler::MAX_DEPTH + SKIPPED_FRAMES);
+        if (depth > SKIPPED_FRAMES) {
+            record_stack(static_cast<CpuProfiler::ThreadTable*>(info->si_value.sival_ptr),
+                         frames + SKIPPED_FRAMES, depth - SKIPPED_FRAMES);
+        }
+    }
+    g_handlers_running.fetch_sub(1);
+    errno = saved_errno;
+}
+
+// Installed once and never removed: a SIGPROF still pending after a profile would
+// otherwise hit the default action and terminate the process
+static bool install_handler() {
+    static std::once_flag once;
+    static bool installed = false;
+    std::call_once(once, []() {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = on_sigprof;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        installed = sigaction(SIGPROF, &action, nullptr) == 0;
+
+        void* warm_up[4];
+        backtrace(warm_up, 4);
+    });
+    return installed;
+}
+
+CpuProfiler& CpuProfiler::instance() {
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+std::string CpuProfiler::frame_name(const std::string& demangled) {
+    std::string name = demangled;
+    size_t clone = name.find(" [clone ");
+    if (clone != std::string::npos) {
+        name.erase(clone);
+    }
+
+    // Drop the parameter list: the parentheses matching the last ')' if only
+    // qualifiers follow it
+    size_t close = name.rfind(')');
+    if (close != std::string::npos) {
+        std::string tail = name.substr(close + 1);
+        if (tail.empty() || tail == " const" || tail == " &" || tail == " &&" || tail == " const &" ||
+            tail == " const &&" || tail == " volatile" || tail == " const volatile") {
+            int nesting = 0;
+            for (size_t i = close + 1; i-- > 0;) {
+                if (name[i] == ')') {
+                    nesting++;
+                } else if (name[i] == '(' && --nesting == 0) {
+                    if (i > 0) {
+                        name.erase(i);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    std::replace(name.begin(), name.end(), ';', ':');
+    return name;
+}
+
+// Function name for a code address; return addresses point after the call, so callers
+// are looked up one byte earlier
+static std::string symbolise(void* address, bool return_address,
+                             std::map<void*, std::string>& cache) {
+    auto cached = cache.find(address);
+    if (cached != cache.end()) {
+        return cached->second;
+    }
+
+    void* lookup = return_address ? static_cast<char*>(address) - 1 : address;
+    std::string name;
+    Dl_info info;
+    bool found = dladdr(lookup, &info) != 0;
+    if (found && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        name = CpuProfiler::frame_name(status == 0 && demangled ? demangled : info.dli_sname);
+        free(demangled);
+    } else if (found && info.dli_fname) {
+        // Not in the dynamic symbol table: module and offset, for offline symbolisation
+        const char* module = strrchr(info.dli_fname, '/');
+        char offset[32];
+        snprintf(offset, sizeof(offset), "+0x%zx",
+                 static_cast<size_t>(static_cast<char*>(lookup) - static_cast<char*>(info.dli_fbase)));
+        name = std::string("[") + (module ? module + 1 : info.dli_fname) + offset + "]";
+    } else {
+        char unknown[32];
+        snprintf(unknown, sizeof(unknown), "[%p]", lookup);
+        name = unknown;
+    }
+    cache[address] = name;
+    return name;
+}
+
+CpuProfiler::Result CpuProfiler::profile(int seconds, int hz, Profile& out) {
+    seconds = std::max(1, std::min(seconds, MAX_SECONDS));
+    hz = std::max(1, std::min(hz, MAX_HZ));
+    if (busy.exchange(true)) {
+        return BUSY;
+    }
+    struct BusyReset {
+        std::atomic<bool>& busy;
+        ~BusyReset() { busy.store(false); }
+    } reset{busy};
+
+    if (!install_handler()) {
+        return FAILED;
+    }
+
+    std::vector<std::unique_ptr<ThreadTable>> tables;
+    long interval_ns = 1000000000L / hz;
+    g_sampling.store(true);
+    for (const ProcessStats::ThreadInfo& thread : ProcessStats::registered_threads()) {
+        std::unique_ptr<ThreadTable> table(new ThreadTable());
+        table->role = thread.role;
+
+        // Fires after every 1/hz seconds of CPU the thread uses, delivered to that thread
+        sigevent event;
+        memset(&event, 0, sizeof(event));
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event.sigev_value.sival_ptr = table.get();
+        event.sigev_notify_thread_id = thread.tid;
+        if (timer_create(thread.clock, &event, &table->timer) != 0) {
+            continue;   // thread exited since it was listed
+        }
+        table->armed = true;
+        itimerspec spec;
+        spec.it_interval.tv_sec = 0;
+        spec.it_interval.tv_nsec = interval_ns;
+        spec.it_value = spec.it_interval;
+        timer_settime(table->timer, 0, &spec, nullptr);
+        tables.push_back(std::move(table));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline && !g_shutdown_requested.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    // Once no handler is running, late signals see g_sampling false and leave the tables alone
+    g_sampling.store(false);
+    for (auto& table : tables) {
+        if (table->armed) {
+            timer_delete(table->timer);
+        }
+    }
+    while (g_handlers_running.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    std::map<void*, std::string> symbols;
+    std::map<std::string, uint64_t> folded_counts;
+    out.samples = 0;
+    out.dropped = 0;
+    for (const auto& table : tables) {
+        out.dropped += table->dropped.load(std::memory_order_relaxed);
+        for (const ThreadTable::Entry& entry : table->entries) {
+            if (entry.hash.load(std::memory_order_acquire) == 0) {
+                continue;
+            }
+            std::string stack = table->role;
+            for (int i = entry.depth - 1; i >= 0; i--) {
+                stack += ';';
+                stack += symbolise(entry.frames[i], i > 0, symbols);
+            }
+            uint64_t count = entry.count.load(std::memory_order_relaxed);
+            folded_counts[stack] += count;
+            out.samples += count;
+        }
+    }
+    out.stacks.assign(folded_counts.begin(), folded_counts.end());
+    out.threads = tables.size();
+    out.seconds = seconds;
+    out.hz = hz;
+    return OK;
+}
+
+std::string CpuProfiler::folded(const Profile& profile) {
+    std::string text;
+    for (const auto& stack : profile.stacks) {
+        text += stack.first;
+        text += ' ';
+        text += std::to_string(stack.second);
+        text += '\n';
+    }
+    return text;
+}
+
+namespace {
+
+struct FlameNode {
+    uint64_t total = 0;
+    std::map<std::string, std::unique_ptr<FlameNode>> children;   // alphabetical, as flamegraph.pl
+};
+
+void append_xml_escaped(std::string& out, const std::string& text) {
+    for (char c : text) {
+        switch (c) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default: out += c;
+        }
+    }
+}
+
+int tree_depth(const FlameNode& node) {
+    int deepest = 0;
+    for (const auto& child : node.children) {
+        deepest = std::max(deepest, tree_depth(*child.second));
+    }
+    return deepest + 1;
+}
+
+struct SvgLayout {
+    double scale;       // pixels per sample
+    int height;
+    std::string* out;
+    uint64_t samples;
+};
+
+const int SVG_WIDTH = 1200;
+const int SVG_PADDING = 10;
+const int FRAME_HEIGHT = 16;
+const double MIN_FRAME_WIDTH = 0.3;
+
+// Warm colours keyed on the name, so a function has the same colour everywhere
+void frame_colour(const std::string& name, char* colour, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+    snprintf(colour, size, "rgb(%d,%d,%d)", 205 + static_cast<int>(hash % 50),
+             static_cast<int>((hash >> 8) % 200), static_cast<int>((hash >> 16) % 55));
+}
+
+void render(const std::string& name, const FlameNode& node, int depth, double x, const SvgLayout& layout) {
+    double width = static_cast<double>(node.total) * layout.scale;
+    if (width < MIN_FRAME_WIDTH) {
+        return;
+    }
+    int y = layout.height - SVG_PADDING - (depth + 1) * FRAME_HEIGHT;
+    char number[160];
+    char colour[32];
+    frame_colour(name, colour, sizeof(colour));
+
+    std::string& out = *layout.out;
+    out += "<g><title>";
+    append_xml_escaped(out, name);
+    snprintf(number, sizeof(number), " (%llu samples, %.2f%%)</title>",
+             static_cast<unsigned long long>(node.total), 100.0 * node.total / layout.samples);
+    out += number;
+    snprintf(number, sizeof(number),
+             "<rect x=\"%.1f\" y=\"%d\" width=\"%.1f\" height=\"%d\" fill=\"%s\" rx=\"2\"/>",
+             x, y, width, FRAME_HEIGHT - 1, colour);
+    out += number;
+    size_t fits = static_cast<size_t>(width / 7);   // ~7 px per character at 12 px
+    if (fits >= 3) {
+        snprintf(number, sizeof(number), "<text x=\"%.1f\" y=\"%d\">", x + 3, y + FRAME_HEIGHT - 4);
+        out += number;
+        append_xml_escaped(out, name.size() <= fits ? name : name.substr(0, fits - 2) + "..");
+        out += "</text>";
+    }
+    out += "</g>\n";
+
+    for (const auto& child : node.children) {
+        render(child.first, *child.second, depth + 1, x, layout);
+        x += static_cast<double>(child.second->total) * layout.scale;
+    }
+}
+
+} // namespace
+
+std::string CpuProfiler::flamegraph_svg(const Profile& profile, const std::string& title) {
+    FlameNode root;
+    for (const auto& stack : profile.stacks) {
+        root.total += stack.second;
+        FlameNode* node = &root;
+        size_t start = 0;
+        while (start <= stack.first.size()) {
+            size_t end = stack.first.find(';', start);
+            if (end == std::string::npos) {
+                end = stack.first.size();
+            }
+            std::unique_ptr<FlameNode>& child = node->children[stack.first.substr(start, end - start)];
+            if (!child) {
+                child.reset(new FlameNode());
+            }
+            child->total += stack.second;
+            node = child.get();
+            start = end + 1;
+        }
+    }
+
+    int height = tree_depth(root) * FRAME_HEIGHT + 2 * SVG_PADDING + 30;
+    std::string out;
+    char number[256];
+    snprintf(number, sizeof(number),
+             "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+             "<svg version=\"1.1\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\" "
+             "xmlns=\"http://www.w3.org/2000/svg\">\n",
+             SVG_WIDTH, height, SVG_WIDTH, height);
+    out += number;
+    out += "<style>text { font-family: Verdana, sans-serif; font-size: 12px; fill: #000; pointer-events: none; }"
+           " rect:hover { stroke: #000; stroke-width: 0.5; }</style>\n";
+    snprintf(number, sizeof(number), "<rect width=\"100%%\" height=\"100%%\" fill=\"#f8f8f0\"/>\n"
+             "<text x=\"%d\" y=\"24\" text-anchor=\"middle\" style=\"font-size: 17px\">", SVG_WIDTH / 2);
+    out += number;
+    append_xml_escaped(out, title);
+    snprintf(number, sizeof(number), " (%llu samples)</text>\n", static_cast<unsigned long long>(root.total));
+    out += number;
+
+    if (root.total > 0) {
+        SvgLayout layout{static_cast<double>(SVG_WIDTH - 2 * SVG_PADDING) / root.total, height, &out, root.total};
+        render("all", root, 0, SVG_PADDING, layout);
+    }
+    out += "</svg>\n";
+    return out;
+}
@@ -0,0 +1,337 @@
+#include "../../include/core/flight_recorder.h"
+#include "../../include/core/log.h"
+#include "../../include/core/process_stats.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const size_t FlightRecorder::CAPACITY;
+const int FlightRecorder::SLOW_CAPTURE_DELAY_MS;
+const int FlightRecorder::SLOW_DUMP_INTERVAL_MS;
+
+// Set once the recorder exists, so the signal handler never constructs it
+static FlightRecorder* g_recorder = nullptr;
+
+static std::atomic<uint64_t> g_next_connection_id{1};
+
+static void copy_text(char* dest, size_t size, const std::string& src) {
+    size_t length = std::min(src.size(), size - 1);
+    memcpy(dest, src.data(), length);
+    dest[length] = '\0';
+}
+
+static int32_t current_tid() {
+    static thread_local int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+void FlightRecorder::Record::set_request(const std::string& method_name, const std::string& request_path) {
+    copy_text(method, sizeof(method), method_name);
+    copy_text(path, sizeof(path), request_path);
+}
+
+int64_t FlightRecorder::Record::start_ns() const {
+    const int64_t phases[] = {accepted_ns, dequeued_ns, first_byte_ns, parsed_ns, handled_ns};
+    for (int64_t phase : phases) {
+        if (phase != 0) {
+            return phase;
+        }
+    }
+    return finished_ns;
+}
+
+FlightRecorder& FlightRecorder::instance() {
+    // Never destroyed: detached threads may still record while the process exits
+    static FlightRecorder* recorder = new FlightRecorder();
+    return *recorder;
+}
+
+FlightRecorder::FlightRecorder() : directory("."), wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    g_recorder = this;
+}
+
+uint64_t FlightRecorder::next_connection_id() {
+    return g_next_connection_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool FlightRecorder::configure(const std::string& new_directory, uint32_t slow_ms) {
+    if (new_directory != "off") {
+        struct stat info;
+        if (stat(new_directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+            LOG_ERROR(LogModule::SERVER, "Flight recorder directory " << new_directory << " is not a directory");
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(config_mutex);
+        directory = new_directory;
+    }
+    enabled.store(new_directory != "off");
+    slow_threshold_ns.store(static_cast<int64_t>(slow_ms) * 1000000);
+    return true;
+}
+
+void FlightRecorder::set_context(std::function<std::string()> provider) {
+    std::lock_guard<std::mutex> lock(config_mutex);
+    context = std::move(provider);
+}
+
+void FlightRecorder::record(Record& record) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint64_t sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+    record.sequence = sequence;
+    record.worker = current_tid();
+    record.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // Two writers only share a slot if CAPACITY requests finish during one copy
+    Slot& slot = slots[sequence & (CAPACITY - 1)];
+    slot.version.store(sequence * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.version.store(sequence * 2 + 2, std::memory_order_release);
+
+    int64_t threshold = slow_threshold_ns.load(std::memory_order_relaxed);
+    if (threshold > 0 && record.finished_ns - record.start_ns() >= threshold) {
+        slow_count.fetch_add(1, std::memory_order_relaxed);
+        int64_t now_ms = record.finished_ns / 1000000;
+        int64_t last = last_slow_dump_ms.load(std::memory_order_relaxed);
+        if ((last == 0 || now_ms - last >= SLOW_DUMP_INTERVAL_MS) &&
+            last_slow_dump_ms.compare_exchange_strong(last, now_ms)) {
+            slow_trigger.store(sequence);
+            wake();
+        }
+    }
+}
+
+void FlightRecorder::snapshot(std::vector<Record>& out) const {
+    out.clear();
+    out.reserve(CAPACITY);
+    for (const Slot& slot : slots) {
+        uint64_t before = slot.version.load(std::memory_order_acquire);
+        if (before == 0 || (before & 1) != 0) {
+            continue;   // empty, or a writer is in the middle of it
+        }
+        Record copy = slot.record;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) == before) {
+            out.push_back(copy);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const Record& a, const Record& b) { return a.sequence < b.sequence; });
+}
+
+static const char* protocol_name(uint8_t protocol) {
+    switch (protocol) {
+        case FlightRecorder::HTTP1: return "http/1.1";
+        case FlightRecorder::HTTPS: return "https";
+        case FlightRecorder::HTTP2: return "h2";
+        default: return "-";
+    }
+}
+
+// Microseconds between two phases, "-" if either is missing
+static void append_phase(std::string& out, int64_t from_ns, int64_t to_ns) {
+    char text[32];
+    if (from_ns == 0 || to_ns == 0) {
+        snprintf(text, sizeof(text), " %9s", "-");
+    } else {
+        snprintf(text, sizeof(text), " %9lld", static_cast<long long>((to_ns - from_ns) / 1000));
+    }
+    out += text;
+}
+
+void FlightRecorder::format_record(const Record& record, std::string& out) {
+    time_t seconds = static_cast<time_t>(record.time_ms / 1000);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+    char text[160];
+    size_t length = strftime(text, sizeof(text), "%H:%M:%S", &utc);
+    snprintf(text + length, sizeof(text) - length, ".%03d %8llu %6llu %-8s %7d %6d %3u %-7s",
+             static_cast<int>(record.time_ms % 1000), static_cast<unsigned long long>(record.sequence),
+             static_cast<unsigned long long>(record.connection_id), protocol_name(record.protocol),
+             record.worker, record.stream_id, static_cast<unsigned>(record.status),
+             record.method[0] ? record.method : "-");
+    out += text;
+    snprintf(text, sizeof(text), " %8llu %9llu", static_cast<unsigned long long>(record.bytes_received),
+             static_cast<unsigned long long>(record.bytes_sent));
+    out += text;
+    append_phase(out, record.accepted_ns, record.dequeued_ns);
+    append_phase(out, record.dequeued_ns, record.first_byte_ns);
+    append_phase(out, record.first_byte_ns, record.parsed_ns);
+    append_phase(out, record.parsed_ns, record.handled_ns);
+    append_phase(out, record.handled_ns, record.finished_ns);
+    append_phase(out, record.start_ns(), record.finished_ns);
+    out += ' ';
+    out += record.path[0] ? record.path : "-";
+    out += '\n';
+}
+
+std::string FlightRecorder::dump(const char* reason, uint64_t trigger) {
+    std::vector<Record> records;
+    snapshot(records);
+
+    std::string dump_directory;
+    std::function<std::string()> provider;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex);
+        dump_directory = directory;
+        provider = context;
+    }
+
+    auto now = std::chrono::system_clock::now();
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    time_t seconds = static_cast<time_t>(now_ms / 1000);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+    char stamp[64];
+    size_t length = strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &utc);
+    snprintf(stamp + length, sizeof(stamp) - length, ".%03d", static_cast<int>(now_ms % 1000));
+    std::string name = std::string("flight-") + stamp + "-" + reason + ".txt";
+    std::string path = dump_directory + "/" + name;
+    std::string partial = dump_directory + "/." + name;   // renamed once complete
+
+    std::string text = "# Flight recorder dump\n# reason: ";
+    text += reason;
+    for (const Record& record : records) {
+        if (trigger != 0 && record.sequence == trigger) {
+            char detail[128];
+            snprintf(detail, sizeof(detail), " (request %llu took %.3f ms, threshold %lld ms)",
+                     static_cast<unsigned long long>(trigger), (record.finished_ns - record.start_ns()) / 1e6,
+                     static_cast<long long>(slow_threshold_ns.load() / 1000000));
+            text += detail;
+        }
+    }
+    text += "\n# time: ";
+    text += stamp;
+    text += " UTC, pid ";
+    text += std::to_string(getpid());
+    text += "\n# records: ";
+    text += std::to_string(records.size());
+    text += '\n';
+    if (provider) {
+        std::string lines = provider();
+        size_t start = 0;
+        while (start < lines.size()) {
+            size_t end = lines.find('\n', start);
+            if (end == std::string::npos) {
+                end = lines.size();
+            }
+            text += "# " + lines.substr(start, end - start) + '\n';
+            start = end + 1;
+        }
+    }
+    text += "# Phases in microseconds: queue = accepted to picked up, wait = picked up to first byte,\n"
+            "# read = first byte to parsed, handler = parsed to response built, write = built to last byte\n";
+    char columns[256];
+    snprintf(columns, sizeof(columns), "%-12s %8s %6s %-8s %7s %6s %3s %-7s %8s %9s %9s %9s %9s %9s %9s %9s %s\n",
+             "# time", "sequence", "conn", "protocol", "worker", "stream", "st", "method", "received", "sent",
+             "queue", "wait", "read", "handler", "write", "total", "path");
+    text += columns;
+    for (const Record& record : records) {
+        format_record(record, text);
+        if (trigger != 0 && record.sequence == trigger) {
+            text.insert(text.size() - 1, "   <-- slow");
+        }
+    }
+
+    int fd = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR(LogModule::SERVER, "Cannot write flight recorder dump " << path << ": " << strerror(errno));
+        return "";
+    }
+    size_t offset = 0;
+    while (offset < text.size()) {
+        ssize_t result = write(fd, text.data() + offset, text.size() - offset);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        offset += static_cast<size_t>(result);
+    }
+    close(fd);
+    if (offset < text.size() || rename(partial.c_str(), path.c_str()) != 0) {
+        LOG_ERROR(LogModule::SERVER, "Cannot write flight recorder dump " << path << ": " << strerror(errno));
+        unlink(partial.c_str());
+        return "";
+    }
+    dump_count.fetch_add(1, std::memory_order_relaxed);
+    LOG_WARN(LogModule::SERVER, "Flight recorder dump (" << reason << ", " << records.size()
+             << " requests) written to " << path);
+    return path;
+}
+
+void FlightRecorder::on_dump_signal(int signal) {
+    (void)signal;
+    if (g_recorder) {
+        int saved_errno = errno;
+        g_recorder->signal_requested.store(true);
+        g_recorder->wake();
+        errno = saved_errno;
+    }
+}
+
+void FlightRecorder::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void FlightRecorder::start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    dump_thread = std::thread([this]() {
+        ProcessStats::register_thread("background");
+        this->dump_loop();
+    });
+}
+
+void FlightRecorder::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    wake();
+    if (dump_thread.joinable()) {
+        dump_thread.join();
+    }
+}
+
+void FlightRecorder::dump_loop() {
+    while (running.load()) {
+        pollfd wake_poll = {wake_fd, POLLIN, 0};
+        if (poll(&wake_poll, 1, -1) <= 0) {
+            continue;   // EINTR
+        }
+        uint64_t count;
+        ssize_t ignored = read(wake_fd, &count, sizeof(count));
+        (void)ignored;
+        if (!running.load()) {
+            break;
+        }
+
+        if (signal_requested.exchange(false)) {
+            dump("signal", 0);
+        }
+        uint64_t trigger = slow_trigger.exchange(0);
+        if (trigger != 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_CAPTURE_DELAY_MS));
+            dump("slow", trigger);
+        }
+    }
+}
+
+FlightRecorder::Stats FlightRecorder::get_stats() const {
+    return Stats{next_sequence.load(std::memory_order_relaxed) - 1, slow_count.load(std::memory_order_relaxed),
+                 dump_count.load(std::memory_order_relaxed)};
+}
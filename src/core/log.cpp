@@ -0,0 +1,116 @@
+#include "../../include/core/log.h"
+#include <unistd.h>
+
+const size_t Log::MODULE_COUNT;
+
+std::atomic<uint8_t> Log::levels[Log::MODULE_COUNT] = {
+    {static_cast<uint8_t>(LogLevel::INFO)}, {static_cast<uint8_t>(LogLevel::INFO)},
+    {static_cast<uint8_t>(LogLevel::INFO)}, {static_cast<uint8_t>(LogLevel::INFO)},
+    {static_cast<uint8_t>(LogLevel::INFO)}, {static_cast<uint8_t>(LogLevel::INFO)}
+};
+
+void Log::set_level(LogModule module, LogLevel level) {
+    levels[static_cast<size_t>(module)].store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+void Log::set_all(LogLevel level) {
+    for (size_t i = 0; i < MODULE_COUNT; i++) {
+        set_level(static_cast<LogModule>(i), level);
+    }
+}
+
+bool Log::configure(const std::string& spec) {
+    LogLevel all;
+    if (parse_level(spec, all)) {
+        set_all(all);
+        return true;
+    }
+
+    // Validate every part before applying any of them
+    LogLevel parsed[MODULE_COUNT];
+    bool present[MODULE_COUNT] = {};
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t end = spec.find(',', start);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        std::string part = spec.substr(start, end - start);
+        size_t equals = part.find('=');
+        LogModule module;
+        LogLevel level;
+        if (equals == std::string::npos || !parse_module(part.substr(0, equals), module) ||
+            !parse_level(part.substr(equals + 1), level)) {
+            return false;
+        }
+        parsed[static_cast<size_t>(module)] = level;
+        present[static_cast<size_t>(module)] = true;
+        start = end + 1;
+    }
+    for (size_t i = 0; i < MODULE_COUNT; i++) {
+        if (present[i]) {
+            set_level(static_cast<LogModule>(i), parsed[i]);
+        }
+    }
+    return true;
+}
+
+bool Log::parse_level(const std::string& name, LogLevel& level) {
+    for (uint8_t i = 0; i <= static_cast<uint8_t>(LogLevel::OFF); i++) {
+        if (name == level_name(static_cast<LogLevel>(i))) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Log::parse_module(const std::string& name, LogModule& module) {
+    for (size_t i = 0; i < MODULE_COUNT; i++) {
+        if (name == module_name(static_cast<LogModule>(i))) {
+            module = static_cast<LogModule>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* Log::level_name(LogLevel level) {
+    switch (level) {
+        case LogLevel::TRACE: return "trace";
+        case LogLevel::DEBUG: return "debug";
+        case LogLevel::INFO: return "info";
+        case LogLevel::WARN: return "warn";
+        case LogLevel::ERROR: return "error";
+        case LogLevel::OFF: return "off";
+        default: return "unknown";
+    }
+}
+
+const char* Log::module_name(LogModule module) {
+    switch (module) {
+        case LogModule::SERVER: return "server";
+        case LogModule::HTTP2: return "http2";
+        case LogModule::WEBSOCKET: return "websocket";
+        case LogModule::TLS: return "tls";
+        case LogModule::POOL: return "pool";
+        case LogModule::EVENTS: return "events";
+        default: return "unknown";
+    }
+}
+
+void Log::write(LogLevel level, LogModule module, const std::string& message) {
+    std::string line;
+    line.reserve(message.size() + 24);
+    line += '[';
+    line += level_name(level);
+    line += ' ';
+    line += module_name(module);
+    line += "] ";
+    line += message;
+    line += '\n';
+
+    int fd = level >= LogLevel::WARN ? STDERR_FILENO : STDOUT_FILENO;
+    ssize_t ignored = ::write(fd, line.data(), line.size());
+    (void)ignored;
+}
@@ -1,4 +1,7 @@
 #include "../../include/core/server.h"
+#include "../../include/core/access_log.h"
+#include "../../include/core/flight_recorder.h"
+#include "../../include/core/log.h"
 #include <iostream>
 #include <signal.h>
 #include <thread>
@@ -34,9 +37,26 @@ void print_usage(const char* program_name) {
     std::cout << "Options:" << std::endl;
     std::cout << "  -p, --port PORT        Server port (default: 8080)" << std::endl;
     std::cout << "  -d, --docroot PATH     Document root directory (default: ./www)" << std::endl;
-    std::cout << "  -t, --threads COUNT    Thread pool size (default: 4)" << std::endl;
+    std::cout << "  -t, --threads COUNT    Thread pool size, the minimum when elastic (default: 4)" << std::endl;
+    std::cout << "  --max-threads COUNT    Let the pool grow to COUNT threads while tasks queue (default: same as -t)" << std::endl;
+    std::cout << "  --queue-wait-ms MS     Start a worker when tasks wait longer than this (default: 10)" << std::endl;
+    std::cout << "  --thread-idle-s SECONDS Retire a worker idle this long, down to -t (default: 30)" << std::endl;
+    std::cout << "  --queue-limits SPEC    Connections each lane may queue before 503s, 0 for none (default: high=256,normal=1024,low=256)" << std::endl;
     std::cout << "  -k, --keep-alive       Enable Keep-Alive (default: enabled)" << std::endl;
     std::cout << "  -T, --timeout SECONDS  Keep-Alive timeout (default: 5)" << std::endl;
+    std::cout << "  --ws-max-message BYTES Max reassembled WebSocket message size (default: 1048576)" << std::endl;
+    std::cout << "  --ws-max-outbound BYTES Max queued outbound bytes per WebSocket client (default: 1048576)" << std::endl;
+    std::cout << "  --ws-slow-policy NAME  Slow WebSocket client policy: drop_oldest, coalesce, disconnect (default: coalesce)" << std::endl;
+    std::cout << "  --access-log PATH      Access log file, - for stdout, off to disable (default: -)" << std::endl;
+    std::cout << "  --access-log-format F  Access log format: common, combined, json (default: common)" << std::endl;
+    std::cout << "  --access-log-sample N  Log 1 in N requests; 5xx are always logged (default: 1)" << std::endl;
+    std::cout << "  --profiler             Serve CPU profiles and flame graphs at /api/profile" << std::endl;
+    std::cout << "  --flight-recorder DIR  Where SIGUSR1 and slow requests dump recent requests, off to disable (default: .)" << std::endl;
+    std::cout << "  --slow-request-ms MS   Dump the flight recorder after a request this slow (default: 0, never)" << std::endl;
+    std::cout << "  --otlp-endpoint URL    OTLP/HTTP collector for traces and metrics, e.g. http://localhost:4318 (default: off)" << std::endl;
+    std::cout << "  --otlp-sample N        Trace 1 in N requests; 5xx and slow requests are always traced (default: 100)" << std::endl;
+    std::cout << "  --otlp-slow-ms MS      Trace every request at least this slow (default: 250)" << std::endl;
+    std::cout << "  --log-level SPEC       Diagnostic level: debug, or per module e.g. http2=trace,server=debug (default: info)" << std::endl;
     std::cout << "  -h, --help             Show this help message" << std::endl;
     std::cout << std::endl;
     std::cout << "Examples:" << std::endl;
@@ -44,6 +64,7 @@ void print_usage(const char* program_name) {
     std::cout << "  " << program_name << " -p 8081           # Custom port" << std::endl;
     std::cout << "  " << program_name << " -p 8080 -t 8      # Port 8080, 8 threads" << std::endl;
     std::cout << "  " << program_name << " -k -T 10          # Keep-Alive with 10s timeout" << std::endl;
+    std::cout << "  " << program_name << " -t 4 --max-threads 64 # 4 threads, up to 64 at peak" << std::endl;
 }
 
 void print_server_info(int port, const std::string& doc_root, size_t thread_count, 
@@ -96,8 +117,24 @@ int main(int argc, char* argv[]) {
     int port = 8080;
     std::string doc_root = "./www";
     size_t thread_count = 4;
+    size_t max_threads = 0;
+    uint32_t queue_wait_ms = 10;
+    uint32_t thread_idle_s = 30;
+    std::string queue_limits = "high=256,normal=1024,low=256";
     bool keep_alive_enabled = true;
     int keep_alive_timeout = 5;
+    size_t ws_max_message = 0;
+    size_t ws_max_outbound = 0;
+    std::string ws_slow_policy;
+    std::string access_log_path = "-";
+    std::string access_log_format = "common";
+    uint32_t access_log_sample = 1;
+    bool profiler_enabled = false;
+    std::string flight_recorder_dir = ".";
+    uint32_t slow_request_ms = 0;
+    std::string otlp_endpoint = "off";
+    uint32_t otlp_sample = 100;
+    uint32_t otlp_slow_ms = 250;
 
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -139,12 +176,62 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
         }
+        else if (arg == "--max-threads") {
+            if (i + 1 < argc) {
+                long count = std::stol(argv[++i]);
+                if (count < 1 || count > 1024) {
+                    std::cerr << "Error: Max thread count must be between 1 and 1024" << std::endl;
+                    return 1;
+                }
+                max_threads = static_cast<size_t>(count);
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--queue-wait-ms") {
+            if (i + 1 < argc) {
+                long target = std::stol(argv[++i]);
+                if (target < 1 || target > 60000) {
+                    std::cerr << "Error: Queue wait target must be between 1 and 60000 ms" << std::endl;
+                    return 1;
+                }
+                queue_wait_ms = static_cast<uint32_t>(target);
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--thread-idle-s") {
+            if (i + 1 < argc) {
+                long idle = std::stol(argv[++i]);
+                if (idle < 1 || idle > 86400) {
+                    std::cerr << "Error: Thread idle time must be between 1 and 86400 seconds" << std::endl;
+                    return 1;
+                }
+                thread_idle_s = static_cast<uint32_t>(idle);
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--queue-limits") {
+            if (i + 1 < argc) {
+                queue_limits = argv[++i];
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
         else if (arg == "-k" || arg == "--keep-alive") {
             keep_alive_enabled = true;
         }
         else if (arg == "--no-keep-alive") {
             keep_alive_enabled = false;
         }
+        else if (arg == "--profiler") {
+            profiler_enabled = true;
+        }
         else if (arg == "-T" || arg == "--timeout") {
             if (i + 1 < argc) {
                 keep_alive_timeout = std::stoi(argv[++i]);
@@ -157,6 +244,147 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
         }
+        else if (arg == "--ws-max-message") {
+            if (i + 1 < argc) {
+                ws_max_message = std::stoul(argv[++i]);
+                if (ws_max_message < 125) {
+                    std::cerr << "Error: WebSocket max message size must be at least 125 bytes" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--ws-max-outbound") {
+            if (i + 1 < argc) {
+                ws_max_outbound = std::stoul(argv[++i]);
+                if (ws_max_outbound < 4096) {
+                    std::cerr << "Error: WebSocket outbound limit must be at least 4096 bytes" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--ws-slow-policy") {
+            if (i + 1 < argc) {
+                ws_slow_policy = argv[++i];
+                SlowConsumerPolicy policy;
+                if (!WebSocketHandler::parse_slow_consumer_policy(ws_slow_policy, policy)) {
+                    std::cerr << "Error: unknown slow consumer policy '" << ws_slow_policy
+                              << "' (use drop_oldest, coalesce or disconnect)" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--access-log") {
+            if (i + 1 < argc) {
+                access_log_path = argv[++i];
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--access-log-format") {
+            if (i + 1 < argc) {
+                access_log_format = argv[++i];
+                AccessLogFormat format;
+                if (!AccessLog::parse_format(access_log_format, format)) {
+                    std::cerr << "Error: unknown access log format '" << access_log_format
+                              << "' (use common, combined or json)" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--access-log-sample") {
+            if (i + 1 < argc) {
+                long sample = std::stol(argv[++i]);
+                if (sample < 1 || sample > 1000000) {
+                    std::cerr << "Error: Access log sampling must be between 1 and 1000000" << std::endl;
+                    return 1;
+                }
+                access_log_sample = static_cast<uint32_t>(sample);
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--flight-recorder") {
+            if (i + 1 < argc) {
+                flight_recorder_dir = argv[++i];
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--slow-request-ms") {
+            if (i + 1 < argc) {
+                long threshold = std::stol(argv[++i]);
+                if (threshold < 0 || threshold > 3600000) {
+                    std::cerr << "Error: Slow request threshold must be between 0 and 3600000 ms" << std::endl;
+                    return 1;
+                }
+                slow_request_ms = static_cast<uint32_t>(threshold);
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--otlp-endpoint") {
+            if (i + 1 < argc) {
+                otlp_endpoint = argv[++i];
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--otlp-sample") {
+            if (i + 1 < argc) {
+                long every = std::stol(argv[++i]);
+                if (every < 0 || every > 1000000) {
+                    std::cerr << "Error: OTLP sample rate must be between 0 and 1000000" << std::endl;
+                    return 1;
+                }
+                otlp_sample = static_cast<uint32_t>(every);
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--otlp-slow-ms") {
+            if (i + 1 < argc) {
+                long threshold = std::stol(argv[++i]);
+                if (threshold < 0 || threshold > 3600000) {
+                    std::cerr << "Error: OTLP slow request threshold must be between 0 and 3600000 ms" << std::endl;
+                    return 1;
+                }
+                otlp_slow_ms = static_cast<uint32_t>(threshold);
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--log-level") {
+            if (i + 1 < argc) {
+                std::string spec = argv[++i];
+                if (!Log::configure(spec)) {
+                    std::cerr << "Error: invalid log level '" << spec
+                              << "' (use trace, debug, info, warn, error, off, optionally as module=level,...)" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return 1;
+            }
+        }
         else {
             // Legacy positional argument support for backward compatibility
             if (i == 1) {
@@ -183,12 +411,31 @@ int main(int argc, char* argv[]) {
     sigaction(SIGTERM, &sa, nullptr);
     signal(SIGPIPE, SIG_IGN); // Ignore broken pipe signals
 
+    // SIGUSR1 dumps the flight recorder; the dump itself happens on its own thread
+    struct sigaction dump_action;
+    dump_action.sa_handler = FlightRecorder::on_dump_signal;
+    sigemptyset(&dump_action.sa_mask);
+    dump_action.sa_flags = SA_RESTART;
+    FlightRecorder::instance();   // exists before the handler can run
+    sigaction(SIGUSR1, &dump_action, nullptr);
+
     // Print configuration
     print_server_info(port, doc_root, thread_count, keep_alive_enabled, keep_alive_timeout);
 
+    if (max_threads != 0 && max_threads < thread_count) {
+        std::cerr << "Error: --max-threads must be at least the thread count (" << thread_count << ")" << std::endl;
+        return 1;
+    }
+    ThreadPool::Scaling pool_scaling = ThreadPool::Scaling::fixed(thread_count);
+    if (max_threads != 0) {
+        pool_scaling.max_threads = max_threads;
+    }
+    pool_scaling.target_wait = std::chrono::milliseconds(queue_wait_ms);
+    pool_scaling.idle_cooldown = std::chrono::seconds(thread_idle_s);
+
     // Create and initialize server
     try {
-        WebServer server(port, doc_root, thread_count);
+        WebServer server(port, doc_root, pool_scaling);
         server_instance = &server;
 
         // Enable Keep-Alive if requested
@@ -196,6 +443,28 @@ int main(int argc, char* argv[]) {
             server.enable_keep_alive(true, keep_alive_timeout);
         }
         
+        if (ws_max_message > 0) {
+            server.set_websocket_max_message_size(ws_max_message);
+        }
+        if (ws_max_outbound > 0 || !ws_slow_policy.empty()) {
+            server.set_websocket_backpressure(ws_max_outbound, ws_slow_policy);
+        }
+        if (!server.set_access_log(access_log_path, access_log_format, access_log_sample)) {
+            return 1;
+        }
+        server.enable_profiler(profiler_enabled);
+        if (!server.set_flight_recorder(flight_recorder_dir, slow_request_ms)) {
+            return 1;
+        }
+        if (!server.set_otlp_export(otlp_endpoint, otlp_sample, otlp_slow_ms)) {
+            return 1;
+        }
+        if (!server.set_queue_limits(queue_limits)) {
+            std::cerr << "Error: invalid queue limits '" << queue_limits
+                      << "' (use lane=count pairs for high, normal and low, e.g. normal=1024,low=0)" << std::endl;
+            return 1;
+        }
+        
         // Enable HTTP/2 support with enhanced features
         server.enable_http2(true);
         
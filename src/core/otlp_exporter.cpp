@@ -0,0 +1,536 @@
+#include "../../include/core/otlp_exporter.h"
+#include "../../include/core/route_stats.h"
+#include "../../include/core/log.h"
+#include "../../include/core/process_stats.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <netdb.h>
+#include <poll.h>
+#include <random>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const size_t OtlpExporter::QUEUE_CAPACITY;
+const size_t OtlpExporter::BATCH_SIZE;
+const int OtlpExporter::EXPORT_INTERVAL_MS;
+const int OtlpExporter::METRICS_INTERVAL_MS;
+const int OtlpExporter::TIMEOUT_MS;
+const uint16_t OtlpExporter::DEFAULT_PORT;
+
+static const char* const SERVICE_NAME = "webserver";
+
+// SPAN_KIND_INTERNAL, SPAN_KIND_SERVER and STATUS_CODE_ERROR
+static const int KIND_INTERNAL = 1;
+static const int KIND_SERVER = 2;
+static const int STATUS_ERROR = 2;
+
+static int64_t unix_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;   // the spec only allows lowercase
+}
+
+static bool parse_hex(const std::string& text, size_t offset, uint8_t* out, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        int high = hex_value(text[offset + 2 * i]);
+        int low = hex_value(text[offset + 2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return true;
+}
+
+static bool all_zero(const uint8_t* bytes, size_t count) {
+    return std::all_of(bytes, bytes + count, [](uint8_t b) { return b == 0; });
+}
+
+static void append_hex(std::string& out, const uint8_t* bytes, size_t count) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < count; i++) {
+        out += digits[bytes[i] >> 4];
+        out += digits[bytes[i] & 0xf];
+    }
+}
+
+static void random_id(uint8_t* out, size_t bytes) {
+    static thread_local std::mt19937_64 generator(std::random_device{}() ^ static_cast<uint64_t>(unix_nanos()));
+    do {
+        for (size_t i = 0; i < bytes; i += 8) {
+            uint64_t value = generator();
+            memcpy(out + i, &value, std::min<size_t>(8, bytes - i));
+        }
+    } while (all_zero(out, bytes));
+}
+
+OtlpExporter& OtlpExporter::instance() {
+    // Never destroyed: detached threads may still record while the process exits
+    static OtlpExporter* exporter = new OtlpExporter();
+    return *exporter;
+}
+
+OtlpExporter::OtlpExporter() : start_unix_nano(unix_nanos()), wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+bool OtlpExporter::parse_traceparent(const std::string& header, TraceContext& context) {
+    // Later versions may append fields after the flags
+    if (header.size() < 55 || (header.size() > 55 && header[55] != '-') ||
+        header[2] != '-' || header[35] != '-' || header[52] != '-') {
+        return false;
+    }
+    uint8_t version;
+    uint8_t flags;
+    if (!parse_hex(header, 0, &version, 1) || version == 0xff || (version == 0 && header.size() != 55) ||
+        !parse_hex(header, 3, context.trace_id, 16) || !parse_hex(header, 36, context.parent_id, 8) ||
+        !parse_hex(header, 53, &flags, 1)) {
+        return false;
+    }
+    if (all_zero(context.trace_id, 16) || all_zero(context.parent_id, 8)) {
+        return false;
+    }
+    context.sampled = (flags & 1) != 0;
+    return true;
+}
+
+bool OtlpExporter::configure(const std::string& endpoint, uint32_t sample, uint32_t slow_ms) {
+    if (endpoint == "off") {
+        enabled.store(false);
+        return true;
+    }
+    const std::string scheme = "http://";
+    if (endpoint.compare(0, scheme.size(), scheme) != 0) {
+        LOG_ERROR(LogModule::SERVER, "OTLP endpoint " << endpoint << " must start with http://");
+        return false;
+    }
+    std::string authority = endpoint.substr(scheme.size());
+    size_t slash = authority.find('/');
+    std::string prefix = slash == std::string::npos ? "" : authority.substr(slash);
+    authority = authority.substr(0, slash);
+    while (!prefix.empty() && prefix.back() == '/') {
+        prefix.pop_back();
+    }
+
+    uint16_t new_port = DEFAULT_PORT;
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        char* end = nullptr;
+        long value = strtol(authority.c_str() + colon + 1, &end, 10);
+        if (colon + 1 == authority.size() || *end != '\0' || value <= 0 || value > 65535) {
+            LOG_ERROR(LogModule::SERVER, "OTLP endpoint " << endpoint << " has an invalid port");
+            return false;
+        }
+        new_port = static_cast<uint16_t>(value);
+        authority = authority.substr(0, colon);
+    }
+    if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']') {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    if (authority.empty()) {
+        LOG_ERROR(LogModule::SERVER, "OTLP endpoint " << endpoint << " has no host");
+        return false;
+    }
+
+    endpoint_url = endpoint;
+    host = authority;
+    port = new_port;
+    path_prefix = prefix;
+    sample_every.store(sample);
+    slow_threshold_ns.store(static_cast<int64_t>(slow_ms) * 1000000);
+    enabled.store(true);
+    return true;
+}
+
+void OtlpExporter::set_metrics_provider(std::function<void(OtlpMetricsWriter&)> provider) {
+    std::lock_guard<std::mutex> lock(provider_mutex);
+    metrics_provider = std::move(provider);
+}
+
+bool OtlpExporter::keep(const FlightRecorder::Record& request, bool parent_sampled) {
+    if (parent_sampled || request.status >= 500 || request.status == 0) {
+        return true;
+    }
+    int64_t end = request.finished_ns != 0 ? request.finished_ns : request.handled_ns;
+    int64_t threshold = slow_threshold_ns.load(std::memory_order_relaxed);
+    if (threshold > 0 && end - request.start_ns() >= threshold) {
+        return true;
+    }
+    uint32_t every = sample_every.load(std::memory_order_relaxed);
+    static thread_local uint64_t seen = 0;
+    return every > 0 && ++seen % every == 0;
+}
+
+void OtlpExporter::record(const FlightRecorder::Record& request, const std::string& traceparent) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    TraceContext context;
+    bool has_parent = !traceparent.empty() && parse_traceparent(traceparent, context);
+    if (!keep(request, has_parent && context.sampled)) {
+        sampled_out.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Span span;
+    if (has_parent) {
+        memcpy(span.trace_id, context.trace_id, sizeof(span.trace_id));
+        memcpy(span.parent_id, context.parent_id, sizeof(span.parent_id));
+    } else {
+        random_id(span.trace_id, sizeof(span.trace_id));
+        memset(span.parent_id, 0, sizeof(span.parent_id));
+    }
+    random_id(span.span_id, sizeof(span.span_id));
+    span.has_parent = has_parent;
+    span.clock_offset_ns = unix_nanos() - FlightRecorder::nanos(std::chrono::steady_clock::now());
+    span.request = request;
+
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (queue.size() >= QUEUE_CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        queue.push_back(span);
+        queued = queue.size();
+    }
+    if (queued == BATCH_SIZE) {
+        wake();
+    }
+}
+
+// int64 values are strings in the protobuf JSON mapping
+static void append_int_attribute(std::string& out, const char* key, int64_t value) {
+    out += ",{\"key\":\"";
+    out += key;
+    out += "\",\"value\":{\"intValue\":\"" + std::to_string(value) + "\"}}";
+}
+
+static void append_string_attribute(std::string& out, const char* key, const std::string& value) {
+    out += ",{\"key\":\"";
+    out += key;
+    out += "\",\"value\":{\"stringValue\":";
+    OtlpMetricsWriter::append_string(out, value);
+    out += "}}";
+}
+
+static void append_span(std::string& out, const uint8_t* trace_id, const uint8_t* span_id, const uint8_t* parent_id,
+                        const std::string& name, int kind, int64_t start, int64_t end) {
+    out += "{\"traceId\":\"";
+    append_hex(out, trace_id, 16);
+    out += "\",\"spanId\":\"";
+    append_hex(out, span_id, 8);
+    out += "\"";
+    if (parent_id) {
+        out += ",\"parentSpanId\":\"";
+        append_hex(out, parent_id, 8);
+        out += "\"";
+    }
+    out += ",\"name\":";
+    OtlpMetricsWriter::append_string(out, name);
+    out += ",\"kind\":" + std::to_string(kind);
+    out += ",\"startTimeUnixNano\":\"" + std::to_string(start) + "\"";
+    out += ",\"endTimeUnixNano\":\"" + std::to_string(end) + "\"";
+}
+
+void OtlpExporter::format_spans(const std::vector<Span>& spans, std::string& out) {
+    out += "{\"resourceSpans\":[{\"resource\":{\"attributes\":";
+    OtlpMetricsWriter::append_attributes(out, {{"service.name", SERVICE_NAME}});
+    out += "},\"scopeSpans\":[{\"scope\":{\"name\":\"webserver\"},\"spans\":[";
+
+    bool first = true;
+    for (const Span& span : spans) {
+        const FlightRecorder::Record& request = span.request;
+        int64_t start = request.start_ns();
+        int64_t end = request.finished_ns != 0 ? request.finished_ns : request.handled_ns;
+        char route[RouteStats::NAME_LENGTH];
+        size_t route_length = RouteStats::route_template(request.path, std::strlen(request.path), request.status, route);
+        bool error = request.status >= 500 || request.status == 0;
+
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        append_span(out, span.trace_id, span.span_id, span.has_parent ? span.parent_id : nullptr,
+                    route_length > 0 ? std::string(request.method) + " " + route : std::string(request.method), KIND_SERVER,
+                    start + span.clock_offset_ns, end + span.clock_offset_ns);
+        out += ",\"attributes\":[{\"key\":\"http.request.method\",\"value\":{\"stringValue\":";
+        OtlpMetricsWriter::append_string(out, request.method);
+        out += "}}";
+        append_string_attribute(out, "url.path", request.path);
+        if (route_length > 0) {
+            append_string_attribute(out, "http.route", route);
+        }
+        append_string_attribute(out, "url.scheme", request.protocol == FlightRecorder::HTTPS ? "https" : "http");
+        append_string_attribute(out, "network.protocol.version", request.protocol == FlightRecorder::HTTP2 ? "2" : "1.1");
+        if (request.status != 0) {
+            append_int_attribute(out, "http.response.status_code", request.status);
+        }
+        append_int_attribute(out, "http.response.body.size", static_cast<int64_t>(request.bytes_sent));
+        out += "]";
+        if (error) {
+            out += ",\"status\":{\"code\":" + std::to_string(STATUS_ERROR) + "}";
+        }
+        out += "}";
+
+        // One child per phase the protocol has, named like ServerMetrics' phases
+        struct Phase {
+            const char* name;
+            int64_t from;
+            int64_t to;
+        };
+        const Phase phases[] = {
+            {"queue", request.accepted_ns, request.dequeued_ns},
+            {"first_byte", request.dequeued_ns, request.first_byte_ns},
+            {"read", request.first_byte_ns, request.parsed_ns},
+            {"handler", request.parsed_ns, request.handled_ns},
+            {"write", request.handled_ns, request.finished_ns},
+        };
+        uint64_t parent_value;
+        memcpy(&parent_value, span.span_id, sizeof(parent_value));
+        for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+            if (phases[i].from == 0 || phases[i].to == 0) {
+                continue;
+            }
+            // Derived from the server span's id, distinct for each phase
+            uint64_t child_value = parent_value ^ ((i + 1) * 0x9e3779b97f4a7c15ULL);
+            uint8_t child_id[8];
+            memcpy(child_id, &child_value, sizeof(child_id));
+            out += ',';
+            append_span(out, span.trace_id, child_id, span.span_id, phases[i].name, KIND_INTERNAL,
+                        phases[i].from + span.clock_offset_ns, phases[i].to + span.clock_offset_ns);
+            out += "}";
+        }
+    }
+    out += "]}]}]}";
+}
+
+void OtlpExporter::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void OtlpExporter::start() {
+    if (!enabled.load() || running.exchange(true)) {
+        return;
+    }
+    export_thread = std::thread([this]() {
+        ProcessStats::register_thread("background");
+        this->export_loop();
+    });
+}
+
+void OtlpExporter::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    wake();
+    if (export_thread.joinable()) {
+        export_thread.join();
+    }
+}
+
+void OtlpExporter::export_loop() {
+    auto next_spans = std::chrono::steady_clock::now() + std::chrono::milliseconds(EXPORT_INTERVAL_MS);
+    auto next_metrics = std::chrono::steady_clock::now() + std::chrono::milliseconds(METRICS_INTERVAL_MS);
+
+    while (running.load()) {
+        auto now = std::chrono::steady_clock::now();
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(std::min(next_spans, next_metrics) - now).count();
+        pollfd wake_poll = {wake_fd, POLLIN, 0};
+        if (poll(&wake_poll, 1, static_cast<int>(std::max<int64_t>(0, wait))) > 0) {
+            uint64_t count;
+            ssize_t ignored = read(wake_fd, &count, sizeof(count));
+            (void)ignored;
+        }
+        if (!running.load()) {
+            break;
+        }
+
+        now = std::chrono::steady_clock::now();
+        size_t queued;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            queued = queue.size();
+        }
+        if (queued >= BATCH_SIZE || now >= next_spans) {
+            export_spans();
+            next_spans = now + std::chrono::milliseconds(EXPORT_INTERVAL_MS);
+        }
+        if (now >= next_metrics) {
+            export_metrics();
+            next_metrics = now + std::chrono::milliseconds(METRICS_INTERVAL_MS);
+        }
+    }
+
+    export_spans();
+    export_metrics();
+}
+
+// Sends the spans queued when it is called. Spans recorded meanwhile wait for the next
+// call, so a collector that is down while traffic refills the queue cannot keep this
+// thread (and stop()) here forever.
+void OtlpExporter::export_spans() {
+    std::vector<Span> batch;
+    std::string body;
+    size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        pending = queue.size();
+    }
+    while (pending > 0) {
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            while (!queue.empty() && batch.size() < std::min(BATCH_SIZE, pending)) {
+                batch.push_back(queue.front());
+                queue.pop_front();
+            }
+        }
+        if (batch.empty()) {
+            return;
+        }
+        pending -= batch.size();
+        body.clear();
+        format_spans(batch, body);
+        if (post("/v1/traces", body)) {
+            exported.fetch_add(batch.size(), std::memory_order_relaxed);
+        } else {
+            dropped.fetch_add(batch.size(), std::memory_order_relaxed);
+        }
+    }
+}
+
+void OtlpExporter::export_metrics() {
+    OtlpMetricsWriter writer(start_unix_nano, unix_nanos());
+    {
+        std::lock_guard<std::mutex> lock(provider_mutex);
+        if (!metrics_provider) {
+            return;
+        }
+        metrics_provider(writer);
+    }
+    if (post("/v1/metrics", writer.take({{"service.name", SERVICE_NAME}}))) {
+        metric_exports.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Blocking POST on a new connection; any 2xx response counts as accepted
+bool OtlpExporter::post(const char* path, const std::string& body) {
+    std::string error;
+    int fd = -1;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    int resolved = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+    if (resolved != 0) {
+        error = std::string("cannot resolve ") + host + ": " + gai_strerror(resolved);
+    }
+    for (addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int connected = connect(fd, address->ai_addr, address->ai_addrlen);
+        if (connected != 0 && errno != EINPROGRESS) {
+            error = std::string("cannot connect: ") + strerror(errno);
+            close(fd);
+            fd = -1;
+        } else if (connected != 0) {
+            pollfd connecting = {fd, POLLOUT, 0};
+            int result = 0;
+            socklen_t length = sizeof(result);
+            if (poll(&connecting, 1, TIMEOUT_MS) <= 0 ||
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &result, &length) != 0 || result != 0) {
+                error = "cannot connect to " + host + ":" + std::to_string(port);
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+    if (addresses) {
+        freeaddrinfo(addresses);
+    }
+
+    bool ok = false;
+    if (fd >= 0) {
+        // configure() strips the brackets of an IPv6 literal; the Host header needs them
+        std::string host_header = host.find(':') == std::string::npos ? host : "[" + host + "]";
+        std::string request = std::string("POST ") + path_prefix + path + " HTTP/1.1\r\nHost: " + host_header + ":" +
+                              std::to_string(port) + "\r\nContent-Type: application/json\r\nContent-Length: " +
+                              std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+        auto remaining = [&deadline]() {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            return static_cast<int>(std::max<int64_t>(0, left.count()));
+        };
+
+        size_t sent = 0;
+        while (sent < request.size()) {
+            pollfd writable = {fd, POLLOUT, 0};
+            if (poll(&writable, 1, remaining()) <= 0) {
+                break;
+            }
+            ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+            sent += n > 0 ? static_cast<size_t>(n) : 0;
+        }
+
+        // Only the status line matters
+        std::string response;
+        while (sent == request.size() && response.find("\r\n") == std::string::npos) {
+            pollfd readable = {fd, POLLIN, 0};
+            if (poll(&readable, 1, remaining()) <= 0) {
+                break;
+            }
+            char buffer[512];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                    continue;
+                }
+                break;
+            }
+            response.append(buffer, static_cast<size_t>(n));
+        }
+        close(fd);
+
+        size_t space = response.find(' ');
+        ok = response.compare(0, 5, "HTTP/") == 0 && space != std::string::npos && response.size() > space + 1 &&
+             response[space + 1] == '2';
+        if (!ok) {
+            error = sent < request.size() ? "send to " + endpoint_url + " failed"
+                    : response.empty() ? "no response from " + endpoint_url
+                    : "collector answered " + response.substr(0, response.find("\r\n"));
+        }
+    }
+
+    if (!ok) {
+        failures.fetch_add(1, std::memory_order_relaxed);
+        if (last_export_ok) {
+            LOG_WARN(LogModule::SERVER, "OTLP export to " << path << " failed: " << error);
+        }
+    } else if (!last_export_ok) {
+        LOG_INFO(LogModule::SERVER, "OTLP export to " << endpoint_url << " recovered");
+    }
+    last_export_ok = ok;
+    return ok;
+}
+
+OtlpExporter::Stats OtlpExporter::get_stats() const {
+    return Stats{exported.load(std::memory_order_relaxed), dropped.load(std::memory_order_relaxed),
+                 sampled_out.load(std::memory_order_relaxed), failures.load(std::memory_order_relaxed),
+                 metric_exports.load(std::memory_order_relaxed)};
+}
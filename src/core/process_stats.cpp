@@ -0,0 +1,145 @@
+#include "../../include/core/process_stats.h"
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static double timeval_seconds(const timeval& tv) {
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+
+static double clock_seconds(clockid_t clock) {
+    timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
+        return 0.0;
+    }
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+ProcessStats::Usage ProcessStats::read_usage() {
+    Usage usage = {0.0, 0.0, 0, 0, 0};
+    rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        usage.user_seconds = timeval_seconds(ru.ru_utime);
+        usage.system_seconds = timeval_seconds(ru.ru_stime);
+        usage.voluntary_switches = static_cast<uint64_t>(ru.ru_nvcsw);
+        usage.involuntary_switches = static_cast<uint64_t>(ru.ru_nivcsw);
+    }
+    usage.rss_bytes = read_rss_bytes();
+    return usage;
+}
+
+// statm is "size resident shared text lib data dt", all in pages
+uint64_t ProcessStats::read_rss_bytes() {
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    char buffer[128];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (length <= 0) {
+        return 0;
+    }
+    buffer[length] = '\0';
+
+    char* cursor = buffer;
+    strtoull(cursor, &cursor, 10);                 // size
+    uint64_t resident_pages = strtoull(cursor, nullptr, 10);
+    return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Registered threads and the CPU time left behind by exited ones. Allocated once and never
+// freed so that detached threads exiting during shutdown can still unregister.
+struct ThreadCpuRegistry {
+    struct Entry {
+        std::string role;
+        clockid_t clock;
+        pid_t tid;
+    };
+
+    std::mutex mutex;
+    std::map<pthread_t, Entry> threads;
+    std::map<std::string, double> retired;
+
+    static ThreadCpuRegistry& instance() {
+        static ThreadCpuRegistry* registry = new ThreadCpuRegistry();
+        return *registry;
+    }
+};
+
+// Unregisters the owning thread when its thread_local storage is destroyed
+struct ThreadCpuRegistration {
+    bool registered = false;
+
+    ~ThreadCpuRegistration() {
+        if (!registered) {
+            return;
+        }
+        ThreadCpuRegistry& registry = ThreadCpuRegistry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.threads.find(pthread_self());
+        if (it != registry.threads.end()) {
+            registry.retired[it->second.role] += clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+            registry.threads.erase(it);
+        }
+    }
+};
+
+void ProcessStats::register_thread(const char* role) {
+    static thread_local ThreadCpuRegistration registration;
+
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0) {
+        return;
+    }
+    ThreadCpuRegistry& registry = ThreadCpuRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    registry.threads[pthread_self()] = ThreadCpuRegistry::Entry{role, clock, tid};
+    registration.registered = true;
+}
+
+std::vector<std::pair<std::string, double>> ProcessStats::thread_cpu_by_role() {
+    ThreadCpuRegistry& registry = ThreadCpuRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Registered threads unregister under this lock before exiting, so their clocks are valid
+    std::map<std::string, double> totals = registry.retired;
+    for (const auto& thread : registry.threads) {
+        totals[thread.second.role] += clock_seconds(thread.second.clock);
+    }
+    return std::vector<std::pair<std::string, double>>(totals.begin(), totals.end());
+}
+
+std::vector<ProcessStats::ThreadInfo> ProcessStats::registered_threads() {
+    ThreadCpuRegistry& registry = ThreadCpuRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<ThreadInfo> threads;
+    for (const auto& thread : registry.threads) {
+        threads.push_back(ThreadInfo{thread.second.tid, thread.second.clock, thread.second.role});
+    }
+    return threads;
+}
+
+CpuSampler::CpuSampler()
+    : last_cpu_seconds(clock_seconds(CLOCK_PROCESS_CPUTIME_ID)), last_wall(std::chrono::steady_clock::now()) {}
+
+double CpuSampler::sample() {
+    double cpu_seconds = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    auto now = std::chrono::steady_clock::now();
+    double wall_seconds = std::chrono::duration<double>(now - last_wall).count();
+
+    double percent = 0.0;
+    if (wall_seconds > 0.0) {
+        percent = (cpu_seconds - last_cpu_seconds) / wall_seconds * 100.0;
+    }
+    last_cpu_seconds = cpu_seconds;
+    last_wall = now;
+    return percent;
+}
@@ -0,0 +1,246 @@
+#include "../../include/core/route_stats.h"
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+const size_t RouteStats::MAX_ROUTES;
+const size_t RouteStats::NAME_LENGTH;
+const int RouteStats::SLOT_SECONDS;
+const int RouteStats::SLOT_COUNT;
+const size_t RouteStats::TABLE_SIZE;
+const char* const RouteStats::OVERFLOW_ROUTE = "(other)";
+
+// Every route the server's router dispatches on, as its template
+static const char* const ROUTER_TEMPLATES[] = {
+    "/", "/metrics", "/dashboard", "/admin-dashboard", "/ws",
+    "/api/docs", "/api/users", "/api/users/{id}", "/api/stats", "/api/log-levels",
+    "/api/profile", "/api/request-rate", "/api/metrics/history", "/api/metrics/stream",
+};
+
+static uint64_t fnv1a(const char* text, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ static_cast<unsigned char>(text[i])) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool equals(const char* text, size_t length, const char* literal) {
+    return std::strlen(literal) == length && std::memcmp(text, literal, length) == 0;
+}
+
+static size_t copy_name(char* out, const char* name) {
+    size_t length = std::strlen(name);
+    std::memcpy(out, name, length + 1);
+    return length;
+}
+
+RouteStats::RouteStats() : start_time(std::chrono::steady_clock::now()) {
+    overflow.shards.reset(new Shard[RequestRecorder::SHARD_COUNT]());
+    std::strncpy(overflow.name, OVERFLOW_ROUTE, NAME_LENGTH - 1);
+    overflow.state.store(READY, std::memory_order_release);
+    for (const char* route : ROUTER_TEMPLATES) {
+        find(route, std::strlen(route), true);
+    }
+}
+
+RouteStats& RouteStats::instance() {
+    static RouteStats* stats = new RouteStats();
+    return *stats;
+}
+
+size_t RouteStats::route_template(const char* path, size_t length, int status_code, char* out) {
+    out[0] = '\0';
+    if (const char* query = static_cast<const char*>(std::memchr(path, '?', length))) {
+        length = static_cast<size_t>(query - path);
+    }
+    if (length == 0 || path[0] != '/') {
+        return 0;
+    }
+    if (equals(path, length, "/dashboard.html")) {
+        return copy_name(out, "/dashboard");
+    }
+    if (equals(path, length, "/websocket")) {
+        return copy_name(out, "/ws");
+    }
+
+    bool api = length >= 4 && std::memcmp(path, "/api", 4) == 0;
+    size_t size = 0;
+    bool fits = true;
+    if (api) {
+        // The API router splits on '/' and ignores empty segments; rejoin what it sees
+        size_t segments = 0;
+        bool users = false;
+        size_t i = 0;
+        while (i < length) {
+            while (i < length && path[i] == '/') {
+                i++;
+            }
+            size_t start = i;
+            while (i < length && path[i] != '/') {
+                i++;
+            }
+            if (i == start) {
+                break;
+            }
+            segments++;
+            users = users || (segments == 2 && equals(path + start, i - start, "users"));
+            if (fits && size + 1 + (i - start) < NAME_LENGTH) {
+                out[size++] = '/';
+                std::memcpy(out + size, path + start, i - start);
+                size += i - start;
+            } else {
+                fits = false;
+            }
+        }
+        if (segments == 3 && users) {
+            return copy_name(out, "/api/users/{id}");
+        }
+    } else if (length < NAME_LENGTH) {
+        std::memcpy(out, path, length);
+        size = length;
+    } else {
+        fits = false;
+    }
+    if (!fits) {
+        out[0] = '\0';
+        return 0;
+    }
+    out[size] = '\0';
+
+    for (const char* known : ROUTER_TEMPLATES) {
+        if (std::strcmp(out, known) == 0) {
+            return size;
+        }
+    }
+    // Any other path is a static file, its own template once it has been served
+    if (!api && status_code >= 200 && status_code < 400) {
+        return size;
+    }
+    out[0] = '\0';
+    return 0;
+}
+
+std::string RouteStats::route_template(const std::string& path, int status_code) {
+    char name[NAME_LENGTH];
+    return std::string(name, route_template(path.data(), path.size(), status_code, name));
+}
+
+// Probes the table for 'route'. With 'add', an empty entry is claimed for it while fewer
+// than MAX_ROUTES are taken; a thread that meets an entry being claimed waits for the
+// claimer to publish it, which takes one allocation.
+RouteStats::Entry* RouteStats::find(const char* route, size_t length, bool add) {
+    if (length == 0 || length >= NAME_LENGTH) {
+        return &overflow;
+    }
+    uint64_t hash = fnv1a(route, length);
+    size_t index = static_cast<size_t>(hash) & (TABLE_SIZE - 1);
+
+    for (size_t probe = 0; probe < TABLE_SIZE; probe++, index = (index + 1) & (TABLE_SIZE - 1)) {
+        Entry& entry = table[index];
+        int state = entry.state.load(std::memory_order_acquire);
+        if (state == EMPTY) {
+            if (!add) {
+                return &overflow;
+            }
+            if (routes.fetch_add(1, std::memory_order_relaxed) >= MAX_ROUTES) {
+                routes.fetch_sub(1, std::memory_order_relaxed);
+                return &overflow;
+            }
+            if (entry.state.compare_exchange_strong(state, CLAIMED, std::memory_order_acquire)) {
+                entry.hash = hash;
+                std::memcpy(entry.name, route, length);
+                entry.shards.reset(new Shard[RequestRecorder::SHARD_COUNT]());
+                entry.state.store(READY, std::memory_order_release);
+                return &entry;
+            }
+            // Another thread claimed this entry first; it may be for the same route
+            routes.fetch_sub(1, std::memory_order_relaxed);
+        }
+        while (state == CLAIMED) {
+            std::this_thread::yield();
+            state = entry.state.load(std::memory_order_acquire);
+        }
+        if (entry.hash == hash && std::memcmp(entry.name, route, length) == 0 && entry.name[length] == '\0') {
+            return &entry;
+        }
+    }
+    return &overflow;
+}
+
+// Reuse a slot for a new period: clear it, then publish the new epoch so readers that
+// see the epoch also see the cleared counts
+static void claim_slot(std::atomic<int64_t>& epoch, int64_t current, std::atomic<uint32_t>* counts) {
+    if (epoch.load(std::memory_order_acquire) >= current) {
+        return;
+    }
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    epoch.store(current, std::memory_order_release);
+}
+
+void RouteStats::record_at(TimePoint now, const std::string& path, int status_code, double response_time_ms) {
+    char route[NAME_LENGTH];
+    size_t length = route_template(path.data(), path.size(), status_code, route);
+    // Static files are only added on success, so probing for missing ones cannot fill the table
+    Entry* entry = find(route, length, status_code >= 200 && status_code < 400);
+    Shard& shard = entry->shards[RequestRecorder::thread_shard()];
+
+    uint64_t micros = response_time_ms > 0 ? static_cast<uint64_t>(std::llround(response_time_ms * 1000.0)) : 0;
+    shard.requests.fetch_add(1, std::memory_order_relaxed);
+    if (status_code >= 500) {
+        shard.server_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.latency_sum.fetch_add(micros, std::memory_order_relaxed);
+
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
+    int64_t slot_epoch = std::max<int64_t>(0, elapsed) / SLOT_SECONDS;
+    Slot& slot = shard.slots[slot_epoch % SLOT_COUNT];
+    claim_slot(slot.epoch, slot_epoch, slot.counts);
+    slot.counts[LatencyHistogram::bucket_index(micros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+RouteStats::Summary RouteStats::summarize(const Entry& entry, int64_t current_slot) const {
+    Summary summary{entry.name, 0, 0, 0, LatencyHistogram()};
+    for (size_t i = 0; i < RequestRecorder::SHARD_COUNT; i++) {
+        const Shard& shard = entry.shards[i];
+        summary.requests += shard.requests.load(std::memory_order_relaxed);
+        summary.server_errors += shard.server_errors.load(std::memory_order_relaxed);
+        summary.latency_sum_micros += shard.latency_sum.load(std::memory_order_relaxed);
+        for (const Slot& slot : shard.slots) {
+            int64_t age = current_slot - slot.epoch.load(std::memory_order_acquire);
+            if (age < 0 || age >= SLOT_COUNT) {
+                continue;
+            }
+            for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; b++) {
+                uint32_t count = slot.counts[b].load(std::memory_order_relaxed);
+                if (count > 0) {
+                    summary.recent.add(b, count);
+                }
+            }
+        }
+    }
+    return summary;
+}
+
+std::vector<RouteStats::Summary> RouteStats::snapshot(TimePoint now) const {
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
+    int64_t current_slot = std::max<int64_t>(0, elapsed) / SLOT_SECONDS;
+
+    std::vector<Summary> summaries;
+    for (const Entry& entry : table) {
+        if (entry.state.load(std::memory_order_acquire) != READY) {
+            continue;
+        }
+        Summary summary = summarize(entry, current_slot);
+        if (summary.requests > 0) {
+            summaries.push_back(std::move(summary));
+        }
+    }
+    Summary other = summarize(overflow, current_slot);
+    if (other.requests > 0) {
+        summaries.push_back(std::move(other));
+    }
+    return summaries;
+}
@@ -1,11 +1,21 @@
 #include "../../include/core/server.h"
+#include "../../include/handlers/prometheus_writer.h"
 #include "../../include/core/shutdown_coordinator.h"
+#include "../../include/core/process_stats.h"
+#include "../../include/core/access_log.h"
+#include "../../include/core/flight_recorder.h"
+#include "../../include/core/log.h"
+#include "../../include/core/probes.h"
+#include "../../include/core/cpu_profiler.h"
+#include "../../include/core/route_stats.h"
+#include "../../include/core/otlp_exporter.h"
 #include <iostream>
 #include <cstring>
 #include <errno.h>
 #include <thread>
 #include <sstream>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <iomanip>
 #include <fstream>
@@ -53,20 +63,53 @@ public:
 // Global resource manager instance
 static ResourceManager g_resource_manager;
 
-WebServer::WebServer(int port, const std::string& doc_root, size_t thread_count) 
+// Whole-string signed integer; false if empty or anything else is in it
+static bool parse_int64(const std::string& text, int64_t& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    long long parsed = strtoll(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// "50 52 49 ..." for the first 'limit' bytes; only called from trace statements
+static std::string hex_prefix(const char* data, size_t length, size_t limit) {
+    std::string hex;
+    for (size_t i = 0; i < std::min(length, limit); i++) {
+        char byte[4];
+        snprintf(byte, sizeof(byte), "%02x ", static_cast<unsigned char>(data[i]));
+        hex += byte;
+    }
+    return hex;
+}
+
+WebServer::WebServer(int port, const std::string& doc_root, size_t thread_count)
+    : WebServer(port, doc_root, ThreadPool::Scaling::fixed(thread_count)) {}
+
+WebServer::WebServer(int port, const std::string& doc_root, const ThreadPool::Scaling& pool_scaling)
     : server_fd(-1), port(port), document_root(doc_root), 
       keep_alive_enabled(false), connection_timeout(5), total_requests(0), next_user_id(1),
       metrics_running(false), http2_enabled(false), tls_enabled(false), ssl_ctx(nullptr) {
     
     memset(&address, 0, sizeof(address));
     file_handler = std::make_unique<FileHandler>(document_root);
-    thread_pool = std::make_unique<ThreadPool>(thread_count);
+    thread_pool = std::make_unique<ThreadPool>(pool_scaling);
     
     // Initialize performance metrics and WebSocket handler
     performance_metrics = std::make_shared<PerformanceMetrics>();
     websocket_handler = std::make_unique<WebSocketHandler>();
     websocket_handler->set_metrics(performance_metrics);
     
+    // Server-sent metrics stream, fed by the WebSocket metrics broadcast
+    event_stream = std::make_shared<EventStreamHub>();
+    websocket_handler->set_event_stream(event_stream);
+    
     initialize_sample_data();
 }
 
@@ -128,12 +171,23 @@ void WebServer::start() {
 
     // Start WebSocket handler and metrics collection
     websocket_handler->start();
+    event_stream->start();
+    AccessLog::instance().start();
+    FlightRecorder::instance().set_context([this]() {
+        return "connections: " + std::to_string(get_active_connections()) +
+               "\nqueued tasks: " + std::to_string(thread_pool ? thread_pool->get_queue_size() : 0) +
+               "\nworker threads: " + std::to_string(thread_pool ? thread_pool->get_thread_count() : 0);
+    });
+    FlightRecorder::instance().start();
+    OtlpExporter::instance().set_metrics_provider([this](OtlpMetricsWriter& out) { write_otlp_metrics(out); });
+    OtlpExporter::instance().start();
     start_metrics_collection();
 
     // Start connection cleanup thread 
     std::thread cleanup_thread;
     if (keep_alive_enabled) {
         cleanup_thread = std::thread([this]() {
+            ProcessStats::register_thread("background");
             auto& coord = ShutdownCoordinator::instance();
             
             while (!coord.is_shutdown_requested()) {
@@ -150,6 +204,7 @@ void WebServer::start() {
     }
 
     // Main accept loop with proper shutdown handling
+    ProcessStats::register_thread("acceptor");
     while (!coordinator.is_shutdown_requested()) {
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
@@ -190,6 +245,9 @@ void WebServer::start() {
             std::cerr << "Accept failed: " << strerror(errno) << std::endl;
             continue;
         }
+        auto accepted = std::chrono::steady_clock::now();
+        ServerMetrics::instance().connection_accepted();
+        SERVER_PROBE1(accept, client_socket);
 
         if (coordinator.is_shutdown_requested()) {
             close(client_socket);
@@ -211,10 +269,15 @@ void WebServer::start() {
             add_connection_safe(client_socket);
         }
 
-        // Add client handling to thread pool with resource cleanup
-        thread_pool->enqueue([this, client_socket]() {
-            this->handle_client_task_safe(client_socket);
-        });
+        // Add client handling to thread pool with resource cleanup; a full lane gets a 503
+        ThreadPool::Priority priority = connection_priority(client_socket);
+        ServerMetrics::instance().record_phase(ServerMetrics::PHASE_ACCEPT, accepted, std::chrono::steady_clock::now());
+        bool queued = thread_pool->enqueue([this, client_socket, accepted, priority]() {
+            this->handle_client_task_safe(client_socket, accepted, std::chrono::steady_clock::now(), priority);
+        }, priority);
+        if (!queued) {
+            reject_overloaded(client_socket);
+        }
     }
 
     safe_cout("Server shutting down...");
@@ -226,6 +289,66 @@ void WebServer::start() {
     }
 }
 
+// Lane for a new connection, from its first request line if it has already arrived (under
+// load it nearly always has). MSG_PEEK leaves the bytes for the worker. Health, metrics
+// and admin endpoints go ahead of other work; WebSocket and event stream upgrades hold a
+// worker for long and yield. Nothing to read yet, TLS and HTTP/2 prior knowledge: NORMAL.
+ThreadPool::Priority WebServer::connection_priority(int client_socket) {
+    char line[256];
+    ssize_t bytes = recv(client_socket, line, sizeof(line) - 1, MSG_PEEK | MSG_DONTWAIT);
+    if (bytes <= 0) {
+        return ThreadPool::NORMAL;
+    }
+    line[bytes] = '\0';
+    const char* path = strchr(line, ' ');
+    if (!path) {
+        return ThreadPool::NORMAL;
+    }
+    path++;
+    size_t length = strcspn(path, " ?\r\n");
+    auto is = [path, length](const char* route) {
+        return strlen(route) == length && strncmp(path, route, length) == 0;
+    };
+    if (is(HEALTH_PATH) || is(METRICS_PATH) || is("/api/stats") || is("/api/log-levels") || is("/admin-dashboard")) {
+        return ThreadPool::HIGH;
+    }
+    if (is("/ws") || is("/websocket") || is(EVENT_STREAM_PATH)) {
+        return ThreadPool::LOW;
+    }
+    return ThreadPool::NORMAL;
+}
+
+static const char OVERLOADED_RESPONSE[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Server: wbeserver-http/1.0\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 18\r\n"
+    "Retry-After: 1\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Server overloaded\n";
+
+// Answered on the acceptor thread without blocking: a fresh socket's send buffer is empty.
+// What the client already sent is read first, since closing with unread data would reset
+// the connection before the client reads the 503.
+void WebServer::send_overloaded(int client_socket) {
+    char discard[4096];
+    for (int i = 0; i < 4 && recv(client_socket, discard, sizeof(discard), MSG_DONTWAIT) > 0; i++) {
+    }
+    ssize_t sent = send(client_socket, OVERLOADED_RESPONSE, sizeof(OVERLOADED_RESPONSE) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent > 0) {
+        ServerMetrics::instance().add_bytes_sent(static_cast<size_t>(sent));
+    }
+}
+
+void WebServer::reject_overloaded(int client_socket) {
+    send_overloaded(client_socket);
+    remove_connection_safe(client_socket);
+    g_resource_manager.unregister_socket(client_socket);
+    shutdown(client_socket, SHUT_WR);
+    close(client_socket);
+}
+
 void WebServer::handle_client_task(int client_socket) {
     std::thread::id thread_id = std::this_thread::get_id();
     bool keep_connection = false;
@@ -246,7 +369,7 @@ void WebServer::handle_client_task(int client_socket) {
             
             if (initial_bytes <= 0) {
                 if (initial_bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && !g_shutdown_requested) {
-                    std::cerr << "Initial recv failed: " << strerror(errno) << std::endl;
+                    LOG_WARN(LogModule::SERVER, "Initial recv failed: " << strerror(errno));
                 }
                 break;
             }
@@ -263,22 +386,13 @@ void WebServer::handle_client_task(int client_socket) {
             if (http2_enabled && initial_bytes >= 24 && 
                 memcmp(buffer, HTTP2_CONNECTION_PREFACE, 24) == 0) {
                 // Handle as HTTP/2 connection - pass the initial data
-                safe_cout("🔵 HTTP/2 connection detected - preface matched");
+                LOG_DEBUG(LogModule::HTTP2, "Connection preface matched on socket " << client_socket);
                 handle_http2_connection(client_socket, buffer, initial_bytes);
-                safe_cout("🔵 HTTP/2 handler returned - connection closed");
                 break;
             } else if (http2_enabled) {
-                // Debug: show what we received instead
-                std::string debug_msg = "🔴 Not HTTP/2 preface. Received " + std::to_string(initial_bytes) + " bytes: ";
-                for (int i = 0; i < std::min(initial_bytes, 24L); i++) {
-                    char hex[4];
-                    snprintf(hex, sizeof(hex), "%02x ", (unsigned char)buffer[i]);
-                    debug_msg += hex;
-                }
-                safe_cout(debug_msg);
-                
-                // Compare with expected preface
-                safe_cout("🔴 Expected preface: 50 52 49 20 2a 20 48 54 54 50 2f 32 2e 30 0d 0a 0d 0a 53 4d 0d 0a 0d 0a");
+                // The hex dump is only built when tracing is compiled in and enabled
+                LOG_TRACE(LogModule::SERVER, "Not an HTTP/2 preface, first bytes: "
+                                                 << hex_prefix(buffer, static_cast<size_t>(initial_bytes), 24));
             }
             
             // Handle as HTTP/1.1 - continue reading headers if needed
@@ -299,7 +413,7 @@ void WebServer::handle_client_task(int client_socket) {
                     break;
                 } else {
                     if (errno != EAGAIN && errno != EWOULDBLOCK && !g_shutdown_requested) {
-                        std::cerr << "Recv failed: " << strerror(errno) << std::endl;
+                        LOG_WARN(LogModule::SERVER, "Recv failed: " << strerror(errno));
                     }
                     break;
                 }
@@ -316,9 +430,9 @@ void WebServer::handle_client_task(int client_socket) {
                     send_response(client_socket, response);
                     
                     auto end_time = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-                    log_request("INVALID", "INVALID", 400, duration);
-                    record_request_metric("INVALID", "INVALID", 400, duration.count());
+                    double elapsed_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+                    log_request(request, 400, response.size(), elapsed_ms, "");
+                    record_request_metric("INVALID", "INVALID", 400, elapsed_ms);
                 }
                 break;
             }
@@ -328,7 +442,7 @@ void WebServer::handle_client_task(int client_socket) {
                 websocket_handler->is_websocket_request(request.headers) &&
                 !g_shutdown_requested) {
                 
-                safe_cout("WebSocket upgrade request detected for path: " + request.path);
+                LOG_DEBUG(LogModule::WEBSOCKET, "Upgrade request for path: " << request.path);
                 
                 if (handle_websocket_upgrade(client_socket, request)) {
                     // WebSocket connection established - don't close socket here
@@ -354,7 +468,7 @@ void WebServer::handle_client_task(int client_socket) {
             }
 
             auto end_time = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+            double elapsed_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
             
             int status_code = 200;
             if (response.find("404") != std::string::npos) status_code = 404;
@@ -362,8 +476,8 @@ void WebServer::handle_client_task(int client_socket) {
             else if (response.find("405") != std::string::npos) status_code = 405;
             
             if (!g_shutdown_requested) {
-                log_request(request.method, request.path, status_code, duration);
-                record_request_metric(request.method, request.path, status_code, duration.count());
+                log_request(request, status_code, response.size(), elapsed_ms, "");
+                record_request_metric(request.method, request.path, status_code, elapsed_ms);
                 total_requests++;
             }
 
@@ -371,9 +485,7 @@ void WebServer::handle_client_task(int client_socket) {
         
     } catch (const std::exception& e) {
         if (!g_shutdown_requested) {
-            std::ostringstream oss;
-            oss << "[Thread " << thread_id << "] Exception: " << e.what();
-            safe_cout(oss.str());
+            LOG_WARN(LogModule::SERVER, "[Thread " << thread_id << "] Exception: " << e.what());
         }
     }
     
@@ -384,7 +496,8 @@ void WebServer::handle_client_task(int client_socket) {
     close(client_socket);
 }
 
-void WebServer::handle_client_task_safe(int client_socket) {
+void WebServer::handle_client_task_safe(int client_socket, std::chrono::steady_clock::time_point accepted,
+                                        std::chrono::steady_clock::time_point dequeued, ThreadPool::Priority lane) {
     // RAII wrapper for socket cleanup
     struct SocketGuard {
         int socket;
@@ -400,6 +513,7 @@ void WebServer::handle_client_task_safe(int client_socket) {
             }
         }
     } guard(client_socket, this);
+    ServerMetrics::ConnectionScope connection_state(ServerMetrics::CONN_HTTP1);
     
     auto& coordinator = ShutdownCoordinator::instance();
     
@@ -417,7 +531,7 @@ void WebServer::handle_client_task_safe(int client_socket) {
             if (peek_result > 0) {
                 // TLS handshake starts with 0x16 (SSL3_RT_HANDSHAKE)
                 if ((unsigned char)peek_buffer[0] == 0x16) {
-                    safe_cout("Detected TLS connection, handling with SSL");
+                    LOG_DEBUG(LogModule::TLS, "Detected TLS connection on socket " << client_socket);
                     handle_tls_connection(client_socket);
                     return;
                 }
@@ -425,19 +539,25 @@ void WebServer::handle_client_task_safe(int client_socket) {
         }
         
         // Handle as regular HTTP connection; if upgraded to WebSocket, release ownership
-        bool upgraded = handle_http_connection(client_socket);
+        bool upgraded = handle_http_connection(client_socket, accepted, dequeued, lane != ThreadPool::NORMAL);
         if (upgraded) {
             guard.release();
         }
         
     } catch (const std::exception& e) {
-        safe_cout("Client handling error: " + std::string(e.what()));
+        LOG_WARN(LogModule::SERVER, "Client handling error: " << e.what());
     }
 }
 
-bool WebServer::handle_http_connection(int client_socket) {
+bool WebServer::handle_http_connection(int client_socket, std::chrono::steady_clock::time_point accepted,
+                                       std::chrono::steady_clock::time_point dequeued, bool single_request) {
     auto& coordinator = ShutdownCoordinator::instance();
+    ServerMetrics& metrics = ServerMetrics::instance();
+    FlightRecorder& recorder = FlightRecorder::instance();
     bool keep_connection = false;
+    bool first_request = true;
+    std::string peer = AccessLog::instance().is_enabled() ? AccessLog::peer_address(client_socket) : "";
+    uint64_t connection_id = FlightRecorder::next_connection_id();
     
     try {
         do {
@@ -449,13 +569,33 @@ bool WebServer::handle_http_connection(int client_socket) {
             
             // Read and parse HTTP request with timeout
             std::string headers_data;
-            if (!read_request_with_timeout(client_socket, headers_data, std::chrono::seconds(5))) {
+            std::chrono::steady_clock::time_point first_byte;
+            if (!read_request_with_timeout(client_socket, headers_data, std::chrono::seconds(5), &first_byte)) {
                 break; // Timeout or error
             }
+            FlightRecorder::Record flight = {};
+            flight.connection_id = connection_id;
+            flight.protocol = FlightRecorder::HTTP1;
+            flight.first_byte_ns = FlightRecorder::nanos(first_byte);
+            flight.bytes_received = headers_data.size();
+            // Later requests on a kept-alive connection would time the client's idle gap
+            if (first_request) {
+                metrics.record_phase(ServerMetrics::PHASE_FIRST_BYTE, dequeued, first_byte);
+                flight.accepted_ns = FlightRecorder::nanos(accepted);
+                flight.dequeued_ns = FlightRecorder::nanos(dequeued);
+                first_request = false;
+            }
             
             if (coordinator.is_shutdown_requested()) {
                 break;
             }
+            
+            // HTTP/2 with prior knowledge (h2c): the connection preface replaces the request
+            if (http2_enabled && headers_data.compare(0, 24, HTTP2_CONNECTION_PREFACE) == 0) {
+                remove_connection_safe(client_socket);
+                handle_http2_connection(client_socket, headers_data.data(), headers_data.size());
+                break;
+            }
 
             HttpRequest request;
             if (!request.parse(headers_data)) {
@@ -465,6 +605,9 @@ bool WebServer::handle_http_connection(int client_socket) {
                 }
                 break;
             }
+            auto parsed = std::chrono::steady_clock::now();
+            metrics.record_phase(ServerMetrics::PHASE_READ, first_byte, parsed);
+            SERVER_PROBE4(request__parsed, client_socket, 0, request.method.c_str(), request.path.c_str());
 
             // Check for WebSocket upgrade
             if (is_websocket_path(request.path) && 
@@ -480,29 +623,65 @@ bool WebServer::handle_http_connection(int client_socket) {
                     break; // Failed upgrade, continue to close
                 }
             }
+            
+            // Server-sent events: the event stream writer thread takes over the socket
+            if (request.method == "GET" && request.path == EVENT_STREAM_PATH &&
+                !coordinator.is_shutdown_requested()) {
+                remove_connection_safe(client_socket);
+                
+                if (event_stream->attach_socket(client_socket, request.get_header("last-event-id"))) {
+                    g_resource_manager.unregister_socket(client_socket);
+                    auto end_time = std::chrono::high_resolution_clock::now();
+                    double elapsed_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+                    log_request(request, 200, 0, elapsed_ms, peer.c_str());
+                    record_request_metric(request.method, request.path, 200, elapsed_ms);
+                    total_requests++;
+                    return true;
+                }
+                break;
+            }
 
             if (coordinator.is_shutdown_requested()) {
                 break;
             }
 
+            // The lane was chosen for this request only; keeping the connection would let
+            // later requests skip the normal lane's limit, so the response says close
+            if (single_request) {
+                request.headers["connection"] = "close";
+            }
+            
             // Handle regular HTTP request
+            SERVER_PROBE4(handler__start, client_socket, 0, request.method.c_str(), request.path.c_str());
             std::string response = handle_request(request, keep_connection);
-            if (!coordinator.is_shutdown_requested()) {
-                send_response_safe(client_socket, response);
+            auto handled = std::chrono::steady_clock::now();
+            int status_code = extract_status_code(response);
+            SERVER_PROBE3(handler__end, client_socket, 0, status_code);
+            metrics.record_phase(ServerMetrics::PHASE_HANDLER, parsed, handled);
+            if (!coordinator.is_shutdown_requested() && send_response_safe(client_socket, response)) {
+                auto written = std::chrono::steady_clock::now();
+                metrics.record_phase(ServerMetrics::PHASE_WRITE, handled, written);
+                SERVER_PROBE4(response__sent, client_socket, 0, status_code, response.size());
+                flight.finished_ns = FlightRecorder::nanos(written);
             }
+            flight.parsed_ns = FlightRecorder::nanos(parsed);
+            flight.handled_ns = FlightRecorder::nanos(handled);
+            flight.status = static_cast<uint16_t>(status_code);
+            flight.bytes_sent = response.size();
+            flight.set_request(request.method, request.path);
+            recorder.record(flight);
+            OtlpExporter::instance().record(flight, request.get_header("traceparent"));
             
             if (keep_connection && keep_alive_enabled && !coordinator.is_shutdown_requested()) {
                 update_connection_timestamp_safe(client_socket);
             }
 
             auto end_time = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-            
-            int status_code = extract_status_code(response);
+            double elapsed_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
             
             if (!coordinator.is_shutdown_requested()) {
-                log_request(request.method, request.path, status_code, duration);
-                record_request_metric(request.method, request.path, status_code, duration.count());
+                log_request(request, status_code, response.size(), elapsed_ms, peer.c_str());
+                record_request_metric(request.method, request.path, status_code, elapsed_ms);
                 total_requests++;
             }
 
@@ -510,7 +689,7 @@ bool WebServer::handle_http_connection(int client_socket) {
         
     } catch (const std::exception& e) {
         if (!coordinator.is_shutdown_requested()) {
-            std::cerr << "Client handler exception: " << e.what() << std::endl;
+            LOG_ERROR(LogModule::SERVER, "Client handler exception: " << e.what());
         }
     }
     return false; // Not upgraded
@@ -526,7 +705,8 @@ int WebServer::extract_status_code(const std::string& response) const {
     return 200; // Default
 }
 
-bool WebServer::read_request_with_timeout(int socket, std::string& headers_data, std::chrono::seconds timeout) {
+bool WebServer::read_request_with_timeout(int socket, std::string& headers_data, std::chrono::seconds timeout,
+                                          std::chrono::steady_clock::time_point* first_byte) {
     auto deadline = std::chrono::steady_clock::now() + timeout;
     char buffer[4096];
     
@@ -551,6 +731,9 @@ bool WebServer::read_request_with_timeout(int socket, std::string& headers_data,
         int select_result = select(socket + 1, &read_fds, nullptr, nullptr, &tv);
         
         if (select_result < 0) {
+            if (errno == EINTR) {
+                continue; // e.g. a profiler signal
+            }
             return false; // Error
         }
         
@@ -561,6 +744,10 @@ bool WebServer::read_request_with_timeout(int socket, std::string& headers_data,
         ssize_t bytes_received = recv(socket, buffer, sizeof(buffer) - 1, 0);
         
         if (bytes_received > 0) {
+            if (first_byte && headers_data.empty()) {
+                *first_byte = std::chrono::steady_clock::now();
+            }
+            ServerMetrics::instance().add_bytes_received(static_cast<size_t>(bytes_received));
             // Bounds checking for received data
             if (bytes_received >= static_cast<ssize_t>(sizeof(buffer))) {
                 bytes_received = sizeof(buffer) - 1;
@@ -574,7 +761,7 @@ bool WebServer::read_request_with_timeout(int socket, std::string& headers_data,
         } else if (bytes_received == 0) {
             return false; // Connection closed
         } else {
-            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
                 return false; // Error
             }
         }
@@ -600,6 +787,9 @@ bool WebServer::send_response_safe(int socket, const std::string& response) {
                                 response_len - total_sent, MSG_NOSIGNAL);
         
         if (bytes_sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EPIPE || errno == ECONNRESET) {
                 return false; // Client disconnected
             }
@@ -608,6 +798,7 @@ bool WebServer::send_response_safe(int socket, const std::string& response) {
         
         total_sent += bytes_sent;
     }
+    ServerMetrics::instance().add_bytes_sent(total_sent);
     
     return true;
 }
@@ -671,6 +862,15 @@ std::string WebServer::handle_request(const HttpRequest& request, bool& keep_ali
 }
 
 std::string WebServer::handle_get_request(const HttpRequest& request, bool& keep_alive) {
+    // Prometheus scrape endpoint
+    if (request.path == METRICS_PATH) {
+        return handle_metrics_request(request);
+    }
+    
+    if (request.path == HEALTH_PATH) {
+        return build_http_response(200, "OK", "application/json", "{\"status\":\"ok\"}", keep_alive, true);
+    }
+    
     // Check for admin dashboard request
     if (request.path == "/admin-dashboard") {
         return handle_admin_dashboard_request(request);
@@ -742,6 +942,14 @@ std::string WebServer::handle_api_request(const HttpRequest& request, bool& keep
         }
     } else if (endpoint == "stats") {
         return handle_server_stats_api(request);
+    } else if (endpoint == "log-levels") {
+        return handle_log_levels_api(request);
+    } else if (endpoint == "profile") {
+        return handle_profile_api(request);
+    } else if (endpoint == "request-rate") {
+        return handle_request_rate_api(request);
+    } else if (endpoint == "metrics" && path_parts.size() == 3 && path_parts[2] == "history") {
+        return handle_metrics_history_api(request);
     }
     
     return build_http_response(404, "Not Found", "application/json", 
@@ -784,6 +992,22 @@ std::string WebServer::handle_users_api(const HttpRequest& request) {
         // Create new user
         std::map<std::string, std::string> new_user = create_user(name, email);
         
+        // Notify WebSocket clients subscribed to the "users" topic
+        if (websocket_handler) {
+            auto user = std::make_shared<JsonValue>();
+            user->make_object();
+            user->set_object_item("id", std::make_shared<JsonValue>(std::stoi(new_user["id"])));
+            user->set_object_item("name", std::make_shared<JsonValue>(new_user["name"]));
+            user->set_object_item("email", std::make_shared<JsonValue>(new_user["email"]));
+            
+            auto event = std::make_shared<JsonValue>();
+            event->make_object();
+            event->set_object_item("type", std::make_shared<JsonValue>("user_created"));
+            event->set_object_item("topic", std::make_shared<JsonValue>("users"));
+            event->set_object_item("data", user);
+            websocket_handler->publish("users", event->to_string());
+        }
+        
         std::string json_response = JsonHandler::build_success_response("User created successfully", 
                                   JsonHandler::parse("{\"id\":" + new_user["id"] + 
                                                    ",\"name\":\"" + new_user["name"] + 
@@ -820,6 +1044,194 @@ std::string WebServer::handle_user_api(const HttpRequest& request, const std::st
                              false, true);
 }
 
+// GET lists the runtime level of every module; POST applies ?module=level pairs
+// (and/or ?all=level) and returns the resulting levels
+std::string WebServer::handle_log_levels_api(const HttpRequest& request) {
+    if (request.method == "POST") {
+        std::string all = request.get_query_param("all");
+        std::string spec;
+        for (const auto& param : request.query_params) {
+            if (param.first != "all") {
+                spec += (spec.empty() ? "" : ",") + param.first + "=" + param.second;
+            }
+        }
+        // Log::configure() changes nothing on a bad spec, so validate before touching 'all'
+        LogLevel all_level = LogLevel::INFO;
+        bool valid = (!all.empty() || !spec.empty()) && (all.empty() || Log::parse_level(all, all_level)) &&
+                     (spec.empty() || Log::configure(spec));
+        if (!valid) {
+            return build_http_response(400, "Bad Request", "application/json",
+                                     JsonHandler::build_error_response("Expected module=level query parameters", 400),
+                                     false, true);
+        }
+        // ?all=warn&http2=trace: the named modules override 'all'
+        if (!all.empty()) {
+            Log::set_all(all_level);
+            if (!spec.empty()) {
+                Log::configure(spec);
+            }
+        }
+    } else if (request.method != "GET") {
+        return build_http_response(405, "Method Not Allowed", "application/json",
+                                 JsonHandler::build_error_response("Method not allowed", 405),
+                                 false, true);
+    }
+
+    auto levels = std::make_shared<JsonValue>();
+    levels->make_object();
+    for (size_t i = 0; i < Log::MODULE_COUNT; i++) {
+        LogModule module = static_cast<LogModule>(i);
+        levels->set_object_item(Log::module_name(module), std::make_shared<JsonValue>(Log::level_name(Log::level(module))));
+    }
+    auto body = std::make_shared<JsonValue>();
+    body->make_object();
+    body->set_object_item("levels", levels);
+    body->set_object_item("compiled_min_level",
+                          std::make_shared<JsonValue>(Log::level_name(static_cast<LogLevel>(LOG_MIN_LEVEL))));
+    return build_http_response(200, "OK", "application/json", body->to_string(), true, true);
+}
+
+// Samples every server thread for ?seconds=N (default 10) at ?hz=N (default 99) and returns
+// a flame graph, or folded stacks with ?format=folded. Blocks this worker meanwhile.
+std::string WebServer::handle_profile_api(const HttpRequest& request) {
+    if (!profiler_enabled.load()) {
+        return build_http_response(403, "Forbidden", "application/json",
+                                 JsonHandler::build_error_response("Profiler disabled; start the server with --profiler", 403),
+                                 false, true);
+    }
+    if (request.method != "GET") {
+        return build_http_response(405, "Method Not Allowed", "application/json",
+                                 JsonHandler::build_error_response("Method not allowed", 405),
+                                 false, true);
+    }
+
+    std::string seconds_param = request.get_query_param("seconds");
+    std::string hz_param = request.get_query_param("hz");
+    std::string format = request.get_query_param("format");
+    int seconds = seconds_param.empty() ? 10 : atoi(seconds_param.c_str());
+    int hz = hz_param.empty() ? CpuProfiler::DEFAULT_HZ : atoi(hz_param.c_str());
+    if (seconds < 1 || seconds > CpuProfiler::MAX_SECONDS || hz < 1 || hz > CpuProfiler::MAX_HZ ||
+        (!format.empty() && format != "svg" && format != "folded")) {
+        return build_http_response(400, "Bad Request", "application/json",
+                                 JsonHandler::build_error_response("Expected seconds=1..60, hz=1..1000, format=svg|folded", 400),
+                                 false, true);
+    }
+
+    CpuProfiler::Profile profile;
+    CpuProfiler::Result result = CpuProfiler::instance().profile(seconds, hz, profile);
+    if (result == CpuProfiler::BUSY) {
+        return build_http_response(409, "Conflict", "application/json",
+                                 JsonHandler::build_error_response("A profile is already running", 409),
+                                 false, true);
+    }
+    if (result != CpuProfiler::OK) {
+        return build_http_response(500, "Internal Server Error", "application/json",
+                                 JsonHandler::build_error_response("Could not start the profiler", 500),
+                                 false, true);
+    }
+
+    if (format == "folded") {
+        return build_http_response(200, "OK", "text/plain; charset=utf-8", CpuProfiler::folded(profile), false, false);
+    }
+    std::string title = "CPU " + std::to_string(profile.seconds) + " s at " + std::to_string(profile.hz) + " Hz, " +
+                        std::to_string(profile.threads) + " threads";
+    if (profile.dropped > 0) {
+        title += ", " + std::to_string(profile.dropped) + " samples dropped";
+    }
+    return build_http_response(200, "OK", "image/svg+xml", CpuProfiler::flamegraph_svg(profile, title), false, false);
+}
+
+std::string WebServer::handle_request_rate_api(const HttpRequest& request) {
+    if (request.method != "GET") {
+        return build_http_response(405, "Method Not Allowed", "application/json",
+                                 JsonHandler::build_error_response("Method not allowed", 405),
+                                 false, true);
+    }
+
+    std::string resolution_param = request.get_query_param("resolution");
+    RequestRecorder::Resolution resolution;
+    if (resolution_param.empty() || resolution_param == "second") {
+        resolution = RequestRecorder::SECOND;
+    } else if (resolution_param == "minute") {
+        resolution = RequestRecorder::MINUTE;
+    } else if (resolution_param == "hour") {
+        resolution = RequestRecorder::HOUR;
+    } else {
+        return build_http_response(400, "Bad Request", "application/json",
+                                 JsonHandler::build_error_response("Expected resolution=second|minute|hour", 400),
+                                 false, true);
+    }
+
+    int length = performance_metrics->get_request_rate_series_length(resolution);
+    std::string periods_param = request.get_query_param("periods");
+    int periods = periods_param.empty() ? length : atoi(periods_param.c_str());
+    if (periods < 1 || periods > length) {
+        return build_http_response(400, "Bad Request", "application/json",
+                                 JsonHandler::build_error_response("Expected periods=1.." + std::to_string(length), 400),
+                                 false, true);
+    }
+    return build_http_response(200, "OK", "application/json",
+                             performance_metrics->get_request_rate_series_json(resolution, periods), true, true);
+}
+
+std::string WebServer::handle_metrics_history_api(const HttpRequest& request) {
+    if (request.method != "GET") {
+        return build_http_response(405, "Method Not Allowed", "application/json",
+                                 JsonHandler::build_error_response("Method not allowed", 405),
+                                 false, true);
+    }
+
+    // from/to are Unix seconds; zero or negative values count back from now
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t from = -300;
+    int64_t to = 0;
+    int64_t step = 0;
+    std::string from_param = request.get_query_param("from");
+    std::string to_param = request.get_query_param("to");
+    std::string step_param = request.get_query_param("step");
+    std::string aggregation_param = request.get_query_param("agg");
+    MetricsHistory::Aggregation aggregation = MetricsHistory::AVG;
+    bool valid = (from_param.empty() || parse_int64(from_param, from)) &&
+                 (to_param.empty() || parse_int64(to_param, to)) &&
+                 (step_param.empty() || (parse_int64(step_param, step) && step > 0 &&
+                                         step <= MetricsHistory::RETENTION_MS / 1000)) &&
+                 (aggregation_param.empty() || MetricsHistory::parse_aggregation(aggregation_param, aggregation));
+    if (from <= 0) from += now;
+    if (to <= 0) to += now;
+    // Checked before any arithmetic on the range: 0 <= from < to <= now + 1 day cannot overflow
+    valid = valid && from >= 0 && to <= now + 86400 && to > from;
+    if (valid && step == 0) {
+        // Default: the finest step that keeps each series under 1000 points
+        step = std::max<int64_t>(1, (to - from + 999) / 1000);
+    }
+    if (!valid || (to - from - 1) / step >= static_cast<int64_t>(MetricsHistory::MAX_POINTS)) {
+        return build_http_response(400, "Bad Request", "application/json",
+                                 JsonHandler::build_error_response(
+                                     "Expected from < to (Unix seconds, or <= 0 for relative to now), step of 1 to 86400 "
+                                     "seconds with at most 10000 steps, agg=avg|min|max|last", 400),
+                                 false, true);
+    }
+
+    std::vector<std::string> series;
+    std::string series_param = request.get_query_param("series");
+    std::istringstream names(series_param);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        const std::vector<std::string>& known = performance_metrics->get_history().names();
+        if (std::find(known.begin(), known.end(), name) == known.end()) {
+            return build_http_response(400, "Bad Request", "application/json",
+                                     JsonHandler::build_error_response("Unknown series: " + name, 400),
+                                     false, true);
+        }
+        series.push_back(name);
+    }
+
+    std::string json = performance_metrics->get_metrics_history_json(from * 1000, to * 1000, step * 1000,
+                                                                     aggregation, series);
+    return build_http_response(200, "OK", "application/json", json, true, true);
+}
+
 std::string WebServer::handle_server_stats_api(const HttpRequest& request) {
     if (request.method == "GET") {
         auto stats = std::make_shared<JsonValue>();
@@ -829,6 +1241,161 @@ std::string WebServer::handle_server_stats_api(const HttpRequest& request) {
         stats->set_object_item("thread_count", std::make_shared<JsonValue>(static_cast<int>(thread_pool->get_thread_count())));
         stats->set_object_item("queue_size", std::make_shared<JsonValue>(static_cast<int>(thread_pool->get_queue_size())));
         
+        // Elastic pool bounds and what its controller has done
+        ThreadPool::ScalingStats scaling = thread_pool->get_scaling_stats();
+        auto pool = std::make_shared<JsonValue>();
+        pool->make_object();
+        pool->set_object_item("min_threads", std::make_shared<JsonValue>(static_cast<int>(scaling.min_threads)));
+        pool->set_object_item("max_threads", std::make_shared<JsonValue>(static_cast<int>(scaling.max_threads)));
+        pool->set_object_item("started", std::make_shared<JsonValue>(static_cast<double>(scaling.started)));
+        pool->set_object_item("retired", std::make_shared<JsonValue>(static_cast<double>(scaling.retired)));
+        pool->set_object_item("saturated", std::make_shared<JsonValue>(static_cast<double>(scaling.saturated)));
+        pool->set_object_item("last_wait_ms", std::make_shared<JsonValue>(scaling.last_wait_ms));
+        auto lanes = std::make_shared<JsonValue>();
+        lanes->make_object();
+        for (int p = 0; p < ThreadPool::PRIORITY_COUNT; p++) {
+            auto priority = static_cast<ThreadPool::Priority>(p);
+            ThreadPool::LaneStats lane_stats = thread_pool->get_lane_stats(priority);
+            auto lane = std::make_shared<JsonValue>();
+            lane->make_object();
+            lane->set_object_item("queued", std::make_shared<JsonValue>(static_cast<int>(lane_stats.queued)));
+            lane->set_object_item("limit", std::make_shared<JsonValue>(static_cast<int>(lane_stats.limit)));
+            lane->set_object_item("rejected", std::make_shared<JsonValue>(static_cast<double>(lane_stats.rejected)));
+            lanes->set_object_item(ThreadPool::priority_name(priority), lane);
+        }
+        pool->set_object_item("lanes", lanes);
+        stats->set_object_item("thread_pool", pool);
+        
+        if (websocket_handler) {
+            // Outbound queue depth and slow-consumer actions across all WebSocket clients
+            WebSocketHandler::BackpressureStats ws_stats = websocket_handler->get_backpressure_stats();
+            auto ws = std::make_shared<JsonValue>();
+            ws->make_object();
+            ws->set_object_item("connections", std::make_shared<JsonValue>(static_cast<int>(websocket_handler->get_connection_count())));
+            ws->set_object_item("queued_bytes", std::make_shared<JsonValue>(static_cast<double>(ws_stats.queued_bytes)));
+            ws->set_object_item("queued_frames", std::make_shared<JsonValue>(static_cast<double>(ws_stats.queued_frames)));
+            ws->set_object_item("peak_queue_bytes", std::make_shared<JsonValue>(static_cast<double>(ws_stats.peak_queue_bytes)));
+            ws->set_object_item("frames_dropped", std::make_shared<JsonValue>(static_cast<double>(ws_stats.frames_dropped)));
+            ws->set_object_item("frames_coalesced", std::make_shared<JsonValue>(static_cast<double>(ws_stats.frames_coalesced)));
+            ws->set_object_item("slow_disconnects", std::make_shared<JsonValue>(static_cast<double>(ws_stats.slow_disconnects)));
+            ws->set_object_item("slow_consumer_policy", std::make_shared<JsonValue>(
+                WebSocketHandler::slow_consumer_policy_name(websocket_handler->get_slow_consumer_policy())));
+            stats->set_object_item("websocket", ws);
+        }
+        if (performance_metrics) {
+            // Response time percentiles (ms) merged from the per-thread histograms
+            auto latency = std::make_shared<JsonValue>();
+            latency->make_object();
+            const int windows[] = {10, 60, 0};
+            for (int window : windows) {
+                LatencyHistogram histogram = performance_metrics->get_latency_histogram(window);
+                auto summary = std::make_shared<JsonValue>();
+                summary->make_object();
+                summary->set_object_item("count", std::make_shared<JsonValue>(static_cast<double>(histogram.count())));
+                summary->set_object_item("p50", std::make_shared<JsonValue>(histogram.percentile(0.50) / 1000.0));
+                summary->set_object_item("p90", std::make_shared<JsonValue>(histogram.percentile(0.90) / 1000.0));
+                summary->set_object_item("p99", std::make_shared<JsonValue>(histogram.percentile(0.99) / 1000.0));
+                summary->set_object_item("p999", std::make_shared<JsonValue>(histogram.percentile(0.999) / 1000.0));
+                summary->set_object_item("max", std::make_shared<JsonValue>(histogram.max() / 1000.0));
+                latency->set_object_item(window > 0 ? std::to_string(window) + "s" : "since_start", summary);
+            }
+            stats->set_object_item("latency_ms", latency);
+        }
+        {
+            // Where HTTP/1.1 request time goes, per phase since start (nanoseconds)
+            auto phases = std::make_shared<JsonValue>();
+            phases->make_object();
+            for (int phase = 0; phase < ServerMetrics::PHASE_COUNT; phase++) {
+                auto request_phase = static_cast<ServerMetrics::Phase>(phase);
+                LatencyHistogram histogram = ServerMetrics::instance().phase_histogram(request_phase);
+                auto summary = std::make_shared<JsonValue>();
+                summary->make_object();
+                summary->set_object_item("count", std::make_shared<JsonValue>(static_cast<double>(histogram.count())));
+                summary->set_object_item("p50", std::make_shared<JsonValue>(static_cast<double>(histogram.percentile(0.50))));
+                summary->set_object_item("p99", std::make_shared<JsonValue>(static_cast<double>(histogram.percentile(0.99))));
+                summary->set_object_item("max", std::make_shared<JsonValue>(static_cast<double>(histogram.max())));
+                phases->set_object_item(ServerMetrics::phase_name(request_phase), summary);
+            }
+            stats->set_object_item("phase_ns", phases);
+        }
+        {
+            // Per route template, slowest recent p99 first (ms); the overflow entry counts
+            // every request that has no template of its own
+            std::vector<RouteStats::Summary> summaries = RouteStats::instance().snapshot(std::chrono::steady_clock::now());
+            std::stable_sort(summaries.begin(), summaries.end(), [](const RouteStats::Summary& a, const RouteStats::Summary& b) {
+                return a.recent.percentile(0.99) > b.recent.percentile(0.99);
+            });
+            auto routes = std::make_shared<JsonValue>();
+            routes->make_array();
+            for (const RouteStats::Summary& summary : summaries) {
+                auto route = std::make_shared<JsonValue>();
+                route->make_object();
+                route->set_object_item("route", std::make_shared<JsonValue>(summary.route));
+                route->set_object_item("requests", std::make_shared<JsonValue>(static_cast<double>(summary.requests)));
+                route->set_object_item("server_errors", std::make_shared<JsonValue>(static_cast<double>(summary.server_errors)));
+                route->set_object_item("mean_ms", std::make_shared<JsonValue>(
+                    static_cast<double>(summary.latency_sum_micros) / static_cast<double>(summary.requests) / 1000.0));
+                route->set_object_item("recent_count", std::make_shared<JsonValue>(static_cast<double>(summary.recent.count())));
+                route->set_object_item("p50", std::make_shared<JsonValue>(summary.recent.percentile(0.50) / 1000.0));
+                route->set_object_item("p99", std::make_shared<JsonValue>(summary.recent.percentile(0.99) / 1000.0));
+                route->set_object_item("max", std::make_shared<JsonValue>(summary.recent.max() / 1000.0));
+                routes->add_to_array(route);
+            }
+            stats->set_object_item("routes", routes);
+        }
+        {
+            // Kernel-reported resource usage; cpu_seconds by thread role includes exited threads
+            ProcessStats::Usage usage = ProcessStats::read_usage();
+            auto process = std::make_shared<JsonValue>();
+            process->make_object();
+            process->set_object_item("user_cpu_seconds", std::make_shared<JsonValue>(usage.user_seconds));
+            process->set_object_item("system_cpu_seconds", std::make_shared<JsonValue>(usage.system_seconds));
+            process->set_object_item("rss_bytes", std::make_shared<JsonValue>(static_cast<double>(usage.rss_bytes)));
+            process->set_object_item("voluntary_context_switches", std::make_shared<JsonValue>(static_cast<double>(usage.voluntary_switches)));
+            process->set_object_item("involuntary_context_switches", std::make_shared<JsonValue>(static_cast<double>(usage.involuntary_switches)));
+            auto threads = std::make_shared<JsonValue>();
+            threads->make_object();
+            for (const auto& role : ProcessStats::thread_cpu_by_role()) {
+                threads->set_object_item(role.first, std::make_shared<JsonValue>(role.second));
+            }
+            process->set_object_item("thread_cpu_seconds", threads);
+            stats->set_object_item("process", process);
+        }
+        {
+            AccessLog::Stats log_stats = AccessLog::instance().get_stats();
+            auto access_log = std::make_shared<JsonValue>();
+            access_log->make_object();
+            access_log->set_object_item("written", std::make_shared<JsonValue>(static_cast<double>(log_stats.written)));
+            access_log->set_object_item("dropped", std::make_shared<JsonValue>(static_cast<double>(log_stats.dropped)));
+            access_log->set_object_item("sampled_out", std::make_shared<JsonValue>(static_cast<double>(log_stats.sampled_out)));
+            stats->set_object_item("access_log", access_log);
+
+            FlightRecorder::Stats flight_stats = FlightRecorder::instance().get_stats();
+            auto flight_recorder = std::make_shared<JsonValue>();
+            flight_recorder->make_object();
+            flight_recorder->set_object_item("recorded", std::make_shared<JsonValue>(static_cast<double>(flight_stats.recorded)));
+            flight_recorder->set_object_item("slow", std::make_shared<JsonValue>(static_cast<double>(flight_stats.slow)));
+            flight_recorder->set_object_item("dumps", std::make_shared<JsonValue>(static_cast<double>(flight_stats.dumps)));
+            stats->set_object_item("flight_recorder", flight_recorder);
+
+            OtlpExporter::Stats otlp_stats = OtlpExporter::instance().get_stats();
+            auto otlp = std::make_shared<JsonValue>();
+            otlp->make_object();
+            otlp->set_object_item("enabled", std::make_shared<JsonValue>(OtlpExporter::instance().is_enabled()));
+            if (OtlpExporter::instance().is_enabled()) {
+                otlp->set_object_item("endpoint", std::make_shared<JsonValue>(OtlpExporter::instance().get_endpoint()));
+            }
+            otlp->set_object_item("spans_exported", std::make_shared<JsonValue>(static_cast<double>(otlp_stats.spans_exported)));
+            otlp->set_object_item("spans_dropped", std::make_shared<JsonValue>(static_cast<double>(otlp_stats.spans_dropped)));
+            otlp->set_object_item("sampled_out", std::make_shared<JsonValue>(static_cast<double>(otlp_stats.sampled_out)));
+            otlp->set_object_item("export_failures", std::make_shared<JsonValue>(static_cast<double>(otlp_stats.export_failures)));
+            otlp->set_object_item("metric_exports", std::make_shared<JsonValue>(static_cast<double>(otlp_stats.metric_exports)));
+            stats->set_object_item("otlp", otlp);
+        }
+        if (event_stream) {
+            stats->set_object_item("event_stream_clients", std::make_shared<JsonValue>(static_cast<int>(event_stream->subscriber_count())));
+        }
+        
         std::string json_response = JsonHandler::build_success_response("Server statistics", stats);
         return build_http_response(200, "OK", "application/json", json_response, true, true);
     }
@@ -838,6 +1405,256 @@ std::string WebServer::handle_server_stats_api(const HttpRequest& request) {
                              false, true);
 }
 
+// Log-linear buckets folded onto fixed bounds; each bound is exact to within ~3%
+static const double REQUEST_DURATION_BOUNDS[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+                                                 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+static const size_t REQUEST_DURATION_BOUND_COUNT = sizeof(REQUEST_DURATION_BOUNDS) / sizeof(REQUEST_DURATION_BOUNDS[0]);
+// Phases are recorded in nanoseconds; bounds reach down to 1 us
+static const double PHASE_DURATION_BOUNDS[] = {0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001,
+                                               0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1,
+                                               0.25, 0.5, 1.0, 2.5};
+static const size_t PHASE_DURATION_BOUND_COUNT = sizeof(PHASE_DURATION_BOUNDS) / sizeof(PHASE_DURATION_BOUNDS[0]);
+
+// Renders counters that are already aggregated: a scrape only sums shards and merges the
+// request histograms, it never walks request or connection history
+std::string WebServer::handle_metrics_request(const HttpRequest& request) {
+    if (request.method != "GET" && request.method != "HEAD") {
+        return get_405_response();
+    }
+    
+    ServerMetrics& metrics = ServerMetrics::instance();
+    PrometheusWriter out;
+    
+    out.family("webserver_requests_total", "counter", "HTTP requests by route group, status class and protocol.");
+    for (int route = 0; route < ServerMetrics::ROUTE_COUNT; route++) {
+        for (int protocol = 0; protocol < ServerMetrics::PROTOCOL_COUNT; protocol++) {
+            for (size_t status = 0; status < ServerMetrics::STATUS_CLASS_COUNT; status++) {
+                uint64_t count = metrics.requests(static_cast<ServerMetrics::Route>(route),
+                                                  static_cast<ServerMetrics::Protocol>(protocol), status);
+                if (count == 0) {
+                    continue;
+                }
+                std::string labels = std::string("route=\"") + ServerMetrics::route_name(static_cast<ServerMetrics::Route>(route)) +
+                                     "\",status=\"" + std::to_string(status + 1) + "xx\",protocol=\"" +
+                                     ServerMetrics::protocol_name(static_cast<ServerMetrics::Protocol>(protocol)) + "\"";
+                out.sample("webserver_requests_total", labels, count);
+            }
+        }
+    }
+    
+    if (performance_metrics) {
+        const double* bounds = REQUEST_DURATION_BOUNDS;
+        const size_t bound_count = REQUEST_DURATION_BOUND_COUNT;
+        LatencyHistogram latency = performance_metrics->get_latency_histogram(0);
+        uint64_t cumulative[REQUEST_DURATION_BOUND_COUNT];
+        for (size_t i = 0; i < bound_count; i++) {
+            cumulative[i] = latency.count_at_most(static_cast<uint64_t>(bounds[i] * 1e6));
+        }
+        out.family("webserver_request_duration_seconds", "histogram", "Time from reading a request to sending its response.");
+        out.histogram("webserver_request_duration_seconds", "", bounds, cumulative, bound_count, latency.count(),
+                      static_cast<double>(performance_metrics->get_latency_sum_micros()) / 1e6);
+    }
+    
+    {
+        const double* bounds = PHASE_DURATION_BOUNDS;
+        const size_t bound_count = PHASE_DURATION_BOUND_COUNT;
+        uint64_t cumulative[PHASE_DURATION_BOUND_COUNT];
+        out.family("webserver_request_phase_seconds", "histogram", "Time spent in each phase of an HTTP/1.1 request.");
+        for (int phase = 0; phase < ServerMetrics::PHASE_COUNT; phase++) {
+            auto request_phase = static_cast<ServerMetrics::Phase>(phase);
+            LatencyHistogram histogram = metrics.phase_histogram(request_phase);
+            for (size_t i = 0; i < bound_count; i++) {
+                cumulative[i] = histogram.count_at_most(static_cast<uint64_t>(bounds[i] * 1e9));
+            }
+            out.histogram("webserver_request_phase_seconds", std::string("phase=\"") + ServerMetrics::phase_name(request_phase) + "\"",
+                          bounds, cumulative, bound_count, histogram.count(),
+                          static_cast<double>(metrics.phase_sum_nanos(request_phase)) / 1e9);
+        }
+    }
+    
+    out.family("webserver_received_bytes_total", "counter", "Bytes read from client sockets.");
+    out.sample("webserver_received_bytes_total", "", metrics.bytes_received());
+    out.family("webserver_sent_bytes_total", "counter", "Bytes written to client sockets.");
+    out.sample("webserver_sent_bytes_total", "", metrics.bytes_sent());
+    
+    out.family("webserver_connections_accepted_total", "counter", "TCP connections accepted.");
+    out.sample("webserver_connections_accepted_total", "", metrics.connections_accepted());
+    out.family("webserver_connections", "gauge", "Open client connections by state.");
+    for (int state = 0; state < ServerMetrics::CONNECTION_STATE_COUNT; state++) {
+        auto connection_state = static_cast<ServerMetrics::ConnectionState>(state);
+        out.sample("webserver_connections", std::string("state=\"") + ServerMetrics::connection_state_name(connection_state) + "\"",
+                   static_cast<double>(metrics.open_connections(connection_state)));
+    }
+    if (websocket_handler) {
+        out.sample("webserver_connections", "state=\"websocket\"", static_cast<uint64_t>(websocket_handler->get_connection_count()));
+    }
+    if (event_stream) {
+        out.sample("webserver_connections", "state=\"event_stream\"", static_cast<uint64_t>(event_stream->subscriber_count()));
+    }
+    
+    if (thread_pool) {
+        uint64_t waits[ServerMetrics::QUEUE_WAIT_BUCKET_COUNT + 1];
+        double wait_sum = 0.0;
+        metrics.queue_wait(waits, wait_sum);
+        out.family("webserver_thread_pool_threads", "gauge", "Worker threads in the pool.");
+        out.sample("webserver_thread_pool_threads", "", static_cast<uint64_t>(thread_pool->get_thread_count()));
+        out.family("webserver_thread_pool_queue_depth", "gauge", "Connections waiting for a worker.");
+        out.sample("webserver_thread_pool_queue_depth", "", static_cast<uint64_t>(thread_pool->get_queue_size()));
+        ThreadPool::ScalingStats scaling = thread_pool->get_scaling_stats();
+        out.family("webserver_thread_pool_threads_limit", "gauge", "Bounds the pool scales worker threads between.");
+        out.sample("webserver_thread_pool_threads_limit", "bound=\"min\"", static_cast<uint64_t>(scaling.min_threads));
+        out.sample("webserver_thread_pool_threads_limit", "bound=\"max\"", static_cast<uint64_t>(scaling.max_threads));
+        out.family("webserver_thread_pool_scaling_decisions_total", "counter", "Pool controller decisions by action.");
+        out.sample("webserver_thread_pool_scaling_decisions_total", "action=\"start\"", scaling.started);
+        out.sample("webserver_thread_pool_scaling_decisions_total", "action=\"retire\"", scaling.retired);
+        out.sample("webserver_thread_pool_scaling_decisions_total", "action=\"saturated\"", scaling.saturated);
+        ThreadPool::LaneStats lane_stats[ThreadPool::PRIORITY_COUNT];
+        for (int p = 0; p < ThreadPool::PRIORITY_COUNT; p++) {
+            lane_stats[p] = thread_pool->get_lane_stats(static_cast<ThreadPool::Priority>(p));
+        }
+        out.family("webserver_thread_pool_lane_depth", "gauge", "Connections waiting for a worker, by priority lane.");
+        for (int p = 0; p < ThreadPool::PRIORITY_COUNT; p++) {
+            out.sample("webserver_thread_pool_lane_depth",
+                       std::string("lane=\"") + ThreadPool::priority_name(static_cast<ThreadPool::Priority>(p)) + "\"",
+                       static_cast<uint64_t>(lane_stats[p].queued));
+        }
+        out.family("webserver_thread_pool_rejected_total", "counter", "Connections answered 503 because their lane was full.");
+        for (int p = 0; p < ThreadPool::PRIORITY_COUNT; p++) {
+            out.sample("webserver_thread_pool_rejected_total",
+                       std::string("lane=\"") + ThreadPool::priority_name(static_cast<ThreadPool::Priority>(p)) + "\"",
+                       lane_stats[p].rejected);
+        }
+        out.family("webserver_thread_pool_queue_wait_seconds", "histogram", "Time a connection waited for a worker.");
+        out.histogram("webserver_thread_pool_queue_wait_seconds", "", ServerMetrics::QUEUE_WAIT_BOUNDS, waits,
+                      ServerMetrics::QUEUE_WAIT_BUCKET_COUNT, waits[ServerMetrics::QUEUE_WAIT_BUCKET_COUNT], wait_sum);
+    }
+    
+    AccessLog::Stats log_stats = AccessLog::instance().get_stats();
+    out.family("webserver_access_log_records_total", "counter", "Access log records by outcome.");
+    out.sample("webserver_access_log_records_total", "result=\"written\"", log_stats.written);
+    out.sample("webserver_access_log_records_total", "result=\"dropped\"", log_stats.dropped);
+    out.sample("webserver_access_log_records_total", "result=\"sampled_out\"", log_stats.sampled_out);
+    
+    ProcessStats::Usage usage = ProcessStats::read_usage();
+    out.family("process_cpu_seconds_total", "counter", "User and system CPU time of the whole process.");
+    out.sample("process_cpu_seconds_total", "", usage.user_seconds + usage.system_seconds);
+    out.family("process_resident_memory_bytes", "gauge", "Resident set size.");
+    out.sample("process_resident_memory_bytes", "", usage.rss_bytes);
+    out.family("webserver_context_switches_total", "counter", "Context switches of all threads, by kind.");
+    out.sample("webserver_context_switches_total", "kind=\"voluntary\"", usage.voluntary_switches);
+    out.sample("webserver_context_switches_total", "kind=\"involuntary\"", usage.involuntary_switches);
+    out.family("webserver_thread_cpu_seconds_total", "counter", "CPU time of server threads by role, including exited threads.");
+    for (const auto& role : ProcessStats::thread_cpu_by_role()) {
+        out.sample("webserver_thread_cpu_seconds_total", "role=\"" + role.first + "\"", role.second);
+    }
+    
+    out.family("webserver_tls_handshakes_total", "counter", "TLS handshakes by result.");
+    out.sample("webserver_tls_handshakes_total", "result=\"ok\"", metrics.tls_handshakes(true));
+    out.sample("webserver_tls_handshakes_total", "result=\"failed\"", metrics.tls_handshakes(false));
+    
+    out.family("webserver_http2_streams_total", "counter", "HTTP/2 request streams opened.");
+    out.sample("webserver_http2_streams_total", "", metrics.http2_streams_started());
+    out.family("webserver_http2_streams_open", "gauge", "HTTP/2 request streams currently open.");
+    out.sample("webserver_http2_streams_open", "", static_cast<double>(metrics.http2_streams_open()));
+    
+    if (websocket_handler) {
+        WebSocketHandler::BackpressureStats ws_stats = websocket_handler->get_backpressure_stats();
+        out.family("webserver_websocket_queued_bytes", "gauge", "Bytes waiting in WebSocket outbound queues.");
+        out.sample("webserver_websocket_queued_bytes", "", static_cast<uint64_t>(ws_stats.queued_bytes));
+        out.family("webserver_websocket_frames_dropped_total", "counter", "Frames dropped or coalesced away for slow WebSocket clients.");
+        out.sample("webserver_websocket_frames_dropped_total", "reason=\"dropped\"", static_cast<uint64_t>(ws_stats.frames_dropped));
+        out.sample("webserver_websocket_frames_dropped_total", "reason=\"coalesced\"", static_cast<uint64_t>(ws_stats.frames_coalesced));
+        out.family("webserver_websocket_slow_disconnects_total", "counter", "WebSocket clients closed for falling behind.");
+        out.sample("webserver_websocket_slow_disconnects_total", "", static_cast<uint64_t>(ws_stats.slow_disconnects));
+    }
+    
+    return build_http_response(200, "OK", PrometheusWriter::CONTENT_TYPE, out.take(), true, false);
+}
+
+// The OTLP subset of /metrics, pushed by the exporter thread: same counters and bounds,
+// OpenTelemetry semantic-convention names and units
+void WebServer::write_otlp_metrics(OtlpMetricsWriter& out) {
+    ServerMetrics& metrics = ServerMetrics::instance();
+    
+    out.sum("webserver.requests", "{request}", "HTTP requests by route group, status class and protocol.", true);
+    for (int route = 0; route < ServerMetrics::ROUTE_COUNT; route++) {
+        for (int protocol = 0; protocol < ServerMetrics::PROTOCOL_COUNT; protocol++) {
+            for (size_t status = 0; status < ServerMetrics::STATUS_CLASS_COUNT; status++) {
+                uint64_t count = metrics.requests(static_cast<ServerMetrics::Route>(route),
+                                                  static_cast<ServerMetrics::Protocol>(protocol), status);
+                if (count == 0) {
+                    continue;
+                }
+                out.point({{"route", ServerMetrics::route_name(static_cast<ServerMetrics::Route>(route))},
+                           {"status", std::to_string(status + 1) + "xx"},
+                           {"protocol", ServerMetrics::protocol_name(static_cast<ServerMetrics::Protocol>(protocol))}},
+                          count);
+            }
+        }
+    }
+    
+    if (performance_metrics) {
+        LatencyHistogram latency = performance_metrics->get_latency_histogram(0);
+        uint64_t cumulative[REQUEST_DURATION_BOUND_COUNT];
+        for (size_t i = 0; i < REQUEST_DURATION_BOUND_COUNT; i++) {
+            cumulative[i] = latency.count_at_most(static_cast<uint64_t>(REQUEST_DURATION_BOUNDS[i] * 1e6));
+        }
+        out.histogram("http.server.request.duration", "s", "Time from reading a request to sending its response.");
+        out.histogram_point({}, REQUEST_DURATION_BOUNDS, cumulative, REQUEST_DURATION_BOUND_COUNT, latency.count(),
+                            static_cast<double>(performance_metrics->get_latency_sum_micros()) / 1e6);
+    }
+    
+    {
+        uint64_t cumulative[PHASE_DURATION_BOUND_COUNT];
+        out.histogram("webserver.request.phase.duration", "s", "Time spent in each phase of an HTTP/1.1 request.");
+        for (int phase = 0; phase < ServerMetrics::PHASE_COUNT; phase++) {
+            auto request_phase = static_cast<ServerMetrics::Phase>(phase);
+            LatencyHistogram histogram = metrics.phase_histogram(request_phase);
+            for (size_t i = 0; i < PHASE_DURATION_BOUND_COUNT; i++) {
+                cumulative[i] = histogram.count_at_most(static_cast<uint64_t>(PHASE_DURATION_BOUNDS[i] * 1e9));
+            }
+            out.histogram_point({{"phase", ServerMetrics::phase_name(request_phase)}}, PHASE_DURATION_BOUNDS, cumulative,
+                                PHASE_DURATION_BOUND_COUNT, histogram.count(),
+                                static_cast<double>(metrics.phase_sum_nanos(request_phase)) / 1e9);
+        }
+    }
+    
+    out.sum("webserver.network.io", "By", "Bytes read from and written to client sockets.", true);
+    out.point({{"network.io.direction", "receive"}}, metrics.bytes_received());
+    out.point({{"network.io.direction", "transmit"}}, metrics.bytes_sent());
+    
+    out.gauge("webserver.connections", "{connection}", "Open client connections by state.");
+    for (int state = 0; state < ServerMetrics::CONNECTION_STATE_COUNT; state++) {
+        auto connection_state = static_cast<ServerMetrics::ConnectionState>(state);
+        out.point({{"state", ServerMetrics::connection_state_name(connection_state)}},
+                  static_cast<double>(metrics.open_connections(connection_state)));
+    }
+    
+    if (thread_pool) {
+        out.gauge("webserver.thread_pool.threads", "{thread}", "Worker threads in the pool.");
+        out.point({}, static_cast<uint64_t>(thread_pool->get_thread_count()));
+        out.gauge("webserver.thread_pool.queue_depth", "{connection}", "Connections waiting for a worker.");
+        out.point({}, static_cast<uint64_t>(thread_pool->get_queue_size()));
+        ThreadPool::ScalingStats scaling = thread_pool->get_scaling_stats();
+        out.sum("webserver.thread_pool.scaling_decisions", "{decision}", "Pool controller decisions by action.", true);
+        out.point({{"action", "start"}}, scaling.started);
+        out.point({{"action", "retire"}}, scaling.retired);
+        out.point({{"action", "saturated"}}, scaling.saturated);
+        out.sum("webserver.thread_pool.rejected", "{connection}", "Connections answered 503 because their lane was full.", true);
+        for (int p = 0; p < ThreadPool::PRIORITY_COUNT; p++) {
+            auto priority = static_cast<ThreadPool::Priority>(p);
+            out.point({{"lane", ThreadPool::priority_name(priority)}}, thread_pool->get_lane_stats(priority).rejected);
+        }
+    }
+    
+    ProcessStats::Usage usage = ProcessStats::read_usage();
+    out.sum("process.cpu.time", "s", "User and system CPU time of the whole process.", true);
+    out.point({{"cpu.mode", "user"}}, usage.user_seconds);
+    out.point({{"cpu.mode", "system"}}, usage.system_seconds);
+    out.gauge("process.memory.usage", "By", "Resident set size.");
+    out.point({}, static_cast<uint64_t>(usage.rss_bytes));
+}
+
 std::string WebServer::handle_api_docs(const HttpRequest& request) {
     (void)request; // Suppress unused parameter warning
     
@@ -866,6 +1683,31 @@ std::string WebServer::handle_api_docs(const HttpRequest& request) {
         <p>Get real-time server performance statistics</p>
     </div>
 
+    <div class="endpoint">
+        <span class="method get">GET</span> <span class="url">/api/request-rate?resolution=minute</span>
+        <p>Request counts per second (last 10 minutes), minute (last hour) or hour (last day)</p>
+    </div>
+
+    <div class="endpoint">
+        <span class="method get">GET</span> <span class="url">/api/metrics/history?from=-3600&amp;step=60&amp;agg=max</span>
+        <p>System metrics of the last 24 hours, downsampled per step (avg, min, max or last)</p>
+    </div>
+
+    <div class="endpoint">
+        <span class="method get">GET</span> <span class="url">/api/log-levels</span>
+        <p>Get the diagnostic log level of each module</p>
+    </div>
+
+    <div class="endpoint">
+        <span class="method post">POST</span> <span class="url">/api/log-levels?http2=trace</span>
+        <p>Change log levels at runtime (module=level, or all=level)</p>
+    </div>
+
+    <div class="endpoint">
+        <span class="method get">GET</span> <span class="url">/api/profile?seconds=10&amp;format=svg</span>
+        <p>Sample CPU and return a flame graph (svg) or folded stacks (requires --profiler)</p>
+    </div>
+
     <h2>👥 User Management</h2>
     <div class="endpoint">
         <span class="method get">GET</span> <span class="url">/api/users</span>
@@ -919,13 +1761,14 @@ void WebServer::send_response(int client_socket, const std::string& response) {
         
         if (bytes_sent < 0) {
             if (errno != EPIPE) { // Broken pipe is common when client disconnects
-                std::cerr << "Send failed: " << strerror(errno) << std::endl;
+                LOG_WARN(LogModule::SERVER, "Send failed: " << strerror(errno));
             }
             break;
         }
         
         total_sent += bytes_sent;
     }
+    ServerMetrics::instance().add_bytes_sent(total_sent);
 }
 
 std::string WebServer::build_http_response(int status_code, const std::string& status_text,
@@ -1068,7 +1911,7 @@ void WebServer::manage_connections() {
         shutdown(socket, SHUT_RDWR);
         close(socket);
         g_resource_manager.unregister_socket(socket);
-        safe_cout("Closed idle connection: " + std::to_string(socket));
+        LOG_DEBUG(LogModule::SERVER, "Closed idle connection: " << socket);
     }
 }
 
@@ -1082,13 +1925,12 @@ void WebServer::enable_keep_alive(bool enable, int timeout_seconds) {
     safe_cout(oss.str());
 }
 
-void WebServer::log_request(const std::string& method, const std::string& path, int status_code,
-                          const std::chrono::milliseconds& duration) const {
-    std::ostringstream oss;
-    oss << "[" << std::this_thread::get_id() << "] " 
-        << method << " " << path << " - " << status_code 
-        << " (" << duration.count() << "ms)";
-    safe_cout(oss.str());
+// Queued on this thread's access log ring; the access log writer thread formats and writes it
+void WebServer::log_request(const HttpRequest& request, int status_code, size_t response_bytes,
+                            double duration_ms, const char* peer) const {
+    const char* protocol = request.version.empty() ? "HTTP/1.1" : request.version.c_str();
+    AccessLog::instance().record(AccessLog::Request{request.method, request.path, &request.headers, protocol, peer,
+                                                    status_code, response_bytes, duration_ms});
 }
 
 void WebServer::safe_cout(const std::string& message) const {
@@ -1118,12 +1960,22 @@ void WebServer::cleanup() {
         websocket_handler.reset(); // Explicitly release
     }
     
+    // Close event stream clients
+    if (event_stream) {
+        event_stream->stop();
+    }
+    
     // Stop thread pool
     if (thread_pool) {
         thread_pool->stop();
         thread_pool.reset(); // Explicitly release
     }
     
+    // Write out queued access log records
+    AccessLog::instance().stop();
+    FlightRecorder::instance().stop();
+    OtlpExporter::instance().stop();
+    
     // Cleanup TLS/SSL context
     cleanup_ssl_context();
     
@@ -1225,7 +2077,10 @@ bool WebServer::handle_websocket_upgrade(int client_socket, const HttpRequest& r
         return false;
     }
     
-    std::string response = websocket_handler->generate_websocket_response(request.headers);
+    WebSocketDeflateConfig deflate_config;
+    MetricsEncoding metrics_encoding = MetricsEncoding::JSON;
+    std::string response = websocket_handler->generate_websocket_response(request.headers, deflate_config,
+                                                                          metrics_encoding);
     
     if (response.empty()) {
         return false;
@@ -1235,17 +2090,19 @@ bool WebServer::handle_websocket_upgrade(int client_socket, const HttpRequest& r
     if (send(client_socket, response.c_str(), response.length(), MSG_NOSIGNAL) < 0) {
         return false;
     }
+    ServerMetrics::instance().add_bytes_sent(response.length());
     
     // Generate unique client ID
     std::string client_id = generate_client_id();
     
-    safe_cout("WebSocket upgrade successful for client: " + client_id);
+    LOG_DEBUG(LogModule::WEBSOCKET, "Upgrade successful for client: " << client_id);
     // This socket will now be owned by the WebSocket handler; remove from resource manager
     g_resource_manager.unregister_socket(client_socket);
     
     // Handle WebSocket connection in a separate thread.
-    std::thread ws_thread([this, client_socket, client_id]() {
-        websocket_handler->handle_websocket_connection(client_socket, client_id);
+    std::thread ws_thread([this, client_socket, client_id, deflate_config, metrics_encoding]() {
+        ProcessStats::register_thread("websocket");
+        websocket_handler->handle_websocket_connection(client_socket, client_id, deflate_config, metrics_encoding);
     });
     ws_thread.detach();
     
@@ -1403,6 +2260,7 @@ void WebServer::start_metrics_collection() {
     }
     
     metrics_thread = std::thread([this]() {
+        ProcessStats::register_thread("background");
         while (metrics_running && !g_shutdown_requested) {
             try {
                 std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -1462,10 +2320,13 @@ void WebServer::metrics_collection_loop() {
     }
 }
 
+// HTTP/1.1 requests; HTTP/2 streams are recorded by HTTP2Handler
 void WebServer::record_request_metric(const std::string& method, const std::string& path, 
                                      int status_code, double response_time_ms) {
     if (performance_metrics && !g_shutdown_requested) {
         performance_metrics->record_request(method, path, status_code, response_time_ms);
+        ServerMetrics::instance().record_request(ServerMetrics::route_for(path), ServerMetrics::HTTP1, status_code);
+        RouteStats::instance().record(path, status_code, response_time_ms);
     }
 }
 
@@ -1479,6 +2340,93 @@ void WebServer::enable_http2(bool enable) {
     }
 }
 
+void WebServer::set_websocket_max_message_size(size_t max_bytes) {
+    if (websocket_handler) {
+        websocket_handler->set_max_message_size(max_bytes);
+        safe_cout("WebSocket max message size: " + std::to_string(max_bytes) + " bytes");
+    }
+}
+
+void WebServer::set_websocket_backpressure(size_t max_outbound_bytes, const std::string& policy_name) {
+    if (!websocket_handler) {
+        return;
+    }
+    if (max_outbound_bytes > 0) {
+        websocket_handler->set_max_outbound_bytes(max_outbound_bytes);
+    }
+    SlowConsumerPolicy policy;
+    if (!policy_name.empty() && WebSocketHandler::parse_slow_consumer_policy(policy_name, policy)) {
+        websocket_handler->set_slow_consumer_policy(policy);
+    }
+    safe_cout("WebSocket outbound limit: " + std::to_string(websocket_handler->get_max_outbound_bytes()) +
+              " bytes per client, slow consumer policy: " +
+              WebSocketHandler::slow_consumer_policy_name(websocket_handler->get_slow_consumer_policy()));
+}
+
+bool WebServer::set_access_log(const std::string& path, const std::string& format_name, uint32_t sample_every) {
+    AccessLogFormat format;
+    if (!AccessLog::parse_format(format_name, format)) {
+        return false;
+    }
+    if (!AccessLog::instance().configure(path, format, sample_every)) {
+        return false;
+    }
+    if (path == "off") {
+        safe_cout("Access log: off");
+    } else {
+        safe_cout("Access log: " + std::string(path == "-" ? "stdout" : path) + " (" + format_name + " format, 1 in " +
+                  std::to_string(sample_every) + " requests)");
+    }
+    return true;
+}
+
+void WebServer::enable_profiler(bool enable) {
+    profiler_enabled.store(enable);
+    if (enable) {
+        safe_cout("CPU profiler enabled at /api/profile");
+    }
+}
+
+bool WebServer::set_flight_recorder(const std::string& directory, uint32_t slow_request_ms) {
+    if (!FlightRecorder::instance().configure(directory, slow_request_ms)) {
+        return false;
+    }
+    if (directory == "off") {
+        safe_cout("Flight recorder: off");
+    } else {
+        std::string slow = slow_request_ms > 0 ? ", and after requests over " + std::to_string(slow_request_ms) + " ms" : "";
+        safe_cout("Flight recorder: dumps to " + directory + " on SIGUSR1" + slow);
+    }
+    return true;
+}
+
+bool WebServer::set_otlp_export(const std::string& endpoint, uint32_t sample_every, uint32_t slow_ms) {
+    if (!OtlpExporter::instance().configure(endpoint, sample_every, slow_ms)) {
+        return false;
+    }
+    if (endpoint != "off") {
+        std::string sampled = sample_every > 0 ? "1 in " + std::to_string(sample_every) + " requests" : "no ordinary requests";
+        safe_cout("OTLP export: " + endpoint + " (traces " + sampled + ", plus 5xx and requests over " +
+                  std::to_string(slow_ms) + " ms)");
+    }
+    return true;
+}
+
+bool WebServer::set_queue_limits(const std::string& spec) {
+    if (!thread_pool->configure_limits(spec)) {
+        return false;
+    }
+    std::string limits;
+    for (int p = 0; p < ThreadPool::PRIORITY_COUNT; p++) {
+        auto priority = static_cast<ThreadPool::Priority>(p);
+        size_t limit = thread_pool->get_lane_stats(priority).limit;
+        limits += std::string(p > 0 ? ", " : "") + ThreadPool::priority_name(priority) + " " +
+                  (limit > 0 ? std::to_string(limit) : "unlimited");
+    }
+    safe_cout("Queue limits: " + limits);
+    return true;
+}
+
 bool WebServer::detect_http2_preface(int client_socket) {
     char buffer[24]; // HTTP/2 connection preface is 24 bytes
     
@@ -1503,6 +2451,7 @@ bool WebServer::detect_http2_preface(int client_socket) {
 }
 
 void WebServer::handle_http2_connection(int client_socket, const char* initial_data, size_t initial_len) {
+    ServerMetrics::StateScope http2_state(ServerMetrics::CONN_HTTP1, ServerMetrics::CONN_HTTP2);
     try {
         // Create HTTP/2 handler (without SSL)
         auto http2_handler = std::make_unique<HTTP2Handler>(
@@ -1513,53 +2462,73 @@ void WebServer::handle_http2_connection(int client_socket, const char* initial_d
             nullptr  // No SSL for regular HTTP/2
         );
         
+        http2_handler->set_event_stream(event_stream);
         if (!http2_handler->initialize()) {
-            safe_cout("Failed to initialize HTTP/2 handler");
+            LOG_ERROR(LogModule::HTTP2, "Failed to initialize handler");
             return;
         }
         
-        safe_cout("HTTP/2 connection established");
+        LOG_DEBUG(LogModule::HTTP2, "Connection established on socket " << client_socket);
         
         // Process initial data if provided (contains the preface and possibly more)
         if (initial_data && initial_len > 0) {
             if (http2_handler->process_data(reinterpret_cast<const uint8_t*>(initial_data), initial_len) < 0) {
-                safe_cout("HTTP/2 initial data processing error");
+                LOG_WARN(LogModule::HTTP2, "Initial data processing error");
                 return;
             }
         }
         
-        // Process HTTP/2 frames
+        // Process HTTP/2 frames; poll() also wakes when an event stream has new data
         char buffer[8192];
+        int idle_ms = 0;
         while (!g_shutdown_requested && 
                (http2_handler->session_want_read() || http2_handler->session_want_write())) {
             
-            if (http2_handler->session_want_read()) {
+            struct pollfd fds[2] = {{client_socket, POLLIN, 0}, {http2_handler->get_wake_fd(), POLLIN, 0}};
+            int ready = poll(fds, 2, 1000);
+            if (ready < 0 && errno != EINTR) {
+                break;
+            }
+            if (ready > 0 && (fds[1].revents & POLLIN) && !http2_handler->resume_event_streams()) {
+                LOG_WARN(LogModule::HTTP2, "Output flush error");
+                break;
+            }
+            
+            // Same idle limit as the socket receive timeout, unless an event stream is open
+            bool readable = ready > 0 && fds[0].revents != 0;
+            idle_ms = readable ? 0 : idle_ms + (ready == 0 ? 1000 : 0);
+            if (idle_ms >= 30000 && !http2_handler->has_event_streams()) {
+                break;
+            }
+            
+            if (readable && http2_handler->session_want_read()) {
                 ssize_t bytes_received = recv(client_socket, buffer, sizeof(buffer), 0);
                 if (bytes_received <= 0) {
                     if (bytes_received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-                        safe_cout("HTTP/2 connection read error");
+                        LOG_WARN(LogModule::HTTP2, "Connection read error: " << strerror(errno));
                     }
                     break;
                 }
+                ServerMetrics::instance().add_bytes_received(static_cast<size_t>(bytes_received));
                 
                 if (http2_handler->process_data(reinterpret_cast<uint8_t*>(buffer), bytes_received) < 0) {
-                    safe_cout("HTTP/2 data processing error");
+                    LOG_WARN(LogModule::HTTP2, "Data processing error");
                     break;
                 }
             }
             
             if (http2_handler->session_want_write()) {
                 if (!http2_handler->flush_output()) {
-                    safe_cout("HTTP/2 output flush error");
+                    LOG_WARN(LogModule::HTTP2, "Output flush error");
                     break;
                 }
             }
         }
         
-        safe_cout("HTTP/2 connection closed");
+        LOG_DEBUG(LogModule::HTTP2, "Connection closed on socket " << client_socket);
         
     } catch (const std::exception& e) {
-        safe_cout("HTTP/2 connection error: " + std::string(e.what()));
+        LOG_WARN(LogModule::HTTP2, "Connection error: " << e.what());
     }
 }
 
@@ -1676,12 +2645,12 @@ SSL* WebServer::create_ssl_connection(int client_socket) {
     
     SSL* ssl = SSL_new(ssl_ctx);
     if (!ssl) {
-        safe_cout("Failed to create SSL connection");
+        LOG_WARN(LogModule::TLS, "Failed to create SSL connection");
         return nullptr;
     }
     
     if (SSL_set_fd(ssl, client_socket) != 1) {
-        safe_cout("Failed to set SSL file descriptor");
+        LOG_WARN(LogModule::TLS, "Failed to set SSL file descriptor");
         SSL_free(ssl);
         return nullptr;
     }
@@ -1691,9 +2660,13 @@ SSL* WebServer::create_ssl_connection(int client_socket) {
 
 bool WebServer::perform_alpn_negotiation(SSL* ssl, std::string& selected_protocol) {
     if (SSL_accept(ssl) <= 0) {
-        safe_cout("SSL handshake failed");
+        ServerMetrics::instance().record_tls_handshake(false);
+        SERVER_PROBE2(tls__handshake, SSL_get_fd(ssl), 0);
+        LOG_DEBUG(LogModule::TLS, "SSL handshake failed");
         return false;
     }
+    ServerMetrics::instance().record_tls_handshake(true);
+    SERVER_PROBE2(tls__handshake, SSL_get_fd(ssl), 1);
     
     const unsigned char* alpn_selected;
     unsigned int alpn_len;
@@ -1701,36 +2674,36 @@ bool WebServer::perform_alpn_negotiation(SSL* ssl, std::string& selected_protoco
     
     if (alpn_selected && alpn_len > 0) {
         selected_protocol = std::string(reinterpret_cast<const char*>(alpn_selected), alpn_len);
-        safe_cout("ALPN negotiated protocol: " + selected_protocol);
+        LOG_DEBUG(LogModule::TLS, "ALPN negotiated protocol: " << selected_protocol);
         return true;
     }
     
     // Default to HTTP/1.1 if no ALPN negotiation
     selected_protocol = "http/1.1";
-    safe_cout("No ALPN negotiation, defaulting to HTTP/1.1");
+    LOG_DEBUG(LogModule::TLS, "No ALPN negotiation, defaulting to HTTP/1.1");
     return true;
 }
 
 void WebServer::handle_tls_connection(int client_socket) {
     SSL* ssl = create_ssl_connection(client_socket);
     if (!ssl) {
-        safe_cout("Failed to create SSL connection");
+        LOG_WARN(LogModule::TLS, "Failed to create SSL connection");
         return;
     }
     
     std::string selected_protocol;
     if (!perform_alpn_negotiation(ssl, selected_protocol)) {
-        safe_cout("TLS handshake or ALPN negotiation failed");
+        LOG_DEBUG(LogModule::TLS, "TLS handshake or ALPN negotiation failed");
         SSL_free(ssl);
         return;
     }
     
     // Route to appropriate handler based on negotiated protocol
     if (selected_protocol == "h2") {
-        safe_cout("Handling HTTP/2 over TLS connection");
+        LOG_DEBUG(LogModule::TLS, "Handling HTTP/2 over TLS connection");
         handle_tls_http2_connection(ssl);
     } else {
-        safe_cout("Handling HTTP/1.1 over TLS connection");
+        LOG_DEBUG(LogModule::TLS, "Handling HTTP/1.1 over TLS connection");
         handle_tls_http_connection(ssl, selected_protocol);
     }
     
@@ -1741,6 +2714,8 @@ void WebServer::handle_tls_connection(int client_socket) {
 void WebServer::handle_tls_http_connection(SSL* ssl, const std::string& selected_protocol) {
     auto& coordinator = ShutdownCoordinator::instance();
     bool keep_connection = false;
+    std::string peer = AccessLog::instance().is_enabled() ? AccessLog::peer_address(SSL_get_fd(ssl)) : "";
+    uint64_t connection_id = FlightRecorder::next_connection_id();
     
     try {
         do {
@@ -1768,6 +2743,7 @@ void WebServer::handle_tls_http_connection(SSL* ssl, const std::string& selected
                 }
                 break;
             }
+            SERVER_PROBE4(request__parsed, SSL_get_fd(ssl), 0, request.method.c_str(), request.path.c_str());
 
             // Check for WebSocket upgrade over TLS
             if (is_websocket_path(request.path) && 
@@ -1775,7 +2751,7 @@ void WebServer::handle_tls_http_connection(SSL* ssl, const std::string& selected
                 !coordinator.is_shutdown_requested()) {
                 
                 // Note: WebSocket over TLS would need additional implementation
-                safe_cout("WebSocket over TLS not supported yet");
+                LOG_DEBUG(LogModule::TLS, "WebSocket over TLS not supported yet");
                 std::string response = get_400_response();
                 ssl_send_response(ssl, response);
                 break;
@@ -1786,19 +2762,38 @@ void WebServer::handle_tls_http_connection(SSL* ssl, const std::string& selected
             }
 
             // Handle regular HTTPS request
+            int fd = SSL_get_fd(ssl);
+            SERVER_PROBE4(handler__start, fd, 0, request.method.c_str(), request.path.c_str());
+            auto parsed = std::chrono::steady_clock::now();
             std::string response = handle_request(request, keep_connection);
-            if (!coordinator.is_shutdown_requested()) {
-                ssl_send_response(ssl, response);
+            auto handled = std::chrono::steady_clock::now();
+            int status_code = extract_status_code(response);
+            SERVER_PROBE3(handler__end, fd, 0, status_code);
+            ServerMetrics::instance().record_phase(ServerMetrics::PHASE_HANDLER, parsed, handled);
+            FlightRecorder::Record flight = {};
+            if (!coordinator.is_shutdown_requested() && ssl_send_response(ssl, response)) {
+                auto written = std::chrono::steady_clock::now();
+                ServerMetrics::instance().record_phase(ServerMetrics::PHASE_WRITE, handled, written);
+                SERVER_PROBE4(response__sent, fd, 0, status_code, response.size());
+                flight.finished_ns = FlightRecorder::nanos(written);
             }
+            flight.connection_id = connection_id;
+            flight.protocol = FlightRecorder::HTTPS;
+            flight.parsed_ns = FlightRecorder::nanos(parsed);
+            flight.handled_ns = FlightRecorder::nanos(handled);
+            flight.status = static_cast<uint16_t>(status_code);
+            flight.bytes_received = headers_data.size();
+            flight.bytes_sent = response.size();
+            flight.set_request(request.method, request.path);
+            FlightRecorder::instance().record(flight);
+            OtlpExporter::instance().record(flight, request.get_header("traceparent"));
 
             auto end_time = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-            
-            int status_code = extract_status_code(response);
+            double elapsed_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
             
             if (!coordinator.is_shutdown_requested()) {
-                log_request(request.method, request.path + " [TLS]", status_code, duration);
-                record_request_metric(request.method, request.path, status_code, duration.count());
+                log_request(request, status_code, response.size(), elapsed_ms, peer.c_str());
+                record_request_metric(request.method, request.path, status_code, elapsed_ms);
                 total_requests++;
             }
 
@@ -1806,12 +2801,13 @@ void WebServer::handle_tls_http_connection(SSL* ssl, const std::string& selected
         
     } catch (const std::exception& e) {
         if (!coordinator.is_shutdown_requested()) {
-            safe_cout("TLS HTTP client handler exception: " + std::string(e.what()));
+            LOG_WARN(LogModule::TLS, "HTTP client handler exception: " << e.what());
         }
     }
 }
 
 void WebServer::handle_tls_http2_connection(SSL* ssl) {
+    ServerMetrics::StateScope http2_state(ServerMetrics::CONN_HTTP1, ServerMetrics::CONN_HTTP2);
     try {
         // Create HTTP/2 handler with SSL support
         auto shared_file_handler = std::shared_ptr<FileHandler>(file_handler.get(), [](FileHandler*) {});
@@ -1822,22 +2818,43 @@ void WebServer::handle_tls_http2_connection(SSL* ssl) {
             document_root, 
             ssl);
         
+        http2_handler->set_event_stream(event_stream);
         if (!http2_handler->initialize()) {
-            safe_cout("Failed to initialize HTTP/2 over TLS handler");
+            LOG_ERROR(LogModule::HTTP2, "Failed to initialize handler over TLS");
             return;
         }
         
-        safe_cout("HTTP/2 over TLS connection established");
+        LOG_DEBUG(LogModule::HTTP2, "Connection over TLS established on socket " << SSL_get_fd(ssl));
         
         // Note: For HTTP/2 over TLS, the client doesn't send the connection preface
         // The nghttp2 library handles this automatically for TLS connections
         
         // Process HTTP/2 frames over TLS
         char buffer[8192];
+        int idle_ms = 0;
         while (!g_shutdown_requested && 
                (http2_handler->session_want_read() || http2_handler->session_want_write())) {
             
-            if (http2_handler->session_want_read()) {
+            // Wait for socket data or event stream wakeups unless OpenSSL already has bytes buffered
+            bool readable = SSL_pending(ssl) > 0;
+            if (!readable) {
+                struct pollfd fds[2] = {{SSL_get_fd(ssl), POLLIN, 0}, {http2_handler->get_wake_fd(), POLLIN, 0}};
+                int ready = poll(fds, 2, 1000);
+                if (ready < 0 && errno != EINTR) {
+                    break;
+                }
+                if (ready > 0 && (fds[1].revents & POLLIN) && !http2_handler->resume_event_streams()) {
+                    LOG_WARN(LogModule::HTTP2, "Output flush error over TLS");
+                    break;
+                }
+                readable = ready > 0 && fds[0].revents != 0;
+                idle_ms = readable ? 0 : idle_ms + (ready == 0 ? 1000 : 0);
+                if (idle_ms >= 30000 && !http2_handler->has_event_streams()) {
+                    break;
+                }
+            }
+            
+            if (readable && http2_handler->session_want_read()) {
                 int bytes_received = SSL_read(ssl, buffer, sizeof(buffer));
                 if (bytes_received <= 0) {
                     int ssl_error = SSL_get_error(ssl, bytes_received);
@@ -1846,16 +2863,17 @@ void WebServer::handle_tls_http2_connection(SSL* ssl) {
                         std::this_thread::sleep_for(std::chrono::milliseconds(1));
                         continue;
                     } else if (ssl_error == SSL_ERROR_ZERO_RETURN) {
-                        safe_cout("HTTP/2 over TLS connection closed by client");
+                        LOG_DEBUG(LogModule::HTTP2, "Connection over TLS closed by client");
                         break;
                     } else {
-                        safe_cout("HTTP/2 over TLS read error: " + std::to_string(ssl_error));
+                        LOG_WARN(LogModule::HTTP2, "Read error over TLS: " << ssl_error);
                         break;
                     }
                 } else {
                     // Successfully read data, process it
+                    ServerMetrics::instance().add_bytes_received(static_cast<size_t>(bytes_received));
                     if (http2_handler->process_data(reinterpret_cast<uint8_t*>(buffer), bytes_received) < 0) {
-                        safe_cout("HTTP/2 over TLS data processing error");
+                        LOG_WARN(LogModule::HTTP2, "Data processing error over TLS");
                         break;
                     }
                 }
@@ -1863,7 +2881,7 @@ void WebServer::handle_tls_http2_connection(SSL* ssl) {
             
             if (http2_handler->session_want_write()) {
                 if (!http2_handler->flush_output()) {
-                    safe_cout("HTTP/2 over TLS output flush error");
+                    LOG_WARN(LogModule::HTTP2, "Output flush error over TLS");
                     break;
                 }
             }
@@ -1872,10 +2890,10 @@ void WebServer::handle_tls_http2_connection(SSL* ssl) {
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
         
-        safe_cout("HTTP/2 over TLS connection closed");
+        LOG_DEBUG(LogModule::HTTP2, "Connection over TLS closed");
         
     } catch (const std::exception& e) {
-        safe_cout("HTTP/2 over TLS connection error: " + std::string(e.what()));
+        LOG_WARN(LogModule::HTTP2, "Connection error over TLS: " << e.what());
     }
 }
 
@@ -1922,6 +2940,7 @@ bool WebServer::ssl_read_request_with_timeout(SSL* ssl, std::string& headers_dat
         
         buffer[bytes_read] = '\0';
         headers_data.append(buffer, bytes_read);
+        ServerMetrics::instance().add_bytes_received(static_cast<size_t>(bytes_read));
     }
     
     return true;
@@ -1945,6 +2964,7 @@ bool WebServer::ssl_send_response(SSL* ssl, const std::string& response) {
         }
         total_sent += bytes_sent;
     }
+    ServerMetrics::instance().add_bytes_sent(total_sent);
     
     return true;
 }
@@ -1972,6 +2992,7 @@ std::string WebServer::ssl_read_request(SSL* ssl, const HttpRequest& parsed_requ
                 total_read += bytes_read;
             }
             
+            ServerMetrics::instance().add_bytes_received(static_cast<size_t>(total_read));
             buffer[total_read] = '\0';
             body = std::string(buffer, total_read);
             delete[] buffer;
@@ -0,0 +1,195 @@
+#include "../../include/core/server_metrics.h"
+#include <cstring>
+
+const size_t ServerMetrics::STATUS_CLASS_COUNT;
+const size_t ServerMetrics::QUEUE_WAIT_BUCKET_COUNT;
+const double ServerMetrics::QUEUE_WAIT_BOUNDS[QUEUE_WAIT_BUCKET_COUNT] = {
+    0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0
+};
+
+ServerMetrics& ServerMetrics::instance() {
+    static ServerMetrics metrics;
+    return metrics;
+}
+
+// Compared in place: this runs for every request on both protocols
+ServerMetrics::Route ServerMetrics::route_for(const std::string& path) {
+    const char* text = path.c_str();
+    size_t length = std::strcspn(text, "?");
+    auto is = [text, length](const char* route) {
+        return std::strlen(route) == length && std::memcmp(text, route, length) == 0;
+    };
+    if (is("/metrics")) {
+        return ROUTE_METRICS;
+    }
+    if (is("/api/metrics/stream")) {
+        return ROUTE_EVENT_STREAM;
+    }
+    if (length >= 4 && std::memcmp(text, "/api", 4) == 0) {
+        return ROUTE_API;
+    }
+    if (is("/ws") || is("/websocket")) {
+        return ROUTE_WEBSOCKET;
+    }
+    if (is("/dashboard") || is("/dashboard.html") || is("/admin-dashboard")) {
+        return ROUTE_DASHBOARD;
+    }
+    return ROUTE_STATIC;
+}
+
+const char* ServerMetrics::route_name(Route route) {
+    switch (route) {
+        case ROUTE_STATIC: return "static";
+        case ROUTE_API: return "api";
+        case ROUTE_DASHBOARD: return "dashboard";
+        case ROUTE_WEBSOCKET: return "websocket";
+        case ROUTE_EVENT_STREAM: return "event_stream";
+        case ROUTE_METRICS: return "metrics";
+        default: return "unknown";
+    }
+}
+
+const char* ServerMetrics::protocol_name(Protocol protocol) {
+    return protocol == HTTP2 ? "h2" : "http/1.1";
+}
+
+const char* ServerMetrics::connection_state_name(ConnectionState state) {
+    return state == CONN_HTTP2 ? "http2" : "http1";
+}
+
+const char* ServerMetrics::phase_name(Phase phase) {
+    switch (phase) {
+        case PHASE_ACCEPT: return "accept";
+        case PHASE_QUEUE: return "queue";
+        case PHASE_FIRST_BYTE: return "first_byte";
+        case PHASE_READ: return "read";
+        case PHASE_HANDLER: return "handler";
+        case PHASE_WRITE: return "write";
+        default: return "unknown";
+    }
+}
+
+void ServerMetrics::record_request(Route route, Protocol protocol, int status_code) {
+    size_t status_class = status_code >= 100 && status_code < 600 ? static_cast<size_t>(status_code / 100 - 1) : 4;
+    shards[RequestRecorder::thread_shard()].requests[route][protocol][status_class].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::add_bytes_received(size_t bytes) {
+    shards[RequestRecorder::thread_shard()].bytes_received.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void ServerMetrics::add_bytes_sent(size_t bytes) {
+    shards[RequestRecorder::thread_shard()].bytes_sent.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+// Buckets are stored non-cumulatively and summed on read
+void ServerMetrics::record_queue_wait(std::chrono::steady_clock::duration wait) {
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+    double seconds = static_cast<double>(nanos) / 1e9;
+
+    size_t bucket = 0;
+    while (bucket < QUEUE_WAIT_BUCKET_COUNT && seconds > QUEUE_WAIT_BOUNDS[bucket]) {
+        bucket++;
+    }
+
+    Shard& shard = shards[RequestRecorder::thread_shard()];
+    shard.queue_wait[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.queue_wait_nanos.fetch_add(nanos > 0 ? static_cast<uint64_t>(nanos) : 0, std::memory_order_relaxed);
+    record_phase(PHASE_QUEUE, wait);
+}
+
+void ServerMetrics::record_phase(Phase phase, std::chrono::steady_clock::duration elapsed) {
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    uint64_t value = nanos > 0 ? static_cast<uint64_t>(nanos) : 0;
+
+    Shard& shard = shards[RequestRecorder::thread_shard()];
+    shard.phases[phase][LatencyHistogram::bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.phase_nanos[phase].fetch_add(value, std::memory_order_relaxed);
+}
+
+void ServerMetrics::record_tls_handshake(bool ok) {
+    (ok ? tls_ok : tls_failed).fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::http2_stream_opened() {
+    http2_streams_total.fetch_add(1, std::memory_order_relaxed);
+    http2_streams_active.fetch_add(1, std::memory_order_relaxed);
+}
+
+ServerMetrics::StateScope::StateScope(ConnectionState from, ConnectionState to) : from(from), to(to) {
+    ServerMetrics& metrics = ServerMetrics::instance();
+    metrics.connection_closed(from);
+    metrics.connection_opened(to);
+}
+
+ServerMetrics::StateScope::~StateScope() {
+    ServerMetrics& metrics = ServerMetrics::instance();
+    metrics.connection_closed(to);
+    metrics.connection_opened(from);
+}
+
+uint64_t ServerMetrics::requests(Route route, Protocol protocol, size_t status_class) const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.requests[route][protocol][status_class].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t ServerMetrics::bytes_received() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.bytes_received.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t ServerMetrics::bytes_sent() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.bytes_sent.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void ServerMetrics::queue_wait(uint64_t cumulative[QUEUE_WAIT_BUCKET_COUNT + 1], double& sum_seconds) const {
+    uint64_t nanos = 0;
+    for (size_t b = 0; b <= QUEUE_WAIT_BUCKET_COUNT; b++) {
+        cumulative[b] = 0;
+    }
+    for (const auto& shard : shards) {
+        for (size_t b = 0; b <= QUEUE_WAIT_BUCKET_COUNT; b++) {
+            cumulative[b] += shard.queue_wait[b].load(std::memory_order_relaxed);
+        }
+        nanos += shard.queue_wait_nanos.load(std::memory_order_relaxed);
+    }
+    for (size_t b = 1; b <= QUEUE_WAIT_BUCKET_COUNT; b++) {
+        cumulative[b] += cumulative[b - 1];
+    }
+    sum_seconds = static_cast<double>(nanos) / 1e9;
+}
+
+LatencyHistogram ServerMetrics::phase_histogram(Phase phase) const {
+    LatencyHistogram histogram;
+    for (const auto& shard : shards) {
+        for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; b++) {
+            uint64_t count = shard.phases[phase][b].load(std::memory_order_relaxed);
+            if (count > 0) {
+                histogram.add(b, count);
+            }
+        }
+    }
+    return histogram;
+}
+
+uint64_t ServerMetrics::phase_sum_nanos(Phase phase) const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.phase_nanos[phase].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t ServerMetrics::tls_handshakes(bool ok) const {
+    return (ok ? tls_ok : tls_failed).load(std::memory_order_relaxed);
+}
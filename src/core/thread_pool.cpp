@@ -2,59 +2,422 @@
 
 #include "../../include/core/thread_pool.h"
 #include "../../include/core/shutdown_coordinator.h"
+#include "../../include/core/server_metrics.h"
+#include "../../include/core/process_stats.h"
+#include "../../include/core/log.h"
+#include "../../include/core/probes.h"
 #include <iostream>
+#include <algorithm>
 #include <future>
 #include <chrono>
+#include <random>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-ThreadPool::ThreadPool(size_t num_threads) : stop_flag(false) {
-    // Create worker threads
-    for (size_t i = 0; i < num_threads; ++i) {
-        workers.emplace_back(&ThreadPool::worker, this);
+const size_t ThreadPool::LOCAL_CAPACITY;
+const int ThreadPool::SPIN_ROUNDS;
+const size_t ThreadPool::NODE_CACHE_SIZE;
+const size_t ThreadPool::NODE_DEPOT_SIZE;
+const int ThreadPool::SCALE_INTERVAL_MS;
+const int ThreadPool::RETIRE_INTERVAL_MS;
+const unsigned ThreadPool::PRIORITY_WEIGHTS[PRIORITY_COUNT] = {8, 4, 1};
+
+// Which pool and deque the current thread works for, so enqueue from a task stays local
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+// Victim selection; quality does not matter, only that workers spread out
+static uint32_t next_random() {
+    static thread_local uint32_t state = std::random_device{}() | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void futex_wait(std::atomic<uint32_t>& word, uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+ThreadPool::ThreadPool(size_t num_threads) : ThreadPool(Scaling::fixed(num_threads)) {}
+
+ThreadPool::ThreadPool(const Scaling& config) : scaling(config), stop_flag(false) {
+    scaling.min_threads = std::max<size_t>(1, scaling.min_threads);
+    scaling.max_threads = std::max(scaling.max_threads, scaling.min_threads);
+    
+    // Every slot's deque exists before any worker can steal from it
+    parkers.reset(new Parker[scaling.max_threads]);
+    for (size_t i = 0; i < scaling.max_threads; ++i) {
+        deques.emplace_back(new LocalQueue());
+    }
+    workers.resize(scaling.max_threads);
+    idle_stack.reserve(scaling.max_threads);
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        for (size_t i = 0; i < scaling.min_threads; ++i) {
+            start_worker(i);
+        }
     }
     
-    std::cout << "Thread pool created with " << num_threads << " threads" << std::endl;
+    if (scaling.max_threads > scaling.min_threads) {
+        controller = std::thread(&ThreadPool::control, this);
+        std::cout << "Thread pool created with " << scaling.min_threads << " threads (elastic up to "
+                  << scaling.max_threads << ")" << std::endl;
+    } else {
+        std::cout << "Thread pool created with " << scaling.min_threads << " threads" << std::endl;
+    }
 }
 
 ThreadPool::~ThreadPool() {
     stop();
 }
 
-void ThreadPool::enqueue(std::function<void()> task) {
+const char* ThreadPool::priority_name(Priority priority) {
+    switch (priority) {
+        case HIGH: return "high";
+        case NORMAL: return "normal";
+        case LOW: return "low";
+        default: return "unknown";
+    }
+}
+
+bool ThreadPool::parse_priority(const std::string& name, Priority& priority) {
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        if (name == priority_name(static_cast<Priority>(p))) {
+            priority = static_cast<Priority>(p);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::set_queue_limit(Priority priority, size_t limit) {
+    std::lock_guard<std::mutex> lock(injection_mutex);
+    lanes[priority].limit = limit;
+}
+
+bool ThreadPool::configure_limits(const std::string& spec) {
+    // Validate every part before applying any of them
+    size_t parsed[PRIORITY_COUNT];
+    bool present[PRIORITY_COUNT] = {};
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t end = spec.find(',', start);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        std::string part = spec.substr(start, end - start);
+        size_t equals = part.find('=');
+        Priority priority;
+        if (equals == std::string::npos || !parse_priority(part.substr(0, equals), priority)) {
+            return false;
+        }
+        std::string value = part.substr(equals + 1);
+        if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        parsed[priority] = std::stoul(value);
+        present[priority] = true;
+        start = end + 1;
+    }
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        if (present[p]) {
+            set_queue_limit(static_cast<Priority>(p), parsed[p]);
+        }
+    }
+    return true;
+}
+
+// Queue nodes are recycled instead of freed. Workers release the nodes the acceptor
+// acquires, so each thread keeps a small cache and trades half of it with a shared depot
+// when it runs empty or full; the depot lock is taken once per NODE_CACHE_SIZE / 2 nodes.
+struct ThreadPool::NodeCache {
+    struct Depot {
+        std::mutex mutex;
+        std::vector<QueuedTask*> nodes;
+        Depot() { nodes.reserve(NODE_DEPOT_SIZE); }
+    };
+    
+    static Depot& depot() {
+        // Never destroyed: detached workers may still release nodes while the process exits
+        static Depot* shared = new Depot();
+        return *shared;
+    }
+    
+    std::vector<QueuedTask*> nodes;
+    
+    NodeCache() { nodes.reserve(NODE_CACHE_SIZE); }
+    ~NodeCache() {
+        for (QueuedTask* node : nodes) {
+            delete node;
+        }
+    }
+};
+
+ThreadPool::NodeCache& ThreadPool::node_cache() {
+    static thread_local NodeCache cache;
+    return cache;
+}
+
+ThreadPool::QueuedTask* ThreadPool::acquire_node(Task&& task, std::chrono::steady_clock::time_point enqueued) {
+    NodeCache& cache = node_cache();
+    if (cache.nodes.empty()) {
+        NodeCache::Depot& depot = NodeCache::depot();
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        size_t take = std::min(NODE_CACHE_SIZE / 2, depot.nodes.size());
+        cache.nodes.insert(cache.nodes.end(), depot.nodes.end() - take, depot.nodes.end());
+        depot.nodes.resize(depot.nodes.size() - take);
+    }
+    if (cache.nodes.empty()) {
+        return new QueuedTask{std::move(task), enqueued};
+    }
+    QueuedTask* node = cache.nodes.back();
+    cache.nodes.pop_back();
+    node->function = std::move(task);
+    node->enqueued = enqueued;
+    return node;
+}
+
+void ThreadPool::release_node(QueuedTask* node) {
+    node->function.reset();
+    NodeCache& cache = node_cache();
+    if (cache.nodes.size() >= NODE_CACHE_SIZE) {
+        NodeCache::Depot& depot = NodeCache::depot();
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        size_t room = NODE_DEPOT_SIZE - std::min(NODE_DEPOT_SIZE, depot.nodes.size());
+        size_t give = std::min(NODE_CACHE_SIZE / 2, room);
+        depot.nodes.insert(depot.nodes.end(), cache.nodes.end() - give, cache.nodes.end());
+        cache.nodes.resize(cache.nodes.size() - give);
+    }
+    if (cache.nodes.size() >= NODE_CACHE_SIZE) {
+        delete node;
+        return;
+    }
+    cache.nodes.push_back(node);
+}
+
+// From one of this pool's workers: onto its own deque, if there is room
+bool ThreadPool::push_local(QueuedTask* task) {
+    return current_pool == this && deques[current_index]->push(task);
+}
+
+// Lane rings grow to the next power of two, keeping their order from head
+void ThreadPool::Lane::push_back(QueuedTask* task) {
+    if (count == ring.size()) {
+        std::vector<QueuedTask*> grown(std::max<size_t>(64, ring.size() * 2));
+        for (size_t i = 0; i < count; i++) {
+            grown[i] = ring[(head + i) & (ring.size() - 1)];
+        }
+        ring.swap(grown);
+        head = 0;
+    }
+    ring[(head + count) & (ring.size() - 1)] = task;
+    count++;
+}
+
+ThreadPool::QueuedTask* ThreadPool::Lane::pop_front() {
+    QueuedTask* task = ring[head];
+    head = (head + 1) & (ring.size() - 1);
+    count--;
+    return task;
+}
+
+// Caller holds injection_mutex; false when the lane is at its limit
+bool ThreadPool::inject(QueuedTask* task, Priority priority) {
+    Lane& lane = lanes[priority];
+    if (lane.limit > 0 && lane.count >= lane.limit) {
+        lane.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    lane.push_back(task);
+    injection_count++;
+    return true;
+}
+
+// Caller holds injection_mutex, and a lane from 'first' on has a task. Smooth weighted
+// round robin (as in nginx): while several lanes wait, each gets picks in proportion to
+// its weight, interleaved, so HIGH goes first most of the time and LOW is never starved.
+ThreadPool::QueuedTask* ThreadPool::take_front(Priority first) {
+    Lane* chosen = nullptr;
+    int total = 0;
+    for (int p = first; p < PRIORITY_COUNT; p++) {
+        Lane& lane = lanes[p];
+        if (lane.count == 0) {
+            continue;
+        }
+        lane.credit += static_cast<int>(PRIORITY_WEIGHTS[p]);
+        total += static_cast<int>(PRIORITY_WEIGHTS[p]);
+        if (!chosen || lane.credit > chosen->credit) {
+            chosen = &lane;
+        }
+    }
+    chosen->credit -= total;
+    QueuedTask* task = chosen->pop_front();
+    if (chosen->count == 0) {
+        chosen->credit = 0;
+    }
+    injection_count--;
+    return task;
+}
+
+// Caller holds injection_mutex
+void ThreadPool::publish_sizes() {
+    injection_size.store(injection_count, std::memory_order_relaxed);
+    urgent_size.store(lanes[HIGH].count, std::memory_order_relaxed);
+}
+
+bool ThreadPool::enqueue(Task task, Priority priority) {
     // Don't accept new tasks if stopping
     if (stop_flag.load()) {
-        return;
+        return false;
     }
     
-    // Add task to queue with thread safety and timeout
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex, std::try_to_lock);
+    QueuedTask* queued = acquire_node(std::move(task), std::chrono::steady_clock::now());
+    if (!push_local(queued)) {
+        std::unique_lock<std::mutex> lock(injection_mutex, std::try_to_lock);
         
         if (!lock.owns_lock()) {
             // If we can't get the lock quickly during shutdown, drop the task
             if (ShutdownCoordinator::instance().is_shutdown_requested()) {
-                return;
+                release_node(queued);
+                return false;
             }
             // Otherwise, block and wait for the lock
             lock.lock();
         }
         
-        if (stop_flag.load()) {
-            return;
+        if (stop_flag.load() || !inject(queued, priority)) {
+            lock.unlock();
+            release_node(queued);
+            return false;
+        }
+        publish_sizes();
+    }
+    SERVER_PROBE1(pool__enqueue, injection_size.load(std::memory_order_relaxed));
+    
+    wake_one();
+    return true;
+}
+
+size_t ThreadPool::enqueue_batch(std::vector<Task> tasks, Priority priority) {
+    if (stop_flag.load() || tasks.empty()) {
+        return 0;
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    size_t next = 0;
+    size_t queued = 0;
+    QueuedTask* overflow = nullptr;
+    while (next < tasks.size() && !overflow) {
+        QueuedTask* node = acquire_node(std::move(tasks[next++]), now);
+        if (push_local(node)) {
+            queued++;
+        } else {
+            overflow = node;
+        }
+    }
+    if (overflow) {
+        QueuedTask* refused = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(injection_mutex);
+            if (stop_flag.load()) {
+                refused = overflow;
+            } else {
+                QueuedTask* node = overflow;
+                while (node) {
+                    if (!inject(node, priority)) {
+                        refused = node;
+                        break;
+                    }
+                    queued++;
+                    node = next < tasks.size() ? acquire_node(std::move(tasks[next++]), now) : nullptr;
+                }
+                // The rest of the batch is past the limit too
+                lanes[priority].rejected.fetch_add(tasks.size() - next, std::memory_order_relaxed);
+                publish_sizes();
+            }
+        }
+        if (refused) {
+            release_node(refused);
         }
-        
-        tasks.push(std::move(task));
     }
+    SERVER_PROBE1(pool__enqueue, injection_size.load(std::memory_order_relaxed));
     
-    // Notify one waiting thread that there's work
-    condition.notify_one();
+    for (size_t i = 0; i < std::min(queued, live_workers.load(std::memory_order_relaxed)); i++) {
+        wake_one();
+    }
+    return queued;
+}
+
+// Pairs with the fences in spin() and park(): either that worker sees the new task, or we
+// see it spinning or parked. A spinning worker will find the task, so nobody is woken.
+void ThreadPool::wake_one() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (spinning.load(std::memory_order_relaxed) > 0) {
+        return;
+    }
+    if (idle_workers.load(std::memory_order_relaxed) == 0) {
+        // Every worker is busy: time for the controller to look at queue wait
+        notify_controller();
+        return;
+    }
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        if (idle_stack.empty()) {
+            notify_controller();
+            return;
+        }
+        // The most recently parked worker has the warmest cache
+        index = idle_stack.back();
+        idle_stack.pop_back();
+        idle_workers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    parkers[index].state.store(NOTIFIED);
+    futex_wake(parkers[index].state);
+}
+
+void ThreadPool::wake_all() {
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    idle_stack.clear();
+    idle_workers.store(0);
+    for (size_t i = 0; i < workers.size(); ++i) {
+        parkers[i].state.store(NOTIFIED);
+        futex_wake(parkers[i].state);
+    }
 }
 
 void ThreadPool::stop() {
     // Set stop flag first
     stop_flag.store(true);
     
-    // Wake up all threads
-    condition.notify_all();
+    // The controller is the only other thread that starts and joins workers
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        controller_sleeping.store(false);
+        control_cv.notify_all();
+    }
+    if (controller.joinable()) {
+        controller.join();
+    }
+    
+    // Wake up all threads; parked workers only return on an explicit wake
+    wake_all();
     
     // Use coordinated shutdown
     auto& coordinator = ShutdownCoordinator::instance();
@@ -65,6 +428,7 @@ void ThreadPool::stop() {
     // Wait for workers to finish with timeout
     const auto timeout = std::chrono::seconds(3);
     auto start_time = std::chrono::steady_clock::now();
+    bool all_joined = true;
     
     for (auto& worker : workers) {
         if (worker.joinable()) {
@@ -85,93 +449,367 @@ void ThreadPool::stop() {
             // Thread didn't join in time, detach it
             std::cout << "Worker thread timeout - detaching" << std::endl;
             worker.detach();
+            all_joined = false;
         }
     }
     
-    // Clear task queue
+    // Clear task queues; a detached worker may still own its deque
     {
-        std::unique_lock<std::mutex> lock(queue_mutex, std::try_to_lock);
+        std::unique_lock<std::mutex> lock(injection_mutex, std::try_to_lock);
         
         if (lock.owns_lock()) {
-            std::queue<std::function<void()>> empty_queue;
-            tasks.swap(empty_queue);
+            while (injection_count > 0) {
+                release_node(take_front(HIGH));
+            }
+            publish_sizes();
         } else {
             std::cout << "Warning: Could not clear task queue" << std::endl;
         }
     }
+    if (all_joined) {
+        for (auto& deque : deques) {
+            while (QueuedTask* task = deque->pop()) {
+                release_node(task);
+            }
+        }
+    }
     
     std::cout << "Thread pool stopped" << std::endl;
 }
 
 size_t ThreadPool::get_thread_count() const {
-    return workers.size();
+    return live_workers.load(std::memory_order_relaxed);
+}
+
+ThreadPool::LaneStats ThreadPool::get_lane_stats(Priority priority) const {
+    std::lock_guard<std::mutex> lock(injection_mutex);
+    const Lane& lane = lanes[priority];
+    return LaneStats{lane.count, lane.limit, lane.rejected.load(std::memory_order_relaxed)};
+}
+
+ThreadPool::ScalingStats ThreadPool::get_scaling_stats() const {
+    ScalingStats stats;
+    stats.min_threads = scaling.min_threads;
+    stats.max_threads = scaling.max_threads;
+    stats.started = started.load(std::memory_order_relaxed);
+    stats.retired = retired.load(std::memory_order_relaxed);
+    stats.saturated = saturated.load(std::memory_order_relaxed);
+    stats.last_wait_ms = last_wait.load(std::memory_order_relaxed) / 1e6;
+    return stats;
 }
 
 size_t ThreadPool::get_queue_size() const {
-    std::unique_lock<std::mutex> lock(queue_mutex, std::try_to_lock);
-    
-    if (lock.owns_lock()) {
-        return tasks.size();
+    size_t depth = injection_size.load(std::memory_order_relaxed);
+    for (const auto& deque : deques) {
+        depth += deque->size();
     }
-    
-    // If we can't get the lock quickly, return approximate size
-    return 0;
+    return depth;
+}
+
+bool ThreadPool::has_work() const {
+    if (injection_size.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+    size_t limit = slot_limit.load(std::memory_order_acquire);
+    for (size_t i = 0; i < limit; i++) {
+        if (deques[i]->size() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Own deque first (newest task, warm cache), then the injection queue, then other workers.
+// A waiting HIGH task moves the injection queue to the front.
+ThreadPool::QueuedTask* ThreadPool::find_task(size_t index) {
+    if (urgent_size.load(std::memory_order_relaxed) > 0) {
+        if (QueuedTask* task = take_injected()) {
+            return task;
+        }
+    }
+    if (QueuedTask* task = deques[index]->pop()) {
+        return task;
+    }
+    if (QueuedTask* task = take_injected()) {
+        return task;
+    }
+    return steal(index);
+}
+
+// Takes one injected task per lock. Injected tasks are never moved into a deque: the deque
+// runs newest first, which would reverse accept order and leave the oldest connection
+// behind the ones that came after it. The rest stay queued for whichever worker is free.
+ThreadPool::QueuedTask* ThreadPool::take_injected() {
+    if (injection_size.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(injection_mutex);
+    if (injection_count == 0) {
+        return nullptr;
+    }
+    QueuedTask* task = take_front(HIGH);
+    publish_sizes();
+    return task;
+}
+
+// One pass over the other workers from a random start; a lost race moves on to the next
+ThreadPool::QueuedTask* ThreadPool::steal(size_t index) {
+    size_t count = slot_limit.load(std::memory_order_acquire);
+    size_t start = next_random() % count;
+    for (size_t i = 0; i < count; i++) {
+        size_t victim = (start + i) % count;
+        if (victim == index) {
+            continue;
+        }
+        if (QueuedTask* task = deques[victim]->steal()) {
+            return task;
+        }
+    }
+    return nullptr;
 }
 
-void ThreadPool::worker() {
+void ThreadPool::run(QueuedTask* queued) {
     auto& coordinator = ShutdownCoordinator::instance();
+    auto waited = std::chrono::steady_clock::now() - queued->enqueued;
+    ServerMetrics::instance().record_queue_wait(waited);
+    if (scaling.max_threads > scaling.min_threads) {
+        int64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count();
+        int64_t longest = max_wait.load(std::memory_order_relaxed);
+        while (nanos > longest && !max_wait.compare_exchange_weak(longest, nanos, std::memory_order_relaxed)) {
+        }
+    }
+    SERVER_PROBE2(pool__dequeue, std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+                  injection_size.load(std::memory_order_relaxed));
     
-    // Each thread runs this function
-    while (!stop_flag.load() && !coordinator.is_shutdown_requested()) {
-        std::function<void()> task;
-        
-        // Get next task from queue
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            
-            // Wait for work or stop signal with timeout
-            bool has_work = condition.wait_for(lock, std::chrono::milliseconds(100), 
-                                             [this, &coordinator] { 
-                                                 return stop_flag.load() || 
-                                                        coordinator.is_shutdown_requested() || 
-                                                        !tasks.empty(); 
-                                             });
-            
-            // Exit if stopping
-            if (stop_flag.load() || coordinator.is_shutdown_requested()) {
-                break;
+    // Execute task outside of any lock
+    if (queued->function) {
+        try {
+            queued->function();
+        } catch (const std::exception& e) {
+            if (!coordinator.is_shutdown_requested()) {
+                LOG_ERROR(LogModule::POOL, "Worker thread exception: " << e.what());
             }
-            
-            // Get task from queue if available
-            if (has_work && !tasks.empty()) {
-                task = std::move(tasks.front());
-                tasks.pop();
-            } else {
-                continue; // No task available, continue waiting
+        } catch (...) {
+            if (!coordinator.is_shutdown_requested()) {
+                LOG_ERROR(LogModule::POOL, "Worker thread unknown exception");
             }
         }
-        
-        // Execute task outside of lock
+    }
+    release_node(queued);
+}
+
+// Keeps looking for a few microseconds before parking, so a task enqueued right after
+// this worker ran dry is picked up without a futex wake. At most half the workers spin.
+ThreadPool::QueuedTask* ThreadPool::spin(size_t index) {
+    if (spinning.load(std::memory_order_relaxed) >= std::max<size_t>(1, live_workers.load(std::memory_order_relaxed) / 2)) {
+        return nullptr;
+    }
+    spinning.fetch_add(1);
+    QueuedTask* task = nullptr;
+    for (int round = 0; round < SPIN_ROUNDS && !task && !stop_flag.load(std::memory_order_relaxed); round++) {
+        cpu_relax();
+        task = find_task(index);
+    }
+    size_t still_spinning = spinning.fetch_sub(1) - 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (task && still_spinning == 0 && has_work()) {
+        // Enqueuers skipped the wake while we spun; hand the rest to a parked worker
+        wake_one();
+    }
+    return task;
+}
+
+// Parks until wake_one() picks this worker, the controller retires it or wake_all() runs.
+// Registering on the idle stack comes before the last look at the queues, so an enqueue
+// in between wakes us.
+void ThreadPool::park(size_t index) {
+    Parker& parker = parkers[index];
+    parker.state.store(PARKED);
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        if (parker.retire.load()) {
+            parker.state.store(RUNNING);
+            return;
+        }
+        parker.parked_since.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        idle_stack.push_back(index);
+        idle_workers.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!has_work() && !stop_flag.load()) {
+        while (parker.state.load() == PARKED) {
+            futex_wait(parker.state, PARKED);
+        }
+    }
+    parker.state.store(RUNNING);
+    
+    // Still registered if we woke for another reason (work found on the last look)
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    for (size_t i = 0; i < idle_stack.size(); i++) {
+        if (idle_stack[i] == index) {
+            idle_stack.erase(idle_stack.begin() + i);
+            idle_workers.fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+}
+
+void ThreadPool::worker(size_t index) {
+    auto& coordinator = ShutdownCoordinator::instance();
+    ProcessStats::register_thread("worker");
+    current_pool = this;
+    current_index = index;
+    
+    // Each thread runs this function until stop() wakes it with stop_flag set
+    while (!stop_flag.load()) {
+        QueuedTask* task = find_task(index);
+        if (!task) {
+            task = spin(index);
+        }
         if (task) {
-            try {
-                task();
-            } catch (const std::exception& e) {
-                if (!coordinator.is_shutdown_requested()) {
-                    std::cerr << "Worker thread exception: " << e.what() << std::endl;
-                }
-            } catch (...) {
-                if (!coordinator.is_shutdown_requested()) {
-                    std::cerr << "Worker thread unknown exception" << std::endl;
-                }
+            run(task);
+            
+            // Check if we should exit early due to shutdown
+            if (coordinator.is_shutdown_requested()) {
+                break;
             }
+            continue;
         }
-        
-        // Check if we should exit early due to shutdown
-        if (coordinator.is_shutdown_requested()) {
+        park(index);
+        if (parkers[index].retire.load()) {
+            // Retired while parked; our deque is empty, since only we push to it
             break;
         }
     }
     
+    current_pool = nullptr;
+    
     // Notify coordinator that this thread is exiting
     coordinator.thread_exiting();
-}
\ No newline at end of file
+}
+
+// Caller holds control_mutex
+void ThreadPool::start_worker(size_t index) {
+    parkers[index].retire.store(false);
+    parkers[index].state.store(RUNNING);
+    if (slot_limit.load() < index + 1) {
+        slot_limit.store(index + 1, std::memory_order_release);
+    }
+    live_workers.fetch_add(1);
+    workers[index] = std::thread(&ThreadPool::worker, this, index);
+}
+
+void ThreadPool::notify_controller() {
+    if (controller_sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        controller_sleeping.store(false);
+        control_cv.notify_one();
+    }
+}
+
+// Age of the oldest task in the injection queue; these wait for any worker to free up
+std::chrono::steady_clock::duration ThreadPool::oldest_wait(std::chrono::steady_clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(injection_mutex);
+    auto oldest = std::chrono::steady_clock::duration::zero();
+    for (const Lane& lane : lanes) {
+        if (lane.count > 0) {
+            oldest = std::max(oldest, now - lane.ring[lane.head]->enqueued);
+        }
+    }
+    return oldest;
+}
+
+// Caller holds control_mutex; takes the lowest free slot
+bool ThreadPool::grow() {
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (!workers[i].joinable()) {
+            start_worker(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Caller holds control_mutex. The bottom of the idle stack parked first, and wake_one()
+// only takes from the top, so it is the coldest worker.
+bool ThreadPool::retire_one(std::chrono::steady_clock::time_point now) {
+    if (live_workers.load() <= scaling.min_threads) {
+        return false;
+    }
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        if (idle_stack.empty()) {
+            return false;
+        }
+        index = idle_stack.front();
+        auto parked = std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(parkers[index].parked_since.load(std::memory_order_relaxed)));
+        if (now - parked < scaling.idle_cooldown) {
+            return false;
+        }
+        idle_stack.erase(idle_stack.begin());
+        idle_workers.fetch_sub(1, std::memory_order_relaxed);
+        // Under idle_mutex, so the worker sees it before it could park again
+        parkers[index].retire.store(true);
+    }
+    parkers[index].state.store(NOTIFIED);
+    futex_wake(parkers[index].state);
+    workers[index].join();
+    live_workers.fetch_sub(1);
+    
+    size_t limit = slot_limit.load();
+    while (limit > 0 && !workers[limit - 1].joinable()) {
+        limit--;
+    }
+    slot_limit.store(limit, std::memory_order_release);
+    return true;
+}
+
+// Elastic pools only. While some worker is parked an enqueue wakes that worker, so the
+// controller sleeps: every RETIRE_INTERVAL_MS above min_threads, until notified at it.
+// Otherwise it checks queue wait every SCALE_INTERVAL_MS.
+void ThreadPool::control() {
+    ProcessStats::register_thread("background");
+    std::unique_lock<std::mutex> lock(control_mutex);
+    auto notified = [this]() { return stop_flag.load() || !controller_sleeping.load(); };
+    while (!stop_flag.load()) {
+        if (idle_workers.load() > 0) {
+            controller_sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (idle_workers.load() == 0) {
+                // Lost the race with the last idle worker being woken
+            } else if (live_workers.load() > scaling.min_threads) {
+                control_cv.wait_for(lock, std::chrono::milliseconds(RETIRE_INTERVAL_MS), notified);
+            } else {
+                control_cv.wait(lock, notified);
+            }
+            controller_sleeping.store(false);
+        } else {
+            control_cv.wait_for(lock, std::chrono::milliseconds(SCALE_INTERVAL_MS), [this]() { return stop_flag.load(); });
+        }
+        if (stop_flag.load()) {
+            break;
+        }
+        
+        // Waits already finished since the last check, or still going on in the queue
+        auto now = std::chrono::steady_clock::now();
+        auto waited = std::max<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds(max_wait.exchange(0, std::memory_order_relaxed)), oldest_wait(now));
+        last_wait.store(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(), std::memory_order_relaxed);
+        
+        if (waited > scaling.target_wait) {
+            if (grow()) {
+                started.fetch_add(1, std::memory_order_relaxed);
+                LOG_DEBUG(LogModule::POOL, "Started a worker after a "
+                          << std::chrono::duration_cast<std::chrono::microseconds>(waited).count()
+                          << " us queue wait, " << live_workers.load() << " now");
+            } else {
+                saturated.fetch_add(1, std::memory_order_relaxed);
+            }
+        } else if (retire_one(now)) {
+            retired.fetch_add(1, std::memory_order_relaxed);
+            LOG_DEBUG(LogModule::POOL, "Retired an idle worker, " << live_workers.load() << " left");
+        }
+    }
+}
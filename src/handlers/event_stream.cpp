@@ -0,0 +1,315 @@
+#include "../../include/handlers/event_stream.h"
+#include "../../include/core/server_metrics.h"
+#include "../../include/core/process_stats.h"
+#include "../../include/core/log.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+const size_t EventStreamHub::DEFAULT_MAX_PENDING;
+const int EventStreamHub::HEARTBEAT_SECONDS;
+const int EventStreamHub::RETRY_MS;
+
+// EventStreamSubscriber Implementation
+EventStreamSubscriber::EventStreamSubscriber(int notify_fd, size_t max_pending)
+    : closed(false), notify_fd(notify_fd), max_pending(max_pending) {}
+
+bool EventStreamSubscriber::push(const std::string& event) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) {
+            return false;
+        }
+        if (pending.size() + event.size() > max_pending) {
+            closed = true;
+            pending.clear();
+        } else {
+            pending += event;
+        }
+    }
+    notify();
+    return !is_closed();
+}
+
+bool EventStreamSubscriber::take(std::string& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pending.empty()) {
+        out += pending;
+        pending.clear();
+        return true;
+    }
+    return !closed;
+}
+
+void EventStreamSubscriber::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    notify();
+}
+
+bool EventStreamSubscriber::is_closed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return closed;
+}
+
+void EventStreamSubscriber::notify() {
+    if (notify_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(notify_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+// EventStreamHub Implementation
+EventStreamHub::EventStreamHub() : wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+EventStreamHub::~EventStreamHub() {
+    stop();
+    if (wake_fd >= 0) {
+        close(wake_fd);
+    }
+}
+
+void EventStreamHub::set_replay(std::function<std::string(const std::string&)> replay_fn) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    replay = replay_fn;
+}
+
+std::string EventStreamHub::format_event(uint64_t id, const std::string& data) {
+    std::string event = "id: " + std::to_string(id) + "\n";
+    size_t start = 0;
+    while (true) {
+        size_t end = data.find('\n', start);
+        event += "data: ";
+        event.append(data, start, end == std::string::npos ? std::string::npos : end - start);
+        event += "\n";
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    event += "\n";
+    return event;
+}
+
+std::shared_ptr<EventStreamSubscriber> EventStreamHub::subscribe(const std::string& last_event_id, int notify_fd) {
+    auto subscriber = std::make_shared<EventStreamSubscriber>(notify_fd, DEFAULT_MAX_PENDING);
+
+    // Replay and registration happen under the lock so no published event falls between them
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    std::string initial = "retry: " + std::to_string(RETRY_MS) + "\n\n";
+    if (replay) {
+        initial += replay(last_event_id);
+    }
+    subscriber->push(initial);
+    subscribers.push_back(subscriber);
+    return subscriber;
+}
+
+void EventStreamHub::publish(uint64_t id, const std::string& data) {
+    std::string event = format_event(id, data);
+
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    auto it = subscribers.begin();
+    while (it != subscribers.end()) {
+        auto subscriber = it->lock();
+        if (!subscriber || !subscriber->push(event)) {
+            it = subscribers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t EventStreamHub::subscriber_count() const {
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    return static_cast<size_t>(std::count_if(subscribers.begin(), subscribers.end(),
+        [](const std::weak_ptr<EventStreamSubscriber>& weak) {
+            auto subscriber = weak.lock();
+            return subscriber && !subscriber->is_closed();
+        }));
+}
+
+bool EventStreamHub::attach_socket(int socket, const std::string& last_event_id) {
+    if (!running.load()) {
+        return false;
+    }
+
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags < 0 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return false;
+    }
+
+    SocketClient client;
+    client.socket = socket;
+    client.offset = 0;
+    client.output = "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/event-stream\r\n"
+                    "Cache-Control: no-cache\r\n"
+                    "Connection: keep-alive\r\n"
+                    "X-Accel-Buffering: no\r\n"
+                    "Access-Control-Allow-Origin: *\r\n"
+                    "\r\n";
+    client.subscriber = subscribe(last_event_id, wake_fd);
+
+    {
+        std::lock_guard<std::mutex> lock(attach_mutex);
+        attached.push_back(std::move(client));
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+    return true;
+}
+
+void EventStreamHub::start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    writer_thread = std::thread([this]() {
+        ProcessStats::register_thread("background");
+        this->writer_loop();
+    });
+}
+
+void EventStreamHub::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+    if (writer_thread.joinable()) {
+        writer_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(attach_mutex);
+    for (auto& client : attached) {
+        close_client(client);
+    }
+    attached.clear();
+}
+
+// Single thread serving every HTTP/1.1 event stream socket with non-blocking writes
+void EventStreamHub::writer_loop() {
+    std::vector<SocketClient> clients;
+    std::vector<pollfd> fds;
+    auto last_heartbeat = std::chrono::steady_clock::now();
+
+    while (running.load()) {
+        {
+            std::lock_guard<std::mutex> lock(attach_mutex);
+            for (auto& client : attached) {
+                clients.push_back(std::move(client));
+            }
+            attached.clear();
+        }
+
+        fds.clear();
+        fds.push_back({wake_fd, POLLIN, 0});
+        for (const auto& client : clients) {
+            short events = POLLIN;
+            if (client.output.size() > client.offset) {
+                events |= POLLOUT;
+            }
+            fds.push_back({client.socket, events, 0});
+        }
+
+        int ready = poll(fds.data(), fds.size(), 1000);
+        if (ready < 0 && errno != EINTR) {
+            LOG_ERROR(LogModule::EVENTS, "Event stream poll failed: " << strerror(errno));
+            break;
+        }
+        if (!running.load()) {
+            break;
+        }
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            uint64_t count;
+            ssize_t ignored = read(wake_fd, &count, sizeof(count));
+            (void)ignored;
+        }
+
+        // Comment lines keep idle proxies from timing out and reveal dead clients
+        auto now = std::chrono::steady_clock::now();
+        bool heartbeat = now - last_heartbeat >= std::chrono::seconds(HEARTBEAT_SECONDS);
+        if (heartbeat) {
+            last_heartbeat = now;
+        }
+
+        // fds[slot] belongs to the client at i; erasing a client advances slot but not i
+        for (size_t i = 0, slot = 1; i < clients.size(); slot++) {
+            SocketClient& client = clients[i];
+            short revents = slot < fds.size() ? fds[slot].revents : 0;
+            bool alive = (revents & (POLLERR | POLLHUP | POLLNVAL)) == 0;
+
+            if (alive && (revents & POLLIN)) {
+                // Clients never send after the request; data or EOF here means it went away
+                char discard[512];
+                ssize_t n = recv(client.socket, discard, sizeof(discard), MSG_DONTWAIT);
+                alive = n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+            }
+
+            if (alive) {
+                // New events are only taken once the previous batch is written, so a stalled
+                // socket leaves them queued in the subscriber, which enforces the backlog limit
+                bool open = !client.output.empty() || client.subscriber->take(client.output);
+                if (heartbeat && open && client.output.empty()) {
+                    client.output = ": ping\n\n";
+                }
+                alive = open && write_client(client);
+            }
+
+            if (alive) {
+                ++i;
+            } else {
+                close_client(client);
+                clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+    }
+
+    for (auto& client : clients) {
+        close_client(client);
+    }
+}
+
+bool EventStreamHub::write_client(SocketClient& client) {
+    while (client.output.size() > client.offset) {
+        ssize_t sent = send(client.socket, client.output.data() + client.offset,
+                            client.output.size() - client.offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true; // Socket buffer full; poll() reports POLLOUT
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ServerMetrics::instance().add_bytes_sent(static_cast<size_t>(sent));
+        client.offset += static_cast<size_t>(sent);
+    }
+    client.output.clear();
+    client.offset = 0;
+    return true;
+}
+
+void EventStreamHub::close_client(SocketClient& client) {
+    if (client.subscriber) {
+        client.subscriber->close();
+    }
+    if (client.socket >= 0) {
+        shutdown(client.socket, SHUT_RDWR);
+        close(client.socket);
+        client.socket = -1;
+    }
+}
@@ -1,9 +1,19 @@
 #include "../../include/handlers/http2_handler.h"
 #include "../../include/handlers/file_handler.h"
+#include "../../include/handlers/websocket_handler.h"
+#include "../../include/core/server_metrics.h"
+#include "../../include/core/route_stats.h"
+#include "../../include/core/otlp_exporter.h"
+#include "../../include/core/access_log.h"
+#include "../../include/core/flight_recorder.h"
+#include "../../include/core/log.h"
+#include "../../include/core/probes.h"
 #include <iostream>
 #include <cstring>
 #include <sys/socket.h>
 #include <algorithm>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 const char HTTP2_CONNECTION_PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
 
@@ -12,13 +22,23 @@ HTTP2Handler::HTTP2Handler(int socket_fd, std::shared_ptr<FileHandler> file_hand
                            const std::string& doc_root, SSL* ssl)
     : session(nullptr), socket_fd(socket_fd), file_handler(file_handler),
       performance_metrics(metrics), document_root(doc_root), 
-      ssl_connection(ssl), is_tls_connection(ssl != nullptr), preface_processed(false) {
+      wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      ssl_connection(ssl), is_tls_connection(ssl != nullptr), preface_processed(false),
+      peer(AccessLog::instance().is_enabled() ? AccessLog::peer_address(socket_fd) : ""),
+      connection_id(FlightRecorder::next_connection_id()) {
 }
 
 HTTP2Handler::~HTTP2Handler() {
+    // Streams still open when the connection goes away
+    for (size_t i = 0; i < streams.size(); i++) {
+        ServerMetrics::instance().http2_stream_closed();
+    }
     if (session) {
         nghttp2_session_del(session);
     }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+    }
 }
 
 bool HTTP2Handler::initialize() {
@@ -29,6 +49,7 @@ bool HTTP2Handler::initialize() {
     nghttp2_session_callbacks_set_send_callback(callbacks, send_callback);
     nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, on_frame_recv_callback);
     nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, on_stream_close_callback);
+    nghttp2_session_callbacks_set_on_begin_headers_callback(callbacks, on_begin_headers_callback);
     nghttp2_session_callbacks_set_on_header_callback(callbacks, on_header_callback);
     nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, on_data_chunk_recv_callback);
     nghttp2_session_callbacks_set_on_frame_send_callback(callbacks, on_frame_send_callback);
@@ -38,7 +59,7 @@ bool HTTP2Handler::initialize() {
     nghttp2_session_callbacks_del(callbacks);
     
     if (rv != 0) {
-        std::cerr << "Failed to create HTTP/2 session: " << nghttp2_strerror(rv) << std::endl;
+        LOG_ERROR(LogModule::HTTP2, "Failed to create session: " << nghttp2_strerror(rv));
         return false;
     }
     
@@ -54,14 +75,14 @@ bool HTTP2Handler::send_settings() {
         {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, 100},
         {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, 65536},
         {NGHTTP2_SETTINGS_MAX_FRAME_SIZE, 16384},
-        {NGHTTP2_SETTINGS_ENABLE_PUSH, 1},
+        // ENABLE_PUSH is a client-only setting; clients reject a server that sends it
         {NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE, 8192}
     };
     
     int rv = nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, settings, 
                                     sizeof(settings) / sizeof(settings[0]));
     if (rv != 0) {
-        std::cerr << "Failed to submit settings: " << nghttp2_strerror(rv) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to submit settings: " << nghttp2_strerror(rv));
         return false;
     }
     
@@ -69,23 +90,9 @@ bool HTTP2Handler::send_settings() {
 }
 
 int HTTP2Handler::process_data(const uint8_t* data, size_t len) {
-    // For TLS connections, the preface is handled differently by nghttp2
-    if (!is_tls_connection) {
-        // Check if this is the HTTP/2 connection preface for non-TLS connections
-        if (!preface_processed && len >= 24 && memcmp(data, HTTP2_CONNECTION_PREFACE, 24) == 0) {
-            // Skip the preface and process any remaining data
-            data += 24;
-            len -= 24;
-            preface_processed = true;
-            
-            if (len == 0) {
-                return 24; // Just the preface, nothing more to process
-            }
-        }
-    } else {
-        // For TLS connections, mark preface as processed (handled by nghttp2 internally)
-        preface_processed = true;
-    }
+    // nghttp2 server sessions validate the client connection preface themselves, so it is
+    // passed through unchanged for both prior-knowledge h2c and TLS connections
+    preface_processed = true;
     
     if (len == 0) {
         return 0;
@@ -93,7 +100,7 @@ int HTTP2Handler::process_data(const uint8_t* data, size_t len) {
     
     ssize_t readlen = nghttp2_session_mem_recv(session, data, len);
     if (readlen < 0) {
-        std::cerr << "Failed to process HTTP/2 data: " << nghttp2_strerror(readlen) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to process data: " << nghttp2_strerror(readlen));
         return -1;
     }
     
@@ -101,13 +108,13 @@ int HTTP2Handler::process_data(const uint8_t* data, size_t len) {
         return -1;
     }
     
-    return readlen + (!is_tls_connection && preface_processed ? 24 : 0);
+    return readlen;
 }
 
 bool HTTP2Handler::flush_output() {
     int rv = nghttp2_session_send(session);
     if (rv != 0) {
-        std::cerr << "Failed to send HTTP/2 data: " << nghttp2_strerror(rv) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to send data: " << nghttp2_strerror(rv));
         return false;
     }
     
@@ -120,18 +127,20 @@ bool HTTP2Handler::flush_output() {
             if (sent <= 0) {
                 int ssl_error = SSL_get_error(ssl_connection, sent);
                 if (ssl_error != SSL_ERROR_WANT_WRITE && ssl_error != SSL_ERROR_WANT_READ) {
-                    std::cerr << "Failed to send data over SSL: " << ssl_error << std::endl;
+                    LOG_WARN(LogModule::HTTP2, "Failed to send data over SSL: " << ssl_error);
                     return false;
                 }
                 return true; // Will retry later
             }
+            ServerMetrics::instance().add_bytes_sent(static_cast<size_t>(sent));
         } else {
             // Send over regular socket
             sent = send(socket_fd, output_buffer.data(), output_buffer.size(), 0);
             if (sent < 0) {
-                std::cerr << "Failed to send data to socket" << std::endl;
+                LOG_WARN(LogModule::HTTP2, "Failed to send data to socket");
                 return false;
             }
+            ServerMetrics::instance().add_bytes_sent(static_cast<size_t>(sent));
         }
         output_buffer.clear();
     }
@@ -165,18 +174,22 @@ int HTTP2Handler::on_frame_recv_callback(nghttp2_session *session,
     switch (frame->hd.type) {
         case NGHTTP2_HEADERS:
             if (frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
-                auto stream = std::make_unique<HTTP2Stream>(frame->hd.stream_id);
+                // The stream was created in on_begin_headers_callback and holds the headers
+                auto it = handler->streams.find(frame->hd.stream_id);
+                if (it == handler->streams.end()) {
+                    break;
+                }
+                HTTP2Stream* stream = it->second.get();
                 if (frame->hd.flags & NGHTTP2_FLAG_END_HEADERS) {
                     stream->headers_complete = true;
                 }
                 if (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) {
                     stream->request_complete = true;
                 }
-                handler->streams[frame->hd.stream_id] = std::move(stream);
                 
                 // Process request if complete
-                if (handler->streams[frame->hd.stream_id]->request_complete) {
-                    handler->process_request(handler->streams[frame->hd.stream_id].get());
+                if (stream->request_complete) {
+                    handler->process_request(stream);
                 }
             }
             break;
@@ -196,15 +209,15 @@ int HTTP2Handler::on_frame_recv_callback(nghttp2_session *session,
             break;
         case NGHTTP2_SETTINGS:
             if (frame->hd.flags & NGHTTP2_FLAG_ACK) {
-                std::cout << "Received SETTINGS ACK" << std::endl;
+                LOG_TRACE(LogModule::HTTP2, "Received SETTINGS ACK");
             }
             break;
         case NGHTTP2_WINDOW_UPDATE:
-            std::cout << "Received WINDOW_UPDATE for stream " << frame->hd.stream_id 
-                     << " increment: " << frame->window_update.window_size_increment << std::endl;
+            LOG_TRACE(LogModule::HTTP2, "Received WINDOW_UPDATE for stream " << frame->hd.stream_id
+                      << " increment: " << frame->window_update.window_size_increment);
             break;
         case NGHTTP2_GOAWAY:
-            std::cout << "Received GOAWAY frame" << std::endl;
+            LOG_DEBUG(LogModule::HTTP2, "Received GOAWAY frame");
             return NGHTTP2_ERR_CALLBACK_FAILURE; // Signal to close connection
         case NGHTTP2_PRIORITY:
             handler->handle_priority_frame(frame);
@@ -220,10 +233,48 @@ int HTTP2Handler::on_frame_recv_callback(nghttp2_session *session,
 int HTTP2Handler::on_stream_close_callback(nghttp2_session *session, int32_t stream_id,
                                           uint32_t error_code, void *user_data) {
     (void)session;
-    (void)error_code;
     
     HTTP2Handler* handler = static_cast<HTTP2Handler*>(user_data);
-    handler->streams.erase(stream_id);
+    auto it = handler->streams.find(stream_id);
+    if (it != handler->streams.end()) {
+        HTTP2Stream* stream = it->second.get();
+        SERVER_PROBE4(response__sent, handler->socket_fd, stream_id, stream->status_code, stream->response_data_sent);
+        // Event streams stay open for as long as the subscriber wants; they are not slow requests
+        if (!stream->method.empty() && !stream->events) {
+            FlightRecorder::Record flight = {};
+            flight.connection_id = handler->connection_id;
+            flight.protocol = FlightRecorder::HTTP2;
+            flight.stream_id = stream_id;
+            flight.first_byte_ns = FlightRecorder::nanos(stream->start_time);
+            flight.parsed_ns = FlightRecorder::nanos(stream->parsed_time);
+            flight.handled_ns = FlightRecorder::nanos(stream->handled_time);
+            flight.finished_ns = FlightRecorder::nanos(std::chrono::steady_clock::now());
+            flight.status = error_code == 0 ? static_cast<uint16_t>(stream->status_code) : 0;
+            flight.bytes_received = stream->body.size();
+            flight.bytes_sent = stream->response_data_sent;
+            flight.set_request(stream->method, stream->path);
+            FlightRecorder::instance().record(flight);
+            auto traceparent = stream->headers.find("traceparent");
+            OtlpExporter::instance().record(flight, traceparent != stream->headers.end() ? traceparent->second : "");
+        }
+        handler->streams.erase(it);
+        ServerMetrics::instance().http2_stream_closed();
+    }
+    SERVER_PROBE3(http2__stream__close, handler->socket_fd, stream_id, error_code);
+    return 0;
+}
+
+int HTTP2Handler::on_begin_headers_callback(nghttp2_session *session, const nghttp2_frame *frame,
+                                             void *user_data) {
+    (void)session;
+    
+    // Header callbacks for a request arrive before its HEADERS frame completes
+    HTTP2Handler* handler = static_cast<HTTP2Handler*>(user_data);
+    if (frame->hd.type == NGHTTP2_HEADERS && frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
+        handler->streams[frame->hd.stream_id] = std::make_unique<HTTP2Stream>(frame->hd.stream_id);
+        ServerMetrics::instance().http2_stream_opened();
+        SERVER_PROBE2(http2__stream__open, handler->socket_fd, frame->hd.stream_id);
+    }
     return 0;
 }
 
@@ -278,17 +329,17 @@ int HTTP2Handler::on_frame_send_callback(nghttp2_session *session,
     
     switch (frame->hd.type) {
         case NGHTTP2_HEADERS:
-            std::cout << "Sent HEADERS frame for stream " << frame->hd.stream_id << std::endl;
+            LOG_TRACE(LogModule::HTTP2, "Sent HEADERS frame for stream " << frame->hd.stream_id);
             break;
         case NGHTTP2_DATA:
-            std::cout << "Sent DATA frame for stream " << frame->hd.stream_id 
-                     << " length: " << frame->data.hd.length << std::endl;
+            LOG_TRACE(LogModule::HTTP2, "Sent DATA frame for stream " << frame->hd.stream_id
+                      << " length: " << frame->data.hd.length);
             break;
         case NGHTTP2_SETTINGS:
             if (frame->hd.flags & NGHTTP2_FLAG_ACK) {
-                std::cout << "Sent SETTINGS ACK" << std::endl;
+                LOG_TRACE(LogModule::HTTP2, "Sent SETTINGS ACK");
             } else {
-                std::cout << "Sent SETTINGS frame" << std::endl;
+                LOG_TRACE(LogModule::HTTP2, "Sent SETTINGS frame");
             }
             break;
         default:
@@ -303,8 +354,7 @@ int HTTP2Handler::on_error_callback(nghttp2_session *session, const char *msg,
     (void)session;
     (void)user_data;
     
-    std::string error_msg(msg, len);
-    std::cerr << "HTTP/2 error: " << error_msg << std::endl;
+    LOG_WARN(LogModule::HTTP2, "Session error: " << std::string(msg, len));
     
     return 0;
 }
@@ -317,6 +367,20 @@ ssize_t HTTP2Handler::data_source_read_callback(nghttp2_session *session, int32_
     
     HTTP2Stream* stream = static_cast<HTTP2Stream*>(source->ptr);
     
+    // Event streams refill the body from their subscriber and pause while it is empty
+    if (stream->events && stream->response_data_sent >= stream->response_body.length()) {
+        stream->response_body.clear();
+        stream->response_data_sent = 0;
+        if (!stream->events->take(stream->response_body)) {
+            *data_flags = NGHTTP2_DATA_FLAG_EOF;
+            return 0;
+        }
+        if (stream->response_body.empty()) {
+            stream->data_deferred = true;
+            return NGHTTP2_ERR_DEFERRED;
+        }
+    }
+    
     size_t remaining = stream->response_body.length() - stream->response_data_sent;
     size_t copy_len = std::min(length, remaining);
     
@@ -325,7 +389,7 @@ ssize_t HTTP2Handler::data_source_read_callback(nghttp2_session *session, int32_
         stream->response_data_sent += copy_len;
     }
     
-    if (stream->response_data_sent >= stream->response_body.length()) {
+    if (!stream->events && stream->response_data_sent >= stream->response_body.length()) {
         *data_flags = NGHTTP2_DATA_FLAG_EOF;
     }
     
@@ -335,7 +399,7 @@ ssize_t HTTP2Handler::data_source_read_callback(nghttp2_session *session, int32_
 void HTTP2Handler::send_window_update(int32_t stream_id, uint32_t window_size_increment) {
     int rv = nghttp2_submit_window_update(session, NGHTTP2_FLAG_NONE, stream_id, window_size_increment);
     if (rv != 0) {
-        std::cerr << "Failed to submit window update: " << nghttp2_strerror(rv) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to submit window update: " << nghttp2_strerror(rv));
     }
 }
 
@@ -343,8 +407,17 @@ void HTTP2Handler::process_request(HTTP2Stream* stream) {
     if (!stream->request_complete) {
         return;
     }
-    
-    std::cout << "Processing HTTP/2 " << stream->method << " request for " << stream->path << std::endl;
+    stream->parsed_time = std::chrono::steady_clock::now();
+    SERVER_PROBE4(request__parsed, socket_fd, stream->stream_id, stream->method.c_str(), stream->path.c_str());
+    SERVER_PROBE4(handler__start, socket_fd, stream->stream_id, stream->method.c_str(), stream->path.c_str());
+    
+    if (stream->method == "GET" && event_stream &&
+        stream->path.substr(0, stream->path.find('?')) == "/api/metrics/stream") {
+        start_event_stream(stream);
+        SERVER_PROBE3(handler__end, socket_fd, stream->stream_id, stream->status_code);
+        record_request(stream);
+        return;
+    }
     
     // Handle different HTTP methods
     if (stream->method == "GET") {
@@ -390,16 +463,68 @@ void HTTP2Handler::process_request(HTTP2Stream* stream) {
         stream->response_headers["content-type"] = "text/plain";
     }
     
+    stream->handled_time = std::chrono::steady_clock::now();
+    SERVER_PROBE3(handler__end, socket_fd, stream->stream_id, stream->status_code);
+    send_response(stream);
+    record_request(stream);
+}
+
+void HTTP2Handler::record_request(const HTTP2Stream* stream) {
+    double elapsed_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - stream->start_time).count();
+    if (performance_metrics) {
+        performance_metrics->record_request(stream->method, stream->path, stream->status_code, elapsed_ms);
+    }
+    ServerMetrics::instance().record_request(ServerMetrics::route_for(stream->path), ServerMetrics::HTTP2,
+                                             stream->status_code);
+    RouteStats::instance().record(stream->path, stream->status_code, elapsed_ms);
+    AccessLog::instance().record(AccessLog::Request{stream->method, stream->path, &stream->headers, "HTTP/2.0",
+                                                    peer.c_str(), stream->status_code, stream->response_body.size(),
+                                                    elapsed_ms});
+}
+
+void HTTP2Handler::start_event_stream(HTTP2Stream* stream) {
+    stream->status_code = 200;
+    stream->response_headers["content-type"] = "text/event-stream";
+    stream->response_headers["cache-control"] = "no-cache";
+    
+    auto last_event_id = stream->headers.find("last-event-id");
+    stream->events = event_stream->subscribe(
+        last_event_id != stream->headers.end() ? last_event_id->second : "", wake_fd);
     send_response(stream);
 }
 
+bool HTTP2Handler::resume_event_streams() {
+    uint64_t count;
+    ssize_t ignored = read(wake_fd, &count, sizeof(count));
+    (void)ignored;
+    
+    for (auto& entry : streams) {
+        HTTP2Stream* stream = entry.second.get();
+        if (stream->events && stream->data_deferred) {
+            stream->data_deferred = false;
+            nghttp2_session_resume_data(session, stream->stream_id);
+        }
+    }
+    return flush_output();
+}
+
+bool HTTP2Handler::has_event_streams() const {
+    for (const auto& entry : streams) {
+        if (entry.second->events) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void HTTP2Handler::send_response(HTTP2Stream* stream) {
     // Prepare response headers with proper memory management
     std::vector<nghttp2_nv> response_headers;
     std::vector<std::string> header_storage; // Keep strings alive
     
     if (!create_response_headers(stream, response_headers, header_storage)) {
-        std::cerr << "Failed to create response headers" << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to create response headers");
         return;
     }
     
@@ -412,7 +537,7 @@ void HTTP2Handler::send_response(HTTP2Stream* stream) {
                                     response_headers.data(), response_headers.size(),
                                     &data_prd);
     if (rv != 0) {
-        std::cerr << "Failed to submit response: " << nghttp2_strerror(rv) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to submit response: " << nghttp2_strerror(rv));
     }
 }
 
@@ -421,6 +546,8 @@ bool HTTP2Handler::create_response_headers(HTTP2Stream* stream, std::vector<nght
     // Prepare header strings that will stay alive
     header_storage.clear();
     headers.clear();
+    // nghttp2_nv points into these strings, so they must never reallocate
+    header_storage.reserve(4 + 2 * stream->response_headers.size());
     
     // Status header
     header_storage.push_back(":status");
@@ -434,17 +561,19 @@ bool HTTP2Handler::create_response_headers(HTTP2Stream* stream, std::vector<nght
     status_header.flags = NGHTTP2_NV_FLAG_NONE;
     headers.push_back(status_header);
     
-    // Content-Length header
-    header_storage.push_back("content-length");
-    header_storage.push_back(std::to_string(stream->response_body.length()));
-    
-    nghttp2_nv length_header;
-    length_header.name = reinterpret_cast<uint8_t*>(const_cast<char*>(header_storage[header_storage.size()-2].c_str()));
-    length_header.value = reinterpret_cast<uint8_t*>(const_cast<char*>(header_storage[header_storage.size()-1].c_str()));
-    length_header.namelen = header_storage[header_storage.size()-2].length();
-    length_header.valuelen = header_storage[header_storage.size()-1].length();
-    length_header.flags = NGHTTP2_NV_FLAG_NONE;
-    headers.push_back(length_header);
+    // Content-Length header (event streams have no length)
+    if (!stream->events) {
+        header_storage.push_back("content-length");
+        header_storage.push_back(std::to_string(stream->response_body.length()));
+        
+        nghttp2_nv length_header;
+        length_header.name = reinterpret_cast<uint8_t*>(const_cast<char*>(header_storage[header_storage.size()-2].c_str()));
+        length_header.value = reinterpret_cast<uint8_t*>(const_cast<char*>(header_storage[header_storage.size()-1].c_str()));
+        length_header.namelen = header_storage[header_storage.size()-2].length();
+        length_header.valuelen = header_storage[header_storage.size()-1].length();
+        length_header.flags = NGHTTP2_NV_FLAG_NONE;
+        headers.push_back(length_header);
+    }
     
     // Add other response headers
     for (const auto& header : stream->response_headers) {
@@ -491,7 +620,7 @@ void HTTP2Handler::enable_server_push(bool enable) {
     nghttp2_settings_entry setting = {NGHTTP2_SETTINGS_ENABLE_PUSH, enable ? 1u : 0u};
     int rv = nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, &setting, 1);
     if (rv != 0) {
-        std::cerr << "Failed to submit push setting: " << nghttp2_strerror(rv) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to submit push setting: " << nghttp2_strerror(rv));
     }
 }
 
@@ -542,11 +671,11 @@ bool HTTP2Handler::push_resource(int32_t parent_stream_id, const std::string& pa
                                                             push_headers.data(), push_headers.size(), nullptr);
     
     if (promised_stream_id < 0) {
-        std::cerr << "Failed to submit push promise: " << nghttp2_strerror(promised_stream_id) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to submit push promise: " << nghttp2_strerror(promised_stream_id));
         return false;
     }
     
-    std::cout << "Push promise submitted for " << path << " on stream " << promised_stream_id << std::endl;
+    LOG_DEBUG(LogModule::HTTP2, "Push promise submitted for " << path << " on stream " << promised_stream_id);
     
     // Create stream for the pushed resource
     auto pushed_stream = std::make_unique<HTTP2Stream>(promised_stream_id);
@@ -555,6 +684,7 @@ bool HTTP2Handler::push_resource(int32_t parent_stream_id, const std::string& pa
     pushed_stream->headers_complete = true;
     pushed_stream->request_complete = true;
     streams[promised_stream_id] = std::move(pushed_stream);
+    ServerMetrics::instance().http2_stream_opened();
     
     // Process the pushed resource
     process_request(streams[promised_stream_id].get());
@@ -590,7 +720,7 @@ void HTTP2Handler::set_stream_priority(int32_t stream_id, int32_t dependency, in
     
     int rv = nghttp2_submit_priority(session, NGHTTP2_FLAG_NONE, stream_id, &priority_spec);
     if (rv != 0) {
-        std::cerr << "Failed to submit priority: " << nghttp2_strerror(rv) << std::endl;
+        LOG_WARN(LogModule::HTTP2, "Failed to submit priority: " << nghttp2_strerror(rv));
     }
 }
 
@@ -623,8 +753,8 @@ void HTTP2Handler::handle_priority_frame(const nghttp2_frame* frame) {
     
     stream_priorities[frame->hd.stream_id] = priority;
     
-    std::cout << "Updated priority for stream " << frame->hd.stream_id 
+    LOG_TRACE(LogModule::HTTP2, "Updated priority for stream " << frame->hd.stream_id
               << " dependency: " << priority_spec.stream_id
               << " weight: " << priority_spec.weight
-              << " exclusive: " << (priority_spec.exclusive ? "true" : "false") << std::endl;
+              << " exclusive: " << (priority_spec.exclusive ? "true" : "false"));
 }
@@ -0,0 +1,103 @@
+#include "../../include/handlers/latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+const int LatencyHistogram::SUB_BUCKET_BITS;
+const size_t LatencyHistogram::SUB_BUCKET_COUNT;
+const size_t LatencyHistogram::BUCKET_COUNT;
+const uint64_t LatencyHistogram::MAX_VALUE;
+
+LatencyHistogram::LatencyHistogram() : counts(BUCKET_COUNT, 0), total(0) {}
+
+// Bucket = (power of two above the linear range) * 32 + top five bits below the leading one
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+    if (value > MAX_VALUE) {
+        value = MAX_VALUE;
+    }
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - SUB_BUCKET_BITS;
+    size_t sub = static_cast<size_t>(value >> shift) - SUB_BUCKET_COUNT;
+    return SUB_BUCKET_COUNT + static_cast<size_t>(shift) * SUB_BUCKET_COUNT + sub;
+}
+
+uint64_t LatencyHistogram::bucket_lower(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    size_t shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+    size_t sub = (index - SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+    return static_cast<uint64_t>(SUB_BUCKET_COUNT + sub) << shift;
+}
+
+uint64_t LatencyHistogram::bucket_upper(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    size_t shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+    return bucket_lower(index) + (static_cast<uint64_t>(1) << shift) - 1;
+}
+
+void LatencyHistogram::add(size_t index, uint64_t count) {
+    counts[index] += count;
+    total += count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (total == 0) {
+        return 0;
+    }
+    q = std::min(1.0, std::max(0.0, q));
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(total))));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucket_lower(i) + (bucket_upper(i) - bucket_lower(i)) / 2;
+        }
+    }
+    return max();
+}
+
+uint64_t LatencyHistogram::max() const {
+    for (size_t i = BUCKET_COUNT; i > 0; i--) {
+        if (counts[i - 1] > 0) {
+            return bucket_upper(i - 1);
+        }
+    }
+    return 0;
+}
+
+uint64_t LatencyHistogram::count_at_most(uint64_t value) const {
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT && bucket_upper(i) <= value; i++) {
+        count += counts[i];
+    }
+    return count;
+}
+
+// Approximate: each sample counts as the midpoint of its bucket
+double LatencyHistogram::mean() const {
+    if (total == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        if (counts[i] > 0) {
+            double mid = static_cast<double>(bucket_lower(i)) +
+                         static_cast<double>(bucket_upper(i) - bucket_lower(i)) / 2.0;
+            sum += mid * static_cast<double>(counts[i]);
+        }
+    }
+    return sum / static_cast<double>(total);
+}
@@ -0,0 +1,51 @@
+#include "../../include/handlers/metrics_binary.h"
+#include <cstring>
+
+const char* const MetricsBinaryWriter::SUBPROTOCOL = "metrics.bin.v1";
+const uint8_t MetricsBinaryWriter::VERSION;
+const size_t MetricsBinaryWriter::HEADER_SIZE;
+const size_t MetricsBinaryWriter::SYSTEM_SAMPLE_SIZE;
+
+MetricsBinaryWriter::MetricsBinaryWriter(MessageType type, uint16_t count, size_t body_size) {
+    out.reserve(HEADER_SIZE + body_size);
+    put_u8(type);
+    put_u8(VERSION);
+    put_u16(count);
+}
+
+// Byte-by-byte stores keep the output little-endian regardless of host order
+void MetricsBinaryWriter::put_u16(uint16_t value) {
+    put_u8(static_cast<uint8_t>(value));
+    put_u8(static_cast<uint8_t>(value >> 8));
+}
+
+void MetricsBinaryWriter::put_u32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        put_u8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void MetricsBinaryWriter::put_u64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        put_u8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void MetricsBinaryWriter::put_f32(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_u32(bits);
+}
+
+const char* MetricsBinaryWriter::type_name(const std::string& payload) {
+    if (payload.empty()) {
+        return "";
+    }
+    switch (static_cast<uint8_t>(payload[0])) {
+        case METRICS: return "metrics";
+        case REQUEST_RATE: return "request_rate";
+        case SYSTEM_METRICS: return "system_metrics";
+        case SYSTEM_METRICS_DELTA: return "system_metrics_delta";
+        default: return "";
+    }
+}
@@ -0,0 +1,306 @@
+#include "../../include/handlers/metrics_history.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+const int64_t MetricsHistory::CHUNK_MS;
+const int64_t MetricsHistory::RETENTION_MS;
+const size_t MetricsHistory::MAX_POINTS;
+
+void BitStream::write(uint64_t value, int count) {
+    if (count == 0) {
+        return;
+    }
+    if (count < 64) {
+        value &= (uint64_t(1) << count) - 1;
+    }
+    int offset = static_cast<int>(bits % 64);
+    if (offset == 0) {
+        words.push_back(0);
+    }
+    int space = 64 - offset;
+    if (count <= space) {
+        words.back() |= value << (space - count);
+    } else {
+        int rest = count - space;
+        words.back() |= value >> rest;
+        words.push_back(value << (64 - rest));
+    }
+    bits += static_cast<size_t>(count);
+}
+
+uint64_t BitStream::Reader::read(int count) {
+    if (count == 0 || position + static_cast<size_t>(count) > stream.bits) {
+        return 0;
+    }
+    size_t word = position / 64;
+    int space = 64 - static_cast<int>(position % 64);
+    uint64_t value;
+    if (count <= space) {
+        value = stream.words[word] >> (space - count);
+    } else {
+        int rest = count - space;
+        value = (stream.words[word] << rest) | (stream.words[word + 1] >> (64 - rest));
+    }
+    if (count < 64) {
+        value &= (uint64_t(1) << count) - 1;
+    }
+    position += static_cast<size_t>(count);
+    return value;
+}
+
+static uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Two's complement in the low 'bits' bits back to a signed value
+static int64_t sign_extend(uint64_t value, int bits) {
+    uint64_t sign = uint64_t(1) << (bits - 1);
+    return static_cast<int64_t>((value ^ sign) - sign);
+}
+
+MetricsHistory::MetricsHistory(const std::vector<std::string>& names) : series_names(names) {}
+
+bool MetricsHistory::parse_aggregation(const std::string& name, Aggregation& aggregation) {
+    if (name == "avg") {
+        aggregation = AVG;
+    } else if (name == "min") {
+        aggregation = MIN;
+    } else if (name == "max") {
+        aggregation = MAX;
+    } else if (name == "last") {
+        aggregation = LAST;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// '0' for a steady interval, otherwise a prefix naming the width: 10 = 7 bits,
+// 110 = 9 bits, 1110 = 12 bits, 1111 = 64 bits
+void MetricsHistory::encode_delta_of_delta(BitStream& out, int64_t dod) {
+    if (dod == 0) {
+        out.write_bit(false);
+    } else if (dod >= -64 && dod < 64) {
+        out.write(0x2, 2);
+        out.write(static_cast<uint64_t>(dod), 7);
+    } else if (dod >= -256 && dod < 256) {
+        out.write(0x6, 3);
+        out.write(static_cast<uint64_t>(dod), 9);
+    } else if (dod >= -2048 && dod < 2048) {
+        out.write(0xe, 4);
+        out.write(static_cast<uint64_t>(dod), 12);
+    } else {
+        out.write(0xf, 4);
+        out.write(static_cast<uint64_t>(dod), 64);
+    }
+}
+
+int64_t MetricsHistory::decode_delta_of_delta(BitStream::Reader& in) {
+    if (!in.read_bit()) {
+        return 0;
+    }
+    if (!in.read_bit()) {
+        return sign_extend(in.read(7), 7);
+    }
+    if (!in.read_bit()) {
+        return sign_extend(in.read(9), 9);
+    }
+    if (!in.read_bit()) {
+        return sign_extend(in.read(12), 12);
+    }
+    return static_cast<int64_t>(in.read(64));
+}
+
+// First value raw; then '0' for an unchanged value, '10' + the meaningful bits when the
+// XOR fits the previous window, or '11' + 5 bits leading zeros + 6 bits length - 1 + bits
+void MetricsHistory::encode_value(BitStream& out, ValueState& state, double value) {
+    uint64_t bits = double_bits(value);
+    if (state.leading < 0 && out.bit_count() == 0) {
+        out.write(bits, 64);
+        state.previous = bits;
+        return;
+    }
+    uint64_t x = bits ^ state.previous;
+    state.previous = bits;
+    if (x == 0) {
+        out.write_bit(false);
+        return;
+    }
+    out.write_bit(true);
+    int leading = std::min(__builtin_clzll(x), 31);
+    int trailing = __builtin_ctzll(x);
+    if (state.leading >= 0 && leading >= state.leading && trailing >= state.trailing) {
+        out.write_bit(false);
+        out.write(x >> state.trailing, 64 - state.leading - state.trailing);
+        return;
+    }
+    int meaningful = 64 - leading - trailing;
+    out.write_bit(true);
+    out.write(static_cast<uint64_t>(leading), 5);
+    out.write(static_cast<uint64_t>(meaningful - 1), 6);
+    out.write(x >> trailing, meaningful);
+    state.leading = leading;
+    state.trailing = trailing;
+}
+
+double MetricsHistory::decode_value(BitStream::Reader& in, ValueState& state, bool first) {
+    if (first) {
+        state.previous = in.read(64);
+        return bits_double(state.previous);
+    }
+    if (in.read_bit()) {
+        if (in.read_bit()) {
+            state.leading = static_cast<int>(in.read(5));
+            int meaningful = static_cast<int>(in.read(6)) + 1;
+            state.trailing = 64 - state.leading - meaningful;
+        }
+        int meaningful = 64 - state.leading - state.trailing;
+        state.previous ^= in.read(meaningful) << state.trailing;
+    }
+    return bits_double(state.previous);
+}
+
+void MetricsHistory::append(int64_t time_ms, const std::vector<double>& values) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!chunks.empty() && time_ms < chunks.back().last_ms) {
+        return;
+    }
+
+    if (chunks.empty() || time_ms - chunks.back().first_ms >= CHUNK_MS) {
+        if (!chunks.empty()) {
+            Chunk& full = chunks.back();
+            full.times.shrink();
+            for (BitStream& stream : full.values) {
+                stream.shrink();
+            }
+        }
+        chunks.emplace_back();
+        Chunk& chunk = chunks.back();
+        chunk.first_ms = time_ms;
+        chunk.last_ms = time_ms;
+        chunk.values.resize(series_names.size());
+        chunk.states.resize(series_names.size());
+        while (chunks.size() > 1 && chunks.front().last_ms < time_ms - RETENTION_MS) {
+            chunks.pop_front();
+        }
+    } else {
+        Chunk& chunk = chunks.back();
+        int64_t delta = time_ms - chunk.last_ms;
+        encode_delta_of_delta(chunk.times, delta - chunk.last_delta);
+        chunk.last_delta = delta;
+        chunk.last_ms = time_ms;
+    }
+
+    Chunk& chunk = chunks.back();
+    for (size_t i = 0; i < series_names.size(); i++) {
+        encode_value(chunk.values[i], chunk.states[i], i < values.size() ? values[i] : 0.0);
+    }
+    chunk.count++;
+}
+
+std::vector<std::vector<MetricsHistory::Point>> MetricsHistory::query(int64_t from_ms, int64_t to_ms, int64_t step_ms,
+                                                                      Aggregation aggregation) const {
+    std::vector<std::vector<Point>> result(series_names.size());
+    if (step_ms <= 0 || to_ms <= from_ms || static_cast<uint64_t>((to_ms - from_ms - 1) / step_ms) >= MAX_POINTS) {
+        return result;
+    }
+    size_t steps = static_cast<size_t>((to_ms - from_ms - 1) / step_ms + 1);
+
+    struct Bucket {
+        double sum = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        double last = 0;
+        size_t count = 0;
+    };
+    std::vector<std::vector<Bucket>> buckets(series_names.size(), std::vector<Bucket>(steps));
+    std::vector<double> sample(series_names.size());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Chunk& chunk : chunks) {
+            if (chunk.last_ms < from_ms || chunk.first_ms >= to_ms) {
+                continue;
+            }
+            BitStream::Reader times(chunk.times);
+            std::vector<BitStream::Reader> readers;
+            std::vector<ValueState> states(series_names.size());
+            for (const BitStream& stream : chunk.values) {
+                readers.emplace_back(stream);
+            }
+
+            int64_t time = chunk.first_ms;
+            int64_t delta = 0;
+            for (size_t n = 0; n < chunk.count; n++) {
+                if (n > 0) {
+                    delta += decode_delta_of_delta(times);
+                    time += delta;
+                }
+                // Every stream is decoded in step, even outside the range, to keep the XOR state
+                for (size_t i = 0; i < series_names.size(); i++) {
+                    sample[i] = decode_value(readers[i], states[i], n == 0);
+                }
+                if (time < from_ms || time >= to_ms) {
+                    continue;
+                }
+                size_t step = static_cast<size_t>((time - from_ms) / step_ms);
+                for (size_t i = 0; i < series_names.size(); i++) {
+                    Bucket& bucket = buckets[i][step];
+                    bucket.sum += sample[i];
+                    bucket.min = std::min(bucket.min, sample[i]);
+                    bucket.max = std::max(bucket.max, sample[i]);
+                    bucket.last = sample[i];
+                    bucket.count++;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < series_names.size(); i++) {
+        for (size_t step = 0; step < steps; step++) {
+            const Bucket& bucket = buckets[i][step];
+            if (bucket.count == 0) {
+                continue;
+            }
+            double value = bucket.last;
+            switch (aggregation) {
+                case AVG: value = bucket.sum / static_cast<double>(bucket.count); break;
+                case MIN: value = bucket.min; break;
+                case MAX: value = bucket.max; break;
+                case LAST: break;
+            }
+            result[i].push_back(Point{from_ms + static_cast<int64_t>(step) * step_ms, value});
+        }
+    }
+    return result;
+}
+
+size_t MetricsHistory::sample_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const Chunk& chunk : chunks) {
+        count += chunk.count;
+    }
+    return count;
+}
+
+size_t MetricsHistory::compressed_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytes = 0;
+    for (const Chunk& chunk : chunks) {
+        bytes += chunk.times.byte_size();
+        for (const BitStream& stream : chunk.values) {
+            bytes += stream.byte_size();
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,158 @@
+#include "../../include/handlers/otlp_writer.h"
+#include <cmath>
+#include <cstdio>
+
+// AGGREGATION_TEMPORALITY_CUMULATIVE
+static const int CUMULATIVE = 2;
+
+static void append_double(std::string& out, double value) {
+    // JSON has no NaN or infinity
+    if (!std::isfinite(value)) {
+        out += '0';
+        return;
+    }
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out.append(buffer, static_cast<size_t>(length));
+}
+
+OtlpMetricsWriter::OtlpMetricsWriter(int64_t start_unix_nano, int64_t time_unix_nano)
+    : start_time(std::to_string(start_unix_nano)), sample_time(std::to_string(time_unix_nano)) {
+    metrics.reserve(16 * 1024);
+}
+
+void OtlpMetricsWriter::append_string(std::string& out, const std::string& value) {
+    out += '"';
+    for (unsigned char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+void OtlpMetricsWriter::append_attributes(std::string& out, const Attributes& attributes) {
+    out += '[';
+    for (size_t i = 0; i < attributes.size(); i++) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += "{\"key\":";
+        append_string(out, attributes[i].first);
+        out += ",\"value\":{\"stringValue\":";
+        append_string(out, attributes[i].second);
+        out += "}}";
+    }
+    out += ']';
+}
+
+void OtlpMetricsWriter::begin_metric(Kind metric_kind, const char* name, const char* unit, const char* description) {
+    end_metric();
+    if (!metrics.empty()) {
+        metrics += ',';
+    }
+    metrics += "{\"name\":";
+    append_string(metrics, name);
+    metrics += ",\"unit\":";
+    append_string(metrics, unit);
+    metrics += ",\"description\":";
+    append_string(metrics, description);
+    switch (metric_kind) {
+        case SUM: metrics += ",\"sum\":{"; break;
+        case GAUGE: metrics += ",\"gauge\":{"; break;
+        default: metrics += ",\"histogram\":{"; break;
+    }
+    if (metric_kind != GAUGE) {
+        metrics += "\"aggregationTemporality\":" + std::to_string(CUMULATIVE) + ",";
+    }
+    if (metric_kind == SUM) {
+        metrics += monotonic ? "\"isMonotonic\":true," : "\"isMonotonic\":false,";
+    }
+    metrics += "\"dataPoints\":[";
+    kind = metric_kind;
+    first_point = true;
+}
+
+void OtlpMetricsWriter::end_metric() {
+    if (kind != NONE) {
+        metrics += "]}}";
+        kind = NONE;
+    }
+}
+
+void OtlpMetricsWriter::sum(const char* name, const char* unit, const char* description, bool is_monotonic) {
+    monotonic = is_monotonic;
+    begin_metric(SUM, name, unit, description);
+}
+
+void OtlpMetricsWriter::gauge(const char* name, const char* unit, const char* description) {
+    begin_metric(GAUGE, name, unit, description);
+}
+
+void OtlpMetricsWriter::histogram(const char* name, const char* unit, const char* description) {
+    begin_metric(HISTOGRAM, name, unit, description);
+}
+
+void OtlpMetricsWriter::begin_point(const Attributes& attributes) {
+    if (!first_point) {
+        metrics += ',';
+    }
+    first_point = false;
+    metrics += "{\"attributes\":";
+    append_attributes(metrics, attributes);
+    metrics += ",\"startTimeUnixNano\":\"" + start_time + "\",\"timeUnixNano\":\"" + sample_time + "\"";
+}
+
+// 64-bit integers are strings in the protobuf JSON mapping
+void OtlpMetricsWriter::point(const Attributes& attributes, uint64_t value) {
+    begin_point(attributes);
+    metrics += ",\"asInt\":\"" + std::to_string(value) + "\"}";
+}
+
+void OtlpMetricsWriter::point(const Attributes& attributes, double value) {
+    begin_point(attributes);
+    metrics += ",\"asDouble\":";
+    append_double(metrics, value);
+    metrics += '}';
+}
+
+// OTLP bucket counts are per bucket, with one more bucket than bounds for the overflow
+void OtlpMetricsWriter::histogram_point(const Attributes& attributes, const double* bounds, const uint64_t* cumulative,
+                                        size_t bound_count, uint64_t count, double sum) {
+    begin_point(attributes);
+    metrics += ",\"count\":\"" + std::to_string(count) + "\",\"sum\":";
+    append_double(metrics, sum);
+    metrics += ",\"bucketCounts\":[";
+    uint64_t previous = 0;
+    for (size_t i = 0; i <= bound_count; i++) {
+        uint64_t upto = i < bound_count ? cumulative[i] : count;
+        metrics += (i > 0 ? ",\"" : "\"") + std::to_string(upto >= previous ? upto - previous : 0) + "\"";
+        previous = upto;
+    }
+    metrics += "],\"explicitBounds\":[";
+    for (size_t i = 0; i < bound_count; i++) {
+        if (i > 0) {
+            metrics += ',';
+        }
+        append_double(metrics, bounds[i]);
+    }
+    metrics += "]}";
+}
+
+std::string OtlpMetricsWriter::take(const Attributes& resource) {
+    end_metric();
+    std::string out = "{\"resourceMetrics\":[{\"resource\":{\"attributes\":";
+    append_attributes(out, resource);
+    out += "},\"scopeMetrics\":[{\"scope\":{\"name\":\"webserver\"},\"metrics\":[";
+    out += metrics;
+    out += "]}]}]}";
+    metrics.clear();
+    return out;
+}
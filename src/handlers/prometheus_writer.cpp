@@ -0,0 +1,87 @@
+#include "../../include/handlers/prometheus_writer.h"
+#include <cmath>
+#include <cstdio>
+
+const char* const PrometheusWriter::CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+PrometheusWriter::PrometheusWriter() {
+    out.reserve(16 * 1024);
+}
+
+void PrometheusWriter::family(const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void PrometheusWriter::begin_sample(const char* name, const char* suffix, const std::string& labels) {
+    out += name;
+    out += suffix;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+}
+
+void PrometheusWriter::sample(const char* name, const std::string& labels, uint64_t value) {
+    begin_sample(name, "", labels);
+    out += std::to_string(value);
+    out += '\n';
+}
+
+void PrometheusWriter::sample(const char* name, const std::string& labels, double value) {
+    begin_sample(name, "", labels);
+    append_double(value);
+    out += '\n';
+}
+
+void PrometheusWriter::histogram(const char* name, const std::string& labels, const double* bounds,
+                                 const uint64_t* cumulative, size_t bound_count, uint64_t count, double sum) {
+    for (size_t i = 0; i <= bound_count; i++) {
+        out += name;
+        out += "_bucket{";
+        if (!labels.empty()) {
+            out += labels;
+            out += ',';
+        }
+        out += "le=\"";
+        if (i < bound_count) {
+            append_double(bounds[i]);
+        } else {
+            out += "+Inf";
+        }
+        out += "\"} ";
+        out += std::to_string(i < bound_count ? cumulative[i] : count);
+        out += '\n';
+    }
+
+    begin_sample(name, "_sum", labels);
+    append_double(sum);
+    out += '\n';
+    begin_sample(name, "_count", labels);
+    out += std::to_string(count);
+    out += '\n';
+}
+
+void PrometheusWriter::append_double(double value) {
+    if (std::isnan(value)) {
+        out += "NaN";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+        return;
+    }
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out.append(buffer, static_cast<size_t>(length));
+}
+
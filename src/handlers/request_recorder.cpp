@@ -0,0 +1,198 @@
+#include "../../include/handlers/request_recorder.h"
+#include <algorithm>
+#include <cmath>
+
+const size_t RequestRecorder::SHARD_COUNT;
+const int RequestRecorder::RATE_SECONDS;
+const int RequestRecorder::MAX_RATE_SECONDS;
+const int RequestRecorder::MINUTE_COUNT;
+const int RequestRecorder::HOUR_COUNT;
+const int RequestRecorder::SLOT_SECONDS;
+const int RequestRecorder::SLOT_COUNT;
+const int RequestRecorder::MAX_WINDOW_SECONDS;
+
+// Reuse a ring entry for a new period: clear it, then publish the new epoch so readers
+// that see the epoch also see the cleared counts
+template <typename T>
+static void claim_period(std::atomic<int64_t>& epoch, int64_t current, std::atomic<T>* counts, size_t count) {
+    if (epoch.load(std::memory_order_acquire) >= current) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    epoch.store(current, std::memory_order_release);
+}
+
+// Value-initialised: every counter and epoch starts at zero
+RequestRecorder::RequestRecorder(int rate_seconds)
+    : start_time(std::chrono::steady_clock::now()),
+      rate_seconds(std::max(RATE_SECONDS, std::min(rate_seconds, MAX_RATE_SECONDS))),
+      shards(new Shard[SHARD_COUNT]()),
+      seconds(new RateBucket[SHARD_COUNT * static_cast<size_t>(this->rate_seconds)]()) {}
+
+// Counts one request in the bucket of 'period', first clearing it if it holds an older period
+static void add_to_bucket(std::atomic<int64_t>& epoch, std::atomic<uint64_t>& count, int64_t period) {
+    claim_period(epoch, period, &count, 1);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t RequestRecorder::thread_shard() {
+    static std::atomic<size_t> next_shard{0};
+    static thread_local size_t index = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return index;
+}
+
+int64_t RequestRecorder::seconds_at(TimePoint now) const {
+    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
+    return std::max<int64_t>(0, elapsed);
+}
+
+void RequestRecorder::record_at(TimePoint now, double response_time_ms, int status_code) {
+    size_t shard_index = thread_shard();
+    Shard& shard = shards[shard_index];
+    int64_t second = seconds_at(now);
+
+    shard.total.fetch_add(1, std::memory_order_relaxed);
+    if (status_code >= 500) {
+        shard.server_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    RateBucket& per_second = seconds[shard_index * rate_seconds + static_cast<size_t>(second % rate_seconds)];
+    add_to_bucket(per_second.epoch, per_second.count, second);
+    RateBucket& per_minute = shard.minutes[(second / 60) % MINUTE_COUNT];
+    add_to_bucket(per_minute.epoch, per_minute.count, second / 60);
+    RateBucket& per_hour = shard.hours[(second / 3600) % HOUR_COUNT];
+    add_to_bucket(per_hour.epoch, per_hour.count, second / 3600);
+
+    uint64_t micros = response_time_ms > 0 ? static_cast<uint64_t>(std::llround(response_time_ms * 1000.0)) : 0;
+    size_t bucket = LatencyHistogram::bucket_index(micros);
+
+    int64_t slot_epoch = second / SLOT_SECONDS;
+    Slot& slot = shard.slots[slot_epoch % SLOT_COUNT];
+    claim_period(slot.epoch, slot_epoch, slot.counts, LatencyHistogram::BUCKET_COUNT);
+    slot.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.lifetime[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.latency_sum.fetch_add(micros, std::memory_order_relaxed);
+}
+
+uint64_t RequestRecorder::total_requests() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        total += shards[i].total.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t RequestRecorder::server_errors() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        total += shards[i].server_errors.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t RequestRecorder::latency_sum_micros() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        total += shards[i].latency_sum.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void RequestRecorder::count_per_second(TimePoint now, int counts[RATE_SECONDS]) const {
+    uint64_t series_counts[RATE_SECONDS];
+    count_series(now, SECOND, series_counts, RATE_SECONDS);
+    for (int i = 0; i < RATE_SECONDS; i++) {
+        counts[i] = static_cast<int>(series_counts[i]);
+    }
+}
+
+int RequestRecorder::series_length(Resolution resolution) const {
+    switch (resolution) {
+        case MINUTE: return MINUTE_COUNT;
+        case HOUR: return HOUR_COUNT;
+        default: return rate_seconds;
+    }
+}
+
+int RequestRecorder::period_seconds(Resolution resolution) {
+    switch (resolution) {
+        case MINUTE: return 60;
+        case HOUR: return 3600;
+        default: return 1;
+    }
+}
+
+const RequestRecorder::RateBucket* RequestRecorder::series(size_t shard, Resolution resolution) const {
+    switch (resolution) {
+        case MINUTE: return shards[shard].minutes;
+        case HOUR: return shards[shard].hours;
+        default: return &seconds[shard * rate_seconds];
+    }
+}
+
+int RequestRecorder::count_series(TimePoint now, Resolution resolution, uint64_t* counts, int periods) const {
+    int length = series_length(resolution);
+    periods = std::max(0, std::min(periods, length));
+    std::fill(counts, counts + periods, 0);
+    int64_t current = seconds_at(now) / period_seconds(resolution);
+
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        const RateBucket* buckets = series(i, resolution);
+        for (int b = 0; b < length; b++) {
+            int64_t age = current - buckets[b].epoch.load(std::memory_order_acquire);
+            if (age >= 0 && age < periods) {
+                counts[age] += buckets[b].count.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return periods;
+}
+
+size_t RequestRecorder::requests_in_last(TimePoint now, int seconds) const {
+    int counts[RATE_SECONDS];
+    count_per_second(now, counts);
+
+    size_t total = 0;
+    for (int i = 0; i < std::min(seconds, RATE_SECONDS); i++) {
+        total += static_cast<size_t>(counts[i]);
+    }
+    return total;
+}
+
+LatencyHistogram RequestRecorder::latency(TimePoint now, int window_seconds) const {
+    LatencyHistogram merged;
+
+    if (window_seconds <= 0) {
+        for (size_t i = 0; i < SHARD_COUNT; i++) {
+            for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; b++) {
+                uint64_t count = shards[i].lifetime[b].load(std::memory_order_relaxed);
+                if (count > 0) {
+                    merged.add(b, count);
+                }
+            }
+        }
+        return merged;
+    }
+
+    int64_t slots = std::min<int64_t>(SLOT_COUNT, (window_seconds + SLOT_SECONDS - 1) / SLOT_SECONDS);
+    int64_t current = seconds_at(now) / SLOT_SECONDS;
+
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        for (int s = 0; s < SLOT_COUNT; s++) {
+            const Slot& slot = shards[i].slots[s];
+            int64_t age = current - slot.epoch.load(std::memory_order_acquire);
+            if (age < 0 || age >= slots) {
+                continue;
+            }
+            for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; b++) {
+                uint32_t count = slot.counts[b].load(std::memory_order_relaxed);
+                if (count > 0) {
+                    merged.add(b, count);
+                }
+            }
+        }
+    }
+    return merged;
+}
@@ -1,5 +1,10 @@
 #include "../../include/handlers/websocket_handler.h"
 #include "../../include/core/shutdown_coordinator.h"
+#include "../../include/core/server_metrics.h"
+#include "../../include/core/process_stats.h"
+#include "../../include/core/log.h"
+#include "../../include/core/probes.h"
+#include "../../include/handlers/json_handler.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -10,6 +15,8 @@
 #include <cstring>
 #include <future>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 // SHA1 and Base64 implementation for WebSocket handshake
 #include <openssl/sha.h>
@@ -17,107 +24,78 @@
 #include <openssl/evp.h>
 #include <openssl/buffer.h>
 
+// WebSocketConnection Implementation
+WebSocketConnection::WebSocketConnection(int sock, const std::string& id, const WebSocketDeflateConfig& deflate_config,
+                                         MetricsEncoding encoding)
+    : socket(sock), client_id(id), last_ping(std::chrono::steady_clock::now()), is_authenticated(false),
+      deflate(deflate_config), metrics_encoding(encoding), outbound_bytes(0), front_offset(0),
+      wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+WebSocketConnection::~WebSocketConnection() {
+    if (wake_fd >= 0) {
+        close(wake_fd);
+    }
+}
+
 // PerformanceMetrics Implementation
-void PerformanceMetrics::record_request(const std::string& method, const std::string& path, 
+const int PerformanceMetrics::LATENCY_WINDOW_SECONDS;
+const int PerformanceMetrics::RATE_HISTORY_SECONDS;
+
+// Called by every worker for every request: only touches the calling thread's shard
+void PerformanceMetrics::record_request(const std::string& /*method*/, const std::string& /*path*/,
                                        int status_code, double response_time_ms) {
-    std::lock_guard<std::mutex> lock(metrics_mutex);
-    
-    RequestMetric metric;
-    metric.timestamp = std::chrono::steady_clock::now();
-    metric.response_time_ms = response_time_ms;
-    metric.status_code = status_code;
-    metric.method = method;
-    metric.path = path;
-    
-    request_history.push(metric);
-    
-    // Keep only last MAX_REQUEST_HISTORY requests
-    while (request_history.size() > MAX_REQUEST_HISTORY) {
-        request_history.pop();
-    }
-    
-    total_requests++;
-    requests_last_minute++;
-    update_request_rate();
+    requests.record(response_time_ms, status_code);
 }
 
 void PerformanceMetrics::record_system_metrics(size_t memory_mb, double cpu_percent, 
                                               size_t active_connections, size_t queue_size, size_t thread_count) {
+    size_t total = get_total_requests();
+    size_t last_minute = get_requests_per_minute();
+    
     std::lock_guard<std::mutex> lock(metrics_mutex);
     
     SystemMetric metric;
+    metric.seq = ++system_seq;
     metric.timestamp = std::chrono::steady_clock::now();
     metric.memory_usage_mb = memory_mb > 0 ? memory_mb : get_memory_usage();
     metric.cpu_usage_percent = cpu_percent >= 0 ? cpu_percent : get_cpu_usage();
     metric.active_connections = active_connections;
-    metric.total_requests = total_requests.load();
-    metric.requests_per_second = static_cast<double>(requests_last_minute.load()) / 60.0;
+    metric.total_requests = total;
+    metric.requests_per_second = static_cast<double>(last_minute) / 60.0;
     metric.queue_size = queue_size;
     metric.thread_count = thread_count;
     
-    system_history.push(metric);
+    system_history.push_back(metric);
+    history.append(std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch()).count(),
+                   {static_cast<double>(metric.memory_usage_mb), metric.cpu_usage_percent,
+                    static_cast<double>(metric.active_connections), static_cast<double>(metric.total_requests),
+                    metric.requests_per_second, static_cast<double>(metric.queue_size),
+                    static_cast<double>(metric.thread_count)});
     
     // Keep only last MAX_SYSTEM_HISTORY metrics
     while (system_history.size() > MAX_SYSTEM_HISTORY) {
-        system_history.pop();
-    }
-}
-
-void PerformanceMetrics::update_request_rate() {
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::minutes>(now - last_minute_reset);
-    
-    if (elapsed.count() >= 1) {
-        requests_last_minute = 0;
-        last_minute_reset = now;
+        system_history.pop_front();
     }
 }
 
 size_t PerformanceMetrics::get_memory_usage() const {
-    // Read memory usage from /proc/self/status on Linux
-    std::ifstream status_file("/proc/self/status");
-    std::string line;
-    while (std::getline(status_file, line)) {
-        if (line.find("VmRSS:") == 0) {
-            std::istringstream iss(line);
-            std::string key, value, unit;
-            iss >> key >> value >> unit;
-            return std::stoul(value) / 1024; // Convert KB to MB
-        }
-    }
-    return 0;
+    return static_cast<size_t>(ProcessStats::read_rss_bytes() / (1024 * 1024));
 }
 
-double PerformanceMetrics::get_cpu_usage() const {
-    // Simplified CPU usage - in production, you'd want more accurate measurement
-    static auto last_time = std::chrono::steady_clock::now();
-    static size_t last_requests = 0;
-    
-    auto now = std::chrono::steady_clock::now();
-    auto time_diff = std::chrono::duration_cast<std::chrono::seconds>(now - last_time).count();
-    
-    if (time_diff > 0) {
-        size_t current_requests = total_requests.load();
-        double request_rate = static_cast<double>(current_requests - last_requests) / time_diff;
-        last_requests = current_requests;
-        last_time = now;
-        
-        // Estimate CPU usage based on request rate (this is a rough approximation)
-        return std::min(100.0, request_rate * 0.5);
-    }
-    
-    return 0.0;
+// Caller holds metrics_mutex, which serialises the sampler
+double PerformanceMetrics::get_cpu_usage() {
+    return cpu_sampler.sample();
 }
 
 std::string PerformanceMetrics::get_metrics_json() const {
-    std::lock_guard<std::mutex> lock(metrics_mutex);
-    
     std::ostringstream json;
     json << "{";
     json << "\"type\":\"metrics\",";
     json << "\"data\":{";
-    json << "\"total_requests\":" << total_requests.load() << ",";
-    json << "\"requests_per_minute\":" << requests_last_minute.load() << ",";
+    json << "\"total_requests\":" << get_total_requests() << ",";
+    json << "\"requests_per_minute\":" << get_requests_per_minute() << ",";
+    json << "\"latency_ms\":" << latency_json(get_latency_histogram(LATENCY_WINDOW_SECONDS), LATENCY_WINDOW_SECONDS) << ",";
     json << "\"timestamp\":" << std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now().time_since_epoch()).count();
     json << "}";
@@ -127,8 +105,6 @@ std::string PerformanceMetrics::get_metrics_json() const {
 }
 
 std::string PerformanceMetrics::get_request_rate_json() const {
-    std::lock_guard<std::mutex> lock(metrics_mutex);
-    
     std::ostringstream json;
     json << "{";
     json << "\"type\":\"request_rate\",";
@@ -136,25 +112,8 @@ std::string PerformanceMetrics::get_request_rate_json() const {
     
     // Create request rate data for last 60 seconds
     auto now = std::chrono::steady_clock::now();
-    std::map<int, int> request_counts;
-    
-    // Initialize all seconds to 0
-    for (int i = 0; i < 60; i++) {
-        request_counts[i] = 0;
-    }
-    
-    // Count requests per second for last minute
-    std::queue<RequestMetric> temp_history = request_history;
-    while (!temp_history.empty()) {
-        const auto& metric = temp_history.front();
-        auto age = std::chrono::duration_cast<std::chrono::seconds>(now - metric.timestamp).count();
-        
-        if (age < 60) {
-            request_counts[static_cast<int>(age)]++;
-        }
-        
-        temp_history.pop();
-    }
+    int request_counts[RequestRecorder::RATE_SECONDS];
+    requests.count_per_second(now, request_counts);
     
     bool first = true;
     for (int i = 59; i >= 0; i--) {
@@ -169,40 +128,142 @@ std::string PerformanceMetrics::get_request_rate_json() const {
     return json.str();
 }
 
+std::string PerformanceMetrics::get_request_rate_series_json(RequestRecorder::Resolution resolution, int periods) const {
+    static const char* const names[] = {"second", "minute", "hour"};
+    auto now = std::chrono::steady_clock::now();
+    std::vector<uint64_t> counts(static_cast<size_t>(std::max(periods, 0)));
+    periods = requests.count_series(now, resolution, counts.data(), periods);
+    int period_seconds = RequestRecorder::period_seconds(resolution);
+    
+    std::ostringstream json;
+    json << "{";
+    json << "\"resolution\":\"" << names[resolution] << "\",";
+    json << "\"period_seconds\":" << period_seconds << ",";
+    json << "\"data\":[";
+    for (int i = periods - 1; i >= 0; i--) {
+        auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            (now - std::chrono::seconds(static_cast<int64_t>(i) * period_seconds)).time_since_epoch()).count();
+        json << "{\"timestamp\":" << timestamp << ",\"count\":" << counts[i] << "}";
+        if (i > 0) json << ",";
+    }
+    json << "]}";
+    return json.str();
+}
+
+std::string PerformanceMetrics::get_metrics_history_json(int64_t from_ms, int64_t to_ms, int64_t step_ms,
+                                                         MetricsHistory::Aggregation aggregation,
+                                                         const std::vector<std::string>& series) const {
+    static const char* const aggregation_names[] = {"avg", "min", "max", "last"};
+    std::vector<std::vector<MetricsHistory::Point>> points = history.query(from_ms, to_ms, step_ms, aggregation);
+    
+    std::ostringstream json;
+    json << "{";
+    json << "\"from\":" << from_ms / 1000 << ",";
+    json << "\"to\":" << to_ms / 1000 << ",";
+    json << "\"step\":" << step_ms / 1000 << ",";
+    json << "\"aggregation\":\"" << aggregation_names[aggregation] << "\",";
+    json << "\"samples\":" << history.sample_count() << ",";
+    json << "\"compressed_bytes\":" << history.compressed_bytes() << ",";
+    json << "\"series\":{";
+    bool first_series = true;
+    for (size_t i = 0; i < history.names().size(); i++) {
+        const std::string& name = history.names()[i];
+        if (!series.empty() && std::find(series.begin(), series.end(), name) == series.end()) {
+            continue;
+        }
+        if (!first_series) json << ",";
+        first_series = false;
+        json << "\"" << name << "\":[";
+        for (size_t p = 0; p < points[i].size(); p++) {
+            if (p > 0) json << ",";
+            json << "[" << points[i][p].time_ms / 1000 << "," << std::setprecision(10) << points[i][p].value << "]";
+        }
+        json << "]";
+    }
+    json << "}}";
+    return json.str();
+}
+
+// Percentiles in milliseconds, from a histogram of microseconds
+std::string PerformanceMetrics::latency_json(const LatencyHistogram& histogram, int window_seconds) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{";
+    json << "\"window_seconds\":" << window_seconds << ",";
+    json << "\"count\":" << histogram.count() << ",";
+    json << "\"mean\":" << histogram.mean() / 1000.0 << ",";
+    json << "\"p50\":" << histogram.percentile(0.50) / 1000.0 << ",";
+    json << "\"p90\":" << histogram.percentile(0.90) / 1000.0 << ",";
+    json << "\"p99\":" << histogram.percentile(0.99) / 1000.0 << ",";
+    json << "\"p999\":" << histogram.percentile(0.999) / 1000.0 << ",";
+    json << "\"max\":" << histogram.max() / 1000.0;
+    json << "}";
+    return json.str();
+}
+
 std::string PerformanceMetrics::get_system_metrics_json() const {
     std::lock_guard<std::mutex> lock(metrics_mutex);
+    return system_snapshot_json_locked();
+}
+
+std::string PerformanceMetrics::get_system_metrics_delta_json(uint64_t after_seq) const {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
     
-    if (system_history.empty()) {
-        return "{\"type\":\"system_metrics\",\"data\":[]}";
+    std::deque<SystemMetric>::const_iterator it;
+    if (!find_delta_start_locked(after_seq, it)) {
+        return system_snapshot_json_locked();
     }
     
     std::ostringstream json;
     json << "{";
-    json << "\"type\":\"system_metrics\",";
+    json << "\"type\":\"system_metrics_delta\",";
+    json << "\"prev_seq\":" << after_seq << ",";
+    json << "\"seq\":" << system_seq << ",";
     json << "\"data\":[";
     
-    std::queue<SystemMetric> temp_history = system_history;
     bool first = true;
+    for (; it != system_history.end(); ++it) {
+        if (!first) json << ",";
+        append_system_metric_json(json, *it);
+        first = false;
+    }
     
-    while (!temp_history.empty()) {
+    json << "]}";
+    return json.str();
+}
+
+// Locates the first sample after 'after_seq'; false when the client needs a full snapshot
+bool PerformanceMetrics::find_delta_start_locked(uint64_t after_seq,
+                                                 std::deque<SystemMetric>::const_iterator& start) const {
+    // Client is too far behind (or ahead after a restart): resend everything
+    if (system_history.empty() || after_seq + 1 < system_history.front().seq || after_seq > system_seq) {
+        return false;
+    }
+    
+    // Only the newest samples are needed; walk back from the end
+    start = system_history.end();
+    while (start != system_history.begin() && std::prev(start)->seq > after_seq) {
+        --start;
+    }
+    return true;
+}
+
+uint64_t PerformanceMetrics::get_latest_system_seq() const {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    return system_seq;
+}
+
+std::string PerformanceMetrics::system_snapshot_json_locked() const {
+    std::ostringstream json;
+    json << "{";
+    json << "\"type\":\"system_metrics\",";
+    json << "\"seq\":" << system_seq << ",";
+    json << "\"data\":[";
+    
+    bool first = true;
+    for (const auto& metric : system_history) {
         if (!first) json << ",";
-        
-        const auto& metric = temp_history.front();
-        auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-            metric.timestamp.time_since_epoch()).count();
-        
-        json << "{";
-        json << "\"timestamp\":" << timestamp << ",";
-        json << "\"memory_mb\":" << metric.memory_usage_mb << ",";
-        json << "\"cpu_percent\":" << std::fixed << std::setprecision(2) << metric.cpu_usage_percent << ",";
-        json << "\"active_connections\":" << metric.active_connections << ",";
-        json << "\"total_requests\":" << metric.total_requests << ",";
-        json << "\"requests_per_second\":" << std::fixed << std::setprecision(2) << metric.requests_per_second << ",";
-        json << "\"queue_size\":" << metric.queue_size << ",";
-        json << "\"thread_count\":" << metric.thread_count;
-        json << "}";
-        
-        temp_history.pop();
+        append_system_metric_json(json, metric);
         first = false;
     }
     
@@ -210,7 +271,137 @@ std::string PerformanceMetrics::get_system_metrics_json() const {
     return json.str();
 }
 
+void PerformanceMetrics::append_system_metric_json(std::ostringstream& json, const SystemMetric& metric) const {
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        metric.timestamp.time_since_epoch()).count();
+    
+    json << "{";
+    json << "\"seq\":" << metric.seq << ",";
+    json << "\"timestamp\":" << timestamp << ",";
+    json << "\"memory_mb\":" << metric.memory_usage_mb << ",";
+    json << "\"cpu_percent\":" << std::fixed << std::setprecision(2) << metric.cpu_usage_percent << ",";
+    json << "\"active_connections\":" << metric.active_connections << ",";
+    json << "\"total_requests\":" << metric.total_requests << ",";
+    json << "\"requests_per_second\":" << std::fixed << std::setprecision(2) << metric.requests_per_second << ",";
+    json << "\"queue_size\":" << metric.queue_size << ",";
+    json << "\"thread_count\":" << metric.thread_count;
+    json << "}";
+}
+
+// Binary encodings (metrics.bin.v1). Timestamps use the same clock as the JSON messages.
+std::string PerformanceMetrics::get_metrics_binary() const {
+    MetricsBinaryWriter out(MetricsBinaryWriter::METRICS, 0, 20);
+    out.put_i64(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    out.put_u64(get_total_requests());
+    out.put_u32(static_cast<uint32_t>(get_requests_per_minute()));
+    return out.take();
+}
+
+std::string PerformanceMetrics::get_request_rate_binary() const {
+    auto now = std::chrono::steady_clock::now();
+    int request_counts[RequestRecorder::RATE_SECONDS];
+    requests.count_per_second(now, request_counts);
+    
+    // Timestamp of the newest second, then one count per second, oldest first
+    MetricsBinaryWriter out(MetricsBinaryWriter::REQUEST_RATE, 60, 8 + 60 * 4);
+    out.put_i64(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count());
+    for (int i = 59; i >= 0; i--) {
+        out.put_u32(static_cast<uint32_t>(request_counts[i]));
+    }
+    return out.take();
+}
+
+std::string PerformanceMetrics::get_system_metrics_binary() const {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    return system_binary_locked(MetricsBinaryWriter::SYSTEM_METRICS, 0, system_history.begin());
+}
+
+std::string PerformanceMetrics::get_system_metrics_delta_binary(uint64_t after_seq) const {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+    
+    std::deque<SystemMetric>::const_iterator it;
+    if (!find_delta_start_locked(after_seq, it)) {
+        return system_binary_locked(MetricsBinaryWriter::SYSTEM_METRICS, 0, system_history.begin());
+    }
+    return system_binary_locked(MetricsBinaryWriter::SYSTEM_METRICS_DELTA, after_seq, it);
+}
+
+// Samples in the history are consecutive, so only the newest seq is sent; sample i of n
+// has seq = seq - n + 1 + i
+std::string PerformanceMetrics::system_binary_locked(MetricsBinaryWriter::MessageType type, uint64_t prev_seq,
+                                                     std::deque<SystemMetric>::const_iterator start) const {
+    size_t count = static_cast<size_t>(std::distance(start, system_history.end()));
+    MetricsBinaryWriter out(type, static_cast<uint16_t>(count), 16 + count * MetricsBinaryWriter::SYSTEM_SAMPLE_SIZE);
+    out.put_u64(prev_seq);
+    out.put_u64(system_seq);
+    
+    for (auto it = start; it != system_history.end(); ++it) {
+        out.put_i64(std::chrono::duration_cast<std::chrono::milliseconds>(
+            it->timestamp.time_since_epoch()).count());
+        out.put_u64(it->total_requests);
+        out.put_u32(static_cast<uint32_t>(it->memory_usage_mb));
+        out.put_f32(static_cast<float>(it->cpu_usage_percent));
+        out.put_u32(static_cast<uint32_t>(it->active_connections));
+        out.put_f32(static_cast<float>(it->requests_per_second));
+        out.put_u32(static_cast<uint32_t>(it->queue_size));
+        out.put_u32(static_cast<uint32_t>(it->thread_count));
+    }
+    return out.take();
+}
+
 // WebSocketHandler Implementation
+const char* const WebSocketHandler::METRICS_TOPIC = "metrics";
+const size_t WebSocketHandler::DEFAULT_MAX_OUTBOUND_BYTES;
+
+WebSocketHandler::OutgoingFrames::OutgoingFrames(const std::string& msg, const std::string* binary_msg)
+    : message(msg), binary_message(binary_msg) {
+    // Messages are coalesced by their "type" field; all server messages start with it
+    static const std::string prefix = "{\"type\":\"";
+    if (msg.compare(0, prefix.length(), prefix) == 0) {
+        size_t end = msg.find('"', prefix.length());
+        if (end != std::string::npos) {
+            coalesce_key = msg.substr(prefix.length(), end - prefix.length());
+        }
+    }
+    if (coalesce_key.empty()) {
+        coalesce_key = "message";   // data frames always need a non-empty key
+    }
+}
+
+bool WebSocketHandler::parse_slow_consumer_policy(const std::string& name, SlowConsumerPolicy& policy) {
+    if (name == "drop_oldest") {
+        policy = SlowConsumerPolicy::DROP_OLDEST;
+    } else if (name == "coalesce") {
+        policy = SlowConsumerPolicy::COALESCE;
+    } else if (name == "disconnect") {
+        policy = SlowConsumerPolicy::DISCONNECT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* WebSocketHandler::slow_consumer_policy_name(SlowConsumerPolicy policy) {
+    switch (policy) {
+        case SlowConsumerPolicy::DROP_OLDEST: return "drop_oldest";
+        case SlowConsumerPolicy::COALESCE: return "coalesce";
+        case SlowConsumerPolicy::DISCONNECT: return "disconnect";
+    }
+    return "unknown";
+}
+
+WebSocketHandler::BackpressureStats WebSocketHandler::get_backpressure_stats() const {
+    BackpressureStats stats;
+    stats.queued_bytes = queued_bytes_total.load();
+    stats.queued_frames = queued_frames_total.load();
+    stats.peak_queue_bytes = peak_queue_bytes.load();
+    stats.frames_dropped = frames_dropped.load();
+    stats.frames_coalesced = frames_coalesced.load();
+    stats.slow_disconnects = slow_disconnects.load();
+    return stats;
+}
+
 WebSocketHandler::WebSocketHandler() : metrics(std::make_shared<PerformanceMetrics>()) {}
 
 WebSocketHandler::~WebSocketHandler() {
@@ -231,7 +422,9 @@ bool WebSocketHandler::is_websocket_request(const std::map<std::string, std::str
     return (connection_val.find("upgrade") != std::string::npos) && upgrade_val == "websocket";
 }
 
-std::string WebSocketHandler::generate_websocket_response(const std::map<std::string, std::string>& headers) const {
+std::string WebSocketHandler::generate_websocket_response(const std::map<std::string, std::string>& headers,
+                                                          WebSocketDeflateConfig& deflate_config,
+                                                          MetricsEncoding& metrics_encoding) const {
     auto ws_key_it = headers.find("sec-websocket-key");
     if (ws_key_it == headers.end()) {
         return "";
@@ -249,6 +442,32 @@ std::string WebSocketHandler::generate_websocket_response(const std::map<std::st
     response << "Upgrade: websocket\r\n";
     response << "Connection: Upgrade\r\n";
     response << "Sec-WebSocket-Accept: " << accept_key << "\r\n";
+    
+    // permessage-deflate (RFC 7692)
+    deflate_config = WebSocketDeflateConfig();
+    auto extensions_it = headers.find("sec-websocket-extensions");
+    std::string extension_response;
+    if (extensions_it != headers.end() &&
+        negotiate_permessage_deflate(extensions_it->second, deflate_config, extension_response)) {
+        response << "Sec-WebSocket-Extensions: " << extension_response << "\r\n";
+    }
+    
+    // Subprotocol: binary metrics when offered, otherwise none (JSON text messages)
+    metrics_encoding = MetricsEncoding::JSON;
+    auto protocol_it = headers.find("sec-websocket-protocol");
+    if (protocol_it != headers.end()) {
+        std::istringstream offers(protocol_it->second);
+        std::string offer;
+        while (std::getline(offers, offer, ',')) {
+            offer.erase(0, offer.find_first_not_of(" \t"));
+            offer.erase(offer.find_last_not_of(" \t") + 1);
+            if (offer == MetricsBinaryWriter::SUBPROTOCOL) {
+                metrics_encoding = MetricsEncoding::BINARY;
+                response << "Sec-WebSocket-Protocol: " << MetricsBinaryWriter::SUBPROTOCOL << "\r\n";
+                break;
+            }
+        }
+    }
     response << "\r\n";
     
     return response.str();
@@ -279,128 +498,203 @@ std::string WebSocketHandler::sha1_hash(const std::string& input) const {
     return std::string(reinterpret_cast<char*>(hash), SHA_DIGEST_LENGTH);
 }
 
-bool WebSocketHandler::handle_websocket_connection(int client_socket, const std::string& client_id) {
-    add_connection(client_socket, client_id);
+bool WebSocketHandler::handle_websocket_connection(int client_socket, const std::string& client_id,
+                                                   const WebSocketDeflateConfig& deflate_config,
+                                                   MetricsEncoding metrics_encoding) {
+    auto conn = add_connection(client_socket, client_id, deflate_config, metrics_encoding);
     // Send an initial snapshot so clients populate immediately without waiting for broadcast cycle
-    if (metrics) {
-        send_message_to_client(client_id, metrics->get_metrics_json());
-        send_message_to_client(client_id, metrics->get_system_metrics_json());
-        send_message_to_client(client_id, metrics->get_request_rate_json());
+    if (metrics && metrics_encoding == MetricsEncoding::BINARY) {
+        send_binary_metrics(*conn, metrics->get_metrics_binary());
+        send_binary_metrics(*conn, metrics->get_system_metrics_binary());
+        send_binary_metrics(*conn, metrics->get_request_rate_binary());
+    } else if (metrics) {
+        send_text(*conn, metrics->get_metrics_json());
+        send_text(*conn, metrics->get_system_metrics_json());
+        send_text(*conn, metrics->get_request_rate_json());
     }
     
-    std::vector<uint8_t> buffer(4096);
+    return run_connection(conn, false);
+}
+
+// Connection thread: reads and dispatches client frames, and is the only writer of the
+// socket. poll() wakes it for incoming data, for queued outbound frames (wake_fd) and,
+// while a frame is partially written, when the socket becomes writable again.
+bool WebSocketHandler::run_connection(const std::shared_ptr<WebSocketConnection>& conn, bool use_coordinator) {
+    auto& coordinator = ShutdownCoordinator::instance();
+    int client_socket = conn->socket;
     
-    while (running.load()) {
-        // Set socket to non-blocking for graceful shutdown
-        int flags = fcntl(client_socket, F_GETFL, 0);
-        fcntl(client_socket, F_SETFL, flags | O_NONBLOCK);
+    WebSocketFrameDecoder decoder(max_message_size.load());
+    decoder.set_allow_rsv1(conn->deflate.enabled);
+    std::unique_ptr<WebSocketInflater> inflater;
+    if (conn->deflate.enabled) {
+        inflater.reset(new WebSocketInflater(conn->deflate.client_no_context_takeover));
+    }
+    
+    // Non-blocking: neither a silent client nor a congested one can stall this thread
+    int flags = fcntl(client_socket, F_GETFL, 0);
+    fcntl(client_socket, F_SETFL, flags | O_NONBLOCK);
+    
+    bool close_sent = false;
+    
+    while (running.load() && !conn->closing.load() &&
+           !(use_coordinator && coordinator.is_shutdown_requested())) {
+        bool pending;
+        {
+            std::lock_guard<std::mutex> lock(conn->send_mutex);
+            pending = !conn->outbound.empty();
+        }
         
-        ssize_t bytes_received = recv(client_socket, buffer.data(), buffer.size(), 0);
+        struct pollfd fds[2];
+        fds[0].fd = client_socket;
+        fds[0].events = POLLIN | (pending ? POLLOUT : 0);
+        fds[0].revents = 0;
+        fds[1].fd = conn->wake_fd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
         
-        if (bytes_received > 0) {
-            buffer.resize(bytes_received);
-            WebSocketFrame frame = parse_frame(buffer);
-            
-            if (frame.opcode == WS_OPCODE_CLOSE || !running.load()) {
+        int ready = poll(fds, conn->wake_fd >= 0 ? 2 : 1, 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready == 0) {
+            continue; // Timeout: re-check running/shutdown
+        }
+        
+        if (fds[1].revents & POLLIN) {
+            uint64_t counter;
+            while (read(conn->wake_fd, &counter, sizeof(counter)) > 0) {}
+        }
+        
+        if ((fds[0].revents & POLLOUT) || (fds[1].revents & POLLIN)) {
+            if (!flush_outbound(*conn)) {
                 break;
-            } else if (frame.opcode == WS_OPCODE_PING) {
-                if (!send_pong(client_socket) || !running.load()) {
-                    break;
-                }
-            } else if (frame.opcode == WS_OPCODE_TEXT && running.load()) {
-                std::string message(frame.payload.begin(), frame.payload.end());
-                
-                if (message == "request_metrics" && metrics) {
-                    send_message_to_client(client_id, metrics->get_metrics_json());
-                } else if (message == "request_rate" && metrics) {
-                    send_message_to_client(client_id, metrics->get_request_rate_json());
-                } else if (message == "system_metrics" && metrics) {
-                    send_message_to_client(client_id, metrics->get_system_metrics_json());
-                }
             }
-            
-            buffer.resize(4096);
-            
-        } else if (bytes_received == 0) {
-            // Connection closed by client
+        }
+        
+        if (fds[0].revents & (POLLERR | POLLNVAL)) {
             break;
-        } else {
-            // Error or would block
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                // No data available, sleep briefly
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            } else {
-                // Real error
-                if (running.load()) {
-                    std::cerr << "WebSocket recv error: " << strerror(errno) << std::endl;
+        }
+        
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            ssize_t bytes_received = decoder.read_from(client_socket);
+            
+            if (bytes_received > 0) {
+                ServerMetrics::instance().add_bytes_received(static_cast<size_t>(bytes_received));
+                // One read may complete several frames, or only part of one
+                if (!dispatch_messages(conn, decoder, inflater.get())) {
+                    close_sent = true;
+                    break;
+                }
+            } else if (bytes_received == 0) {
+                // Connection closed by client
+                break;
+            } else if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR) {
+                if (running.load() && !conn->closing.load()) {
+                    LOG_WARN(LogModule::WEBSOCKET, "Recv error: " << strerror(errno));
                 }
                 break;
             }
         }
     }
     
-    remove_connection(client_id);
+    // Let a queued close frame (and whatever precedes it) reach the client
+    if (close_sent) {
+        drain_before_close(*conn, 200);
+    }
+    
+    // A failed broadcast may already have dropped it from the map; subscriptions go regardless
+    remove_connection(conn->client_id);
+    unsubscribe_all(conn);
+    release_outbound(*conn);
     close(client_socket);
     return true;
 }
 
-WebSocketHandler::WebSocketFrame WebSocketHandler::parse_frame(const std::vector<uint8_t>& data) const {
-    WebSocketFrame frame;
-    
-    if (data.size() < 2) {
-        frame.fin = false;
-        frame.opcode = 0;
-        return frame;
-    }
-    
-    frame.fin = (data[0] & 0x80) != 0;
-    frame.opcode = data[0] & 0x0F;
-    frame.masked = (data[1] & 0x80) != 0;
-    
-    size_t payload_start = 2;
-    uint64_t payload_len = data[1] & 0x7F;
-    
-    if (payload_len == 126) {
-        if (data.size() < 4) return frame;
-        payload_len = (data[2] << 8) | data[3];
-        payload_start = 4;
-    } else if (payload_len == 127) {
-        if (data.size() < 10) return frame;
-        payload_len = 0;
-        for (int i = 0; i < 8; i++) {
-            payload_len |= static_cast<uint64_t>(data[2 + i]) << (8 * (7 - i));
+bool WebSocketHandler::dispatch_messages(const std::shared_ptr<WebSocketConnection>& conn,
+                                         WebSocketFrameDecoder& decoder, WebSocketInflater* inflater) {
+    const std::string& client_id = conn->client_id;
+    WebSocketMessage message;
+    std::vector<uint8_t> inflated;
+    
+    while (true) {
+        WebSocketFrameDecoder::Status status = decoder.next(message);
+        
+        if (status == WebSocketFrameDecoder::NEED_MORE) {
+            return true;
         }
-        payload_start = 10;
-    }
-    
-    frame.payload_length = payload_len;
-    
-    if (frame.masked) {
-        if (data.size() < payload_start + 4) return frame;
-        std::memcpy(frame.mask, &data[payload_start], 4);
-        payload_start += 4;
-    }
-    
-    if (data.size() < payload_start + payload_len) return frame;
-    
-    frame.payload.resize(payload_len);
-    for (uint64_t i = 0; i < payload_len; i++) {
-        if (frame.masked) {
-            frame.payload[i] = data[payload_start + i] ^ frame.mask[i % 4];
-        } else {
-            frame.payload[i] = data[payload_start + i];
+        
+        if (status == WebSocketFrameDecoder::PROTOCOL_ERROR) {
+            if (running.load()) {
+                LOG_WARN(LogModule::WEBSOCKET, "Protocol error from " << client_id << ": "
+                                                                       << decoder.error_message());
+            }
+            send_close(*conn, decoder.close_code());
+            return false;
+        }
+        
+        if (message.compressed) {
+            // The decoder only accepts RSV1 when deflate was negotiated
+            WebSocketInflater::Result result = inflater
+                ? inflater->inflate_message(message.payload, inflated, decoder.get_max_message_size())
+                : WebSocketInflater::CORRUPT;
+            if (result != WebSocketInflater::OK) {
+                send_close(*conn, result == WebSocketInflater::TOO_LARGE
+                                       ? WebSocketFrameDecoder::CLOSE_MESSAGE_TOO_BIG
+                                       : WebSocketFrameDecoder::CLOSE_PROTOCOL_ERROR);
+                return false;
+            }
+            message.payload.swap(inflated);
+            message.compressed = false;
+        }
+        SERVER_PROBE3(websocket__message__in, conn->socket, message.opcode, message.payload.size());
+        
+        if (message.opcode == WS_OPCODE_CLOSE) {
+            send_close(*conn, WebSocketFrameDecoder::CLOSE_NORMAL);
+            return false;
+        } else if (message.opcode == WS_OPCODE_PING) {
+            if (!send_pong(*conn, message.payload)) {
+                return false;
+            }
+        } else if (message.opcode == WS_OPCODE_PONG) {
+            continue;
+        } else if (message.opcode == WS_OPCODE_TEXT && metrics && message.payload.size() <= 32) {
+            // Built-in metric commands are short text messages
+            std::string command(message.payload.begin(), message.payload.end());
+            std::string reply;
+            bool binary = conn->metrics_encoding == MetricsEncoding::BINARY;
+            
+            if (command == "request_metrics") {
+                reply = binary ? metrics->get_metrics_binary() : metrics->get_metrics_json();
+            } else if (command == "request_rate") {
+                reply = binary ? metrics->get_request_rate_binary() : metrics->get_request_rate_json();
+            } else if (command == "system_metrics" || command == "resync") {
+                // Full snapshot; clients send "resync" after detecting a sequence gap
+                reply = binary ? metrics->get_system_metrics_binary() : metrics->get_system_metrics_json();
+            }
+            
+            if (!reply.empty()) {
+                if (!(binary ? send_binary_metrics(*conn, reply) : send_text(*conn, reply))) {
+                    return false;
+                }
+            } else if (message_handler) {
+                message_handler(client_id, message.opcode, message.payload);
+            }
+        } else if (message.opcode == WS_OPCODE_TEXT && !message.payload.empty() && message.payload[0] == '{' &&
+                   handle_topic_command(conn, std::string(message.payload.begin(), message.payload.end()))) {
+            continue;
+        } else if (message_handler) {
+            message_handler(client_id, message.opcode, message.payload);
         }
     }
-    
-    return frame;
 }
 
-std::vector<uint8_t> WebSocketHandler::create_frame(uint8_t opcode, const std::string& payload) const {
+std::vector<uint8_t> WebSocketHandler::create_frame(uint8_t opcode, const std::string& payload, bool compressed) const {
     std::vector<uint8_t> frame;
+    frame.reserve(payload.length() + 10);
     
-    // First byte: FIN=1, RSV=0, Opcode
-    frame.push_back(0x80 | opcode);
+    // First byte: FIN=1, RSV1 marks a permessage-deflate payload, Opcode
+    frame.push_back(0x80 | (compressed ? 0x40 : 0x00) | opcode);
     
     // Payload length
     uint64_t payload_len = payload.length();
@@ -423,28 +717,386 @@ std::vector<uint8_t> WebSocketHandler::create_frame(uint8_t opcode, const std::s
     return frame;
 }
 
-bool WebSocketHandler::send_frame(int socket, uint8_t opcode, const std::string& payload) const {
-    auto frame = create_frame(opcode, payload);
-    ssize_t sent = send(socket, frame.data(), frame.size(), MSG_NOSIGNAL);
-    return sent == static_cast<ssize_t>(frame.size());
+bool WebSocketHandler::send_frame(WebSocketConnection& conn, uint8_t opcode, const std::string& payload) {
+    // Control frames bypass the slow-consumer policy (they are tiny and never coalesced)
+    return enqueue_frame(conn, std::make_shared<const std::vector<uint8_t>>(create_frame(opcode, payload)), "");
 }
 
-bool WebSocketHandler::send_ping(int socket) const {
-    return send_frame(socket, WS_OPCODE_PING, "");
+bool WebSocketHandler::send_text(WebSocketConnection& conn, const std::string& message) {
+    OutgoingFrames frames(message);
+    return enqueue_frame(conn, frame_for(conn, frames), frames.coalesce_key);
 }
 
-bool WebSocketHandler::send_pong(int socket) const {
-    return send_frame(socket, WS_OPCODE_PONG, "");
+bool WebSocketHandler::send_binary_metrics(WebSocketConnection& conn, const std::string& payload) {
+    // Coalesced together with the JSON message of the same type
+    std::string key = MetricsBinaryWriter::type_name(payload);
+    return enqueue_frame(conn, std::make_shared<const std::vector<uint8_t>>(create_frame(WS_OPCODE_BINARY, payload)),
+                         key.empty() ? "message" : key);
 }
 
-void WebSocketHandler::add_connection(int socket, const std::string& client_id) {
-    std::lock_guard<std::timed_mutex> lock(connections_mutex);
-    connections[client_id] = std::make_shared<WebSocketConnection>(socket, client_id);
+bool WebSocketHandler::enqueue_frame(WebSocketConnection& conn,
+                                     const std::shared_ptr<const std::vector<uint8_t>>& frame,
+                                     const std::string& coalesce_key) {
+    if (conn.closing.load()) {
+        return false;
+    }
+    
+    size_t limit = max_outbound_bytes.load();
+    bool is_control = coalesce_key.empty();
+    size_t frame_size = frame->size();
+    bool disconnect = false;
+    
+    {
+        std::lock_guard<std::mutex> lock(conn.send_mutex);
+        
+        if (!is_control && conn.outbound_bytes + frame_size > limit) {
+            SlowConsumerPolicy policy = slow_consumer_policy.load();
+            
+            // The front frame may be partially written; it must stay to keep the stream valid
+            size_t first_removable = conn.front_offset > 0 ? 1 : 0;
+            
+            if (policy == SlowConsumerPolicy::DISCONNECT) {
+                // Shut down while holding send_mutex: the owner thread takes it in
+                // release_outbound() before closing the socket, so the fd cannot be reused yet
+                disconnect = true;
+                if (!conn.closing.exchange(true)) {
+                    slow_disconnects++;
+                    shutdown(conn.socket, SHUT_RDWR);
+                }
+            } else {
+                if (policy == SlowConsumerPolicy::COALESCE) {
+                    // Older messages of the same type are superseded by the newest one
+                    for (size_t i = conn.outbound.size(); i-- > first_removable;) {
+                        if (conn.outbound[i].coalesce_key == coalesce_key) {
+                            drop_queued_frame(conn, i);
+                            frames_coalesced++;
+                        }
+                    }
+                }
+                
+                // Still too much queued: drop the oldest data frames, keeping control frames
+                size_t i = first_removable;
+                while (conn.outbound_bytes + frame_size > limit && i < conn.outbound.size()) {
+                    if (conn.outbound[i].coalesce_key.empty()) {
+                        i++;
+                        continue;
+                    }
+                    drop_queued_frame(conn, i);
+                    frames_dropped++;
+                }
+                
+                if (conn.outbound_bytes + frame_size > limit) {
+                    // A single message larger than the limit is dropped outright
+                    frames_dropped++;
+                    return true;
+                }
+            }
+        }
+        
+        if (!disconnect) {
+            conn.outbound.push_back(WebSocketConnection::OutboundFrame{frame, coalesce_key});
+            conn.outbound_bytes += frame_size;
+            queued_bytes_total += frame_size;
+            queued_frames_total++;
+            
+            size_t peak = peak_queue_bytes.load();
+            while (conn.outbound_bytes > peak &&
+                   !peak_queue_bytes.compare_exchange_weak(peak, conn.outbound_bytes)) {}
+        }
+    }
+    
+    if (disconnect) {
+        return false;
+    }
+    
+    // Wake the connection thread so it writes the frame
+    if (conn.wake_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(conn.wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+    return true;
+}
+
+void WebSocketHandler::drop_queued_frame(WebSocketConnection& conn, size_t index) {
+    size_t size = conn.outbound[index].data->size();
+    conn.outbound_bytes -= size;
+    queued_bytes_total -= size;
+    queued_frames_total--;
+    conn.outbound.erase(conn.outbound.begin() + index);
+}
+
+bool WebSocketHandler::flush_outbound(WebSocketConnection& conn) {
+    std::lock_guard<std::mutex> lock(conn.send_mutex);
+    
+    while (!conn.outbound.empty()) {
+        const std::vector<uint8_t>& frame = *conn.outbound.front().data;
+        size_t remaining = frame.size() - conn.front_offset;
+        ssize_t sent = send(conn.socket, frame.data() + conn.front_offset, remaining, MSG_NOSIGNAL);
+        
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true; // Socket buffer full; poll() will report POLLOUT
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ServerMetrics::instance().add_bytes_sent(static_cast<size_t>(sent));
+        
+        conn.front_offset += static_cast<size_t>(sent);
+        if (conn.front_offset == frame.size()) {
+            SERVER_PROBE3(websocket__message__out, conn.socket, frame[0] & 0x0f, frame.size());
+            conn.front_offset = 0;
+            drop_queued_frame(conn, 0);
+        }
+    }
+    return true;
+}
+
+void WebSocketHandler::drain_before_close(WebSocketConnection& conn, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (!flush_outbound(conn)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(conn.send_mutex);
+            if (conn.outbound.empty()) {
+                return;
+            }
+        }
+        struct pollfd pfd;
+        pfd.fd = conn.socket;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        poll(&pfd, 1, 10);
+    }
+}
+
+void WebSocketHandler::release_outbound(WebSocketConnection& conn) {
+    conn.closing.store(true);
+    std::lock_guard<std::mutex> lock(conn.send_mutex);
+    queued_bytes_total -= conn.outbound_bytes;
+    queued_frames_total -= conn.outbound.size();
+    conn.outbound.clear();
+    conn.outbound_bytes = 0;
+    conn.front_offset = 0;
+}
+
+const std::shared_ptr<const std::vector<uint8_t>>& WebSocketHandler::frame_for(const WebSocketConnection& conn,
+                                                                                OutgoingFrames& frames) const {
+    // Binary payloads are already compact and are never compressed
+    if (conn.metrics_encoding == MetricsEncoding::BINARY && frames.binary_message) {
+        if (!frames.binary) {
+            frames.binary = std::make_shared<const std::vector<uint8_t>>(
+                create_frame(WS_OPCODE_BINARY, *frames.binary_message));
+        }
+        return frames.binary;
+    }
+    
+    if (conn.deflate.enabled && frames.message.length() >= MIN_COMPRESS_SIZE) {
+        auto it = frames.compressed.find(conn.deflate.server_max_window_bits);
+        if (it == frames.compressed.end()) {
+            std::string deflated;
+            std::shared_ptr<const std::vector<uint8_t>> frame;
+            // Fall back to the plain frame when compression does not help
+            if (websocket_deflate_message(frames.message, conn.deflate.server_max_window_bits, deflated) &&
+                deflated.length() < frames.message.length()) {
+                frame = std::make_shared<const std::vector<uint8_t>>(create_frame(WS_OPCODE_TEXT, deflated, true));
+            }
+            it = frames.compressed.emplace(conn.deflate.server_max_window_bits, frame).first;
+        }
+        if (it->second) {
+            return it->second;
+        }
+    }
+    
+    if (!frames.plain) {
+        frames.plain = std::make_shared<const std::vector<uint8_t>>(create_frame(WS_OPCODE_TEXT, frames.message));
+    }
+    return frames.plain;
+}
+
+bool WebSocketHandler::send_ping(WebSocketConnection& conn) {
+    return send_frame(conn, WS_OPCODE_PING, "");
+}
+
+bool WebSocketHandler::send_pong(WebSocketConnection& conn, const std::vector<uint8_t>& payload) {
+    // Pong must echo the application data of the ping it answers
+    return send_frame(conn, WS_OPCODE_PONG, std::string(payload.begin(), payload.end()));
+}
+
+bool WebSocketHandler::send_close(WebSocketConnection& conn, uint16_t code) {
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code & 0xFF));
+    return send_frame(conn, WS_OPCODE_CLOSE, payload);
+}
+
+std::shared_ptr<WebSocketConnection> WebSocketHandler::add_connection(int socket, const std::string& client_id,
+                                                                      const WebSocketDeflateConfig& deflate_config,
+                                                                      MetricsEncoding metrics_encoding) {
+    auto conn = std::make_shared<WebSocketConnection>(socket, client_id, deflate_config, metrics_encoding);
+    {
+        std::lock_guard<std::timed_mutex> lock(connections_mutex);
+        connections[client_id] = conn;
+    }
+    if (metrics_encoding == MetricsEncoding::BINARY) {
+        binary_metrics_clients++;
+    }
+    subscribe_connection(conn, METRICS_TOPIC);
+    return conn;
 }
 
 void WebSocketHandler::remove_connection(const std::string& client_id) {
-    std::lock_guard<std::timed_mutex> lock(connections_mutex);
-    connections.erase(client_id);
+    std::shared_ptr<WebSocketConnection> conn;
+    {
+        std::lock_guard<std::timed_mutex> lock(connections_mutex);
+        auto it = connections.find(client_id);
+        if (it == connections.end()) {
+            return;
+        }
+        conn = it->second;
+        connections.erase(it);
+    }
+    if (conn->metrics_encoding == MetricsEncoding::BINARY) {
+        binary_metrics_clients--;
+    }
+    unsubscribe_all(conn);
+}
+
+// Topic pub/sub
+size_t WebSocketHandler::publish(const std::string& topic, const std::string& message) {
+    if (!running.load()) {
+        return 0;
+    }
+    
+    OutgoingFrames frames(message);
+    return publish_frames(topic, frames);
+}
+
+// Dashboard metrics go out as JSON, or as the binary encoding to clients that asked for it,
+// and to event stream clients tagged with the latest system metrics seq
+size_t WebSocketHandler::publish_metrics(const std::string& message, const std::string& binary_message,
+                                         uint64_t event_id) {
+    if (!running.load()) {
+        return 0;
+    }
+    if (event_stream) {
+        event_stream->publish(event_id, message);
+    }
+    OutgoingFrames frames(message, binary_message.empty() ? nullptr : &binary_message);
+    return publish_frames(METRICS_TOPIC, frames);
+}
+
+size_t WebSocketHandler::publish_frames(const std::string& topic, OutgoingFrames& frames) {
+    // Snapshot of this topic's subscribers; no global lock is held while sending
+    auto subscribers = topic_index.subscribers(topic);
+    size_t delivered = 0;
+    
+    for (const auto& conn : *subscribers) {
+        if (!running.load()) break;
+        if (enqueue_frame(*conn, frame_for(*conn, frames), frames.coalesce_key)) {
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+bool WebSocketHandler::subscribe(const std::string& client_id, const std::string& topic) {
+    std::shared_ptr<WebSocketConnection> conn;
+    {
+        std::lock_guard<std::timed_mutex> lock(connections_mutex);
+        auto it = connections.find(client_id);
+        if (it == connections.end()) {
+            return false;
+        }
+        conn = it->second;
+    }
+    return subscribe_connection(conn, topic);
+}
+
+bool WebSocketHandler::unsubscribe(const std::string& client_id, const std::string& topic) {
+    std::shared_ptr<WebSocketConnection> conn;
+    {
+        std::lock_guard<std::timed_mutex> lock(connections_mutex);
+        auto it = connections.find(client_id);
+        if (it == connections.end()) {
+            return false;
+        }
+        conn = it->second;
+    }
+    return unsubscribe_connection(conn, topic);
+}
+
+bool WebSocketHandler::subscribe_connection(const std::shared_ptr<WebSocketConnection>& conn,
+                                            const std::string& topic) {
+    if (!WebSocketTopicIndex::is_valid_topic(topic)) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(conn->topics_mutex);
+    if (conn->topics.count(topic) || conn->topics.size() >= MAX_TOPICS_PER_CONNECTION) {
+        return false;
+    }
+    conn->topics.insert(topic);
+    topic_index.subscribe(topic, conn);
+    return true;
+}
+
+bool WebSocketHandler::unsubscribe_connection(const std::shared_ptr<WebSocketConnection>& conn,
+                                              const std::string& topic) {
+    std::lock_guard<std::mutex> lock(conn->topics_mutex);
+    if (conn->topics.erase(topic) == 0) {
+        return false;
+    }
+    topic_index.unsubscribe(topic, conn);
+    return true;
+}
+
+void WebSocketHandler::unsubscribe_all(const std::shared_ptr<WebSocketConnection>& conn) {
+    std::lock_guard<std::mutex> lock(conn->topics_mutex);
+    for (const auto& topic : conn->topics) {
+        topic_index.unsubscribe(topic, conn);
+    }
+    conn->topics.clear();
+}
+
+bool WebSocketHandler::handle_topic_command(const std::shared_ptr<WebSocketConnection>& conn,
+                                            const std::string& text) {
+    // {"action":"subscribe"|"unsubscribe","topic":"name"}
+    auto command = JsonHandler::parse(text);
+    if (!command || !command->is_object() || !command->get_object_item("action")->is_string()) {
+        return false;
+    }
+    
+    const std::string& action = command->get_object_item("action")->as_string();
+    if (action != "subscribe" && action != "unsubscribe") {
+        return false;
+    }
+    
+    // A missing or non-string topic stays empty and is reported as invalid
+    std::string topic;
+    if (command->has_key("topic") && command->get_object_item("topic")->is_string()) {
+        topic = command->get_object_item("topic")->as_string();
+    }
+    bool changed = action == "subscribe" ? subscribe_connection(conn, topic)
+                                         : unsubscribe_connection(conn, topic);
+    
+    std::ostringstream reply;
+    if (changed) {
+        reply << "{\"type\":\"" << action << "d\",\"topic\":\"" << JsonHandler::escape_string(topic) << "\"}";
+    } else {
+        std::string reason = !WebSocketTopicIndex::is_valid_topic(topic) ? "invalid topic"
+                           : action == "subscribe" ? "already subscribed or topic limit reached"
+                                                   : "not subscribed";
+        reply << "{\"type\":\"error\",\"action\":\"" << action << "\",\"topic\":\""
+              << JsonHandler::escape_string(topic) << "\",\"message\":\"" << reason << "\"}";
+    }
+    send_text(*conn, reply.str());
+    return true;
 }
 
 void WebSocketHandler::broadcast_message(const std::string& message) {
@@ -454,6 +1106,7 @@ void WebSocketHandler::broadcast_message(const std::string& message) {
     }
     
     std::vector<std::string> dead_connections;
+    OutgoingFrames frames(message);
     
     // C++14 compatible iteration
     for (auto it = connections.begin(); it != connections.end(); ++it) {
@@ -462,7 +1115,7 @@ void WebSocketHandler::broadcast_message(const std::string& message) {
         
         if (!running) break; // Exit early if shutting down
         
-        if (!send_frame(conn->socket, WS_OPCODE_TEXT, message)) {
+        if (!enqueue_frame(*conn, frame_for(*conn, frames), frames.coalesce_key)) {
             dead_connections.push_back(client_id);
         }
     }
@@ -482,12 +1135,18 @@ void WebSocketHandler::send_message_to_client(const std::string& client_id, cons
     
     auto it = connections.find(client_id);
     if (it != connections.end()) {
-        if (!send_frame(it->second->socket, WS_OPCODE_TEXT, message)) {
+        OutgoingFrames frames(message);
+        if (!enqueue_frame(*it->second, frame_for(*it->second, frames), frames.coalesce_key)) {
             connections.erase(it);
         }
     }
 }
 
+void WebSocketHandler::set_message_handler(
+    std::function<void(const std::string&, uint8_t, const std::vector<uint8_t>&)> handler) {
+    message_handler = handler;
+}
+
 void WebSocketHandler::set_metrics(std::shared_ptr<PerformanceMetrics> perf_metrics) {
     metrics = perf_metrics;
 }
@@ -499,15 +1158,41 @@ void WebSocketHandler::record_request(const std::string& method, const std::stri
     }
 }
 
+void WebSocketHandler::set_event_stream(std::shared_ptr<EventStreamHub> hub) {
+    event_stream = hub;
+    if (!hub) {
+        return;
+    }
+    
+    // Event ids are system metrics seqs, so Last-Event-ID resumes with a delta; without one
+    // (or when it is no longer in the history) the client starts from a full snapshot
+    std::shared_ptr<PerformanceMetrics> perf = metrics;
+    hub->set_replay([perf](const std::string& last_event_id) {
+        if (!perf) {
+            return std::string();
+        }
+        uint64_t seq = perf->get_latest_system_seq();
+        bool resume = !last_event_id.empty() && last_event_id.size() <= 19 &&
+                      std::all_of(last_event_id.begin(), last_event_id.end(), ::isdigit);
+        std::string system = resume ? perf->get_system_metrics_delta_json(std::stoull(last_event_id))
+                                    : perf->get_system_metrics_json();
+        return EventStreamHub::format_event(seq, perf->get_metrics_json()) +
+               EventStreamHub::format_event(seq, system) +
+               EventStreamHub::format_event(seq, perf->get_request_rate_json());
+    });
+}
+
 void WebSocketHandler::start() {
     running = true;
     
     // Create threads directly without shared_ptr complications
     broadcast_thread = std::thread([this]() {
+        ProcessStats::register_thread("background");
         this->broadcast_loop_safe();
     });
     
     ping_thread = std::thread([this]() {
+        ProcessStats::register_thread("background");
         this->ping_loop_safe();
     });
 }
@@ -561,6 +1246,8 @@ size_t WebSocketHandler::get_connection_count() const {
 }
 
 void WebSocketHandler::broadcast_loop() {
+    uint64_t last_broadcast_seq = metrics ? metrics->get_latest_system_seq() : 0;
+    
     while (running.load()) {
         try {
             std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -578,19 +1265,31 @@ void WebSocketHandler::broadcast_loop() {
                 }
             }
             
-            if (conn_count == 0) continue;
+            if ((conn_count == 0 || topic_index.subscriber_count(METRICS_TOPIC) == 0) && !has_event_stream_clients()) {
+                // Nobody to send to; new clients start from a snapshot anyway
+                if (metrics) last_broadcast_seq = metrics->get_latest_system_seq();
+                continue;
+            }
             
-            // Broadcast system metrics every second
+            // Broadcast only the samples recorded since the last tick
             if (metrics && running.load()) {
-                auto system_metrics = metrics->get_system_metrics_json();
-                broadcast_message(system_metrics);
+                uint64_t latest_seq = metrics->get_latest_system_seq();
+                if (latest_seq != last_broadcast_seq) {
+                    // The binary encoding is only built while a binary client is connected
+                    bool binary = binary_metrics_clients.load() > 0;
+                    publish_metrics(metrics->get_system_metrics_delta_json(last_broadcast_seq),
+                                    binary ? metrics->get_system_metrics_delta_binary(last_broadcast_seq) : std::string(),
+                                    latest_seq);
+                    last_broadcast_seq = latest_seq;
+                }
             }
             
             // Broadcast request rate every 5 seconds
             static int counter = 0;
             if (++counter % 5 == 0 && metrics && running.load()) {
                 auto request_rate = metrics->get_request_rate_json();
-                broadcast_message(request_rate);
+                publish_metrics(request_rate, binary_metrics_clients.load() > 0 ? metrics->get_request_rate_binary() : std::string(),
+                                last_broadcast_seq);
             }
             
         } catch (const std::exception& e) {
@@ -604,6 +1303,7 @@ void WebSocketHandler::broadcast_loop() {
 
 void WebSocketHandler::broadcast_loop_safe() {
     auto& coordinator = ShutdownCoordinator::instance();
+    uint64_t last_broadcast_seq = metrics ? metrics->get_latest_system_seq() : 0;
     
     while (running.load() && !coordinator.is_shutdown_requested()) {
         try {
@@ -614,25 +1314,38 @@ void WebSocketHandler::broadcast_loop_safe() {
             
             if (!running.load()) break;
             
-            // Check connection count with timeout-based lock
-            size_t conn_count = get_connection_count_safe();
-            if (conn_count == 0) continue;
+            // Fan-out cost depends only on the metrics topic's subscribers and event stream clients
+            if (topic_index.subscriber_count(METRICS_TOPIC) == 0 && !has_event_stream_clients()) {
+                // Nobody to send to; new clients start from a snapshot anyway
+                if (metrics) last_broadcast_seq = metrics->get_latest_system_seq();
+                continue;
+            }
             
-            // Broadcast system metrics
+            // Broadcast only the samples recorded since the last tick; new clients get a
+            // full snapshot on connect and the sequence numbers let them detect gaps
             if (metrics && running.load() && !coordinator.is_shutdown_requested()) {
-                auto system_metrics = metrics->get_system_metrics_json();
-                broadcast_message_safe(system_metrics);
+                uint64_t latest_seq = metrics->get_latest_system_seq();
+                if (latest_seq != last_broadcast_seq) {
+                    // The binary encoding is only built while a binary client is connected
+                    bool binary = binary_metrics_clients.load() > 0;
+                    publish_metrics(metrics->get_system_metrics_delta_json(last_broadcast_seq),
+                                    binary ? metrics->get_system_metrics_delta_binary(last_broadcast_seq) : std::string(),
+                                    latest_seq);
+                    last_broadcast_seq = latest_seq;
+                }
                 // Also broadcast basic aggregate metrics so clients that rely on 'metrics' type update
                 // without needing to send a request can function immediately.
                 auto basic_metrics = metrics->get_metrics_json();
-                broadcast_message_safe(basic_metrics);
+                publish_metrics(basic_metrics, binary_metrics_clients.load() > 0 ? metrics->get_metrics_binary() : std::string(),
+                                last_broadcast_seq);
             }
             
             // Broadcast request rate every 5 seconds
             static int counter = 0;
             if (++counter % 5 == 0 && metrics && running.load() && !coordinator.is_shutdown_requested()) {
                 auto request_rate = metrics->get_request_rate_json();
-                broadcast_message_safe(request_rate);
+                publish_metrics(request_rate, binary_metrics_clients.load() > 0 ? metrics->get_request_rate_binary() : std::string(),
+                                last_broadcast_seq);
             }
             
         } catch (const std::exception& e) {
@@ -669,7 +1382,7 @@ void WebSocketHandler::ping_loop() {
                     
                     if (!running.load()) break;
                     
-                    if (!send_ping(conn->socket)) {
+                    if (!send_ping(*conn)) {
                         dead_connections.push_back(client_id);
                     } else {
                         conn->last_ping = std::chrono::steady_clock::now();
@@ -723,7 +1436,7 @@ void WebSocketHandler::ping_loop_safe() {
                 const std::string& client_id = it->first;
                 const std::shared_ptr<WebSocketConnection>& conn = it->second;
                 
-                if (!send_ping(conn->socket)) {
+                if (!send_ping(*conn)) {
                     dead_connections.push_back(client_id);
                 } else {
                     conn->last_ping = std::chrono::steady_clock::now();
@@ -759,6 +1472,7 @@ void WebSocketHandler::broadcast_message_safe(const std::string& message) {
     }
     
     std::vector<std::string> dead_connections;
+    OutgoingFrames frames(message);
     
     for (auto it = connections.begin(); it != connections.end(); ++it) {
         if (!running.load() || ShutdownCoordinator::instance().is_shutdown_requested()) {
@@ -768,7 +1482,7 @@ void WebSocketHandler::broadcast_message_safe(const std::string& message) {
         const std::string& client_id = it->first;
         const std::shared_ptr<WebSocketConnection>& conn = it->second;
         
-        if (!send_frame(conn->socket, WS_OPCODE_TEXT, message)) {
+        if (!enqueue_frame(*conn, frame_for(*conn, frames), frames.coalesce_key)) {
             dead_connections.push_back(client_id);
         }
     }
@@ -791,7 +1505,8 @@ void WebSocketHandler::send_message_to_client_safe(const std::string& client_id,
     
     auto it = connections.find(client_id);
     if (it != connections.end()) {
-        if (!send_frame(it->second->socket, WS_OPCODE_TEXT, message)) {
+        OutgoingFrames frames(message);
+        if (!enqueue_frame(*it->second, frame_for(*it->second, frames), frames.coalesce_key)) {
             connections.erase(it);
         }
     }
@@ -805,69 +1520,9 @@ size_t WebSocketHandler::get_connection_count_safe() const {
     return 0; // Return 0 if we can't get the lock quickly
 }
 
-bool WebSocketHandler::handle_websocket_connection_safe(int client_socket, const std::string& client_id) {
-    add_connection(client_socket, client_id);
-    
-    std::vector<uint8_t> buffer(4096);
-    auto& coordinator = ShutdownCoordinator::instance();
-    
-    while (running.load() && !coordinator.is_shutdown_requested()) {
-        // Use select with timeout for non-blocking receive
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(client_socket, &read_fds);
-        
-        struct timeval timeout;
-        timeout.tv_sec = 1;  // 1 second timeout
-        timeout.tv_usec = 0;
-        
-        int select_result = select(client_socket + 1, &read_fds, nullptr, nullptr, &timeout);
-        
-        if (select_result < 0) {
-            break; // Error
-        }
-        
-        if (select_result == 0) {
-            continue; // Timeout, check shutdown and continue
-        }
-        
-        if (!FD_ISSET(client_socket, &read_fds)) {
-            continue;
-        }
-        
-        ssize_t bytes_received = recv(client_socket, buffer.data(), buffer.size(), 0);
-        
-        if (bytes_received > 0) {
-            buffer.resize(bytes_received);
-            WebSocketFrame frame = parse_frame(buffer);
-            
-            if (frame.opcode == WS_OPCODE_CLOSE || !running.load() || coordinator.is_shutdown_requested()) {
-                break;
-            } else if (frame.opcode == WS_OPCODE_PING) {
-                if (!send_pong(client_socket) || !running.load()) {
-                    break;
-                }
-            } else if (frame.opcode == WS_OPCODE_TEXT && running.load() && !coordinator.is_shutdown_requested()) {
-                std::string message(frame.payload.begin(), frame.payload.end());
-                
-                if (message == "request_metrics" && metrics) {
-                    send_message_to_client_safe(client_id, metrics->get_metrics_json());
-                } else if (message == "request_rate" && metrics) {
-                    send_message_to_client_safe(client_id, metrics->get_request_rate_json());
-                } else if (message == "system_metrics" && metrics) {
-                    send_message_to_client_safe(client_id, metrics->get_system_metrics_json());
-                }
-            }
-            
-            buffer.resize(4096);
-        } else if (bytes_received == 0) {
-            break; // Connection closed
-        } else {
-            break; // Error
-        }
-    }
-    
-    remove_connection(client_id);
-    close(client_socket);
-    return true;
-}
\ No newline at end of file
+bool WebSocketHandler::handle_websocket_connection_safe(int client_socket, const std::string& client_id,
+                                                        const WebSocketDeflateConfig& deflate_config,
+                                                        MetricsEncoding metrics_encoding) {
+    auto conn = add_connection(client_socket, client_id, deflate_config, metrics_encoding);
+    return run_connection(conn, true);
+}
@@ -0,0 +1,93 @@
+#include "../../include/handlers/websocket_topics.h"
+#include "../../include/handlers/websocket_handler.h"
+#include <algorithm>
+#include <cctype>
+
+const size_t WebSocketTopicIndex::SHARD_COUNT;
+const size_t WebSocketTopicIndex::MAX_TOPIC_LENGTH;
+
+bool WebSocketTopicIndex::is_valid_topic(const std::string& topic) {
+    if (topic.empty() || topic.length() > MAX_TOPIC_LENGTH) {
+        return false;
+    }
+    return std::all_of(topic.begin(), topic.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == ':' || c == '-';
+    });
+}
+
+WebSocketTopicIndex::Shard& WebSocketTopicIndex::shard_for(const std::string& topic) {
+    return shards[std::hash<std::string>()(topic) % SHARD_COUNT];
+}
+
+const WebSocketTopicIndex::Shard& WebSocketTopicIndex::shard_for(const std::string& topic) const {
+    return shards[std::hash<std::string>()(topic) % SHARD_COUNT];
+}
+
+bool WebSocketTopicIndex::subscribe(const std::string& topic, const std::shared_ptr<WebSocketConnection>& conn) {
+    Shard& shard = shard_for(topic);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto& current = shard.topics[topic];
+    if (current && std::find(current->begin(), current->end(), conn) != current->end()) {
+        return false;
+    }
+
+    auto updated = current ? std::make_shared<SubscriberList>(*current) : std::make_shared<SubscriberList>();
+    updated->push_back(conn);
+    current = updated;
+    return true;
+}
+
+bool WebSocketTopicIndex::unsubscribe(const std::string& topic, const std::shared_ptr<WebSocketConnection>& conn) {
+    Shard& shard = shard_for(topic);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.topics.find(topic);
+    if (it == shard.topics.end()) {
+        return false;
+    }
+
+    const SubscriberList& current = *it->second;
+    auto pos = std::find(current.begin(), current.end(), conn);
+    if (pos == current.end()) {
+        return false;
+    }
+
+    if (current.size() == 1) {
+        shard.topics.erase(it);   // last subscriber: drop the topic
+        return true;
+    }
+
+    auto updated = std::make_shared<SubscriberList>();
+    updated->reserve(current.size() - 1);
+    for (const auto& subscriber : current) {
+        if (subscriber != conn) {
+            updated->push_back(subscriber);
+        }
+    }
+    it->second = updated;
+    return true;
+}
+
+std::shared_ptr<const WebSocketTopicIndex::SubscriberList>
+WebSocketTopicIndex::subscribers(const std::string& topic) const {
+    static const std::shared_ptr<const SubscriberList> empty = std::make_shared<SubscriberList>();
+
+    const Shard& shard = shard_for(topic);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.topics.find(topic);
+    return it != shard.topics.end() ? it->second : empty;
+}
+
+size_t WebSocketTopicIndex::subscriber_count(const std::string& topic) const {
+    return subscribers(topic)->size();
+}
+
+size_t WebSocketTopicIndex::topic_count() const {
+    size_t total = 0;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.topics.size();
+    }
+    return total;
+}
@@ -0,0 +1,231 @@
+#include "../../include/network/websocket_deflate.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+std::string trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t");
+    return value.substr(start, end - start + 1);
+}
+
+std::vector<std::string> split(const std::string& value, char delimiter) {
+    std::vector<std::string> parts;
+    std::istringstream iss(value);
+    std::string part;
+    while (std::getline(iss, part, delimiter)) {
+        parts.push_back(trim(part));
+    }
+    return parts;
+}
+
+// Parse "8".."15" (optionally quoted); returns 0 when invalid
+int parse_window_bits(std::string value) {
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+    if (value.empty() || value.size() > 2 ||
+        !std::all_of(value.begin(), value.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; })) {
+        return 0;
+    }
+    int bits = std::stoi(value);
+    return (bits >= 8 && bits <= 15) ? bits : 0;
+}
+
+// Evaluate a single offer; returns false if it must be declined
+bool accept_offer(const std::vector<std::string>& params, WebSocketDeflateConfig& config,
+                  std::string& response_value) {
+    WebSocketDeflateConfig candidate;
+    candidate.enabled = true;
+    bool seen_server_nct = false, seen_client_nct = false, seen_server_bits = false, seen_client_bits = false;
+
+    for (size_t i = 1; i < params.size(); i++) {
+        std::string name = params[i];
+        std::string value;
+        size_t eq = name.find('=');
+        if (eq != std::string::npos) {
+            value = trim(name.substr(eq + 1));
+            name = trim(name.substr(0, eq));
+        }
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+        if (name == "server_no_context_takeover") {
+            if (seen_server_nct || !value.empty()) return false;
+            seen_server_nct = true;
+        } else if (name == "client_no_context_takeover") {
+            if (seen_client_nct || !value.empty()) return false;
+            seen_client_nct = true;
+            candidate.client_no_context_takeover = true;
+        } else if (name == "server_max_window_bits") {
+            if (seen_server_bits) return false;
+            seen_server_bits = true;
+            int bits = parse_window_bits(value);
+            // zlib cannot produce a raw deflate stream with an 8-bit window
+            if (bits < 9) return false;
+            candidate.server_max_window_bits = bits;
+        } else if (name == "client_max_window_bits") {
+            if (seen_client_bits) return false;
+            seen_client_bits = true;
+            // Value is optional; our inflater always uses a 15-bit window, which
+            // decodes any smaller client window, so no limit is sent back.
+            if (!value.empty() && parse_window_bits(value) == 0) return false;
+        } else {
+            return false; // Unknown parameter: decline this offer
+        }
+    }
+
+    std::ostringstream response;
+    response << "permessage-deflate; server_no_context_takeover";
+    if (candidate.client_no_context_takeover) {
+        response << "; client_no_context_takeover";
+    }
+    if (seen_server_bits) {
+        response << "; server_max_window_bits=" << candidate.server_max_window_bits;
+    }
+
+    config = candidate;
+    response_value = response.str();
+    return true;
+}
+
+const uint8_t DEFLATE_TAIL[4] = {0x00, 0x00, 0xff, 0xff};
+
+} // namespace
+
+bool negotiate_permessage_deflate(const std::string& extensions_header,
+                                  WebSocketDeflateConfig& config,
+                                  std::string& response_value) {
+    // Offers are comma separated, parameters semicolon separated
+    for (const auto& offer : split(extensions_header, ',')) {
+        std::vector<std::string> params = split(offer, ';');
+        if (params.empty()) {
+            continue;
+        }
+        std::string name = params[0];
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name != "permessage-deflate") {
+            continue;
+        }
+        if (accept_offer(params, config, response_value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool websocket_deflate_message(const std::string& input, int window_bits, std::string& output) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // Negative window bits selects a raw deflate stream (no zlib header)
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())) + 8);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    int rv = deflate(&stream, Z_SYNC_FLUSH);
+    size_t produced = output.size() - stream.avail_out;
+    deflateEnd(&stream);
+
+    if (rv != Z_OK || stream.avail_in != 0 || produced < 4) {
+        return false;
+    }
+
+    // A sync flush always ends with an empty stored block: 00 00 ff ff
+    if (std::memcmp(output.data() + produced - 4, DEFLATE_TAIL, 4) == 0) {
+        produced -= 4;
+    }
+    output.resize(produced);
+    return true;
+}
+
+// WebSocketInflater Implementation
+WebSocketInflater::WebSocketInflater(bool reset_per_message)
+    : initialized(false), reset_per_message(reset_per_message) {
+    std::memset(&stream, 0, sizeof(stream));
+    initialized = inflateInit2(&stream, -15) == Z_OK;
+}
+
+WebSocketInflater::~WebSocketInflater() {
+    if (initialized) {
+        inflateEnd(&stream);
+    }
+}
+
+WebSocketInflater::Result WebSocketInflater::inflate_message(const std::vector<uint8_t>& input,
+                                                             std::vector<uint8_t>& output,
+                                                             size_t max_size) {
+    if (!initialized) {
+        return CORRUPT;
+    }
+
+    output.clear();
+    uint8_t chunk[16384];
+
+    // Feed the payload followed by the tail the sender stripped
+    const uint8_t* parts[2] = {input.data(), DEFLATE_TAIL};
+    size_t lengths[2] = {input.size(), sizeof(DEFLATE_TAIL)};
+
+    for (int p = 0; p < 2; p++) {
+        stream.next_in = const_cast<Bytef*>(parts[p]);
+        stream.avail_in = static_cast<uInt>(lengths[p]);
+
+        while (stream.avail_in > 0) {
+            stream.next_out = chunk;
+            stream.avail_out = sizeof(chunk);
+
+            int rv = inflate(&stream, Z_SYNC_FLUSH);
+            if (rv != Z_OK && rv != Z_BUF_ERROR && rv != Z_STREAM_END) {
+                inflateReset(&stream);
+                return CORRUPT;
+            }
+
+            size_t produced = sizeof(chunk) - stream.avail_out;
+            if (output.size() + produced > max_size) {
+                inflateReset(&stream);
+                return TOO_LARGE;
+            }
+            output.insert(output.end(), chunk, chunk + produced);
+
+            if (rv == Z_BUF_ERROR && produced == 0) {
+                break;
+            }
+            if (rv == Z_STREAM_END) {
+                // Sender finished a final block; further messages start a new stream
+                inflateReset(&stream);
+                break;
+            }
+        }
+    }
+
+    // Drain any output still buffered inside zlib
+    while (true) {
+        stream.next_out = chunk;
+        stream.avail_out = sizeof(chunk);
+        int rv = inflate(&stream, Z_SYNC_FLUSH);
+        size_t produced = sizeof(chunk) - stream.avail_out;
+        if (produced == 0 || (rv != Z_OK && rv != Z_BUF_ERROR)) {
+            break;
+        }
+        if (output.size() + produced > max_size) {
+            inflateReset(&stream);
+            return TOO_LARGE;
+        }
+        output.insert(output.end(), chunk, chunk + produced);
+    }
+
+    if (reset_per_message) {
+        inflateReset(&stream);
+    }
+    return OK;
+}
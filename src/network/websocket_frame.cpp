@@ -0,0 +1,358 @@
+#include "../../include/network/websocket_frame.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WS_UNMASK_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WS_UNMASK_NEON 1
+#endif
+
+namespace {
+
+#if defined(WS_UNMASK_X86) && defined(__GNUC__)
+// Compiled for AVX2 regardless of -march; only called after a runtime CPU check
+__attribute__((target("avx2")))
+size_t unmask_avx2(uint8_t* data, size_t len, uint32_t key) {
+    const __m256i key_vec = _mm256_set1_epi32(static_cast<int>(key));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(chunk, key_vec));
+    }
+    return i;
+}
+
+bool cpu_has_avx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+size_t unmask_vector(uint8_t* data, size_t len, uint32_t key) {
+    size_t i = 0;
+#if defined(WS_UNMASK_X86)
+#if defined(__GNUC__)
+    if (len >= 64 && cpu_has_avx2()) {
+        i = unmask_avx2(data, len, key);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i key_vec = _mm_set1_epi32(static_cast<int>(key));
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(chunk, key_vec));
+    }
+#endif
+#elif defined(WS_UNMASK_NEON)
+    const uint8x16_t key_vec = vreinterpretq_u8_u32(vdupq_n_u32(key));
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), key_vec));
+    }
+#endif
+    return i;
+}
+
+} // namespace
+
+void websocket_unmask(uint8_t* data, size_t len, const uint8_t mask[4], size_t mask_offset) {
+    // Rotate the mask so that byte 0 of 'data' lines up with mask[0] of the key
+    uint8_t rotated[4];
+    for (int k = 0; k < 4; k++) {
+        rotated[k] = mask[(mask_offset + k) & 3];
+    }
+    uint32_t key;
+    std::memcpy(&key, rotated, sizeof(key));
+
+    // Vector lanes are multiples of 4 bytes, so the key stays in phase
+    size_t i = unmask_vector(data, len, key);
+
+    const uint64_t key64 = (static_cast<uint64_t>(key) << 32) | key;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        word ^= key64;
+        std::memcpy(data + i, &word, sizeof(word));
+    }
+
+    for (; i < len; i++) {
+        data[i] ^= rotated[i & 3];
+    }
+}
+
+// ByteRingBuffer Implementation
+static size_t round_up_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+ByteRingBuffer::ByteRingBuffer(size_t capacity)
+    : storage(round_up_pow2(std::max<size_t>(capacity, 64))), mask(storage.size() - 1), head(0), tail(0) {}
+
+uint8_t* ByteRingBuffer::write_ptr(size_t& contiguous) {
+    if (writable() == 0) {
+        grow(capacity() * 2);
+    }
+    size_t write_index = tail & mask;
+    contiguous = std::min(capacity() - write_index, writable());
+    return storage.data() + write_index;
+}
+
+void ByteRingBuffer::commit(size_t len) {
+    tail += std::min(len, writable());
+}
+
+void ByteRingBuffer::write(const uint8_t* data, size_t len) {
+    if (len > writable()) {
+        grow(size() + len);
+    }
+    while (len > 0) {
+        size_t contiguous = 0;
+        uint8_t* dest = write_ptr(contiguous);
+        size_t chunk = std::min(contiguous, len);
+        std::memcpy(dest, data, chunk);
+        commit(chunk);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+void ByteRingBuffer::peek_bytes(uint8_t* dest, size_t len) const {
+    len = std::min(len, size());
+    size_t read_index = head & mask;
+    size_t first = std::min(len, capacity() - read_index);
+    std::memcpy(dest, storage.data() + read_index, first);
+    if (len > first) {
+        std::memcpy(dest + first, storage.data(), len - first);
+    }
+}
+
+void ByteRingBuffer::read(uint8_t* dest, size_t len) {
+    len = std::min(len, size());
+    peek_bytes(dest, len);
+    consume(len);
+}
+
+void ByteRingBuffer::consume(size_t len) {
+    head += std::min(len, size());
+    if (head == tail) {
+        // Reset positions so the next recv gets the whole buffer contiguously
+        head = tail = 0;
+    }
+}
+
+void ByteRingBuffer::grow(size_t min_capacity) {
+    size_t new_capacity = round_up_pow2(std::max(min_capacity, capacity() * 2));
+    std::vector<uint8_t> new_storage(new_capacity);
+    size_t used = size();
+    peek_bytes(new_storage.data(), used);
+    storage.swap(new_storage);
+    mask = new_capacity - 1;
+    head = 0;
+    tail = used;
+}
+
+// WebSocketFrameDecoder Implementation
+namespace {
+const uint8_t OPCODE_CONTINUATION = 0x0;
+const uint8_t OPCODE_TEXT = 0x1;
+const uint8_t OPCODE_BINARY = 0x2;
+const uint8_t OPCODE_PONG = 0xa;
+const size_t RECV_CHUNK = 16384;
+} // namespace
+
+const size_t WebSocketFrameDecoder::DEFAULT_MAX_MESSAGE_SIZE;
+const uint16_t WebSocketFrameDecoder::CLOSE_NORMAL;
+const uint16_t WebSocketFrameDecoder::CLOSE_PROTOCOL_ERROR;
+const uint16_t WebSocketFrameDecoder::CLOSE_MESSAGE_TOO_BIG;
+
+WebSocketFrameDecoder::WebSocketFrameDecoder(size_t max_message_size, bool require_mask)
+    : ring(RECV_CHUNK), max_message_size(max_message_size), require_mask(require_mask),
+      allow_rsv1(false), state(READ_HEADER), frame_fin(false), frame_opcode(0), frame_rsv(0), frame_masked(false),
+      frame_length(0), frame_received(0), in_message(false), message_opcode(0),
+      message_compressed(false), error_close_code(0) {
+    std::memset(frame_mask, 0, sizeof(frame_mask));
+}
+
+ssize_t WebSocketFrameDecoder::read_from(int socket) {
+    size_t contiguous = 0;
+    uint8_t* dest = ring.write_ptr(contiguous);
+    ssize_t bytes_received = recv(socket, dest, contiguous, 0);
+    if (bytes_received > 0) {
+        ring.commit(static_cast<size_t>(bytes_received));
+    }
+    return bytes_received;
+}
+
+void WebSocketFrameDecoder::feed(const uint8_t* data, size_t len) {
+    ring.write(data, len);
+}
+
+bool WebSocketFrameDecoder::parse_header() {
+    if (ring.size() < 2) {
+        return false;
+    }
+
+    uint8_t byte0 = ring.peek(0);
+    uint8_t byte1 = ring.peek(1);
+    size_t header_len = 2;
+    uint64_t length = byte1 & 0x7F;
+
+    if (length == 126) {
+        header_len += 2;
+    } else if (length == 127) {
+        header_len += 8;
+    }
+    bool masked = (byte1 & 0x80) != 0;
+    if (masked) {
+        header_len += 4;
+    }
+
+    if (ring.size() < header_len) {
+        return false;
+    }
+
+    uint8_t header[14];
+    ring.read(header, header_len);
+
+    size_t pos = 2;
+    if (length == 126) {
+        length = (static_cast<uint64_t>(header[2]) << 8) | header[3];
+        pos = 4;
+    } else if (length == 127) {
+        length = 0;
+        for (int i = 0; i < 8; i++) {
+            length = (length << 8) | header[2 + i];
+        }
+        pos = 10;
+    }
+
+    frame_fin = (byte0 & 0x80) != 0;
+    frame_opcode = byte0 & 0x0F;
+    frame_masked = masked;
+    frame_length = length;
+    frame_received = 0;
+    if (masked) {
+        std::memcpy(frame_mask, header + pos, 4);
+    }
+
+    frame_rsv = byte0 & 0x70;
+    return true;
+}
+
+WebSocketFrameDecoder::Status WebSocketFrameDecoder::fail(uint16_t code, const std::string& reason) {
+    state = FAILED;
+    error_close_code = code;
+    error_text = reason;
+    return PROTOCOL_ERROR;
+}
+
+WebSocketFrameDecoder::Status WebSocketFrameDecoder::next(WebSocketMessage& out) {
+    while (true) {
+        if (state == FAILED) {
+            return PROTOCOL_ERROR;
+        }
+
+        if (state == READ_HEADER) {
+            if (!parse_header()) {
+                return NEED_MORE;
+            }
+
+            bool rsv1 = (frame_rsv & 0x40) != 0;
+            if ((frame_rsv & 0x30) != 0 || (rsv1 && !allow_rsv1)) {
+                return fail(CLOSE_PROTOCOL_ERROR, "reserved bits set without a negotiated extension");
+            }
+            if (require_mask && !frame_masked) {
+                return fail(CLOSE_PROTOCOL_ERROR, "client frames must be masked");
+            }
+            if (frame_length >> 63) {
+                return fail(CLOSE_PROTOCOL_ERROR, "invalid payload length");
+            }
+
+            bool is_control = (frame_opcode & 0x08) != 0;
+            if (is_control) {
+                if (frame_opcode > OPCODE_PONG) {
+                    return fail(CLOSE_PROTOCOL_ERROR, "unknown control opcode");
+                }
+                if (!frame_fin || frame_length > 125 || rsv1) {
+                    return fail(CLOSE_PROTOCOL_ERROR, "invalid control frame");
+                }
+                control_payload.clear();
+                control_payload.reserve(static_cast<size_t>(frame_length));
+            } else if (frame_opcode == OPCODE_CONTINUATION) {
+                if (!in_message) {
+                    return fail(CLOSE_PROTOCOL_ERROR, "continuation frame without a message");
+                }
+                if (rsv1) {
+                    return fail(CLOSE_PROTOCOL_ERROR, "RSV1 set on a continuation frame");
+                }
+            } else if (frame_opcode == OPCODE_TEXT || frame_opcode == OPCODE_BINARY) {
+                if (in_message) {
+                    return fail(CLOSE_PROTOCOL_ERROR, "new message before previous one finished");
+                }
+                in_message = true;
+                message_opcode = frame_opcode;
+                message_compressed = rsv1;
+                message_payload.clear();
+            } else {
+                return fail(CLOSE_PROTOCOL_ERROR, "unknown data opcode");
+            }
+
+            if (!is_control) {
+                if (frame_length > max_message_size - std::min(max_message_size, message_payload.size())) {
+                    return fail(CLOSE_MESSAGE_TOO_BIG, "message exceeds maximum size");
+                }
+                message_payload.reserve(message_payload.size() + static_cast<size_t>(frame_length));
+            }
+
+            state = READ_PAYLOAD;
+        }
+
+        // READ_PAYLOAD: move whatever part of the payload has arrived out of the ring
+        bool is_control = (frame_opcode & 0x08) != 0;
+        std::vector<uint8_t>& target = is_control ? control_payload : message_payload;
+
+        size_t remaining = static_cast<size_t>(frame_length - frame_received);
+        size_t available = std::min(remaining, ring.size());
+        if (available > 0) {
+            size_t start = target.size();
+            target.resize(start + available);
+            ring.read(target.data() + start, available);
+            if (frame_masked) {
+                websocket_unmask(target.data() + start, available, frame_mask,
+                                 static_cast<size_t>(frame_received));
+            }
+            frame_received += available;
+        }
+
+        if (frame_received < frame_length) {
+            return NEED_MORE;
+        }
+
+        state = READ_HEADER;
+
+        if (is_control) {
+            out.opcode = frame_opcode;
+            out.compressed = false;
+            out.payload.swap(control_payload);
+            control_payload.clear();
+            return MESSAGE;
+        }
+
+        if (frame_fin) {
+            out.opcode = message_opcode;
+            out.compressed = message_compressed;
+            out.payload.swap(message_payload);
+            message_payload.clear();
+            in_message = false;
+            return MESSAGE;
+        }
+        // Non-final fragment: keep reassembling
+    }
+}
@@ -0,0 +1,103 @@
+// Unit tests for admission control in the acceptor: picking a thread pool lane from the
+// peeked request line, and the 503 sent when that lane is full
+#include "../../include/core/server.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+// Lane for a connection whose client has sent 'data'; the bytes stay unread
+static ThreadPool::Priority classify(const std::string& data, std::string* left = nullptr) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        return ThreadPool::PRIORITY_COUNT;
+    }
+    if (!data.empty() && write(sockets[1], data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+        close(sockets[0]);
+        close(sockets[1]);
+        return ThreadPool::PRIORITY_COUNT;
+    }
+    ThreadPool::Priority priority = WebServer::connection_priority(sockets[0]);
+    if (left) {
+        char buffer[512];
+        ssize_t bytes = recv(sockets[0], buffer, sizeof(buffer), MSG_DONTWAIT);
+        left->assign(buffer, bytes > 0 ? static_cast<size_t>(bytes) : 0);
+    }
+    close(sockets[0]);
+    close(sockets[1]);
+    return priority;
+}
+
+static void test_lanes() {
+    std::string left;
+    check(classify("GET /health HTTP/1.1\r\nHost: x\r\n\r\n", &left) == ThreadPool::HIGH,
+          "health checks are high priority");
+    check(left == "GET /health HTTP/1.1\r\nHost: x\r\n\r\n", "classifying leaves the request for the worker");
+    check(classify("GET /metrics HTTP/1.1\r\n\r\n") == ThreadPool::HIGH &&
+          classify("GET /api/stats?x=1 HTTP/1.1\r\n\r\n") == ThreadPool::HIGH &&
+          classify("POST /api/log-levels HTTP/1.1\r\n\r\n") == ThreadPool::HIGH,
+          "metrics and admin endpoints are high priority, with or without a query");
+    check(classify("GET /ws HTTP/1.1\r\n\r\n") == ThreadPool::LOW &&
+          classify("GET /api/metrics/stream HTTP/1.1\r\n\r\n") == ThreadPool::LOW,
+          "long-lived upgrades are low priority");
+    check(classify("GET / HTTP/1.1\r\n\r\n") == ThreadPool::NORMAL &&
+          classify("GET /healthz HTTP/1.1\r\n\r\n") == ThreadPool::NORMAL &&
+          classify("GET /api/stats/extra HTTP/1.1\r\n\r\n") == ThreadPool::NORMAL,
+          "other paths, including ones that only start like a high route, are normal");
+    check(classify("") == ThreadPool::NORMAL && classify("\x16\x03\x01\x02\x00") == ThreadPool::NORMAL &&
+          classify("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n") == ThreadPool::NORMAL,
+          "nothing sent yet, TLS and HTTP/2 prior knowledge are normal");
+    check(classify("GET /" + std::string(400, 'a') + " HTTP/1.1\r\n\r\n") == ThreadPool::NORMAL,
+          "a request line longer than the peek is normal");
+}
+
+static void test_overloaded_response() {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        check(false, "socketpair");
+        return;
+    }
+    std::string request = "GET / HTTP/1.1\r\nHost: x\r\n\r\n";
+    ssize_t written = write(sockets[1], request.data(), request.size());
+    (void)written;
+    WebServer::send_overloaded(sockets[0]);
+
+    char buffer[1024];
+    ssize_t bytes = recv(sockets[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+    std::string response(buffer, bytes > 0 ? static_cast<size_t>(bytes) : 0);
+    char unread;
+    bool drained = recv(sockets[0], &unread, 1, MSG_DONTWAIT) < 0;
+    close(sockets[0]);
+    close(sockets[1]);
+
+    check(response.compare(0, 34, "HTTP/1.1 503 Service Unavailable\r\n") == 0, "a full lane is answered 503");
+    check(response.find("\r\nRetry-After: 1\r\n") != std::string::npos &&
+          response.find("\r\nConnection: close\r\n") != std::string::npos,
+          "the 503 asks the client to retry and closes the connection");
+    size_t body = response.find("\r\n\r\n");
+    size_t length = response.find("Content-Length: ");
+    check(body != std::string::npos && length != std::string::npos &&
+          std::stoul(response.substr(length + 16)) == response.size() - body - 4,
+          "Content-Length matches the body");
+    check(drained, "the request is read first, so closing does not reset the connection");
+}
+
+int main() {
+    std::cout << "Admission control tests" << std::endl;
+
+    test_lanes();
+    test_overloaded_response();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All admission control tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
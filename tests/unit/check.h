@@ -0,0 +1,20 @@
+#ifndef UNIT_CHECK_H
+#define UNIT_CHECK_H
+
+#include <iostream>
+#include <string>
+
+// Pass/fail reporting shared by the unit tests. Each test is its own program, so each
+// gets its own counter; main() returns EXIT_FAILURE when it is non-zero.
+static int failures = 0;
+
+static void check(bool condition, const std::string& name) {
+    if (condition) {
+        std::cout << "✅ " << name << std::endl;
+    } else {
+        std::cout << "❌ " << name << std::endl;
+        failures++;
+    }
+}
+
+#endif // UNIT_CHECK_H
@@ -0,0 +1,105 @@
+// Unit tests for the sampling CPU profiler: frame names, sampling registered threads,
+// folded output and the SVG flame graph
+#include "../../include/core/cpu_profiler.h"
+#include "../../include/core/process_stats.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static std::atomic<bool> spinning{true};
+static volatile uint64_t sink = 0;
+
+// Exported and never inlined, so the profiler can name it through the dynamic symbol table
+__attribute__((noinline)) void cpu_profiler_test_spin() {
+    while (spinning.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 1000; i++) {
+            sink = sink * 31 + static_cast<uint64_t>(i);
+        }
+    }
+}
+
+static void test_frame_names() {
+    check(CpuProfiler::frame_name("WebServer::handle_request(HttpRequest const&, bool&)") ==
+          "WebServer::handle_request", "parameter lists are dropped");
+    check(CpuProfiler::frame_name("ThreadPool::get_queue_size() const") == "ThreadPool::get_queue_size",
+          "trailing qualifiers are dropped with the parameters");
+    check(CpuProfiler::frame_name("std::function<void ()>::operator()() const") ==
+          "std::function<void ()>::operator()", "operator() keeps its own parentheses");
+    check(CpuProfiler::frame_name("foo(int) [clone .cold]") == "foo", "clone suffixes are dropped");
+    check(CpuProfiler::frame_name("a;b") == "a:b", "semicolons cannot split a folded frame");
+}
+
+static void test_sampling() {
+    std::thread spinner([]() {
+        ProcessStats::register_thread("spinner");
+        cpu_profiler_test_spin();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    CpuProfiler::Profile profile;
+    CpuProfiler::Result busy_result = CpuProfiler::OK;
+    std::thread second([&busy_result]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        CpuProfiler::Profile ignored;
+        busy_result = CpuProfiler::instance().profile(1, 10, ignored);
+    });
+    CpuProfiler::Result result = CpuProfiler::instance().profile(1, 200, profile);
+    second.join();
+    spinning.store(false);
+    spinner.join();
+
+    check(result == CpuProfiler::OK && profile.threads >= 1, "profile samples the registered threads");
+    check(busy_result == CpuProfiler::BUSY, "only one profile runs at a time");
+    // 1 s of CPU at 200 Hz; allow for a loaded test machine
+    check(profile.samples >= 50 && profile.samples <= 260, "sample count follows the rate and duration");
+
+    bool found = false;
+    for (const auto& stack : profile.stacks) {
+        if (stack.first.compare(0, 8, "spinner;") == 0 &&
+            stack.first.find("cpu_profiler_test_spin") != std::string::npos) {
+            found = true;
+        }
+    }
+    check(found, "stacks start at the thread role and name the spinning function");
+
+    std::string folded = CpuProfiler::folded(profile);
+    check(!folded.empty() && folded.back() == '\n' && folded.find(";cpu_profiler_test_spin") != std::string::npos,
+          "folded output has one \"stack count\" line per stack");
+}
+
+static void test_flamegraph() {
+    CpuProfiler::Profile profile;
+    profile.stacks = {{"worker;main;a<b>", 3}, {"worker;main;c", 1}};
+    profile.samples = 4;
+    profile.dropped = 0;
+    profile.threads = 1;
+    profile.seconds = 1;
+    profile.hz = 99;
+    std::string svg = CpuProfiler::flamegraph_svg(profile, "test & title");
+    check(svg.find("<svg") != std::string::npos && svg.find("</svg>") != std::string::npos,
+          "flame graph is a complete SVG document");
+    check(svg.find("a&lt;b&gt; (3 samples, 75.00%)") != std::string::npos && svg.find("test &amp; title") != std::string::npos,
+          "frame titles carry escaped names and their share");
+    check(svg.find("<title>main (4 samples, 100.00%)") != std::string::npos, "shared frames are merged");
+}
+
+int main() {
+    std::cout << "CPU profiler tests" << std::endl;
+
+    test_frame_names();
+    test_sampling();
+    test_flamegraph();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All CPU profiler tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+// Unit tests for the server-sent event stream fan-out
+#include "../../include/handlers/event_stream.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static void test_format_event() {
+    check(EventStreamHub::format_event(7, "{\"a\":1}") == "id: 7\ndata: {\"a\":1}\n\n",
+          "single-line payload becomes one data line");
+    check(EventStreamHub::format_event(8, "one\ntwo") == "id: 8\ndata: one\ndata: two\n\n",
+          "every payload line gets its own data prefix");
+}
+
+static void test_subscribe_replay() {
+    EventStreamHub hub;
+    std::string seen_id;
+    hub.set_replay([&seen_id](const std::string& last_event_id) {
+        seen_id = last_event_id;
+        return EventStreamHub::format_event(5, "snapshot");
+    });
+
+    int notify_fd = eventfd(0, EFD_NONBLOCK);
+    auto subscriber = hub.subscribe("4", notify_fd);
+    hub.publish(6, "live");
+
+    std::string out;
+    bool open = subscriber->take(out);
+    check(seen_id == "4", "replay receives the client's Last-Event-ID");
+    check(open && out == "retry: 3000\n\nid: 5\ndata: snapshot\n\nid: 6\ndata: live\n\n",
+          "retry hint and replay are queued before published events");
+
+    uint64_t count = 0;
+    check(read(notify_fd, &count, sizeof(count)) == sizeof(count) && count > 0,
+          "queued events signal the notify fd");
+    check(hub.subscriber_count() == 1, "subscriber is counted");
+
+    subscriber.reset();
+    hub.publish(7, "after");
+    check(hub.subscriber_count() == 0, "released subscribers are dropped on publish");
+    close(notify_fd);
+}
+
+static void test_slow_subscriber_closed() {
+    EventStreamSubscriber subscriber(-1, 64);
+    check(subscriber.push(std::string(40, 'x')), "events within the limit are queued");
+    check(!subscriber.push(std::string(40, 'y')), "exceeding the limit closes the subscriber");
+
+    std::string out;
+    check(!subscriber.take(out) && out.empty(), "closed subscriber discards its backlog");
+    check(!subscriber.push("late"), "closed subscriber rejects new events");
+}
+
+static void test_take_drains_before_closing() {
+    EventStreamSubscriber subscriber(-1, 1024);
+    subscriber.push("last");
+    subscriber.close();
+
+    std::string out;
+    check(subscriber.take(out) && out == "last", "queued events are still delivered after close");
+    check(!subscriber.take(out), "take reports end of stream once drained");
+}
+
+int main() {
+    std::cout << "Event stream tests" << std::endl;
+
+    test_format_event();
+    test_subscribe_replay();
+    test_slow_subscriber_closed();
+    test_take_drains_before_closing();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All event stream tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+// Unit tests for the flight recorder: ring order and wrap-around, concurrent writers,
+// record formatting and slow-request dumps
+#include "../../include/core/flight_recorder.h"
+#include "check.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static FlightRecorder::Record make_record(const std::string& path, int64_t start_ns, int64_t total_ns) {
+    FlightRecorder::Record record = {};
+    record.connection_id = 7;
+    record.protocol = FlightRecorder::HTTP1;
+    record.first_byte_ns = start_ns;
+    record.parsed_ns = start_ns + total_ns / 4;
+    record.handled_ns = start_ns + total_ns / 2;
+    record.finished_ns = start_ns + total_ns;
+    record.status = 200;
+    record.bytes_sent = 512;
+    record.set_request("GET", path);
+    return record;
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+// Name of the first dump file in 'directory', "" if none
+static std::string find_dump(const char* directory) {
+    std::string found;
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        return found;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (std::string(entry->d_name).compare(0, 7, "flight-") == 0) {
+            found = entry->d_name;
+            break;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+static void test_ring() {
+    FlightRecorder& recorder = FlightRecorder::instance();
+    for (size_t i = 0; i < FlightRecorder::CAPACITY + 10; i++) {
+        FlightRecorder::Record record = make_record("/item/" + std::to_string(i), 1000000, 2000000);
+        recorder.record(record);
+    }
+    std::vector<FlightRecorder::Record> records;
+    recorder.snapshot(records);
+    check(records.size() == FlightRecorder::CAPACITY, "the ring keeps the last CAPACITY records");
+    check(std::string(records.front().path) == "/item/10" &&
+          std::string(records.back().path) == "/item/" + std::to_string(FlightRecorder::CAPACITY + 9),
+          "oldest records are overwritten and the snapshot is in order");
+    check(records.back().worker > 0 && records.back().time_ms > 0, "record() fills in the worker and time");
+
+    FlightRecorder::Record record = make_record(std::string(200, 'x'), 1, 1);
+    check(std::string(record.path).size() == sizeof(record.path) - 1, "long paths are truncated");
+}
+
+static void test_concurrent_writers() {
+    FlightRecorder& recorder = FlightRecorder::instance();
+    uint64_t before = recorder.get_stats().recorded;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&recorder, t]() {
+            for (int i = 0; i < 5000; i++) {
+                FlightRecorder::Record record = make_record("/thread/" + std::to_string(t), 1000, 1000);
+                recorder.record(record);
+            }
+        });
+    }
+    std::vector<FlightRecorder::Record> records;
+    for (int i = 0; i < 20; i++) {
+        recorder.snapshot(records);
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    recorder.snapshot(records);
+    bool consistent = records.size() == FlightRecorder::CAPACITY;
+    for (const auto& record : records) {
+        consistent = consistent && std::string(record.path).compare(0, 8, "/thread/") == 0 &&
+                     record.finished_ns == record.first_byte_ns + 1000;
+    }
+    check(recorder.get_stats().recorded - before == 20000, "every record gets a sequence number");
+    check(consistent, "snapshots taken during concurrent writes only see whole records");
+}
+
+static void test_format() {
+    FlightRecorder::Record record = make_record("/slow", 1000000000, 8000000);
+    record.sequence = 42;
+    record.time_ms = 3723004;   // 01:02:03.004
+    std::string line;
+    FlightRecorder::format_record(record, line);
+    check(line.compare(0, 12, "01:02:03.004") == 0 && line.find(" http/1.1 ") != std::string::npos &&
+          line.find(" GET ") != std::string::npos, "lines start with the time, protocol and method");
+    check(line.find("      2000      2000      4000      8000 /slow\n") != std::string::npos,
+          "phases are in microseconds and the path comes last");
+    check(line.find("         -         - ") != std::string::npos, "missing phases show as -");
+}
+
+static void test_slow_dump() {
+    char directory[] = "/tmp/flight_recorder_test_XXXXXX";
+    check(mkdtemp(directory) != nullptr, "temporary dump directory");
+    FlightRecorder& recorder = FlightRecorder::instance();
+    check(!recorder.configure("/nonexistent/flight", 0), "a missing dump directory is rejected");
+    check(recorder.configure(directory, 50), "configure the dump directory and a 50 ms threshold");
+    recorder.set_context([]() { return std::string("queued tasks: 3"); });
+    recorder.start();
+
+    int64_t now = FlightRecorder::nanos(std::chrono::steady_clock::now());
+    FlightRecorder::Record fast = make_record("/fast", now, 1000000);
+    recorder.record(fast);
+    FlightRecorder::Record slow = make_record("/slow", now, 80000000);
+    recorder.record(slow);
+    FlightRecorder::Record slower = make_record("/slower", now, 90000000);
+    recorder.record(slower);
+
+    std::string dump;
+    for (int i = 0; i < 50 && dump.empty(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::string name = find_dump(directory);
+        if (!name.empty()) {
+            dump = read_file(std::string(directory) + "/" + name);
+        }
+    }
+    recorder.stop();
+
+    FlightRecorder::Stats stats = recorder.get_stats();
+    check(stats.slow == 2 && stats.dumps == 1, "slow requests trigger one rate-limited dump");
+    check(dump.find("# reason: slow (request " + std::to_string(slow.sequence) + " took 80.000 ms, threshold 50 ms)") !=
+          std::string::npos, "the dump names the slow request");
+    check(dump.find("# queued tasks: 3\n") != std::string::npos, "the dump header carries the server context");
+    check(dump.find("/slow   <-- slow\n") != std::string::npos && dump.find("/fast\n") != std::string::npos,
+          "the dump marks the slow request among its neighbours");
+
+    std::string cleanup = std::string("rm -rf ") + directory;
+    check(system(cleanup.c_str()) == 0, "remove the dump directory");
+    recorder.configure(".", 0);
+}
+
+int main() {
+    std::cout << "Flight recorder tests" << std::endl;
+
+    test_ring();
+    test_concurrent_writers();
+    test_format();
+    test_slow_dump();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All flight recorder tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
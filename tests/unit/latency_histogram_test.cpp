@@ -0,0 +1,153 @@
+// Unit tests for the log-linear latency histogram and the sharded request recorder
+#include "../../include/handlers/request_recorder.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static void test_bucket_layout() {
+    bool exact = true;
+    for (uint64_t v = 0; v < LatencyHistogram::SUB_BUCKET_COUNT; v++) {
+        exact = exact && LatencyHistogram::bucket_index(v) == v;
+    }
+    check(exact, "small values get one bucket each");
+
+    bool bounded = true;
+    size_t previous = 0;
+    for (uint64_t v = 1; v < LatencyHistogram::MAX_VALUE; v = v * 3 / 2 + 1) {
+        size_t index = LatencyHistogram::bucket_index(v);
+        uint64_t lower = LatencyHistogram::bucket_lower(index);
+        uint64_t upper = LatencyHistogram::bucket_upper(index);
+        bounded = bounded && lower <= v && v <= upper && index >= previous &&
+                  (upper - lower) * LatencyHistogram::SUB_BUCKET_COUNT <= v;
+        previous = index;
+    }
+    check(bounded, "buckets contain their values and stay within 1/32 relative width");
+
+    check(LatencyHistogram::bucket_index(UINT64_MAX) == LatencyHistogram::BUCKET_COUNT - 1,
+          "oversized values clamp into the last bucket");
+}
+
+static void test_percentiles() {
+    LatencyHistogram histogram;
+    for (uint64_t v = 1; v <= 100000; v++) {
+        histogram.record(v);
+    }
+
+    auto close_to = [](uint64_t actual, double expected) {
+        return actual >= expected * 0.97 && actual <= expected * 1.03;
+    };
+    check(histogram.count() == 100000, "every sample is counted");
+    check(close_to(histogram.percentile(0.50), 50000) && close_to(histogram.percentile(0.99), 99000) &&
+          close_to(histogram.percentile(0.999), 99900),
+          "p50, p99 and p999 are within 3% of the exact values");
+    check(close_to(histogram.max(), 100000), "max is within 3%");
+    check(LatencyHistogram().percentile(0.99) == 0, "empty histogram reports zero");
+}
+
+static void test_windows() {
+    RequestRecorder recorder;
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < 1000; i++) {
+        recorder.record_at(t0 + std::chrono::seconds(1), 1.0, 200);
+    }
+    for (int i = 0; i < 10; i++) {
+        recorder.record_at(t0 + std::chrono::seconds(21), 250.0, 503);
+    }
+
+    auto now = t0 + std::chrono::seconds(21);
+    LatencyHistogram recent = recorder.latency(now, 5);
+    LatencyHistogram minute = recorder.latency(now, 60);
+    check(recent.count() == 10 && recent.percentile(0.5) >= 242000, "short window only holds recent samples");
+    check(minute.count() == 1010 && minute.percentile(0.5) < 1100 && minute.percentile(0.999) >= 242000,
+          "minute window merges older slots");
+
+    auto later = t0 + std::chrono::seconds(90);
+    check(recorder.latency(later, 60).count() == 0 && recorder.latency(later, 0).count() == 1010,
+          "expired slots drop out of windows but not the lifetime histogram");
+
+    int counts[RequestRecorder::RATE_SECONDS];
+    recorder.count_per_second(t0 + std::chrono::seconds(23), counts);
+    check(counts[2] == 10 && counts[22] == 1000, "per-second counts are indexed by age");
+    check(recorder.total_requests() == 1010 && recorder.server_errors() == 10, "totals and 5xx count");
+}
+
+static void test_rate_series() {
+    RequestRecorder recorder(120);
+    auto t0 = std::chrono::steady_clock::now();
+    recorder.record_at(t0 + std::chrono::seconds(5), 1.0, 200);
+    for (int i = 0; i < 3; i++) {
+        recorder.record_at(t0 + std::chrono::seconds(100), 1.0, 200);
+    }
+
+    uint64_t seconds[RequestRecorder::MAX_RATE_SECONDS];
+    int filled = recorder.count_series(t0 + std::chrono::seconds(110), RequestRecorder::SECOND, seconds, 1000);
+    check(filled == 120 && recorder.series_length(RequestRecorder::SECOND) == 120,
+          "per-second history has the length it was built with");
+    check(seconds[10] == 3 && seconds[105] == 1, "per-second series reaches past the last minute");
+    check(RequestRecorder(10).series_length(RequestRecorder::SECOND) == RequestRecorder::RATE_SECONDS &&
+          RequestRecorder(100000).series_length(RequestRecorder::SECOND) == RequestRecorder::MAX_RATE_SECONDS,
+          "per-second history is clamped to 60..3600");
+
+    uint64_t minutes[RequestRecorder::MINUTE_COUNT];
+    recorder.count_series(t0 + std::chrono::seconds(130), RequestRecorder::MINUTE, minutes, RequestRecorder::MINUTE_COUNT);
+    check(minutes[0] == 0 && minutes[1] == 3 && minutes[2] == 1, "minute rollup sums each minute");
+
+    recorder.record_at(t0 + std::chrono::seconds(3700), 1.0, 200);
+    uint64_t hours[RequestRecorder::HOUR_COUNT];
+    recorder.count_series(t0 + std::chrono::seconds(3700), RequestRecorder::HOUR, hours, RequestRecorder::HOUR_COUNT);
+    check(hours[0] == 1 && hours[1] == 4, "hour rollup sums each hour");
+
+    recorder.count_series(t0 + std::chrono::seconds(3700), RequestRecorder::MINUTE, minutes, RequestRecorder::MINUTE_COUNT);
+    uint64_t in_last_hour = 0;
+    for (uint64_t count : minutes) {
+        in_last_hour += count;
+    }
+    check(in_last_hour == 1 && minutes[0] == 1, "minutes older than an hour drop out of the rollup");
+}
+
+static void test_concurrent_recording() {
+    RequestRecorder recorder;
+    const int threads = 8;
+    const int per_thread = 20000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&recorder, t]() {
+            for (int i = 0; i < per_thread; i++) {
+                recorder.record(0.5 + t, 200);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    uint64_t expected = static_cast<uint64_t>(threads) * per_thread;
+    check(recorder.total_requests() == expected && recorder.latency(std::chrono::steady_clock::now(), 0).count() == expected,
+          "no samples lost across concurrent writers");
+}
+
+int main() {
+    std::cout << "Latency histogram tests" << std::endl;
+
+    test_bucket_layout();
+    test_percentiles();
+    test_windows();
+    test_rate_series();
+    test_concurrent_recording();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All latency histogram tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+// Unit tests for the binary metrics encoding and its subprotocol negotiation
+#include "../../include/handlers/websocket_handler.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static uint64_t read_le(const std::string& data, size_t offset, size_t width) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < width; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(data[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+static float read_f32(const std::string& data, size_t offset) {
+    uint32_t bits = static_cast<uint32_t>(read_le(data, offset, 4));
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void record(PerformanceMetrics& metrics, int samples) {
+    for (int i = 0; i < samples; i++) {
+        metrics.record_system_metrics(64 + i, 12.5, 3, 2, 4);
+    }
+}
+
+static void test_system_delta_layout() {
+    PerformanceMetrics metrics;
+    record(metrics, 10);
+    std::string delta = metrics.get_system_metrics_delta_binary(8);
+
+    const size_t body = MetricsBinaryWriter::HEADER_SIZE + 16;
+    bool ok = delta.size() == body + 2 * MetricsBinaryWriter::SYSTEM_SAMPLE_SIZE &&
+              read_le(delta, 0, 1) == MetricsBinaryWriter::SYSTEM_METRICS_DELTA &&
+              read_le(delta, 1, 1) == MetricsBinaryWriter::VERSION &&
+              read_le(delta, 2, 2) == 2 &&
+              read_le(delta, 4, 8) == 8 &&
+              read_le(delta, 12, 8) == 10;
+    check(ok, "delta header carries type, count, prev_seq and seq");
+
+    // Second sample is seq 10: memory 73, cpu 12.5, 3 connections, queue 2, 4 threads
+    size_t sample = body + MetricsBinaryWriter::SYSTEM_SAMPLE_SIZE;
+    ok = read_le(delta, sample + 16, 4) == 73 &&
+         read_f32(delta, sample + 20) == 12.5f &&
+         read_le(delta, sample + 24, 4) == 3 &&
+         read_le(delta, sample + 32, 4) == 2 &&
+         read_le(delta, sample + 36, 4) == 4;
+    check(ok, "sample fields are little-endian at fixed offsets");
+
+    std::string stale = metrics.get_system_metrics_delta_binary(1000);
+    check(read_le(stale, 0, 1) == MetricsBinaryWriter::SYSTEM_METRICS && read_le(stale, 2, 2) == 10,
+          "unknown position falls back to a binary snapshot");
+}
+
+static void test_smaller_than_json() {
+    PerformanceMetrics metrics;
+    record(metrics, 300);
+    std::string json = metrics.get_system_metrics_json();
+    std::string binary = metrics.get_system_metrics_binary();
+    check(binary.size() * 4 < json.size(), "binary snapshot is a fraction of the JSON size");
+
+    std::string rate = metrics.get_request_rate_binary();
+    check(rate.size() == MetricsBinaryWriter::HEADER_SIZE + 8 + 60 * 4 &&
+          std::string(MetricsBinaryWriter::type_name(rate)) == "request_rate",
+          "request rate is 60 fixed-width counts");
+}
+
+static void test_subprotocol_negotiation() {
+    WebSocketHandler handler;
+    std::map<std::string, std::string> headers;
+    headers["sec-websocket-key"] = "dGhlIHNhbXBsZSBub25jZQ==";
+    headers["sec-websocket-protocol"] = "chat, metrics.bin.v1";
+
+    WebSocketDeflateConfig deflate;
+    MetricsEncoding encoding = MetricsEncoding::JSON;
+    std::string response = handler.generate_websocket_response(headers, deflate, encoding);
+    check(encoding == MetricsEncoding::BINARY &&
+          response.find("Sec-WebSocket-Protocol: metrics.bin.v1\r\n") != std::string::npos,
+          "offered binary subprotocol is selected");
+
+    headers["sec-websocket-protocol"] = "chat";
+    response = handler.generate_websocket_response(headers, deflate, encoding);
+    check(encoding == MetricsEncoding::JSON && response.find("Sec-WebSocket-Protocol") == std::string::npos,
+          "unknown subprotocols keep JSON and send no protocol header");
+}
+
+int main() {
+    std::cout << "Binary metrics encoding tests" << std::endl;
+
+    test_system_delta_layout();
+    test_smaller_than_json();
+    test_subprotocol_negotiation();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All binary metrics encoding tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
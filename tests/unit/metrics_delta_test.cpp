@@ -0,0 +1,67 @@
+// Unit tests for sequence-numbered system metric snapshots and deltas
+#include "../../include/handlers/websocket_handler.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static size_t count(const std::string& haystack, const std::string& needle) {
+    size_t n = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) {
+        n++;
+    }
+    return n;
+}
+
+static void record(PerformanceMetrics& metrics, int samples) {
+    for (int i = 0; i < samples; i++) {
+        metrics.record_system_metrics(64, 1.0, 1, 0, 4);
+    }
+}
+
+static void test_delta_contains_only_new_samples() {
+    PerformanceMetrics metrics;
+    record(metrics, 10);
+    std::string delta = metrics.get_system_metrics_delta_json(8);
+    bool ok = metrics.get_latest_system_seq() == 10 &&
+              delta.find("\"type\":\"system_metrics_delta\"") != std::string::npos &&
+              delta.find("\"prev_seq\":8") != std::string::npos &&
+              count(delta, "\"memory_mb\"") == 2 &&
+              delta.find("{\"seq\":9,") != std::string::npos;
+    check(ok, "delta carries only samples after prev_seq");
+
+    std::string empty = metrics.get_system_metrics_delta_json(10);
+    check(count(empty, "\"memory_mb\"") == 0 && empty.find("\"seq\":10") != std::string::npos,
+          "up-to-date client receives an empty delta");
+}
+
+static void test_snapshot_fallback() {
+    PerformanceMetrics metrics;
+    record(metrics, 310);   // more than the 300 retained samples
+    std::string stale = metrics.get_system_metrics_delta_json(5);
+    bool ok = stale.find("\"type\":\"system_metrics\"") != std::string::npos &&
+              count(stale, "\"memory_mb\"") == 300 &&
+              stale.find("\"seq\":310") != std::string::npos;
+
+    std::string ahead = metrics.get_system_metrics_delta_json(1000);
+    ok = ok && ahead.find("\"type\":\"system_metrics\"") != std::string::npos;
+    check(ok, "evicted or unknown positions fall back to a full snapshot");
+}
+
+int main() {
+    std::cout << "System metrics delta tests" << std::endl;
+
+    test_delta_contains_only_new_samples();
+    test_snapshot_fallback();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All system metrics delta tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
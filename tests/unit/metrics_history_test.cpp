@@ -0,0 +1,142 @@
+// Unit tests for the Gorilla-compressed metrics history: bit streams, exact round trips,
+// compression ratio, retention and downsampling
+#include "../../include/handlers/metrics_history.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <random>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static const int64_t T0 = 1760000000000;   // Unix ms
+
+static void test_bit_stream() {
+    std::mt19937_64 random(7);
+    std::vector<std::pair<uint64_t, int>> written;
+    BitStream stream;
+    for (int i = 0; i < 2000; i++) {
+        int bits = static_cast<int>(random() % 65);
+        uint64_t value = random();
+        if (bits < 64) {
+            value &= (uint64_t(1) << bits) - 1;
+        }
+        stream.write(value, bits);
+        written.push_back(std::make_pair(value, bits));
+    }
+    BitStream::Reader reader(stream);
+    bool same = true;
+    size_t total = 0;
+    for (const auto& entry : written) {
+        same = same && reader.read(entry.second) == entry.first;
+        total += static_cast<size_t>(entry.second);
+    }
+    check(same && stream.bit_count() == total, "values of 0 to 64 bits read back across word boundaries");
+}
+
+static void test_round_trip() {
+    MetricsHistory history({"steady", "noisy", "counter"});
+    std::mt19937_64 random(11);
+    std::vector<int64_t> times;
+    std::vector<std::vector<double>> samples;
+    int64_t time = T0;
+    for (int i = 0; i < 5000; i++) {
+        // Mostly 1 s apart with a few ms of jitter, and the odd long gap
+        time += i % 997 == 0 ? 3600123 : 1000 + static_cast<int64_t>(random() % 7) - 3;
+        std::vector<double> values = {42.0, std::round(std::sin(i * 0.1) * 10000) / 100.0,
+                                      static_cast<double>(i * 3)};
+        if (i == 100) {
+            values[1] = -0.0;
+        } else if (i == 101) {
+            values[1] = 1e300;
+        }
+        history.append(time, values);
+        times.push_back(time);
+        samples.push_back(values);
+    }
+    history.append(T0, {1.0, 1.0, 1.0});
+
+    // 1 ms steps return every raw sample; a window of MAX_POINTS ms at a time
+    std::vector<std::vector<MetricsHistory::Point>> points(3);
+    const int64_t window = static_cast<int64_t>(MetricsHistory::MAX_POINTS);
+    for (int64_t from = T0; from <= time; from += window) {
+        auto part = history.query(from, from + window, 1, MetricsHistory::LAST);
+        for (size_t s = 0; s < 3; s++) {
+            points[s].insert(points[s].end(), part[s].begin(), part[s].end());
+        }
+    }
+    bool exact = points[0].size() == samples.size() && points[1].size() == samples.size();
+    for (size_t i = 0; exact && i < samples.size(); i++) {
+        for (size_t s = 0; s < 3; s++) {
+            exact = exact && points[s][i].time_ms == times[i] && points[s][i].value == samples[i][s] &&
+                    std::signbit(points[s][i].value) == std::signbit(samples[i][s]);
+        }
+    }
+    check(exact, "every timestamp and value decodes exactly, across chunks and gaps");
+    check(history.sample_count() == 5000, "samples older than the last one are ignored");
+}
+
+static void test_compression() {
+    MetricsHistory history({"memory_mb", "cpu_percent", "active_connections", "total_requests",
+                            "requests_per_second", "queue_size", "thread_count"});
+    std::mt19937_64 random(3);
+    int64_t time = T0;
+    double requests = 0;
+    for (int i = 0; i < 24 * 3600; i++) {
+        time += 1000 + static_cast<int64_t>(random() % 3);
+        double rate = 200 + static_cast<double>(random() % 50);
+        requests += rate;
+        history.append(time, {static_cast<double>(120 + i / 3600), (random() % 10000) / 100.0,
+                              static_cast<double>(random() % 40), requests, rate,
+                              static_cast<double>(random() % 3), 4.0});
+    }
+    size_t bytes = history.compressed_bytes();
+    std::cout << "   24 h of 7 gauges: " << bytes << " bytes, "
+              << static_cast<double>(bytes) * 8 / (24 * 3600 * 7) << " bits per value" << std::endl;
+    check(history.sample_count() == 24 * 3600, "a day of per-second samples is retained");
+    check(bytes < 4 * 1024 * 1024 && bytes < 24 * 3600 * 7 * 8 / 3, "a day of samples fits in a few MB");
+
+    history.append(time + MetricsHistory::RETENTION_MS + 1000, {0, 0, 0, 0, 0, 0, 0});
+    check(history.sample_count() < 24 * 3600, "chunks past the retention are dropped");
+}
+
+static void test_downsampling() {
+    MetricsHistory history({"gauge"});
+    for (int i = 0; i < 60; i++) {
+        history.append(T0 + i * 1000, {static_cast<double>(i)});
+    }
+    auto avg = history.query(T0, T0 + 60000, 10000, MetricsHistory::AVG)[0];
+    auto max = history.query(T0, T0 + 60000, 10000, MetricsHistory::MAX)[0];
+    auto min = history.query(T0 + 5000, T0 + 25000, 10000, MetricsHistory::MIN)[0];
+    check(avg.size() == 6 && avg[0].time_ms == T0 && avg[0].value == 4.5 && avg[5].value == 54.5,
+          "avg gives one point per step at the step start");
+    check(max.size() == 6 && max[2].value == 29, "max takes the largest sample of each step");
+    check(min.size() == 2 && min[0].time_ms == T0 + 5000 && min[0].value == 5 && min[1].value == 15,
+          "steps are aligned to the start of the range");
+    check(history.query(T0, T0 + 60000, 0, MetricsHistory::AVG)[0].empty() &&
+          history.query(T0, T0 + 100000000, 1, MetricsHistory::AVG)[0].empty(),
+          "a zero step or more than MAX_POINTS steps returns nothing");
+
+    MetricsHistory::Aggregation aggregation;
+    check(MetricsHistory::parse_aggregation("last", aggregation) && aggregation == MetricsHistory::LAST &&
+          !MetricsHistory::parse_aggregation("median", aggregation), "aggregation names parse");
+}
+
+int main() {
+    std::cout << "Metrics history tests" << std::endl;
+
+    test_bit_stream();
+    test_round_trip();
+    test_compression();
+    test_downsampling();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All metrics history tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+// Unit tests for OTLP export: traceparent parsing, span and metric JSON, and an export
+// round trip against an in-process collector
+#include "../../include/core/otlp_exporter.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static bool contains(const std::string& text, const std::string& part) {
+    return text.find(part) != std::string::npos;
+}
+
+static size_t occurrences(const std::string& text, const std::string& part) {
+    size_t count = 0;
+    for (size_t at = text.find(part); at != std::string::npos; at = text.find(part, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+static FlightRecorder::Record make_request(const char* method, const char* path, int status, int64_t duration_ms) {
+    FlightRecorder::Record request = {};
+    strncpy(request.method, method, sizeof(request.method) - 1);
+    strncpy(request.path, path, sizeof(request.path) - 1);
+    request.status = status;
+    request.protocol = FlightRecorder::HTTP1;
+    request.bytes_sent = 42;
+    int64_t now = FlightRecorder::nanos(std::chrono::steady_clock::now());
+    request.accepted_ns = now;
+    request.dequeued_ns = now + 1000;
+    request.first_byte_ns = now + 2000;
+    request.parsed_ns = now + 3000;
+    request.handled_ns = now + duration_ms * 1000000;
+    request.finished_ns = request.handled_ns + 1000;
+    return request;
+}
+
+static void test_traceparent() {
+    OtlpExporter::TraceContext context;
+    check(OtlpExporter::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", context) &&
+          context.sampled && context.trace_id[0] == 0x4b && context.parent_id[7] == 0xb7,
+          "valid traceparent parses ids and the sampled flag");
+    check(OtlpExporter::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00", context) &&
+          !context.sampled, "unsampled flag is read");
+    check(OtlpExporter::parse_traceparent("01-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-extra", context),
+          "later versions may carry extra fields");
+    check(!OtlpExporter::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-extra", context) &&
+          !OtlpExporter::parse_traceparent("ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", context) &&
+          !OtlpExporter::parse_traceparent("00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01", context) &&
+          !OtlpExporter::parse_traceparent("00-00000000000000000000000000000000-00f067aa0ba902b7-01", context) &&
+          !OtlpExporter::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01", context) &&
+          !OtlpExporter::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736", context),
+          "malformed, uppercase, all-zero and version ff headers are rejected");
+}
+
+static void test_format_spans() {
+    OtlpExporter::Span span = {};
+    OtlpExporter::TraceContext context;
+    OtlpExporter::parse_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01", context);
+    memcpy(span.trace_id, context.trace_id, sizeof(span.trace_id));
+    memcpy(span.parent_id, context.parent_id, sizeof(span.parent_id));
+    memset(span.span_id, 0x11, sizeof(span.span_id));
+    span.has_parent = true;
+    span.clock_offset_ns = 1000000000;
+    span.request = make_request("GET", "/api/users/7", 503, 5);
+
+    std::string body;
+    OtlpExporter::format_spans({span}, body);
+    check(contains(body, "\"traceId\":\"4bf92f3577b34da6a3ce929d0e0e4736\"") &&
+          contains(body, "\"parentSpanId\":\"00f067aa0ba902b7\""),
+          "server span continues the caller's trace");
+    check(contains(body, "\"name\":\"GET /api/users/{id}\"") && contains(body, "\"kind\":2") &&
+          contains(body, "{\"key\":\"http.route\",\"value\":{\"stringValue\":\"/api/users/{id}\"}}") &&
+          contains(body, "{\"key\":\"http.response.status_code\",\"value\":{\"intValue\":\"503\"}}") &&
+          contains(body, "\"status\":{\"code\":2}"),
+          "server span is named by route and carries HTTP attributes and error status");
+    check(occurrences(body, "\"parentSpanId\":\"1111111111111111\"") == 5 && contains(body, "\"name\":\"handler\"") &&
+          occurrences(body, "\"kind\":1") == 5,
+          "each phase becomes a child of the server span");
+}
+
+static void test_metrics_writer() {
+    OtlpMetricsWriter writer(100, 200);
+    const double bounds[] = {0.1, 1.0};
+    const uint64_t cumulative[] = {3, 5};
+    writer.sum("webserver.requests", "{request}", "Requests.", true);
+    writer.point({{"route", "api"}}, static_cast<uint64_t>(7));
+    writer.histogram("http.server.request.duration", "s", "Durations.");
+    writer.histogram_point({}, bounds, cumulative, 2, 6, 2.5);
+    std::string body = writer.take({{"service.name", "webserver"}});
+
+    check(contains(body, "\"isMonotonic\":true") && contains(body, "\"aggregationTemporality\":2") &&
+          contains(body, "\"asInt\":\"7\"") && contains(body, "\"startTimeUnixNano\":\"100\",\"timeUnixNano\":\"200\""),
+          "sums are cumulative with string int64 values");
+    check(contains(body, "\"count\":\"6\",\"sum\":2.5,\"bucketCounts\":[\"3\",\"2\",\"1\"],\"explicitBounds\":[0.1,1]"),
+          "cumulative counts become per-bucket counts with an overflow bucket");
+}
+
+// Accepts connections on 127.0.0.1 (or ::1) and answers every request with 'status',
+// 'delay_ms' after reading it
+class FakeCollector {
+public:
+    explicit FakeCollector(const char* status_line, int family = AF_INET, int delay_ms = 0)
+        : status(status_line), delay(delay_ms) {
+        listen_fd = socket(family, SOCK_STREAM, 0);
+        if (family == AF_INET6) {
+            sockaddr_in6 address = {};
+            address.sin6_family = AF_INET6;
+            address.sin6_addr = in6addr_loopback;
+            bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+            socklen_t length = sizeof(address);
+            getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &length);
+            port = ntohs(address.sin6_port);
+        } else {
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+            socklen_t length = sizeof(address);
+            getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &length);
+            port = ntohs(address.sin_port);
+        }
+        listen(listen_fd, 16);
+        thread = std::thread([this]() { serve(); });
+    }
+
+    ~FakeCollector() {
+        running = false;
+        thread.join();
+        close(listen_fd);
+    }
+
+    std::vector<std::string> requests() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return received;
+    }
+
+    uint16_t port;
+
+private:
+    void serve() {
+        while (running) {
+            pollfd readable = {listen_fd, POLLIN, 0};
+            if (poll(&readable, 1, 50) <= 0) {
+                continue;
+            }
+            int client = accept(listen_fd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            std::string request;
+            char buffer[4096];
+            size_t expected = std::string::npos;
+            while (expected == std::string::npos || request.size() < expected) {
+                ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+                if (n <= 0) {
+                    break;
+                }
+                request.append(buffer, static_cast<size_t>(n));
+                size_t header_end = request.find("\r\n\r\n");
+                size_t length_at = request.find("Content-Length: ");
+                if (header_end != std::string::npos && length_at != std::string::npos) {
+                    expected = header_end + 4 + std::stoul(request.substr(length_at + 16));
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            std::string response = std::string(status) + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            ssize_t ignored = send(client, response.data(), response.size(), MSG_NOSIGNAL);
+            (void)ignored;
+            close(client);
+            std::lock_guard<std::mutex> lock(mutex);
+            received.push_back(request);
+        }
+    }
+
+    const char* status;
+    int delay;
+    int listen_fd;
+    std::atomic<bool> running{true};
+    std::thread thread;
+    std::mutex mutex;
+    std::vector<std::string> received;
+};
+
+static void test_export_round_trip() {
+    FakeCollector collector("HTTP/1.1 200 OK");
+    OtlpExporter& exporter = OtlpExporter::instance();
+    check(!exporter.configure("https://localhost:4318", 10, 100) && !exporter.configure("http://localhost:0", 10, 100),
+          "https and invalid ports are refused");
+    check(exporter.configure("http://127.0.0.1:" + std::to_string(collector.port) + "/otel/", 0, 100) &&
+          exporter.is_enabled(), "endpoint with a path prefix is accepted");
+    exporter.set_metrics_provider([](OtlpMetricsWriter& out) {
+        out.gauge("webserver.connections", "{connection}", "Open connections.");
+        out.point({{"state", "active"}}, static_cast<uint64_t>(3));
+    });
+    exporter.start();
+
+    OtlpExporter::Stats before = exporter.get_stats();
+    exporter.record(make_request("GET", "/", 200, 1), "");
+    exporter.record(make_request("GET", "/", 200, 1), "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00");
+    exporter.record(make_request("GET", "/api/stats", 200, 150), "");
+    exporter.record(make_request("POST", "/api/users", 500, 1), "");
+    exporter.record(make_request("GET", "/", 200, 1), "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01");
+    exporter.stop();
+
+    OtlpExporter::Stats after = exporter.get_stats();
+    check(after.sampled_out - before.sampled_out == 2 && after.spans_exported - before.spans_exported == 3,
+          "slow, failed and caller-sampled requests are kept, others sampled out");
+    check(after.metric_exports - before.metric_exports == 1 && after.export_failures == before.export_failures,
+          "stopping flushes spans and a last metrics export");
+
+    std::string traces;
+    std::string metrics;
+    for (const auto& request : collector.requests()) {
+        if (request.compare(0, 21, "POST /otel/v1/traces ") == 0) {
+            traces += request;
+        } else if (request.compare(0, 22, "POST /otel/v1/metrics ") == 0) {
+            metrics += request;
+        }
+    }
+    check(contains(traces, "\"name\":\"GET /api/stats\"") && contains(traces, "\"name\":\"POST /api/users\"") &&
+          contains(traces, "\"parentSpanId\":\"00f067aa0ba902b7\""),
+          "collector receives the kept spans under the path prefix");
+    check(contains(metrics, "\"name\":\"webserver.connections\"") &&
+          contains(metrics, "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"webserver\"}}"),
+          "collector receives the provider's metrics");
+}
+
+static void test_export_failure() {
+    FakeCollector collector("HTTP/1.1 503 Service Unavailable");
+    OtlpExporter& exporter = OtlpExporter::instance();
+    exporter.configure("http://127.0.0.1:" + std::to_string(collector.port), 0, 100);
+    exporter.set_metrics_provider(nullptr);
+    exporter.start();
+    OtlpExporter::Stats before = exporter.get_stats();
+    exporter.record(make_request("GET", "/", 502, 1), "");
+    exporter.stop();
+    OtlpExporter::Stats after = exporter.get_stats();
+    check(after.export_failures - before.export_failures == 1 && after.spans_dropped - before.spans_dropped == 1 &&
+          after.spans_exported == before.spans_exported,
+          "rejected exports count as failures and drop their spans");
+    exporter.configure("off", 0, 0);
+    check(!exporter.is_enabled(), "off disables export");
+}
+
+static void test_export_ipv6() {
+    FakeCollector collector("HTTP/1.1 200 OK", AF_INET6);
+    OtlpExporter& exporter = OtlpExporter::instance();
+    check(exporter.configure("http://[::1]:" + std::to_string(collector.port), 0, 100), "IPv6 literal endpoint is accepted");
+    exporter.set_metrics_provider(nullptr);
+    exporter.start();
+    OtlpExporter::Stats before = exporter.get_stats();
+    exporter.record(make_request("GET", "/", 500, 1), "");
+    exporter.stop();
+    std::vector<std::string> requests = collector.requests();
+    check(exporter.get_stats().spans_exported - before.spans_exported == 1 && requests.size() == 1 &&
+          contains(requests[0], "\r\nHost: [::1]:" + std::to_string(collector.port) + "\r\n"),
+          "the Host header keeps an IPv6 address in brackets");
+}
+
+static void test_stop_while_refilled() {
+    // Every export takes 20 ms while a writer keeps the queue full
+    FakeCollector collector("HTTP/1.1 503 Service Unavailable", AF_INET, 20);
+    OtlpExporter& exporter = OtlpExporter::instance();
+    exporter.configure("http://127.0.0.1:" + std::to_string(collector.port), 0, 100);
+    exporter.set_metrics_provider(nullptr);
+    exporter.start();
+    std::atomic<bool> writing{true};
+    std::thread writer([&]() {
+        auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (writing.load() && std::chrono::steady_clock::now() < give_up) {
+            exporter.record(make_request("GET", "/", 500, 1), "");
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    auto stopping = std::chrono::steady_clock::now();
+    exporter.stop();
+    auto stopped = std::chrono::steady_clock::now() - stopping;
+    writing = false;
+    writer.join();
+    check(stopped < std::chrono::seconds(2),
+          "stop() returns while spans keep arriving for a slow collector (" +
+          std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(stopped).count()) + " ms)");
+    exporter.configure("off", 0, 0);
+}
+
+int main() {
+    std::cout << "OTLP exporter tests" << std::endl;
+
+    test_traceparent();
+    test_format_spans();
+    test_metrics_writer();
+    test_export_round_trip();
+    test_export_failure();
+    test_export_ipv6();
+    test_stop_while_refilled();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All OTLP exporter tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+// Unit tests for the Prometheus exposition writer and the server-wide counters behind it
+#include "../../include/core/server_metrics.h"
+#include "../../include/handlers/prometheus_writer.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static void test_writer_format() {
+    PrometheusWriter out;
+    out.family("demo_total", "counter", "Demo counter.");
+    out.sample("demo_total", "route=\"api\"", static_cast<uint64_t>(7));
+    out.sample("demo_gauge", "", 0.5);
+
+    const double bounds[] = {0.001, 0.01};
+    const uint64_t cumulative[] = {3, 5};
+    out.histogram("demo_seconds", "", bounds, cumulative, 2, 6, 0.25);
+
+    std::string text = out.take();
+    check(text.find("# HELP demo_total Demo counter.\n# TYPE demo_total counter\n") == 0,
+          "family writes HELP and TYPE lines");
+    check(text.find("demo_total{route=\"api\"} 7\n") != std::string::npos &&
+          text.find("demo_gauge 0.5\n") != std::string::npos,
+          "samples with and without labels");
+    check(text.find("demo_seconds_bucket{le=\"0.001\"} 3\n"
+                    "demo_seconds_bucket{le=\"0.01\"} 5\n"
+                    "demo_seconds_bucket{le=\"+Inf\"} 6\n"
+                    "demo_seconds_sum 0.25\n"
+                    "demo_seconds_count 6\n") != std::string::npos,
+          "histogram ends with +Inf, sum and count");
+}
+
+static void test_routes() {
+    check(ServerMetrics::route_for("/api/users/3") == ServerMetrics::ROUTE_API &&
+          ServerMetrics::route_for("/api/metrics/stream?x=1") == ServerMetrics::ROUTE_EVENT_STREAM &&
+          ServerMetrics::route_for("/metrics") == ServerMetrics::ROUTE_METRICS &&
+          ServerMetrics::route_for("/ws") == ServerMetrics::ROUTE_WEBSOCKET &&
+          ServerMetrics::route_for("/admin-dashboard") == ServerMetrics::ROUTE_DASHBOARD &&
+          ServerMetrics::route_for("/style.css") == ServerMetrics::ROUTE_STATIC,
+          "paths map onto the router's groups");
+    check(ServerMetrics::route_for("/dashboard.html?v=" + std::string(40, '1')) == ServerMetrics::ROUTE_DASHBOARD &&
+          ServerMetrics::route_for("/metricsx") == ServerMetrics::ROUTE_STATIC &&
+          ServerMetrics::route_for("/ws/") == ServerMetrics::ROUTE_STATIC,
+          "the query is ignored, other paths only match exactly");
+}
+
+static void test_counters() {
+    ServerMetrics& metrics = ServerMetrics::instance();
+    uint64_t before = metrics.requests(ServerMetrics::ROUTE_API, ServerMetrics::HTTP2, 4);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&metrics]() {
+            for (int i = 0; i < 1000; i++) {
+                metrics.record_request(ServerMetrics::ROUTE_API, ServerMetrics::HTTP2, 503);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    check(metrics.requests(ServerMetrics::ROUTE_API, ServerMetrics::HTTP2, 4) - before == 4000,
+          "per-thread shards sum to every recorded request");
+
+    uint64_t waits[ServerMetrics::QUEUE_WAIT_BUCKET_COUNT + 1];
+    double sum = 0.0;
+    metrics.queue_wait(waits, sum);
+    uint64_t fast = waits[0];
+    uint64_t total = waits[ServerMetrics::QUEUE_WAIT_BUCKET_COUNT];
+    metrics.record_queue_wait(std::chrono::microseconds(1));
+    metrics.record_queue_wait(std::chrono::seconds(30));
+    metrics.queue_wait(waits, sum);
+    check(waits[0] == fast + 1 && waits[ServerMetrics::QUEUE_WAIT_BUCKET_COUNT] == total + 2 &&
+          waits[ServerMetrics::QUEUE_WAIT_BUCKET_COUNT - 1] == total + 1 && sum >= 30.0,
+          "queue wait buckets are cumulative and overflow only into +Inf");
+
+    LatencyHistogram queue_phase = metrics.phase_histogram(ServerMetrics::PHASE_QUEUE);
+    check(queue_phase.count() >= 2 && queue_phase.max() >= 4000000000ULL,
+          "queue waits also land in the nanosecond queue phase histogram");
+
+    auto start = std::chrono::steady_clock::now();
+    metrics.record_phase(ServerMetrics::PHASE_HANDLER, start, start + std::chrono::nanoseconds(1500));
+    metrics.record_phase(ServerMetrics::PHASE_HANDLER, start, start + std::chrono::microseconds(250));
+    LatencyHistogram handler = metrics.phase_histogram(ServerMetrics::PHASE_HANDLER);
+    check(handler.count() == 2 && handler.count_at_most(1550) == 1 &&
+          metrics.phase_sum_nanos(ServerMetrics::PHASE_HANDLER) == 251500,
+          "phases keep nanosecond resolution");
+    check(metrics.phase_histogram(ServerMetrics::PHASE_WRITE).count() == 0,
+          "phases are recorded independently");
+
+    {
+        ServerMetrics::ConnectionScope connection(ServerMetrics::CONN_HTTP1);
+        ServerMetrics::StateScope upgraded(ServerMetrics::CONN_HTTP1, ServerMetrics::CONN_HTTP2);
+        check(metrics.open_connections(ServerMetrics::CONN_HTTP1) == 0 &&
+              metrics.open_connections(ServerMetrics::CONN_HTTP2) == 1,
+              "state scope moves a connection between gauges");
+    }
+    check(metrics.open_connections(ServerMetrics::CONN_HTTP1) == 0 &&
+          metrics.open_connections(ServerMetrics::CONN_HTTP2) == 0,
+          "gauges return to zero when scopes end");
+}
+
+int main() {
+    std::cout << "Prometheus metrics tests" << std::endl;
+
+    test_writer_format();
+    test_routes();
+    test_counters();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All Prometheus metrics tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
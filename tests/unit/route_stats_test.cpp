@@ -0,0 +1,172 @@
+// Unit tests for per-route request stats: template normalization, the route cap and
+// overflow entry, latency windows, concurrent registration and allocation-free recording
+#include "../../include/core/route_stats.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+#include <new>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+// Heap allocations made by the calling thread
+static thread_local size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+static const RouteStats::Summary* find_route(const std::vector<RouteStats::Summary>& summaries, const std::string& route) {
+    for (const auto& summary : summaries) {
+        if (summary.route == route) {
+            return &summary;
+        }
+    }
+    return nullptr;
+}
+
+static void test_templates() {
+    check(RouteStats::route_template("/api/users/42", 200) == "/api/users/{id}" &&
+          RouteStats::route_template("/api/users/abc?x=1", 404) == "/api/users/{id}",
+          "user ids collapse into one template whatever the status");
+    check(RouteStats::route_template("/api//stats/", 200) == "/api/stats" &&
+          RouteStats::route_template("/api/metrics/history?from=-60", 200) == "/api/metrics/history",
+          "API paths are normalized like the router splits them");
+    check(RouteStats::route_template("/dashboard.html", 200) == "/dashboard" &&
+          RouteStats::route_template("/websocket", 101) == "/ws",
+          "aliases share their route's template");
+    check(RouteStats::route_template("/style.css?v=2", 200) == "/style.css" &&
+          RouteStats::route_template("/missing.css", 404).empty(),
+          "static files are a template only when served");
+    check(RouteStats::route_template("/api/unknown", 404).empty() && RouteStats::route_template("INVALID", 400).empty(),
+          "unknown endpoints and unparsable requests have no template");
+    check(RouteStats::route_template("/api/users/" + std::string(100, '9'), 200) == "/api/users/{id}" &&
+          RouteStats::route_template("/" + std::string(RouteStats::NAME_LENGTH, 'x'), 200).empty(),
+          "a long user id still collapses, a template too long to track has none");
+}
+
+static void test_no_allocations() {
+    RouteStats stats;
+    auto t0 = std::chrono::steady_clock::now();
+    std::string paths[] = {"/api/users/42?x=1", "/api//metrics/history/", "/style.css", "/missing",
+                           "/api/users/" + std::string(100, '9'), "/" + std::string(200, 'x')};
+    for (const std::string& path : paths) {
+        stats.record_at(t0, path, 200, 1.0);   // registers the static files
+    }
+    size_t before = allocations;
+    for (int i = 0; i < 100; i++) {
+        for (const std::string& path : paths) {
+            stats.record_at(t0, path, 200, 1.0);
+        }
+    }
+    size_t made = allocations - before;
+    check(made == 0, "recording a request allocates nothing once its route is registered (" +
+                     std::to_string(made) + " allocations)");
+}
+
+static void test_cap_and_overflow() {
+    RouteStats stats;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t fixed = stats.route_count();
+
+    for (int i = 0; i < 100; i++) {
+        stats.record_at(t0, "/file" + std::to_string(i) + ".html", 200, 1.0);
+        stats.record_at(t0, "/scan/" + std::to_string(i), 404, 1.0);
+    }
+    stats.record_at(t0, "/" + std::string(RouteStats::NAME_LENGTH, 'x'), 200, 1.0);
+    stats.record_at(t0, "/api/users/7", 503, 2.0);
+
+    auto summaries = stats.snapshot(t0);
+    const RouteStats::Summary* other = find_route(summaries, RouteStats::OVERFLOW_ROUTE);
+    size_t files = 0;
+    for (const auto& summary : summaries) {
+        files += summary.route.compare(0, 5, "/file") == 0 ? 1 : 0;
+    }
+    check(stats.route_count() == RouteStats::MAX_ROUTES && files == RouteStats::MAX_ROUTES - fixed,
+          "static files fill the table up to MAX_ROUTES");
+    check(other && other->requests == 100 + (100 - files) + 1, "misses, extra files and long paths go to the overflow entry");
+
+    const RouteStats::Summary* users = find_route(summaries, "/api/users/{id}");
+    check(users && users->requests == 1 && users->server_errors == 1 && users->latency_sum_micros == 2000,
+          "router routes stay tracked when the table is full");
+    check(!find_route(summaries, "/api/docs"), "routes without requests are left out");
+}
+
+static void test_windows() {
+    RouteStats stats;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++) {
+        stats.record_at(t0, "/api/stats", 200, 1.0);
+    }
+    stats.record_at(t0 + std::chrono::seconds(40), "/api/stats", 200, 250.0);
+
+    auto recent = find_route(stats.snapshot(t0 + std::chrono::seconds(40)), "/api/stats");
+    check(recent && recent->recent.count() == 101 && recent->recent.max() >= 242000,
+          "recent latencies cover the current and the previous slot");
+    auto later = find_route(stats.snapshot(t0 + std::chrono::seconds(65)), "/api/stats");
+    check(later && later->recent.count() == 1 && later->requests == 101,
+          "older slots drop out of the recent histogram but not the totals");
+}
+
+static void test_concurrent_registration() {
+    RouteStats stats;
+    const int threads = 8;
+    const int per_thread = 5000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&stats]() {
+            for (int i = 0; i < per_thread; i++) {
+                stats.record("/asset" + std::to_string(i % 40) + ".js", 200, 0.5);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    uint64_t total = 0;
+    std::set<std::string> names;
+    auto summaries = stats.snapshot(std::chrono::steady_clock::now());
+    for (const auto& summary : summaries) {
+        total += summary.requests;
+        names.insert(summary.route);
+    }
+    check(names.size() == summaries.size() && stats.route_count() == RouteStats::MAX_ROUTES,
+          "racing threads register each template once");
+    check(total == static_cast<uint64_t>(threads) * per_thread, "no requests lost across concurrent writers");
+}
+
+int main() {
+    std::cout << "Route stats tests" << std::endl;
+
+    test_templates();
+    test_cap_and_overflow();
+    test_windows();
+    test_concurrent_registration();
+    test_no_allocations();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All route stats tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
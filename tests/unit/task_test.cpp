@@ -0,0 +1,118 @@
+// Unit tests for Task: inline and heap storage, move-only captures, and that the
+// callable is destroyed exactly once however the Task is moved
+#include "../../include/core/task.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+// Counts its own destructions, so double destroys and leaks both show up
+struct Tracked {
+    int* destroyed;
+    bool live = true;
+    explicit Tracked(int* counter) : destroyed(counter) {}
+    Tracked(Tracked&& other) noexcept : destroyed(other.destroyed) { other.live = false; }
+    ~Tracked() {
+        if (live) {
+            (*destroyed)++;
+        }
+    }
+};
+
+static void test_storage() {
+    int value = 0;
+    void* server = &value;
+    int client_socket = 7;
+    auto accepted = std::chrono::steady_clock::now();
+    // Same captures as the acceptor's connection task
+    Task connection([server, client_socket, accepted, &value]() { value += client_socket; (void)server; (void)accepted; });
+    check(connection.is_inline(), "a connection-sized lambda is stored inline");
+    connection();
+    check(value == 7, "an inline task runs its callable");
+    
+    char big[128] = {1};
+    Task large([big, &value]() { value += big[0]; });
+    check(large && !large.is_inline(), "a callable larger than the buffer goes to the heap");
+    large();
+    check(value == 8, "a heap task runs its callable");
+    
+    std::function<void()> wrapped = [&value]() { value++; };
+    Task from_function(wrapped);
+    from_function();
+    check(value == 9, "a std::function converts to a task");
+    check(sizeof(Task) == 64 && !Task(), "a task is one cache line and empty by default");
+}
+
+static void test_move_only() {
+    std::unique_ptr<int> owned(new int(41));
+    int seen = 0;
+    Task task([owned = std::move(owned), &seen]() { seen = *owned + 1; });
+    Task moved(std::move(task));
+    check(!task && moved, "moving a task leaves the source empty");
+    moved();
+    check(seen == 42, "a task can own a move-only capture");
+    
+    std::vector<Task> tasks;
+    for (int i = 0; i < 100; i++) {
+        tasks.emplace_back([i, &seen]() { seen += i; });
+    }
+    seen = 0;
+    for (auto& t : tasks) {
+        t();
+    }
+    check(seen == 4950, "tasks survive vector reallocation");
+}
+
+static void test_destroy_once() {
+    int inline_destroyed = 0;
+    {
+        Tracked tracked(&inline_destroyed);
+        Task a([tracked = std::move(tracked)]() {});
+        Task b(std::move(a));
+        Task c;
+        c = std::move(b);
+        a = std::move(c);
+    }
+    check(inline_destroyed == 1, "an inline callable is destroyed exactly once across moves");
+    
+    int heap_destroyed = 0;
+    {
+        Tracked tracked(&heap_destroyed);
+        char padding[100] = {};
+        Task a([tracked = std::move(tracked), padding]() { (void)padding; });
+        Task b(std::move(a));
+        check(!b.is_inline(), "a large capture is heap-allocated");
+        b = Task();
+        check(heap_destroyed == 1, "assigning over a task destroys its callable");
+    }
+    check(heap_destroyed == 1, "a heap callable is destroyed exactly once");
+    
+    int reset_destroyed = 0;
+    Tracked tracked(&reset_destroyed);
+    Task task([tracked = std::move(tracked)]() {});
+    task.reset();
+    check(!task && reset_destroyed == 1, "reset destroys the callable and empties the task");
+}
+
+int main() {
+    std::cout << "Task tests" << std::endl;
+
+    test_storage();
+    test_move_only();
+    test_destroy_once();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All task tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
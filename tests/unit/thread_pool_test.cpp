@@ -0,0 +1,505 @@
+// Unit tests for the work-stealing thread pool: the Chase-Lev deque under concurrent
+// thieves, LIFO local execution, stealing, queue depth, batches, allocation-free
+// scheduling, FIFO injection, elastic sizing, priority lanes and limits, parking and wakeup latency
+#include "../../include/core/thread_pool.h"
+#include "check.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <mutex>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+// Heap allocations made by the calling thread
+static thread_local size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+template <typename Predicate>
+static bool wait_until(Predicate predicate) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Voluntary context switches of every thread in the process: each wakeup of a sleeping
+// thread adds one
+static uint64_t voluntary_switches() {
+    uint64_t total = 0;
+    DIR* tasks = opendir("/proc/self/task");
+    if (!tasks) {
+        return 0;
+    }
+    while (dirent* entry = readdir(tasks)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::ifstream status(std::string("/proc/self/task/") + entry->d_name + "/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 24, "voluntary_ctxt_switches:") == 0) {
+                total += std::stoull(line.substr(24));
+            }
+        }
+    }
+    closedir(tasks);
+    return total;
+}
+
+static void test_deque() {
+    WorkStealingDeque<int, 8> deque;
+    int items[10];
+    bool pushed = true;
+    for (int i = 0; i < 8; i++) {
+        pushed = pushed && deque.push(&items[i]);
+    }
+    check(pushed && !deque.push(&items[8]) && deque.size() == 8, "push fails once the deque is full");
+    check(deque.pop() == &items[7] && deque.steal() == &items[0], "owner pops the newest, thieves steal the oldest");
+
+    // One owner pushing and popping against three thieves: every item is taken exactly once
+    const int total = 200000;
+    WorkStealingDeque<int, 256> shared;
+    std::vector<int> values(total);
+    std::vector<std::atomic<int>> taken(total);
+    for (auto& count : taken) {
+        count.store(0);
+    }
+    std::atomic<bool> done{false};
+    std::atomic<int> stolen{0};
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; t++) {
+        thieves.emplace_back([&]() {
+            while (!done.load()) {
+                if (int* item = shared.steal()) {
+                    taken[item - values.data()]++;
+                    stolen++;
+                }
+            }
+        });
+    }
+    int next = 0;
+    while (next < total) {
+        if (!shared.push(&values[next])) {
+            if (int* item = shared.pop()) {
+                taken[item - values.data()]++;
+            }
+            continue;
+        }
+        next++;
+        if (next % 3 == 0) {
+            if (int* item = shared.pop()) {
+                taken[item - values.data()]++;
+            }
+        }
+    }
+    // Whatever is left (the deque is nearly full) goes to the thieves
+    wait_until([&]() { return shared.size() == 0; });
+    done = true;
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+    bool exactly_once = true;
+    for (auto& count : taken) {
+        exactly_once = exactly_once && count.load() == 1;
+    }
+    check(exactly_once && stolen.load() > 0, "concurrent pops and steals take each item exactly once");
+}
+
+static void test_local_lifo(ThreadPool& single) {
+    std::mutex mutex;
+    std::vector<int> order;
+    std::atomic<bool> finished{false};
+    single.enqueue([&]() {
+        for (int i = 0; i < 3; i++) {
+            single.enqueue([&, i]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(i);
+                if (order.size() == 3) {
+                    finished = true;
+                }
+            });
+        }
+    });
+    wait_until([&]() { return finished.load(); });
+    check(order == std::vector<int>({2, 1, 0}), "tasks enqueued by a worker run on it newest first");
+}
+
+static void test_all_tasks_run(ThreadPool& pool) {
+    const int external = 20000;
+    std::atomic<int> count{0};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 2; p++) {
+        producers.emplace_back([&]() {
+            for (int i = 0; i < external / 2; i++) {
+                pool.enqueue([&count]() { count++; });
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    check(wait_until([&]() { return count.load() == external; }) && wait_until([&]() { return pool.get_queue_size() == 0; }),
+          "every task from outside the pool runs once and the queue drains");
+}
+
+static void test_stealing(ThreadPool& pool) {
+    // One task fans out slow children onto its own deque; idle workers must steal them
+    std::mutex mutex;
+    std::set<std::thread::id> runners;
+    std::atomic<int> count{0};
+    pool.enqueue([&]() {
+        for (int i = 0; i < 64; i++) {
+            pool.enqueue([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                std::lock_guard<std::mutex> lock(mutex);
+                runners.insert(std::this_thread::get_id());
+                count++;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    bool all = wait_until([&]() { return count.load() == 64; });
+    std::lock_guard<std::mutex> lock(mutex);
+    check(all && runners.size() > 1, "idle workers steal from a busy worker's deque");
+}
+
+static void test_queue_size(ThreadPool& single) {
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+    single.enqueue([&]() {
+        started = true;
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    wait_until([&]() { return started.load(); });
+    std::atomic<int> count{0};
+    for (int i = 0; i < 5; i++) {
+        single.enqueue([&count]() { count++; });
+    }
+    check(single.get_queue_size() == 5, "queue size counts tasks waiting for a worker");
+    release = true;
+    check(wait_until([&]() { return count.load() == 5 && single.get_queue_size() == 0; }), "waiting tasks run once a worker frees up");
+}
+
+static void test_batch(ThreadPool& pool) {
+    // Slow tasks in one batch must wake more than one worker
+    std::mutex mutex;
+    std::set<std::thread::id> runners;
+    std::atomic<int> count{0};
+    std::vector<Task> tasks;
+    for (int i = 0; i < 8; i++) {
+        tasks.emplace_back([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::lock_guard<std::mutex> lock(mutex);
+            runners.insert(std::this_thread::get_id());
+            count++;
+        });
+    }
+    pool.enqueue_batch(std::move(tasks));
+    bool all = wait_until([&]() { return count.load() == 8; });
+    std::lock_guard<std::mutex> lock(mutex);
+    check(all && runners.size() > 1, "a batch runs every task and wakes several workers");
+}
+
+// Holds every worker of a 4-thread pool, so enqueued tasks pile up in the injection queue
+static void hold_workers(ThreadPool& pool, std::atomic<bool>& release) {
+    std::atomic<int> held{0};
+    for (int i = 0; i < 4; i++) {
+        pool.enqueue([&]() {
+            held++;
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    wait_until([&]() { return held.load() == 4; });
+}
+
+static void test_no_allocations(ThreadPool& pool) {
+    int server = 0;
+    std::atomic<int> count{0};
+    auto enqueue_connections = [&](int n) {
+        for (int i = 0; i < n; i++) {
+            // The acceptor's captures: a pointer, a socket and the accept timestamp
+            int* target = &server;
+            int client_socket = i;
+            auto accepted = std::chrono::steady_clock::now();
+            pool.enqueue([target, client_socket, accepted, &count]() {
+                (void)target;
+                (void)client_socket;
+                (void)accepted;
+                count++;
+            });
+        }
+    };
+    
+    // Warm up: grow the injection ring and fill the node depot
+    std::atomic<bool> release{false};
+    hold_workers(pool, release);
+    enqueue_connections(2000);
+    release = true;
+    wait_until([&]() { return count.load() == 2000 && pool.get_queue_size() == 0; });
+    
+    std::atomic<bool> release_again{false};
+    hold_workers(pool, release_again);
+    size_t before = allocations;
+    enqueue_connections(1000);
+    size_t made = allocations - before;
+    release_again = true;
+    bool all = wait_until([&]() { return count.load() == 3000; });
+    check(all && made == 0, "enqueueing 1000 connection tasks allocates nothing (" + std::to_string(made) + " allocations)");
+}
+
+static void test_elastic(ThreadPool& elastic) {
+    // 40 tasks of 20 ms on 2 workers would wait up to 400 ms; the 5 ms target adds workers
+    std::atomic<int> count{0};
+    for (int i = 0; i < 40; i++) {
+        elastic.enqueue([&count]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            count++;
+        });
+    }
+    size_t peak = 0;
+    bool all = wait_until([&]() {
+        peak = std::max(peak, elastic.get_thread_count());
+        return count.load() == 40;
+    });
+    ThreadPool::ScalingStats grown = elastic.get_scaling_stats();
+    check(all && peak > 2 && peak <= 8 && grown.started > 0,
+          "queue wait over the target starts workers up to the maximum (peak " + std::to_string(peak) + ")");
+    
+    // 200 ms idle cooldown, one retirement per 100 ms check
+    bool shrunk = wait_until([&]() { return elastic.get_thread_count() == 2; });
+    ThreadPool::ScalingStats idle = elastic.get_scaling_stats();
+    check(shrunk && idle.retired == idle.started, "idle workers retire back to the minimum (" + std::to_string(idle.retired) + " retired)");
+    
+    // Retired slots are reused
+    std::atomic<int> again{0};
+    for (int i = 0; i < 20; i++) {
+        elastic.enqueue([&again]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            again++;
+        });
+    }
+    check(wait_until([&]() { return again.load() == 20; }) && elastic.get_scaling_stats().started > idle.started,
+          "a second burst starts workers again");
+}
+
+// Occupies the single pool's worker until 'release' is set
+static void hold_single(ThreadPool& single, std::atomic<bool>& release) {
+    std::atomic<bool> started{false};
+    single.enqueue([&]() {
+        started = true;
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    wait_until([&]() { return started.load(); });
+}
+
+static void test_injected_fifo(ThreadPool& single) {
+    // All 50 wait in the injection queue behind a busy worker, as connections do under load
+    std::mutex mutex;
+    std::vector<int> order;
+    std::atomic<bool> release{false};
+    hold_single(single, release);
+    for (int i = 0; i < 50; i++) {
+        single.enqueue([&, i]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(i);
+        });
+    }
+    release = true;
+    wait_until([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return order.size() == 50;
+    });
+    bool in_order = order.size() == 50;
+    for (int i = 0; in_order && i < 50; i++) {
+        in_order = order[i] == i;
+    }
+    check(in_order, "tasks enqueued from outside the pool run in enqueue order");
+}
+
+static void test_lanes(ThreadPool& single) {
+    std::mutex mutex;
+    std::vector<ThreadPool::Priority> order;
+    auto record = [&](ThreadPool::Priority priority) {
+        return [&, priority]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(priority);
+        };
+    };
+    
+    // Queued behind 20 others, HIGH tasks still run first
+    std::atomic<bool> release{false};
+    hold_single(single, release);
+    for (int i = 0; i < 10; i++) {
+        single.enqueue(record(ThreadPool::LOW), ThreadPool::LOW);
+        single.enqueue(record(ThreadPool::NORMAL), ThreadPool::NORMAL);
+    }
+    for (int i = 0; i < 10; i++) {
+        single.enqueue(record(ThreadPool::HIGH), ThreadPool::HIGH);
+    }
+    check(single.get_lane_stats(ThreadPool::HIGH).queued == 10 && single.get_lane_stats(ThreadPool::LOW).queued == 10,
+          "each priority queues in its own lane");
+    release = true;
+    wait_until([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return order.size() == 30;
+    });
+    // Weighted, not strict: the other lanes get the occasional turn
+    bool high_first = order.size() == 30 && std::count(order.begin(), order.begin() + 16, ThreadPool::HIGH) == 10;
+    check(high_first, "high priority tasks run ahead of earlier normal and low ones");
+    // While all three lanes wait, 13 picks go 8/4/1
+    bool weighted = order.size() == 30 && std::count(order.begin(), order.begin() + 13, ThreadPool::HIGH) == 8 &&
+                    std::count(order.begin(), order.begin() + 13, ThreadPool::NORMAL) == 4 &&
+                    std::count(order.begin(), order.begin() + 13, ThreadPool::LOW) == 1;
+    check(weighted, "lanes that all have work are picked by weight 8/4/1");
+    
+    // Tasks a worker has not started stay counted against their lane's limit
+    std::atomic<bool> release_first{false};
+    std::atomic<bool> release_second{false};
+    std::atomic<bool> second_started{false};
+    std::atomic<int> waiting_ran{0};
+    hold_single(single, release_first);
+    single.enqueue([&]() {
+        second_started = true;
+        while (!release_second.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    for (int i = 0; i < 9; i++) {
+        single.enqueue([&waiting_ran]() { waiting_ran++; });
+    }
+    release_first = true;
+    wait_until([&]() { return second_started.load(); });
+    check(single.get_lane_stats(ThreadPool::NORMAL).queued == 9,
+          "tasks behind a running one stay queued in their lane");
+    release_second = true;
+    wait_until([&]() { return waiting_ran.load() == 9; });
+    
+    // A full lane refuses more, the others still accept
+    std::atomic<bool> release_again{false};
+    hold_single(single, release_again);
+    single.set_queue_limit(ThreadPool::LOW, 5);
+    std::atomic<int> count{0};
+    int accepted = 0;
+    for (int i = 0; i < 8; i++) {
+        accepted += single.enqueue([&count]() { count++; }, ThreadPool::LOW) ? 1 : 0;
+    }
+    std::vector<Task> batch;
+    for (int i = 0; i < 4; i++) {
+        batch.emplace_back([&count]() { count++; });
+    }
+    size_t batched = single.enqueue_batch(std::move(batch), ThreadPool::LOW);
+    bool normal_accepted = single.enqueue([&count]() { count++; }, ThreadPool::NORMAL);
+    ThreadPool::LaneStats low = single.get_lane_stats(ThreadPool::LOW);
+    check(accepted == 5 && batched == 0 && normal_accepted && low.queued == 5 && low.limit == 5 && low.rejected == 7,
+          "a lane at its limit refuses tasks and counts them (" + std::to_string(low.rejected) + " rejected)");
+    release_again = true;
+    check(wait_until([&]() { return count.load() == 6; }), "tasks accepted under the limit all run");
+    single.set_queue_limit(ThreadPool::LOW, 0);
+    
+    check(single.configure_limits("high=2,low=0") && single.get_lane_stats(ThreadPool::HIGH).limit == 2,
+          "limits parse as lane=count pairs");
+    check(!single.configure_limits("high=2,urgent=1") && !single.configure_limits("normal=many") &&
+          single.get_lane_stats(ThreadPool::HIGH).limit == 2, "an invalid limit spec changes nothing");
+    single.set_queue_limit(ThreadPool::HIGH, 0);
+}
+
+static void test_parking(ThreadPool& pool, ThreadPool& single) {
+    // Let spinners give up and park, then stay idle
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    uint64_t before = voluntary_switches();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    uint64_t wakeups = voluntary_switches() - before;
+    check(wakeups <= 3, "idle workers stay parked (" + std::to_string(wakeups) + " wakeups in 500 ms)");
+    
+    // Time from enqueue to the task starting, on a pool whose workers are all parked
+    std::vector<int64_t> latencies;
+    for (int i = 0; i < 50; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::atomic<int64_t> started{0};
+        auto enqueued = std::chrono::steady_clock::now();
+        pool.enqueue([&started]() { started = std::chrono::steady_clock::now().time_since_epoch().count(); });
+        wait_until([&]() { return started.load() != 0; });
+        latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(started.load())) - enqueued).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    check(latencies[latencies.size() / 2] < 1000,
+          "a parked worker picks a task up within a millisecond (median " + std::to_string(latencies[latencies.size() / 2]) + " us)");
+    
+    // stop() wakes parked workers directly instead of waiting for them to poll
+    auto stopping = std::chrono::steady_clock::now();
+    pool.stop();
+    single.stop();
+    auto stop_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - stopping).count();
+    check(stop_ms < 50, "stopping idle pools wakes their workers at once (" + std::to_string(stop_ms) + " ms)");
+}
+
+int main() {
+    std::cout << "Thread pool tests" << std::endl;
+
+    test_deque();
+
+    // Stopping a pool requests a process-wide shutdown, so both pools live until the end
+    ThreadPool single(1);
+    ThreadPool pool(4);
+    test_local_lifo(single);
+    test_injected_fifo(single);
+    test_queue_size(single);
+    test_all_tasks_run(pool);
+    test_stealing(pool);
+    test_batch(pool);
+    test_no_allocations(pool);
+    test_lanes(single);
+    
+    ThreadPool::Scaling scaling;
+    scaling.min_threads = 2;
+    scaling.max_threads = 8;
+    scaling.target_wait = std::chrono::milliseconds(5);
+    scaling.idle_cooldown = std::chrono::milliseconds(200);
+    ThreadPool elastic(scaling);
+    test_elastic(elastic);
+    // Back at the minimum, so its controller sleeps through the idle check below
+    wait_until([&]() { return elastic.get_thread_count() == 2; });
+    test_parking(pool, single);
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All thread pool tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
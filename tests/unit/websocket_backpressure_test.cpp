@@ -0,0 +1,94 @@
+// Unit tests for per-connection outbound limits and slow-consumer policies.
+// The connections here have no reader thread, so nothing drains their queues: this is
+// exactly the situation of a client that has stopped reading.
+#include "../../include/handlers/websocket_handler.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <atomic>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static std::string message(const std::string& type, size_t size) {
+    std::string msg = "{\"type\":\"" + type + "\",\"data\":\"";
+    msg.append(size, 'x');
+    msg += "\"}";
+    return msg;
+}
+
+// Starts a handler with one stalled subscriber on topic "t"
+struct StalledClient {
+    WebSocketHandler handler;
+    int fds[2];
+
+    explicit StalledClient(SlowConsumerPolicy policy) {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        handler.set_max_outbound_bytes(4096);
+        handler.set_slow_consumer_policy(policy);
+        handler.start();
+        handler.add_connection(fds[0], "stalled");
+        handler.subscribe("stalled", "t");
+    }
+
+    ~StalledClient() {
+        handler.remove_connection("stalled");
+        close(fds[1]);
+    }
+};
+
+static void test_drop_oldest() {
+    StalledClient client(SlowConsumerPolicy::DROP_OLDEST);
+    for (int i = 0; i < 100; i++) {
+        client.handler.publish("t", message("event", 200));
+    }
+    WebSocketHandler::BackpressureStats stats = client.handler.get_backpressure_stats();
+    check(stats.queued_bytes <= 4096 && stats.frames_dropped > 0 && stats.slow_disconnects == 0,
+          "drop_oldest keeps the queue within the byte limit");
+}
+
+static void test_coalesce() {
+    StalledClient client(SlowConsumerPolicy::COALESCE);
+    for (int i = 0; i < 100; i++) {
+        client.handler.publish("t", message("snapshot", 500));
+    }
+    WebSocketHandler::BackpressureStats stats = client.handler.get_backpressure_stats();
+    check(stats.queued_bytes <= 4096 && stats.frames_coalesced > 0 && stats.queued_frames <= 8,
+          "coalesce replaces queued messages of the same type");
+}
+
+static void test_disconnect() {
+    StalledClient client(SlowConsumerPolicy::DISCONNECT);
+    size_t delivered = 0;
+    for (int i = 0; i < 100; i++) {
+        delivered += client.handler.publish("t", message("event", 200));
+    }
+    WebSocketHandler::BackpressureStats stats = client.handler.get_backpressure_stats();
+    check(stats.slow_disconnects == 1 && delivered < 100, "disconnect closes a client that exceeds the limit");
+}
+
+static void test_oversized_message() {
+    StalledClient client(SlowConsumerPolicy::DROP_OLDEST);
+    client.handler.publish("t", message("huge", 10000));
+    WebSocketHandler::BackpressureStats stats = client.handler.get_backpressure_stats();
+    check(stats.queued_bytes == 0 && stats.frames_dropped == 1, "a message larger than the limit is dropped");
+}
+
+int main() {
+    std::cout << "WebSocket backpressure tests" << std::endl;
+
+    test_drop_oldest();
+    test_coalesce();
+    test_disconnect();
+    test_oversized_message();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All WebSocket backpressure tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+// Unit tests for permessage-deflate negotiation and message compression
+#include "../../include/network/websocket_deflate.h"
+#include "../../include/network/websocket_frame.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <atomic>
+#include <cstring>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static std::string metrics_json(int seed) {
+    std::string json = "{\"type\":\"system_metrics\",\"data\":[";
+    for (int i = 0; i < 40; i++) {
+        json += "{\"memory_mb\":" + std::to_string(100 + (seed + i) % 7) +
+                ",\"cpu_percent\":" + std::to_string((seed * i) % 100) + ".5}";
+        json += (i < 39) ? "," : "]}";
+    }
+    return json;
+}
+
+static void test_negotiation() {
+    WebSocketDeflateConfig config;
+    std::string response;
+
+    bool ok = negotiate_permessage_deflate("permessage-deflate; client_max_window_bits", config, response) &&
+              config.enabled && !config.client_no_context_takeover &&
+              response == "permessage-deflate; server_no_context_takeover";
+
+    ok = ok && negotiate_permessage_deflate(
+                   "x-webkit-deflate-frame, permessage-deflate; client_no_context_takeover; server_max_window_bits=10",
+                   config, response) &&
+         config.client_no_context_takeover && config.server_max_window_bits == 10 &&
+         response == "permessage-deflate; server_no_context_takeover; client_no_context_takeover; server_max_window_bits=10";
+
+    check(ok, "permessage-deflate offers are accepted with server_no_context_takeover");
+}
+
+static void test_declined_offers() {
+    WebSocketDeflateConfig config;
+    std::string response;
+    bool ok = !negotiate_permessage_deflate("permessage-deflate; server_max_window_bits=8", config, response) &&
+              !negotiate_permessage_deflate("permessage-deflate; unknown_param", config, response) &&
+              !negotiate_permessage_deflate("x-webkit-deflate-frame", config, response);
+
+    // A declined first offer falls through to the next acceptable one
+    ok = ok && negotiate_permessage_deflate(
+                   "permessage-deflate; server_max_window_bits=8, permessage-deflate", config, response) &&
+         config.server_max_window_bits == 15;
+    check(ok, "unsupported offers are declined");
+}
+
+static void test_round_trip_with_context_takeover() {
+    // Client side with context takeover: one deflate stream spanning messages
+    z_stream client;
+    std::memset(&client, 0, sizeof(client));
+    deflateInit2(&client, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+
+    WebSocketInflater inflater(false);
+    bool ok = true;
+    size_t raw_total = 0, compressed_total = 0;
+    for (int m = 0; m < 5 && ok; m++) {
+        std::string message = metrics_json(m);
+        std::vector<uint8_t> out(message.size() + 64);
+        client.next_in = reinterpret_cast<Bytef*>(&message[0]);
+        client.avail_in = static_cast<uInt>(message.size());
+        client.next_out = out.data();
+        client.avail_out = static_cast<uInt>(out.size());
+        deflate(&client, Z_SYNC_FLUSH);
+        out.resize(out.size() - client.avail_out - 4);   // strip 00 00 ff ff
+
+        std::vector<uint8_t> inflated;
+        ok = inflater.inflate_message(out, inflated, 1 << 20) == WebSocketInflater::OK &&
+             std::string(inflated.begin(), inflated.end()) == message;
+        raw_total += message.size();
+        compressed_total += out.size();
+    }
+    deflateEnd(&client);
+    check(ok && compressed_total * 5 < raw_total, "inflater keeps the window across messages");
+}
+
+static void test_server_compression() {
+    std::string message = metrics_json(3);
+    std::string compressed;
+    bool ok = websocket_deflate_message(message, 15, compressed) && compressed.size() * 5 < message.size();
+
+    // Each message is independent, so a fresh inflater per message must decode it
+    for (int i = 0; i < 2 && ok; i++) {
+        WebSocketInflater inflater(true);
+        std::vector<uint8_t> inflated;
+        ok = inflater.inflate_message(std::vector<uint8_t>(compressed.begin(), compressed.end()),
+                                      inflated, 1 << 20) == WebSocketInflater::OK &&
+             std::string(inflated.begin(), inflated.end()) == message;
+    }
+
+    WebSocketInflater limited(true);
+    std::vector<uint8_t> inflated;
+    ok = ok && limited.inflate_message(std::vector<uint8_t>(compressed.begin(), compressed.end()),
+                                       inflated, 100) == WebSocketInflater::TOO_LARGE;
+    check(ok, "server messages compress without context takeover and respect the size limit");
+}
+
+static void test_decoder_rsv1() {
+    const uint8_t frame[] = {0xC1, 0x80, 0, 0, 0, 0};   // FIN | RSV1 | text, masked, empty
+    WebSocketMessage message;
+
+    WebSocketFrameDecoder plain;
+    plain.feed(frame, sizeof(frame));
+    bool ok = plain.next(message) == WebSocketFrameDecoder::PROTOCOL_ERROR;
+
+    WebSocketFrameDecoder negotiated;
+    negotiated.set_allow_rsv1(true);
+    negotiated.feed(frame, sizeof(frame));
+    ok = ok && negotiated.next(message) == WebSocketFrameDecoder::MESSAGE && message.compressed;
+
+    const uint8_t ping[] = {0xC9, 0x80, 0, 0, 0, 0};     // RSV1 on a control frame
+    WebSocketFrameDecoder control;
+    control.set_allow_rsv1(true);
+    control.feed(ping, sizeof(ping));
+    ok = ok && control.next(message) == WebSocketFrameDecoder::PROTOCOL_ERROR;
+    check(ok, "RSV1 accepted only on data frames after negotiation");
+}
+
+int main() {
+    std::cout << "WebSocket permessage-deflate tests" << std::endl;
+
+    test_negotiation();
+    test_declined_offers();
+    test_round_trip_with_context_takeover();
+    test_server_compression();
+    test_decoder_rsv1();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All WebSocket deflate tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+// Unit tests for the incremental WebSocket frame decoder and SIMD unmasking
+#include "../../include/network/websocket_frame.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <atomic>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+// Build a masked client frame
+static std::vector<uint8_t> client_frame(uint8_t opcode, const std::vector<uint8_t>& payload,
+                                         bool fin = true, const uint8_t* mask_key = nullptr) {
+    static const uint8_t default_mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+    const uint8_t* mask = mask_key ? mask_key : default_mask;
+    std::vector<uint8_t> frame;
+    frame.push_back((fin ? 0x80 : 0x00) | opcode);
+
+    uint64_t len = payload.size();
+    if (len < 126) {
+        frame.push_back(0x80 | static_cast<uint8_t>(len));
+    } else if (len < 65536) {
+        frame.push_back(0x80 | 126);
+        frame.push_back(static_cast<uint8_t>(len >> 8));
+        frame.push_back(static_cast<uint8_t>(len & 0xFF));
+    } else {
+        frame.push_back(0x80 | 127);
+        for (int i = 7; i >= 0; i--) {
+            frame.push_back(static_cast<uint8_t>((len >> (8 * i)) & 0xFF));
+        }
+    }
+    frame.insert(frame.end(), mask, mask + 4);
+    for (size_t i = 0; i < payload.size(); i++) {
+        frame.push_back(payload[i] ^ mask[i % 4]);
+    }
+    return frame;
+}
+
+static std::vector<uint8_t> bytes(const std::string& text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+static std::vector<uint8_t> pattern(size_t len) {
+    std::vector<uint8_t> data(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = static_cast<uint8_t>((i * 131 + 7) & 0xFF);
+    }
+    return data;
+}
+
+static void test_unmask_matches_scalar() {
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    bool ok = true;
+    for (size_t len = 0; len < 300 && ok; len++) {
+        for (size_t offset = 0; offset < 4 && ok; offset++) {
+            std::vector<uint8_t> data = pattern(len);
+            std::vector<uint8_t> expected = data;
+            for (size_t i = 0; i < len; i++) {
+                expected[i] ^= mask[(i + offset) % 4];
+            }
+            websocket_unmask(data.data(), data.size(), mask, offset);
+            ok = (data == expected);
+        }
+    }
+    check(ok, "vectorized unmask matches byte-wise reference for all lengths/offsets");
+}
+
+static void test_single_frame() {
+    WebSocketFrameDecoder decoder;
+    auto frame = client_frame(0x1, bytes("request_metrics"));
+    decoder.feed(frame.data(), frame.size());
+
+    WebSocketMessage message;
+    bool ok = decoder.next(message) == WebSocketFrameDecoder::MESSAGE &&
+              message.opcode == 0x1 && message.payload == bytes("request_metrics") &&
+              decoder.next(message) == WebSocketFrameDecoder::NEED_MORE;
+    check(ok, "single masked text frame");
+}
+
+static void test_byte_at_a_time() {
+    WebSocketFrameDecoder decoder;
+    auto payload = pattern(70000);
+    auto frame = client_frame(0x2, payload);
+
+    WebSocketMessage message;
+    size_t messages = 0;
+    for (size_t i = 0; i < frame.size(); i++) {
+        decoder.feed(&frame[i], 1);
+        if (decoder.next(message) == WebSocketFrameDecoder::MESSAGE) {
+            messages++;
+        }
+    }
+    check(messages == 1 && message.opcode == 0x2 && message.payload == payload,
+          "64-bit length frame delivered one byte at a time");
+}
+
+static void test_multiple_frames_one_read() {
+    WebSocketFrameDecoder decoder;
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 5; i++) {
+        auto frame = client_frame(0x1, bytes("msg" + std::to_string(i)));
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    decoder.feed(stream.data(), stream.size());
+
+    WebSocketMessage message;
+    bool ok = true;
+    for (int i = 0; i < 5; i++) {
+        ok = ok && decoder.next(message) == WebSocketFrameDecoder::MESSAGE &&
+             message.payload == bytes("msg" + std::to_string(i));
+    }
+    ok = ok && decoder.next(message) == WebSocketFrameDecoder::NEED_MORE;
+    check(ok, "several frames in one read");
+}
+
+static void test_fragmented_with_interleaved_ping() {
+    WebSocketFrameDecoder decoder;
+    auto part1 = client_frame(0x2, pattern(5000), false);
+    auto ping = client_frame(0x9, bytes("hb"));
+    auto part2 = client_frame(0x0, pattern(3000), true);
+
+    std::vector<uint8_t> stream;
+    stream.insert(stream.end(), part1.begin(), part1.end());
+    stream.insert(stream.end(), ping.begin(), ping.end());
+    stream.insert(stream.end(), part2.begin(), part2.end());
+
+    // Split the stream at awkward boundaries
+    WebSocketMessage message;
+    std::vector<WebSocketMessage> received;
+    size_t pos = 0;
+    size_t step = 1;
+    while (pos < stream.size()) {
+        size_t chunk = std::min(step, stream.size() - pos);
+        decoder.feed(&stream[pos], chunk);
+        pos += chunk;
+        step = step * 3 + 1;
+        while (decoder.next(message) == WebSocketFrameDecoder::MESSAGE) {
+            received.push_back(message);
+        }
+    }
+
+    std::vector<uint8_t> expected = pattern(5000);
+    std::vector<uint8_t> tail = pattern(3000);
+    expected.insert(expected.end(), tail.begin(), tail.end());
+
+    bool ok = received.size() == 2 &&
+              received[0].opcode == 0x9 && received[0].payload == bytes("hb") &&
+              received[1].opcode == 0x2 && received[1].payload == expected;
+    check(ok, "fragmented message reassembled around an interleaved ping");
+}
+
+static void test_max_message_size() {
+    WebSocketFrameDecoder decoder(1024);
+    auto part1 = client_frame(0x1, pattern(800), false);
+    auto part2 = client_frame(0x0, pattern(800), true);
+    decoder.feed(part1.data(), part1.size());
+    decoder.feed(part2.data(), part2.size());
+
+    WebSocketMessage message;
+    bool ok = decoder.next(message) == WebSocketFrameDecoder::PROTOCOL_ERROR &&
+              decoder.close_code() == WebSocketFrameDecoder::CLOSE_MESSAGE_TOO_BIG;
+    check(ok, "reassembled message over the limit is rejected with 1009");
+}
+
+static void test_protocol_errors() {
+    WebSocketMessage message;
+
+    WebSocketFrameDecoder unmasked;
+    const uint8_t raw[] = {0x81, 0x02, 'h', 'i'};
+    unmasked.feed(raw, sizeof(raw));
+    bool ok = unmasked.next(message) == WebSocketFrameDecoder::PROTOCOL_ERROR &&
+              unmasked.close_code() == WebSocketFrameDecoder::CLOSE_PROTOCOL_ERROR;
+
+    WebSocketFrameDecoder orphan;
+    auto continuation = client_frame(0x0, bytes("x"));
+    orphan.feed(continuation.data(), continuation.size());
+    ok = ok && orphan.next(message) == WebSocketFrameDecoder::PROTOCOL_ERROR;
+
+    WebSocketFrameDecoder big_control;
+    auto ping = client_frame(0x9, pattern(200));
+    big_control.feed(ping.data(), ping.size());
+    ok = ok && big_control.next(message) == WebSocketFrameDecoder::PROTOCOL_ERROR;
+
+    check(ok, "unmasked, orphan continuation and oversized control frames are rejected");
+}
+
+static void test_ring_buffer_wrap() {
+    ByteRingBuffer ring(64);
+    std::vector<uint8_t> first = pattern(50);
+    ring.write(first.data(), first.size());
+    std::vector<uint8_t> out(40);
+    ring.read(out.data(), out.size());
+
+    std::vector<uint8_t> second = pattern(45);
+    ring.write(second.data(), second.size());   // wraps around the end
+
+    std::vector<uint8_t> all(ring.size());
+    ring.read(all.data(), all.size());
+
+    std::vector<uint8_t> expected(first.begin() + 40, first.end());
+    expected.insert(expected.end(), second.begin(), second.end());
+    check(all == expected && ring.empty(), "ring buffer preserves order across wrap-around");
+}
+
+int main() {
+    std::cout << "WebSocket frame decoder tests" << std::endl;
+
+    test_unmask_matches_scalar();
+    test_single_frame();
+    test_byte_at_a_time();
+    test_multiple_frames_one_read();
+    test_fragmented_with_interleaved_ping();
+    test_max_message_size();
+    test_protocol_errors();
+    test_ring_buffer_wrap();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All WebSocket frame tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
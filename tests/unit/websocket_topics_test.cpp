@@ -0,0 +1,82 @@
+// Unit tests for the sharded WebSocket topic index
+#include "../../include/handlers/websocket_handler.h"
+#include "check.h"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <atomic>
+
+// Defined in main.cpp for the server binary; tests link the server objects without it
+std::atomic<bool> g_shutdown_requested{false};
+
+static std::shared_ptr<WebSocketConnection> make_conn(int id) {
+    return std::make_shared<WebSocketConnection>(-1, "client_" + std::to_string(id));
+}
+
+static void test_subscribe_unsubscribe() {
+    WebSocketTopicIndex index;
+    auto a = make_conn(1);
+    auto b = make_conn(2);
+
+    bool ok = index.subscribe("users", a) && index.subscribe("users", b) && !index.subscribe("users", a) &&
+              index.subscribe("metrics", a) && index.subscriber_count("users") == 2 && index.topic_count() == 2;
+
+    auto snapshot = index.subscribers("users");
+    ok = ok && index.unsubscribe("users", a) && !index.unsubscribe("users", a) &&
+         index.subscriber_count("users") == 1 && snapshot->size() == 2;   // old snapshot unchanged
+
+    ok = ok && index.unsubscribe("users", b) && index.subscriber_count("users") == 0 && index.topic_count() == 1;
+    check(ok, "subscribe/unsubscribe with copy-on-write snapshots");
+}
+
+static void test_topic_names() {
+    bool ok = WebSocketTopicIndex::is_valid_topic("metrics") &&
+              WebSocketTopicIndex::is_valid_topic("orders.eu-west:1") &&
+              !WebSocketTopicIndex::is_valid_topic("") &&
+              !WebSocketTopicIndex::is_valid_topic("has space") &&
+              !WebSocketTopicIndex::is_valid_topic(std::string(65, 'x'));
+    check(ok, "topic name validation");
+}
+
+static void test_concurrent_updates() {
+    WebSocketTopicIndex index;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&index, t]() {
+            for (int i = 0; i < 200; i++) {
+                auto conn = make_conn(t * 1000 + i);
+                std::string topic = "topic" + std::to_string(i % 10);
+                index.subscribe(topic, conn);
+                if (i % 2 == 0) {
+                    index.unsubscribe(topic, conn);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < 10; i++) {
+        total += index.subscriber_count("topic" + std::to_string(i));
+    }
+    check(total == 8 * 100, "concurrent subscribers across shards are all accounted for");
+}
+
+int main() {
+    std::cout << "WebSocket topic index tests" << std::endl;
+
+    test_subscribe_unsubscribe();
+    test_topic_names();
+    test_concurrent_updates();
+
+    if (failures > 0) {
+        std::cout << failures << " test(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All WebSocket topic tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}